@@ -207,6 +207,10 @@ typedef struct {
     // frag scoreboard
     scoreboard_t *scores; // [cl.maxclients]
 
+    int protocol; // PROTOCOL_VERSION or PROTOCOL_DELTA
+    entityframe_t *entityframes; // PROTOCOL_DELTA only, [ENTITY_FRAMES]
+    int entityack; // last svc_entities sequence received, acknowledged in every clc_move
+
 #ifdef QUAKE2
     // light level at player's position including dlights
     // this is sent back to the server each frame
@@ -317,6 +321,17 @@ void CL_Record_f(void);
 void CL_PlayDemo_f(void);
 void CL_TimeDemo_f(void);
 
+// the parts of a frame timedemo reports on
+typedef enum {
+    td_server, // Host_ServerFrame
+    td_parse, // CL_ReadFromServer
+    td_screen, // SCR_UpdateScreen
+    td_audio, // S_Update and CDAudio_Update
+    TD_NUMPHASES
+} tdphase_t;
+
+void CL_TimeDemoFrame(uint32_t const phase[TD_NUMPHASES]);
+
 //
 // cl_parse.c
 //
@@ -167,6 +167,9 @@ struct cache_user_s;
 extern char com_gamedir[MAX_OSPATH];
 
 void COM_WriteFile(char const *filename, void const *data, int len);
+void COM_CreatePath(char *path);
+// forgets cached failed lookups, call after creating files in the game directory
+void COM_FlushMisses(void);
 int COM_OpenFile(char const *filename, int *hndl);
 int COM_FOpenFile(char const *filename, FILE **file);
 void COM_CloseFile(int h);
@@ -175,6 +178,9 @@ byte *COM_LoadStackFile(char const *path, void *buffer, int bufsize);
 byte *COM_LoadTempFile(char const *path);
 byte *COM_LoadHunkFile(char const *path);
 void COM_LoadCacheFile(char const *path, struct cache_user_s *cu);
+// read only view into a mapped pak, NULL if the file has to be loaded instead
+byte const *COM_MapFile(char const *path, int *length);
+int COM_FileSource(char const *filename, char *path, size_t path_len, int *offset, byte const **mapped);
 
 extern struct cvar_s registered;
 
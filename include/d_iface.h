@@ -122,7 +122,7 @@ extern float r_aliasuvscale; // scale-up factor for screen u and v
 extern int r_pixbytes;
 extern qboolean r_dowarp;
 
-extern affinetridesc_t r_affinetridesc;
+extern THREAD_LOCAL affinetridesc_t r_affinetridesc;
 extern spritedesc_t r_spritedesc;
 extern zpointdesc_t r_zpointdesc;
 extern polydesc_t r_polydesc;
@@ -174,7 +174,7 @@ extern byte *r_skysource;
 // !!! must be kept the same as in quakeasm.h !!!
 #define TRANSPARENT_COLOR 0xFF
 
-extern void *acolormap; // FIXME: should go away
+extern THREAD_LOCAL void *acolormap; // FIXME: should go away
 
 //=======================================================================//
 
@@ -192,7 +192,7 @@ typedef struct {
     int surfheight; // in mipmapped texels
 } drawsurf_t;
 
-extern drawsurf_t r_drawsurf;
+extern THREAD_LOCAL drawsurf_t r_drawsurf;
 
 void R_DrawSurface(void);
 void R_GenTile(msurface_t *psurf, void *pdest);
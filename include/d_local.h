@@ -60,12 +60,12 @@ extern qboolean d_roverwrapped;
 extern surfcache_t *sc_rover;
 extern surfcache_t *d_initial_rover;
 
-extern float d_sdivzstepu, d_tdivzstepu, d_zistepu;
-extern float d_sdivzstepv, d_tdivzstepv, d_zistepv;
-extern float d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+extern THREAD_LOCAL float d_sdivzstepu, d_tdivzstepu, d_zistepu;
+extern THREAD_LOCAL float d_sdivzstepv, d_tdivzstepv, d_zistepv;
+extern THREAD_LOCAL float d_sdivzorigin, d_tdivzorigin, d_ziorigin;
 
-extern fixed16_t sadjust, tadjust;
-extern fixed16_t bbextents, bbextentt;
+extern THREAD_LOCAL fixed16_t sadjust, tadjust;
+extern THREAD_LOCAL fixed16_t bbextents, bbextentt;
 
 void D_DrawSpans8(espan_t *pspans);
 void D_DrawSpans16(espan_t *pspans);
@@ -75,10 +75,22 @@ void D_SpriteDrawSpans(sspan_t *pspan);
 
 void D_DrawSkyScans8(espan_t *pspan);
 void D_DrawSkyScans16(espan_t *pspan);
+void D_Sky_uv_To_st(int u, int v, fixed16_t *s, fixed16_t *t);
+
+extern THREAD_LOCAL unsigned char *r_turb_pbase, *r_turb_pdest;
+extern THREAD_LOCAL fixed16_t r_turb_s, r_turb_t, r_turb_sstep, r_turb_tstep;
+extern THREAD_LOCAL int *r_turb_turb;
+extern THREAD_LOCAL int r_turb_spancount;
+void D_DrawTurbulent8Span(void);
+
+// sets the d_draw* pointers to the fastest span drawers, d_simd.c
+void D_SelectSpanDrawers(void);
 
 void R_ShowSubDiv(void);
 extern void (*prealspandrawer)(void);
+qboolean D_AllocSurface(msurface_t *surface, int miplevel, surfcache_t **pcache);
 surfcache_t *D_CacheSurface(msurface_t *surface, int miplevel);
+void D_DrawBandSurfaces(surfcache_t **caches);
 
 extern int D_MipLevelForScale(float scale);
 
@@ -95,6 +107,9 @@ extern int d_scantable[MAXHEIGHT];
 
 extern int d_vrectx, d_vrecty, d_vrectright_particle, d_vrectbottom_particle;
 
+// rows the thread draws, narrowed to one band by r_band.c
+extern THREAD_LOCAL int d_bandtop, d_bandbottom;
+
 extern int d_y_aspect_shift, d_pix_min, d_pix_max, d_pix_shift;
 
 extern pixel_t *d_viewbuffer;
@@ -105,3 +120,6 @@ extern int d_minmip;
 extern float d_scalemip[3];
 
 extern void (*d_drawspans)(espan_t *pspan);
+extern void (*d_drawzspans)(espan_t *pspan);
+extern void (*d_drawturbulent)(espan_t *pspan);
+extern void (*d_drawskyscans)(espan_t *pspan);
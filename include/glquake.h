@@ -155,9 +155,9 @@ extern int c_brush_polys, c_alias_polys;
 //
 // view origin
 //
-extern vec3_t vup;
-extern vec3_t vpn;
-extern vec3_t vright;
+extern THREAD_LOCAL vec3_t vup;
+extern THREAD_LOCAL vec3_t vpn;
+extern THREAD_LOCAL vec3_t vright;
 extern vec3_t r_origin;
 
 //
@@ -0,0 +1,44 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs.h -- worker threads for splitting a frame's work across cores
+
+/*
+Jobs_Run(func, count, arg) calls func(index, arg) for every index below count,
+spread over the worker threads and the calling thread, and returns once all of
+them are done. Jobs can't start other jobs.
+
+Building without ENABLE_THREADS runs the jobs one after another on the calling
+thread, and THREAD_LOCAL globals become plain globals.
+*/
+
+#ifdef ENABLE_THREADS
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+#define MAX_JOB_THREADS 16
+
+typedef void (*jobfunc_t)(int index, void *arg);
+
+void Jobs_Init(void);
+// threads Jobs_Run spreads work over, counting the calling thread
+int Jobs_NumThreads(void);
+void Jobs_Run(jobfunc_t func, int count, void *arg);
@@ -0,0 +1,69 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// mod_bake.h -- brush models saved the way they are in memory, to load without parsing
+
+/*
+A brush model parses into one run of low hunk memory. Baking writes that run
+out with every pointer in it turned into an offset from its start, followed by
+the model_t of the world and of each of its submodels, and the offsets of the
+pointers. Loading it is one read into the hunk and adding the address it went
+to onto each pointer.
+
+The renderer's model loader knows where its pointers are:
+
+Mod_BakeBegin(&format, mark, models, nummodels);
+Mod_BakePointer(&models[0]->planes); // and every other pointer
+Mod_BakeEnd(models[0]->name);
+
+maps/e1m1.bsp bakes to maps/e1m1 plus the renderer's extension. A baked model
+is only loaded by builds with the same structures, and only while the .bsp has
+the same size and CRC, otherwise the .bsp is parsed as usual.
+*/
+
+typedef struct {
+    char const *extension; // of the baked files, with the dot
+    int const *sizes; // of the structures baked, to tell builds apart
+    int numsizes;
+    void *const *externals; // addresses of the pointers to things outside the model
+    int numexternals;
+} bakeformat_t;
+
+// starts baking the models parsed into the low hunk since mark
+void Mod_BakeBegin(bakeformat_t const *format, int mark, model_t **models, int nummodels);
+// field is the address of a pointer in the hunk run or one of the models,
+// NULL pointers and ones seen before are left alone
+void Mod_BakePointer(void *field);
+// writes name's baked file to the game directory
+void Mod_BakeEnd(char const *name);
+
+extern qboolean mod_baking; // parse brush models even when there's a baked one
+
+// reads name's baked model into the low hunk if there's an up to date one,
+// *models points at the model_t's until the next Hunk_TempAlloc
+int Mod_LoadBaked(bakeformat_t const *format, char const *name, model_t const **models);
+
+// the renderer's part of mod_bake, bakes mod and its submodels, which were
+// just parsed into the low hunk after mark
+void Mod_BakeModel(model_t *mod, int mark);
+// and the files it bakes to
+extern bakeformat_t const mod_bakeformat;
+
+// name's baked file, false when they aren't loaded
+qboolean Mod_BakedPath(char const *name, char *path, int pathsize);
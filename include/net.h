@@ -149,7 +149,7 @@ extern qsocket_t *net_freeSockets;
 extern int net_numsockets;
 
 typedef struct {
-    char *name;
+    char const *name;
     qboolean initialized;
     int controlSock;
     int (*Init)(void);
@@ -170,10 +170,12 @@ typedef struct {
     int (*AddrCompare)(struct qsockaddr *addr1, struct qsockaddr *addr2);
     int (*GetSocketPort)(struct qsockaddr *addr);
     int (*SetSocketPort)(struct qsockaddr *addr, int port);
+    void (*Flush)(int socket); // sends what Write queued up
 } net_landriver_t;
 
 #define MAX_NET_DRIVERS 8
 extern int net_numlandrivers;
+extern int net_landriverlevel;
 extern net_landriver_t net_landrivers[MAX_NET_DRIVERS];
 
 typedef struct {
@@ -192,6 +194,7 @@ typedef struct {
     void (*Close)(qsocket_t *sock);
     void (*Shutdown)(void);
     int controlSock;
+    void (*Poll)(void); // reads what arrived and sends what's queued, NULL if it has nothing to do
 } net_driver_t;
 
 extern int net_numdrivers;
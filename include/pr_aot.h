@@ -0,0 +1,43 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_aot.h -- interface between the interpreter and progs compiled to C++ by qcc2cpp
+
+typedef void (*pr_native_t)(void);
+
+// provided by the generated pr_aot.c, only used when its progs crc matches
+extern unsigned short const pr_aot_crc;
+extern int const pr_aot_numstatements;
+extern int const pr_aot_numfunctions;
+extern pr_native_t const pr_aot_functions[]; // NULL for builtins and functions left to the interpreter
+
+extern int pr_aot_runaway;
+
+int PR_EnterFunction(dfunction_t *f);
+int PR_LeaveFunction(void);
+void PR_AotCall(func_t fnum, int argc);
+
+// checked on every backwards branch instead of every statement
+#define PR_AOT_LOOP(statement)                                                                                         \
+    do {                                                                                                               \
+        if (!--pr_aot_runaway) {                                                                                       \
+            pr_xstatement = statement;                                                                                 \
+            PR_RunError("runaway loop error");                                                                         \
+        }                                                                                                              \
+    } while (0)
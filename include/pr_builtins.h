@@ -0,0 +1,196 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_builtins.h -- the builtin table, shared by pr_cmds.c and natively compiled progs
+
+#include <iterator>
+
+void PF_Find(void);
+void PF_Fixme(void);
+void PF_Remove(void);
+void PF_Spawn(void);
+void PF_TraceToss(void);
+void PF_WaterMove(void);
+void PF_WriteAngle(void);
+void PF_WriteByte(void);
+void PF_WriteChar(void);
+void PF_WriteCoord(void);
+void PF_WriteEntity(void);
+void PF_WriteLong(void);
+void PF_WriteShort(void);
+void PF_WriteString(void);
+void PF_aim(void);
+void PF_ambientsound(void);
+void PF_bprint(void);
+void PF_break(void);
+void PF_ceil(void);
+void PF_centerprint(void);
+void PF_changelevel(void);
+void PF_changepitch(void);
+void PF_changeyaw(void);
+void PF_checkbottom(void);
+void PF_checkclient(void);
+void PF_coredump(void);
+void PF_cos(void);
+void PF_cvar(void);
+void PF_cvar_set(void);
+void PF_dprint(void);
+void PF_droptofloor(void);
+void PF_eprint(void);
+void PF_error(void);
+void PF_etos(void);
+void PF_fabs(void);
+void PF_findradius(void);
+void PF_floor(void);
+void PF_ftos(void);
+void PF_lightstyle(void);
+void PF_localcmd(void);
+void PF_makestatic(void);
+void PF_makevectors(void);
+void PF_nextent(void);
+void PF_normalize(void);
+void PF_objerror(void);
+void PF_particle(void);
+void PF_pointcontents(void);
+void PF_precache_file(void);
+void PF_precache_model(void);
+void PF_precache_sound(void);
+void PF_random(void);
+void PF_rint(void);
+void PF_setmodel(void);
+void PF_setorigin(void);
+void PF_setsize(void);
+void PF_setspawnparms(void);
+void PF_sin(void);
+void PF_sound(void);
+void PF_sprint(void);
+void PF_sqrt(void);
+void PF_stuffcmd(void);
+void PF_traceline(void);
+void PF_traceoff(void);
+void PF_traceon(void);
+void PF_vectoangles(void);
+void PF_vectoyaw(void);
+void PF_vlen(void);
+void PF_vtos(void);
+void PF_walkmove(void);
+void SV_MoveToGoal(void);
+
+inline constexpr builtin_t pr_builtin[] = { PF_Fixme,
+                           PF_makevectors, // void(entity e)	makevectors 		= #1;
+                           PF_setorigin, // void(entity e, vector o) setorigin	= #2;
+                           PF_setmodel, // void(entity e, string m) setmodel	= #3;
+                           PF_setsize, // void(entity e, vector min, vector max) setsize = #4;
+                           PF_Fixme, // void(entity e, vector min, vector max) setabssize = #5;
+                           PF_break, // void() break						= #6;
+                           PF_random, // float() random						= #7;
+                           PF_sound, // void(entity e, float chan, string samp) sound = #8;
+                           PF_normalize, // vector(vector v) normalize			= #9;
+                           PF_error, // void(string e) error				= #10;
+                           PF_objerror, // void(string e) objerror				= #11;
+                           PF_vlen, // float(vector v) vlen				= #12;
+                           PF_vectoyaw, // float(vector v) vectoyaw		= #13;
+                           PF_Spawn, // entity() spawn						= #14;
+                           PF_Remove, // void(entity e) remove				= #15;
+                           PF_traceline, // float(vector v1, vector v2, float tryents) traceline = #16;
+                           PF_checkclient, // entity() clientlist					= #17;
+                           PF_Find, // entity(entity start, .string fld, string match) find = #18;
+                           PF_precache_sound, // void(string s) precache_sound		= #19;
+                           PF_precache_model, // void(string s) precache_model		= #20;
+                           PF_stuffcmd, // void(entity client, string s)stuffcmd = #21;
+                           PF_findradius, // entity(vector org, float rad) findradius = #22;
+                           PF_bprint, // void(string s) bprint				= #23;
+                           PF_sprint, // void(entity client, string s) sprint = #24;
+                           PF_dprint, // void(string s) dprint				= #25;
+                           PF_ftos, // void(string s) ftos				= #26;
+                           PF_vtos, // void(string s) vtos				= #27;
+                           PF_coredump,
+                           PF_traceon,
+                           PF_traceoff,
+                           PF_eprint, // void(entity e) debug print an entire entity
+                           PF_walkmove, // float(float yaw, float dist) walkmove
+                           PF_Fixme, // float(float yaw, float dist) walkmove
+                           PF_droptofloor,
+                           PF_lightstyle,
+                           PF_rint,
+                           PF_floor,
+                           PF_ceil,
+                           PF_Fixme,
+                           PF_checkbottom,
+                           PF_pointcontents,
+                           PF_Fixme,
+                           PF_fabs,
+                           PF_aim,
+                           PF_cvar,
+                           PF_localcmd,
+                           PF_nextent,
+                           PF_particle,
+                           PF_changeyaw,
+                           PF_Fixme,
+                           PF_vectoangles,
+
+                           PF_WriteByte,
+                           PF_WriteChar,
+                           PF_WriteShort,
+                           PF_WriteLong,
+                           PF_WriteCoord,
+                           PF_WriteAngle,
+                           PF_WriteString,
+                           PF_WriteEntity,
+
+#ifdef QUAKE2
+                           PF_sin,
+                           PF_cos,
+                           PF_sqrt,
+                           PF_changepitch,
+                           PF_TraceToss,
+                           PF_etos,
+                           PF_WaterMove,
+#else
+                           PF_Fixme,          PF_Fixme,         PF_Fixme,       PF_Fixme,
+                           PF_Fixme,          PF_Fixme,         PF_Fixme,
+#endif
+
+                           SV_MoveToGoal,
+                           PF_precache_file,
+                           PF_makestatic,
+
+                           PF_changelevel,
+                           PF_Fixme,
+
+                           PF_cvar_set,
+                           PF_centerprint,
+
+                           PF_ambientsound,
+
+                           PF_precache_model,
+                           PF_precache_sound, // precache_sound2 is different only for qcc
+                           PF_precache_file,
+
+                           PF_setspawnparms };
+
+// calls builtin number n directly when the number is known at compile time
+template <int n>
+inline void PR_CallBuiltin(void)
+{
+    if constexpr (n < std::size(pr_builtin))
+        pr_builtin[n]();
+    else
+        PR_RunError("Bad builtin call number");
+}
@@ -0,0 +1,46 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// prefetch.h -- reading the next level's files ahead on a background thread
+
+/*
+Once a level is up, Prefetch_Level looks through its entities for the maps it
+can change level to ("map" keys, trigger_changelevel's) and a background thread
+reads their .bsp and baked files while the level is played, up to prefetch
+kilobytes of them.
+
+Files in a mapped pak are only read through, so the mapping doesn't wait on the
+disk later. Others are copied into a staging area of -prefetch <kilobytes> set
+aside from the heap at startup (none unless asked for), where COM_LoadFile and
+Mod_LoadBaked find them with Prefetch_Find.
+
+Builds without ENABLE_THREADS don't prefetch.
+*/
+
+void Prefetch_Init(void);
+// throws away what was read ahead for the last level and starts on this one's
+void Prefetch_Level(char const *entities, char const *mapname);
+// throws away everything read ahead
+void Prefetch_Flush(void);
+// throws away what was read ahead of a file that was just written
+void Prefetch_Drop(char const *path);
+
+// the staged copy of a file, valid until the next Prefetch_Level or Prefetch_Flush,
+// waits if the thread is reading it right now
+byte const *Prefetch_Find(char const *path, int *length);
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// profile.h -- scoped zone profiler
+
+/*
+PROF_BEGIN("name") and PROF_END() time what runs between them:
+
+void R_RenderView(void)
+{
+    PROF_BEGIN("R_RenderView");
+    ...
+    PROF_END();
+}
+
+They nest, every return in between needs its PROF_END. Every scope is recorded
+to a ring of trace events that profile_dump writes out in Chrome's trace event
+format, and is totalled per frame for the summary prof_show prints to the
+console. Building without ENABLE_PROFILER compiles the scopes away.
+
+The open scopes are kept on a fixed stack per thread rather than in objects on
+the C stack, which a Host_Error longjmp can't unwind; Prof_Unwind ends the
+scopes the longjmp skipped.
+*/
+
+#ifdef ENABLE_PROFILER
+
+typedef struct profzone_s {
+    char const *name;
+    struct profzone_s *next; // registered zones, set on first use
+    qboolean registered;
+    uint32_t calls; // since the last summary
+    uint64_t total, self; // microseconds since the last summary
+} profzone_t;
+
+#define PROF_CONCAT2(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT2(a, b)
+#define PROF_BEGIN(name) \
+    do { \
+        static profzone_t PROF_CONCAT(prof_zone_, __LINE__) = {name}; \
+        Prof_Begin(&PROF_CONCAT(prof_zone_, __LINE__)); \
+    } while (0)
+#define PROF_END() Prof_End()
+
+void Prof_Begin(profzone_t *z);
+void Prof_End(void);
+// called by Host_Frame once a frame is done
+void Prof_EndFrame(void);
+// ends the scopes a Host_Error longjmp skipped
+void Prof_Unwind(void);
+
+#else
+
+#define PROF_BEGIN(name)
+#define PROF_END()
+#define Prof_EndFrame()
+#define Prof_Unwind()
+
+#endif
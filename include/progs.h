@@ -34,6 +34,7 @@ typedef union eval_s {
 typedef struct edict_s {
     qboolean free;
     link_t area; // linked to a division node or leaf
+    link_t gridlink; // linked to the find grid cell holding the centre of absmin/absmax
 
     int num_leafs;
     short leafnums[MAX_ENT_LEAFS];
@@ -45,6 +46,7 @@ typedef struct edict_s {
     // other fields from progs come immediately after
 } edict_t;
 #define EDICT_FROM_AREA(l) STRUCT_FROM_LINK(l, edict_t, area)
+#define EDICT_FROM_GRID(l) STRUCT_FROM_LINK(l, edict_t, gridlink)
 
 //============================================================================
 
@@ -57,12 +59,18 @@ extern float *pr_globals; // same as pr_global_struct
 
 extern int pr_edict_size; // in bytes
 
+// find()'s .classname index follows the edicts through these
+void PF_FindReset(void); // all new edicts
+void PF_FindRelink(edict_t *ed); // cleared, parsed or freed
+void PF_FindStored(int ofs); // after a string store to the edicts at byte offset ofs
+
 //============================================================================
 
 void PR_Init(void);
 
 void PR_ExecuteProgram(func_t fnum);
 void PR_LoadProgs(void);
+void PR_DecodeProgram(void);
 
 void PR_Profile_f(void);
 
@@ -126,3 +134,9 @@ void ED_PrintEdicts(void);
 void ED_PrintNum(int ent);
 
 eval_t *GetEdictFieldValue(edict_t *ed, char const *field);
+
+// offsets in ints of optional fields that aren't in entvars_t, -1 when the progs don't define them
+extern int pr_field_items2;
+extern int pr_field_gravity;
+#define EDICT_FIELD(ed, ofs) ((ofs) < 0 ? NULL : (eval_t *)((int *)&(ed)->v + (ofs)))
+dfunction_t *ED_FindFunction(char const *name);
@@ -20,6 +20,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // protocol.h -- communications protocols
 
 #define PROTOCOL_VERSION 15
+// sv_protocol 16: entities are sent in svc_entities, as changes from the last
+// frame the client acknowledged in its clc_move
+#define PROTOCOL_DELTA 16
 
 // if the high bit of the servercmd is set, the low bits are fast update flags:
 #define U_MOREBITS (1 << 0)
@@ -39,6 +42,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define U_SKIN (1 << 12)
 #define U_EFFECTS (1 << 13)
 #define U_LONGENTITY (1 << 14)
+#define U_REMOVE (1 << 15) // svc_entities only, the entity left the frame, no data follows
 
 #define SU_VIEWHEIGHT (1 << 0)
 #define SU_IDEALPITCH (1 << 1)
@@ -126,15 +130,31 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define svc_cutscene 34
 
+#define svc_entities 35 // [long] sequence [long] delta from sequence, 0 for the baselines,
+    // then updates ending in a 0 byte
+
 //
 // client to server
 //
 #define clc_bad 0
 #define clc_nop 1
 #define clc_disconnect 2
-#define clc_move 3 // [usercmd_t]
+#define clc_move 3 // [usercmd_t] (PROTOCOL_DELTA: [long] last svc_entities sequence received)
 #define clc_stringcmd 4 // [string] message
 
+//
+// PROTOCOL_DELTA entity frames, both ends keep the last ENTITY_FRAMES of them.
+// The client's hold every entity there can be, the server's MAX_FRAME_ENTITIES
+//
+#define ENTITY_FRAMES 16 // a power of two
+
+typedef struct {
+    int sequence; // 0 while unused
+    int numentities;
+    short *nums; // ascending
+    entity_state_t *states;
+} entityframe_t;
+
 //
 // temp entity events
 //
@@ -0,0 +1,37 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pvs.h -- decompressed potentially visible sets, shared by the server and the renderers
+
+/*
+Mod_LeafPVS(leaf, model) returns the leaf's row of the PVS, one bit per leaf
+(leaf 1 is bit 0) padded with zeros to a whole number of words. Decoded rows
+are kept in a least recently used cache of PVS_CACHE_SIZE bytes, which also
+remembers the last few fat PVSs by the leafs they were made of.
+
+The rows PVS_FatPVS and Mod_LeafPVS return are only valid until the next call
+of either, and both are only called from the main thread.
+*/
+
+void PVS_Init(void);
+// forgets every decoded row, the models they came from are about to be freed
+void PVS_Flush(void);
+
+// the PVS of every leaf within 8 units of org
+byte *PVS_FatPVS(model_t *model, vec3_t org);
@@ -216,6 +216,8 @@ void VID_UnlockBuffer(void);
 #include "sys.h"
 #include "zone.h"
 #include "mathlib.h"
+#include "profile.h"
+#include "jobs.h"
 
 typedef struct {
     vec3_t origin;
@@ -247,6 +249,9 @@ typedef struct {
 #include "model.h"
 #include "d_iface.h"
 #endif
+#include "pvs.h"
+#include "mod_bake.h"
+#include "prefetch.h"
 
 #include "input.h"
 #include "world.h"
@@ -0,0 +1,52 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// r_lightmap.h -- surface lightmap building shared by the renderers
+
+/*
+A surface's light is built in an 8.8 fixed point block of up to 18x18 texels:
+
+R_LightMapStyles(surf, lightadj, base, blocklights);
+if (surf->dlightframe == r_framecount)
+    R_LightMapDynamic(surf, cl_dlights, blocklights);
+R_StoreLightMap<format>(blocklights, smax, tmax, dest, stride);
+
+The format is a struct the renderer defines with the type it stores each
+texel as, the distance between texels in dest and a Store function turning
+the 8.8 light into that.
+*/
+
+#define LIGHTMAP_MAXSIZE 18 // texels on a side
+
+// sets blocklights to base plus each of the surface's styled lightmaps times
+// its lightadj (8.8 fraction)
+void R_LightMapStyles(msurface_t *surf, int const *lightadj, unsigned base, unsigned *blocklights);
+
+// adds the dynamic lights in surf->dlightbits
+void R_LightMapDynamic(msurface_t *surf, dlight_t const *dlights, unsigned *blocklights);
+
+template <typename format>
+void R_StoreLightMap(unsigned const *blocklights, int smax, int tmax, typename format::texel_t *dest, int stride)
+{
+    int s, t;
+
+    for (t = 0; t < tmax; t++, dest += stride)
+        for (s = 0; s < smax; s++)
+            dest[s * format::step] = format::Store(*blocklights++);
+}
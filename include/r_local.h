@@ -92,7 +92,7 @@ typedef struct clipplane_s {
     byte reserved[2];
 } clipplane_t;
 
-extern clipplane_t view_clipplanes[4];
+extern THREAD_LOCAL clipplane_t view_clipplanes[4];
 
 //=============================================================================
 
@@ -182,18 +182,18 @@ extern int *pfrustum_indexes[4];
 // !!! if this is changed, it must be changed in asm_draw.h too !!!
 #define NEAR_CLIP 0.01
 
-extern int ubasestep, errorterm, erroradjustup, erroradjustdown;
+extern THREAD_LOCAL int ubasestep, errorterm, erroradjustup, erroradjustdown;
 extern int vstartscan;
 
-extern fixed16_t sadjust, tadjust;
-extern fixed16_t bbextents, bbextentt;
+extern THREAD_LOCAL fixed16_t sadjust, tadjust;
+extern THREAD_LOCAL fixed16_t bbextents, bbextentt;
 
 #define MAXBVERTINDEXES                                \
     1000 // new clipped vertices when clipping bmodels to the world BSP
 extern mvertex_t *r_ptverts, *r_ptvertsmax;
 
 extern vec3_t sbaseaxis[3], tbaseaxis[3];
-extern float entity_rotation[3][3];
+extern THREAD_LOCAL float entity_rotation[3][3];
 
 extern int reinit_surfcache;
 
@@ -229,7 +229,18 @@ extern mdl_t *pmdl;
 extern float leftclip, topclip, rightclip, bottomclip;
 extern int r_acliptype;
 extern finalvert_t *pfinalverts;
-extern auxvert_t *pauxverts;
+
+// a frame's vertices in view space, the alias pipeline works through them
+// ALIAS_BATCH at a time
+#define ALIAS_BATCH 4
+
+typedef struct {
+    float x[MAXALIASVERTS + ALIAS_BATCH];
+    float y[MAXALIASVERTS + ALIAS_BATCH];
+    float z[MAXALIASVERTS + ALIAS_BATCH];
+} aliasverts_t;
+
+extern aliasverts_t *paliasverts;
 
 qboolean R_AliasCheckBBox(void);
 
@@ -260,10 +271,10 @@ extern edge_t *removeedges[MAXHEIGHT];
 extern int screenwidth;
 
 // FIXME: make stack vars when debugging done
-extern edge_t edge_head;
-extern edge_t edge_tail;
-extern edge_t edge_aftertail;
-extern int r_bmodelactive;
+extern THREAD_LOCAL edge_t edge_head;
+extern THREAD_LOCAL edge_t edge_tail;
+extern THREAD_LOCAL edge_t edge_aftertail;
+extern THREAD_LOCAL int r_bmodelactive;
 extern vrect_t *pconupdate;
 
 extern float aliasxscale, aliasyscale, aliasxcenter, aliasycenter;
@@ -294,6 +305,37 @@ extern int r_dlightframecount;
 extern qboolean r_fov_greater_than_90;
 
 void R_StoreEfrags(efrag_t **ppefrag);
+
+//
+// r_band.c
+//
+typedef struct {
+    int top, bottom; // screen rows
+
+    edge_t *edges; // this band's copy of r_edges
+    int numactive; // active edge table at the top row
+    int *activeedges;
+    fixed16_t *activeu;
+
+    surf_t *surfs; // this band's copy of surfaces, with its spans
+    espan_t *spans;
+    int maxspans;
+    qboolean overflowed;
+} band_t;
+
+// set while the world and models are queued for the bands instead of drawn
+extern THREAD_LOCAL qboolean r_bandqueue;
+
+void R_BandNewMap(void);
+qboolean R_BandScanEdges(void);
+void R_BandFlush(void);
+void R_BandEndFrame(void);
+void R_BandQueueFinalVerts(finalvert_t *fv, int numverts);
+void R_BandQueuePolyset(void);
+void R_BandQueueParticle(particle_t *pparticle);
+
+void R_SnapshotBandEdges(band_t *bands, int numbands);
+void R_ScanBandEdges(band_t *band);
 void R_TimeRefresh_f(void);
 void R_TimeGraph(void);
 void R_PrintAliasStats(void);
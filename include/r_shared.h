@@ -43,8 +43,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 extern void R_DrawLine(polyvert_t *polyvert0, polyvert_t *polyvert1);
 
-extern int cachewidth;
-extern pixel_t *cacheblock;
+extern THREAD_LOCAL int cachewidth;
+extern THREAD_LOCAL pixel_t *cacheblock;
 extern int screenwidth;
 
 extern float pixelAspect;
@@ -56,10 +56,9 @@ extern cvar_t r_clearcolor;
 extern int sintable[SIN_BUFFER_SIZE];
 extern int intsintable[SIN_BUFFER_SIZE];
 
-extern vec3_t vup, base_vup;
-extern vec3_t vpn, base_vpn;
-extern vec3_t vright, base_vright;
-extern entity_t *currententity;
+extern THREAD_LOCAL vec3_t vup, vpn, vright;
+extern vec3_t base_vup, base_vpn, base_vright;
+extern THREAD_LOCAL entity_t *currententity;
 
 #define NUMSTACKEDGES 2400
 #define MINEDGES NUMSTACKEDGES
@@ -95,7 +94,8 @@ typedef struct surf_s {
     int pad[2]; // to 64 bytes
 } surf_t;
 
-extern surf_t *surfaces, *surface_p, *surf_max;
+extern THREAD_LOCAL surf_t *surfaces, *surface_p;
+extern surf_t *surf_max;
 
 // surfaces are generated in back to front order by the bsp, so if a surf
 // pointer is greater than another one, it should be drawn in front
@@ -108,7 +108,8 @@ extern surf_t *surfaces, *surface_p, *surf_max;
 extern vec3_t sxformaxis[4]; // s axis transformed into viewspace
 extern vec3_t txformaxis[4]; // t axis transformed into viewspac
 
-extern vec3_t modelorg, base_modelorg;
+extern THREAD_LOCAL vec3_t modelorg;
+extern vec3_t base_modelorg;
 
 extern float xcenter, ycenter;
 extern float xscale, yscale;
@@ -123,7 +124,7 @@ extern void SetUpForLineScan(fixed8_t startvertu, fixed8_t startvertv, fixed8_t
 extern int r_skymade;
 extern void R_MakeSky(void);
 
-extern int ubasestep, errorterm, erroradjustup, erroradjustdown;
+extern THREAD_LOCAL int ubasestep, errorterm, erroradjustup, erroradjustdown;
 
 // flags in finalvert_t.flags
 #define ALIAS_LEFT_CLIP 0x0001
@@ -31,6 +31,20 @@ typedef struct {
 
 typedef enum { ss_loading, ss_active } server_state_t;
 
+// entities the server keeps in each of a client's PROTOCOL_DELTA frames, the
+// ones past it aren't sent to that client
+#define MAX_FRAME_ENTITIES 256
+
+// a client's datagram, built on the job threads by SV_SendClientMessages
+typedef struct {
+    sizebuf_t msg;
+    byte buf[MAX_DATAGRAM];
+    byte *pvs; // the client's fat PVS, found on the main thread
+    qboolean overflow; // ran out of room for entities
+    int dropped; // entities that didn't fit the client's entity frame
+    int lastdropped; // the last datagram's, to only report when it starts
+} clientsnapshot_t;
+
 typedef struct {
     qboolean active; // false if only a net client
 
@@ -67,6 +81,11 @@ typedef struct {
 
     sizebuf_t signon;
     byte signon_buf[8192];
+
+    int protocol; // PROTOCOL_VERSION or PROTOCOL_DELTA
+    entityframe_t *entityframes; // PROTOCOL_DELTA only, ENTITY_FRAMES per client
+    clientsnapshot_t *snapshots; // [maxclients]
+    int pvsbytes; // size of a snapshot's pvs
 } server_t;
 
 #define NUM_PING_TIMES 16
@@ -102,6 +121,8 @@ typedef struct client_s {
 
     // client known data for deltas
     int old_frags;
+    int entityframe; // sequence of the last svc_entities sent
+    int entityack; // last one the client received
 } client_t;
 
 //=============================================================================
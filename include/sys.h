@@ -37,6 +37,10 @@ void Sys_FileClose(int handle);
 void Sys_FileSeek(int handle, int position);
 int Sys_FileRead(int handle, void *dest, int count);
 int Sys_FileWrite(int handle, void const *data, int count);
+
+// maps the first length bytes of an open file read only for the rest of the
+// run, returns NULL if the platform can't map files
+void const *Sys_FileMap(int handle, int length);
 int Sys_FileTime(char const *path);
 void Sys_mkdir(char const *path);
 
@@ -58,6 +62,9 @@ void Sys_Printf(char const *fmt, ...);
 void Sys_Quit(void);
 
 uint32_t Sys_CurrentTicks(void);
+// microseconds since startup, for timing parts of a frame
+// platforms without a finer clock step it a millisecond at a time
+uint64_t Sys_MicroTicks(void);
 
 char *Sys_ConsoleInput(void);
 
@@ -52,6 +52,10 @@ void SV_LinkEdict(edict_t *ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+int SV_FindInRadius(vec3_t const org, float rad, edict_t **list);
+// fills list (MAX_EDICTS long) with the linked, non SOLID_NOT edicts whose
+// bounding box centre is within rad of org, in edict order, returns the count
+
 int SV_PointContents(vec3_t p);
 int SV_TruePointContents(vec3_t p);
 // returns the CONTENTS_* value from the world at the given point.
@@ -93,13 +93,34 @@ void Z_DumpHeap(void);
 void Z_CheckHeap(void);
 int Z_FreeMemory(void);
 
+// what the hunk and cache memory allocated from now on is counted against,
+// for hunk_report
+typedef enum {
+    hs_other,
+    hs_model,
+    hs_texture,
+    hs_lightmap,
+    hs_progs,
+    hs_edicts,
+    hs_sound,
+    hs_surfcache,
+    HS_NUMSUBSYSTEMS
+} hunksubsystem_t;
+
+hunksubsystem_t Hunk_Subsystem(hunksubsystem_t subsystem); // returns the previous one
+void Hunk_BeginLevel(void); // starts the next level's line in the report
+void Hunk_Shutdown(void); // writes hunk_exitreport
+
 void *Hunk_Alloc(int size); // returns 0 filled memory
 void *Hunk_AllocName(int size, char const *name);
 
 void *Hunk_HighAllocName(int size, char const *name);
 
+int Hunk_FreeSize(void); // between the low and the high hunk, where the cache lives too
+
 int Hunk_LowMark(void);
 void Hunk_FreeToLowMark(int mark);
+byte *Hunk_LowPointer(int mark); // the memory at mark, for code that moves whole runs of allocations
 
 int Hunk_HighMark(void);
 void Hunk_FreeToHighMark(int mark);
@@ -110,6 +131,7 @@ void Hunk_Check(void);
 
 typedef struct cache_user_s {
     void *data;
+    int resource; // for the cache's statistics, 0 until it's first cached
 } cache_user_t;
 
 void Cache_Flush(void);
@@ -125,3 +147,9 @@ void *Cache_Alloc(cache_user_t *c, int size, char *name);
 // wasn't enough room.
 
 void Cache_Report(void);
+// forgets the statistics of what isn't cached any more, between levels
+void Cache_ClearResources(void);
+
+void Cache_Compact(void);
+// moves some cached data down into the free space under it, call when
+// nothing holds on to pointers into the cache
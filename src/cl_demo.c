@@ -238,6 +238,7 @@ void CL_Record_f(void)
         Con_Printf("ERROR: couldn't open.\n");
         return;
     }
+    COM_FlushMisses();
 
     cls.forcetrack = track;
     fprintf(cls.demofile, "%i\n", cls.forcetrack);
@@ -301,6 +302,153 @@ void CL_PlayDemo_f(void)
     //	fscanf (cls.demofile, "%i\n", &cls.forcetrack);
 }
 
+/*
+==============================================================================
+
+TIMEDEMO FRAME TIMES
+
+Every frame of a timedemo is timed, along with the phases Host_Frame reports,
+so the hitches an average hides show up in the percentiles. Times are kept in
+microseconds.
+==============================================================================
+*/
+
+#ifdef PSXQUAKE
+#define TD_MAXFRAMES 1024
+#else
+#define TD_MAXFRAMES 32768
+#endif
+
+// whole frame first, then the phases
+#define TD_NUMCOLUMNS (1 + TD_NUMPHASES)
+
+static uint32_t td_times[TD_MAXFRAMES][TD_NUMCOLUMNS];
+static uint32_t td_sorted[TD_MAXFRAMES];
+static int td_numframes, td_lostframes;
+static uint64_t td_frameend;
+
+static char const *const td_names[TD_NUMCOLUMNS] = {"frame", "server", "parse", "screen", "audio"};
+
+CVAR_REGISTER(timedemo_csv, CVAR_CTOR({ "timedemo_csv", "" }));
+CVAR_REGISTER(timedemo_quit, CVAR_CTOR({ "timedemo_quit", "0" }));
+
+/*
+====================
+CL_TimeDemoFrame
+
+Called by Host_Frame at the end of every frame while a timedemo runs
+====================
+*/
+void CL_TimeDemoFrame(uint32_t const phase[TD_NUMPHASES])
+{
+    uint64_t now;
+    uint32_t *times;
+    int i;
+
+    now = Sys_MicroTicks();
+
+    // the first frame loads the level and doesn't count, same as for the fps
+    if (host_framecount > cls.td_startframe) {
+        if (td_numframes == TD_MAXFRAMES) {
+            td_lostframes++;
+        } else {
+            times = td_times[td_numframes++];
+            times[0] = now - td_frameend;
+            for (i = 0; i < TD_NUMPHASES; i++)
+                times[1 + i] = phase[i];
+        }
+    }
+
+    td_frameend = now;
+}
+
+static int CL_CompareTimes(void const *a, void const *b)
+{
+    uint32_t ta = *(uint32_t const *)a, tb = *(uint32_t const *)b;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+/*
+====================
+CL_TimeDemoPercentile
+
+Nearest rank, of td_sorted
+====================
+*/
+static float CL_TimeDemoPercentile(int percent)
+{
+    int rank;
+
+    rank = (td_numframes * percent + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return td_sorted[rank - 1] / 1000.0f;
+}
+
+/*
+====================
+CL_TimeDemoReport
+
+====================
+*/
+static void CL_TimeDemoReport(void)
+{
+    char name[MAX_OSPATH];
+    uint64_t total;
+    FILE *f;
+    int i, j;
+
+    if (!td_numframes)
+        return;
+
+    Con_Printf("ms        min    avg    p50    p95    p99    max\n");
+    for (j = 0; j < TD_NUMCOLUMNS; j++) {
+        total = 0;
+        for (i = 0; i < td_numframes; i++) {
+            td_sorted[i] = td_times[i][j];
+            total += td_sorted[i];
+        }
+        qsort(td_sorted, td_numframes, sizeof(td_sorted[0]), CL_CompareTimes);
+        Con_Printf("%-6s %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f\n", td_names[j], td_sorted[0] / 1000.0f,
+                   total / 1000.0f / td_numframes, CL_TimeDemoPercentile(50),
+                   CL_TimeDemoPercentile(95), CL_TimeDemoPercentile(99), td_sorted[td_numframes - 1] / 1000.0f);
+    }
+    if (td_lostframes)
+        Con_Printf("only the first %i frames were timed, %i more ran\n", td_numframes, td_lostframes);
+
+    if (!timedemo_csv.string[0])
+        return;
+
+    if (strstr(timedemo_csv.string, "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+    // with room for the extension
+    if (snprintf(name, sizeof(name), "%s/%s", com_gamedir, timedemo_csv.string) >= sizeof(name) - 4) {
+        Con_Printf("ERROR: timedemo_csv is too long.\n");
+        return;
+    }
+    COM_DefaultExtension(name, ".csv");
+    f = fopen(name, "w");
+    if (!f) {
+        Con_Printf("ERROR: couldn't open %s.\n", name);
+        return;
+    }
+    fprintf(f, "frame");
+    for (j = 0; j < TD_NUMCOLUMNS; j++)
+        fprintf(f, ",%s_ms", td_names[j]);
+    fprintf(f, "\n");
+    for (i = 0; i < td_numframes; i++) {
+        fprintf(f, "%i", i);
+        for (j = 0; j < TD_NUMCOLUMNS; j++)
+            fprintf(f, ",%.3f", td_times[i][j] / 1000.0f);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    Con_Printf("Wrote %i frames to %s\n", td_numframes, name);
+}
+
 /*
 ====================
 CL_FinishTimeDemo
@@ -315,11 +463,20 @@ void CL_FinishTimeDemo(void)
     cls.timedemo = false;
 
     // the first frame didn't count
-    frames = (host_framecount - cls.td_startframe) - 1 * MS_PER_S;
+    frames = (host_framecount - cls.td_startframe) - 1;
     time = realtime - cls.td_starttime;
     if (!time)
-        time = 1 * MS_PER_S;
-    Con_Printf("%i frames %6u mseconds %6u fps\n", frames, time, frames / time / MS_PER_S);
+        time = 1;
+    Con_Printf("%i frames %6u mseconds %6.1f fps\n", frames, time, (float)frames * MS_PER_S / time);
+
+    CL_TimeDemoReport();
+
+    // for unattended runs, quit skips the menu's confirmation
+    if (timedemo_quit.value) {
+        CL_Disconnect();
+        Host_ShutdownServer(false);
+        Sys_Quit();
+    }
 }
 
 /*
@@ -335,7 +492,7 @@ void CL_TimeDemo_f(void)
         return;
 
     if (Cmd_Argc() != 2) {
-        Con_Printf("timedemo <demoname> : gets demo speeds\n");
+        Con_Printf("timedemo <demoname> : gets demo speeds, set timedemo_csv to save every frame's times\n");
         return;
     }
 
@@ -347,4 +504,5 @@ void CL_TimeDemo_f(void)
     cls.timedemo = true;
     cls.td_startframe = host_framecount;
     cls.td_lastframe = -1; // get a new message this frame
+    td_numframes = td_lostframes = 0;
 }
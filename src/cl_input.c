@@ -481,6 +481,9 @@ void CL_SendMove(usercmd_t *cmd)
     MSG_WriteByte(&buf, cmd->lightlevel);
 #endif
 
+    if (cl.protocol == PROTOCOL_DELTA)
+        MSG_WriteLong(&buf, cl.entityack);
+
     //
     // deliver the message
     //
@@ -539,6 +539,8 @@ int CL_ReadFromServer(void)
 {
     int ret;
 
+    PROF_BEGIN("CL_ReadFromServer");
+
     cl.oldtime = cl.time;
     cl.time += host_frametime;
 
@@ -559,6 +561,7 @@ int CL_ReadFromServer(void)
     //
     // bring the links up to date
     //
+    PROF_END();
     return 0;
 }
 
@@ -51,7 +51,8 @@ char const *svc_strings[] = { "svc_bad", "svc_nop", "svc_disconnect", "svc_updat
                         "svc_spawnstaticsound", "svc_intermission",
                         "svc_finale", // [string] music [string] text
                         "svc_cdtrack", // [byte] track [byte] looptrack
-                        "svc_sellscreen", "svc_cutscene" };
+                        "svc_sellscreen", "svc_cutscene",
+                        "svc_entities" };
 
 //=============================================================================
 
@@ -142,6 +143,9 @@ void CL_KeepaliveMessage(void)
     old = net_message;
     memcpy(olddata, net_message.data, net_message.cursize);
 
+    // the datagram driver only reads the socket from NET_Poll, the acks for our
+    // keepalives included
+    NET_Poll();
     do {
         ret = CL_GetMessage();
         switch (ret) {
@@ -166,6 +170,8 @@ void CL_KeepaliveMessage(void)
     uint32_t time = Sys_CurrentTicks();
     if (time - lastmsg < 5 * MS_PER_S)
         return;
+    if (!NET_CanSendMessage(cls.netcon))
+        return; // the last one isn't acked yet, it's sent again until it is
     lastmsg = time;
 
     // write out a nop
@@ -174,6 +180,7 @@ void CL_KeepaliveMessage(void)
     MSG_WriteByte(&cls.message, clc_nop);
     NET_SendMessage(cls.netcon, &cls.message);
     SZ_Clear(&cls.message);
+    NET_Poll(); // hand it to the socket now, the next poll may be a while
 }
 
 /*
@@ -188,6 +195,9 @@ void CL_ParseServerInfo(void)
     int nummodels, numsounds;
     char model_precache[MAX_MODELS][MAX_QPATH];
     char sound_precache[MAX_SOUNDS][MAX_QPATH];
+    char mapname[MAX_QPATH];
+    entity_state_t *states;
+    short *nums;
 
     Con_DPrintf("Serverinfo packet received.\n");
     //
@@ -197,10 +207,11 @@ void CL_ParseServerInfo(void)
 
     // parse protocol version number
     i = MSG_ReadLong();
-    if (i != PROTOCOL_VERSION) {
-        Con_Printf("Server returned version %i, not %i", i, PROTOCOL_VERSION);
+    if (i != PROTOCOL_VERSION && i != PROTOCOL_DELTA) {
+        Con_Printf("Server returned version %i, not %i or %i", i, PROTOCOL_VERSION, PROTOCOL_DELTA);
         return;
     }
+    cl.protocol = i;
 
     // parse maxclients
     cl.maxclients = MSG_ReadByte();
@@ -209,6 +220,16 @@ void CL_ParseServerInfo(void)
         return;
     }
     cl.scores = Hunk_AllocName(cl.maxclients * sizeof(*cl.scores), "scores");
+    if (cl.protocol == PROTOCOL_DELTA) {
+        cl.entityframes = Hunk_AllocName(
+            ENTITY_FRAMES * (sizeof(entityframe_t) + MAX_EDICTS * (sizeof(entity_state_t) + sizeof(short))), "entframes");
+        states = (entity_state_t *)(cl.entityframes + ENTITY_FRAMES);
+        nums = (short *)(states + ENTITY_FRAMES * MAX_EDICTS);
+        for (i = 0; i < ENTITY_FRAMES; i++) {
+            cl.entityframes[i].states = states + i * MAX_EDICTS;
+            cl.entityframes[i].nums = nums + i * MAX_EDICTS;
+        }
+    }
 
     // parse gametype
     cl.gametype = MSG_ReadByte();
@@ -281,6 +302,12 @@ void CL_ParseServerInfo(void)
 
     R_NewMap();
 
+    // a local server already started reading the next levels
+    if (!sv.active) {
+        COM_FileBase(cl.worldmodel->name, mapname, sizeof(mapname));
+        Prefetch_Level(cl.worldmodel->entities, mapname);
+    }
+
     Hunk_Check(); // make sure nothing is hurt
 
     noclip_anglehack = false; // noclip is turned off at start
@@ -288,46 +315,58 @@ void CL_ParseServerInfo(void)
 
 /*
 ==================
-CL_ParseUpdate
+CL_ReadEntityState
 
-Parse an entity update message from the server
-If an entities model or origin changes from frame to frame, it must be
-relinked.  Other attributes can change without relinking.
+Reads the fields an entity update's bits say follow over state
 ==================
 */
-int bitcounts[16];
+static void CL_ReadEntityState(int bits, entity_state_t *state)
+{
+    if (bits & U_MODEL) {
+        state->modelindex = MSG_ReadByte();
+        if (state->modelindex >= MAX_MODELS)
+            Host_Error("CL_ParseModel: bad modnum");
+    }
 
-void CL_ParseUpdate(int bits)
+    if (bits & U_FRAME)
+        state->frame = MSG_ReadByte();
+    if (bits & U_COLORMAP)
+        state->colormap = MSG_ReadByte();
+    if (bits & U_SKIN)
+        state->skin = MSG_ReadByte();
+    if (bits & U_EFFECTS)
+        state->effects = MSG_ReadByte();
+
+    if (bits & U_ORIGIN1)
+        state->origin[0] = MSG_ReadCoord();
+    if (bits & U_ANGLE1)
+        state->angles[0] = MSG_ReadAngle();
+    if (bits & U_ORIGIN2)
+        state->origin[1] = MSG_ReadCoord();
+    if (bits & U_ANGLE2)
+        state->angles[1] = MSG_ReadAngle();
+    if (bits & U_ORIGIN3)
+        state->origin[2] = MSG_ReadCoord();
+    if (bits & U_ANGLE3)
+        state->angles[2] = MSG_ReadAngle();
+}
+
+/*
+==================
+CL_SetEntityState
+
+Moves entity num to state, it's in this message
+==================
+*/
+static void CL_SetEntityState(int num, entity_state_t const *state, qboolean nolerp)
 {
     int i;
     model_t *model;
-    int modnum;
     qboolean forcelink;
     entity_t *ent;
-    int num;
-    int skin;
-
-    if (cls.signon == SIGNONS - 1) { // first update is the final signon stage
-        cls.signon = SIGNONS;
-        CL_SignonReply();
-    }
-
-    if (bits & U_MOREBITS) {
-        i = MSG_ReadByte();
-        bits |= (i << 8);
-    }
-
-    if (bits & U_LONGENTITY)
-        num = MSG_ReadShort();
-    else
-        num = MSG_ReadByte();
 
     ent = CL_EntityNum(num);
 
-    for (i = 0; i < 16; i++)
-        if (bits & (1 << i))
-            bitcounts[i]++;
-
     if (ent->msgtime != cl.mtime[1])
         forcelink = true; // no previous frame to lerp from
     else
@@ -335,14 +374,7 @@ void CL_ParseUpdate(int bits)
 
     ent->msgtime = cl.mtime[0];
 
-    if (bits & U_MODEL) {
-        modnum = MSG_ReadByte();
-        if (modnum >= MAX_MODELS)
-            Host_Error("CL_ParseModel: bad modnum");
-    } else
-        modnum = ent->baseline.modelindex;
-
-    model = cl.model_precache[modnum];
+    model = cl.model_precache[state->modelindex];
     if (model != ent->model) {
         ent->model = model;
         // automatic animation (torches, etc) can be either all together
@@ -357,20 +389,12 @@ void CL_ParseUpdate(int bits)
 #ifdef GLQUAKE
         if (num > 0 && num <= cl.maxclients)
             R_TranslatePlayerSkin(num - 1);
-#else
-        (void)skin;
 #endif
     }
 
-    if (bits & U_FRAME)
-        ent->frame = MSG_ReadByte();
-    else
-        ent->frame = ent->baseline.frame;
+    ent->frame = state->frame;
 
-    if (bits & U_COLORMAP)
-        i = MSG_ReadByte();
-    else
-        i = ent->baseline.colormap;
+    i = state->colormap;
     if (!i)
         ent->colormap = vid.colormap;
     else {
@@ -380,61 +404,25 @@ void CL_ParseUpdate(int bits)
     }
 
 #ifdef GLQUAKE
-    if (bits & U_SKIN)
-        skin = MSG_ReadByte();
-    else
-        skin = ent->baseline.skin;
-    if (skin != ent->skinnum) {
-        ent->skinnum = skin;
+    if (state->skin != ent->skinnum) {
+        ent->skinnum = state->skin;
         if (num > 0 && num <= cl.maxclients)
             R_TranslatePlayerSkin(num - 1);
     }
-
 #else
-
-    if (bits & U_SKIN)
-        ent->skinnum = MSG_ReadByte();
-    else
-        ent->skinnum = ent->baseline.skin;
+    ent->skinnum = state->skin;
 #endif
 
-    if (bits & U_EFFECTS)
-        ent->effects = MSG_ReadByte();
-    else
-        ent->effects = ent->baseline.effects;
+    ent->effects = state->effects;
 
     // shift the known values for interpolation
     VectorCopy(ent->msg_origins[0], ent->msg_origins[1]);
     VectorCopy(ent->msg_angles[0], ent->msg_angles[1]);
 
-    if (bits & U_ORIGIN1)
-        ent->msg_origins[0][0] = MSG_ReadCoord();
-    else
-        ent->msg_origins[0][0] = ent->baseline.origin[0];
-    if (bits & U_ANGLE1)
-        ent->msg_angles[0][0] = MSG_ReadAngle();
-    else
-        ent->msg_angles[0][0] = ent->baseline.angles[0];
-
-    if (bits & U_ORIGIN2)
-        ent->msg_origins[0][1] = MSG_ReadCoord();
-    else
-        ent->msg_origins[0][1] = ent->baseline.origin[1];
-    if (bits & U_ANGLE2)
-        ent->msg_angles[0][1] = MSG_ReadAngle();
-    else
-        ent->msg_angles[0][1] = ent->baseline.angles[1];
-
-    if (bits & U_ORIGIN3)
-        ent->msg_origins[0][2] = MSG_ReadCoord();
-    else
-        ent->msg_origins[0][2] = ent->baseline.origin[2];
-    if (bits & U_ANGLE3)
-        ent->msg_angles[0][2] = MSG_ReadAngle();
-    else
-        ent->msg_angles[0][2] = ent->baseline.angles[2];
+    VectorCopy(state->origin, ent->msg_origins[0]);
+    VectorCopy(state->angles, ent->msg_angles[0]);
 
-    if (bits & U_NOLERP)
+    if (nolerp)
         ent->forcelink = true;
 
     if (forcelink) { // didn't have an update last message
@@ -446,6 +434,148 @@ void CL_ParseUpdate(int bits)
     }
 }
 
+/*
+==================
+CL_ParseUpdate
+
+Parse an entity update message from the server
+If an entities model or origin changes from frame to frame, it must be
+relinked.  Other attributes can change without relinking.
+==================
+*/
+int bitcounts[16];
+
+void CL_ParseUpdate(int bits)
+{
+    int i;
+    int num;
+    entity_state_t state;
+
+    if (cls.signon == SIGNONS - 1) { // first update is the final signon stage
+        cls.signon = SIGNONS;
+        CL_SignonReply();
+    }
+
+    if (bits & U_MOREBITS) {
+        i = MSG_ReadByte();
+        bits |= (i << 8);
+    }
+
+    if (bits & U_LONGENTITY)
+        num = MSG_ReadShort();
+    else
+        num = MSG_ReadByte();
+
+    state = CL_EntityNum(num)->baseline;
+
+    for (i = 0; i < 16; i++)
+        if (bits & (1 << i))
+            bitcounts[i]++;
+
+    CL_ReadEntityState(bits, &state);
+    CL_SetEntityState(num, &state, bits & U_NOLERP);
+}
+
+/*
+==================
+CL_ParseEntities
+
+A PROTOCOL_DELTA frame of entities: updates and removes against a frame
+received earlier, the entities it doesn't mention are as they were then
+==================
+*/
+void CL_ParseEntities(void)
+{
+    entityframe_t *frame, *from;
+    entity_state_t *state;
+    int sequence, fromsequence;
+    int bits, num, i, j, fromcount;
+    byte nolerp[MAX_EDICTS];
+    qboolean lost;
+
+    if (cl.protocol != PROTOCOL_DELTA)
+        Host_Error("CL_ParseEntities: server isn't protocol %i", PROTOCOL_DELTA);
+
+    if (cls.signon == SIGNONS - 1) { // first update is the final signon stage
+        cls.signon = SIGNONS;
+        CL_SignonReply();
+    }
+
+    sequence = MSG_ReadLong();
+    fromsequence = MSG_ReadLong();
+
+    frame = &cl.entityframes[sequence & (ENTITY_FRAMES - 1)];
+    frame->sequence = 0;
+    frame->numentities = 0;
+
+    from = NULL;
+    lost = false;
+    if (fromsequence) {
+        from = &cl.entityframes[fromsequence & (ENTITY_FRAMES - 1)];
+        if (from->sequence != fromsequence || sequence - fromsequence <= 0 || sequence - fromsequence >= ENTITY_FRAMES) {
+            from = NULL; // still has to be read through
+            lost = true;
+        }
+    }
+    fromcount = from ? from->numentities : 0;
+
+    j = 0;
+    while ((bits = MSG_ReadByte())) {
+        if (bits & U_MOREBITS)
+            bits |= MSG_ReadByte() << 8;
+        if (bits & U_LONGENTITY)
+            num = MSG_ReadShort();
+        else
+            num = MSG_ReadByte();
+        if (msg_badread || num < 0 || num >= MAX_EDICTS)
+            Host_Error("CL_ParseEntities: bad entity");
+
+        // the ones before it didn't change
+        for (; j < fromcount && from->nums[j] < num; j++) {
+            frame->nums[frame->numentities] = from->nums[j];
+            frame->states[frame->numentities] = from->states[j];
+            nolerp[frame->numentities++] = false;
+        }
+
+        if (frame->numentities == MAX_EDICTS)
+            Host_Error("CL_ParseEntities: more than %i entities", MAX_EDICTS);
+
+        state = &frame->states[frame->numentities];
+        if (j < fromcount && from->nums[j] == num)
+            *state = from->states[j++];
+        else
+            *state = CL_EntityNum(num)->baseline;
+
+        if (bits & U_REMOVE)
+            continue;
+
+        CL_ReadEntityState(bits, state);
+        frame->nums[frame->numentities] = num;
+        nolerp[frame->numentities++] = (bits & U_NOLERP) != 0;
+    }
+
+    for (; j < fromcount; j++) {
+        if (frame->numentities == MAX_EDICTS)
+            Host_Error("CL_ParseEntities: more than %i entities", MAX_EDICTS);
+        frame->nums[frame->numentities] = from->nums[j];
+        frame->states[frame->numentities] = from->states[j];
+        nolerp[frame->numentities++] = false;
+    }
+
+    if (lost) {
+        // the entities that weren't sent vanish until a frame we have is acknowledged
+        Con_DPrintf("CL_ParseEntities: %i is from %i, which wasn't kept\n", sequence, fromsequence);
+        frame->numentities = 0;
+        return;
+    }
+
+    frame->sequence = sequence;
+    cl.entityack = sequence;
+
+    for (i = 0; i < frame->numentities; i++)
+        CL_SetEntityState(frame->nums[i], &frame->states[i], nolerp[i]);
+}
+
 /*
 ==================
 CL_ParseBaseline
@@ -710,8 +840,9 @@ void CL_ParseServerMessage(void)
 
         case svc_version:
             i = MSG_ReadLong();
-            if (i != PROTOCOL_VERSION)
-                Host_Error("CL_ParseServerMessage: Server is protocol %i instead of %i\n", i, PROTOCOL_VERSION);
+            if (i != PROTOCOL_VERSION && i != PROTOCOL_DELTA)
+                Host_Error("CL_ParseServerMessage: Server is protocol %i instead of %i or %i\n", i, PROTOCOL_VERSION,
+                           PROTOCOL_DELTA);
             break;
 
         case svc_disconnect:
@@ -879,6 +1010,10 @@ void CL_ParseServerMessage(void)
             SCR_CenterPrint(MSG_ReadString());
             break;
 
+        case svc_entities:
+            CL_ParseEntities();
+            break;
+
         case svc_sellscreen:
             Cmd_ExecuteString("help", src_command);
             break;
@@ -825,6 +825,7 @@ int com_filesize;
 
 typedef struct {
     char name[MAX_QPATH];
+    uint32_t name_hash;
     int filepos, filelen;
 } packfile_t;
 
@@ -833,6 +834,9 @@ typedef struct pack_s {
     int handle;
     int numfiles;
     packfile_t *files;
+    int hashmask;
+    short *hashtable; // open addressed index into files, -1 for empty slots
+    byte const *mapped; // the whole pak when the platform can map it, NULL otherwise
 } pack_t;
 
 //
@@ -853,14 +857,129 @@ typedef struct {
 
 char com_gamedir[MAX_OSPATH];
 
+// Number of known missing file names remembered per directory, power of two
+#ifdef PSXQUAKE
+#define MAX_DIR_MISSES 256
+#else
+#define MAX_DIR_MISSES 1024
+#endif
+#define MAX_DIR_MISS_NAMES (MAX_DIR_MISSES * 24) // bytes of the names
+
+typedef struct {
+    uint32_t hash; // 0 for empty slots
+    unsigned short name, length; // in the directory's missnames
+} dirmiss_t;
+
 typedef struct searchpath_s {
     char filename[MAX_OSPATH];
     pack_t *pack; // only one of filename / pack will be used
+    dirmiss_t *misses; // names that weren't found in the directory
+    char *missnames;
+    int nummisses, missnamesize;
     struct searchpath_s *next;
 } searchpath_t;
 
 searchpath_t *com_searchpaths;
 
+static int com_probes; // hash slots and directory stats touched by COM_FindEntry
+
+/*
+============
+COM_HashName
+
+Zero marks empty slots in the miss tables, so it's never returned
+============
+*/
+static uint32_t COM_HashName(char const *name)
+{
+    uint32_t hash = pq_hash(name, strlen(name));
+    return hash ? hash : 1;
+}
+
+/*
+============
+COM_PackFindFile
+
+Returns the index of the file in the pak or -1
+============
+*/
+static int COM_PackFindFile(pack_t const *pak, char const *filename, uint32_t hash)
+{
+    for (int slot = hash & pak->hashmask;; slot = (slot + 1) & pak->hashmask) {
+        com_probes++;
+        int i = pak->hashtable[slot];
+        if (i < 0)
+            return -1;
+        if (pak->files[i].name_hash == hash && !strcmp(pak->files[i].name, filename))
+            return i;
+    }
+}
+
+/*
+============
+COM_DirMissed
+
+Checks the negative lookup cache of a game directory. The names are compared
+too, a file mustn't go missing because its hash matches one that is.
+============
+*/
+static qboolean COM_DirMissed(searchpath_t const *search, char const *filename, int length, uint32_t hash)
+{
+    for (int slot = hash & (MAX_DIR_MISSES - 1);; slot = (slot + 1) & (MAX_DIR_MISSES - 1)) {
+        dirmiss_t const *miss = &search->misses[slot];
+        com_probes++;
+        if (miss->hash == 0)
+            return false;
+        if (miss->hash == hash && miss->length == length && !memcmp(search->missnames + miss->name, filename, length))
+            return true;
+    }
+}
+
+static void COM_DirClearMisses(searchpath_t *search)
+{
+    memset(search->misses, 0, MAX_DIR_MISSES * sizeof(*search->misses));
+    search->nummisses = 0;
+    search->missnamesize = 0;
+}
+
+static void COM_DirAddMiss(searchpath_t *search, char const *filename, int length, uint32_t hash)
+{
+    // keep at least a quarter of the table empty so probe chains stay short
+    if (search->nummisses >= MAX_DIR_MISSES * 3 / 4 || search->missnamesize + length > MAX_DIR_MISS_NAMES)
+        COM_DirClearMisses(search);
+
+    int slot = hash & (MAX_DIR_MISSES - 1);
+    while (search->misses[slot].hash)
+        slot = (slot + 1) & (MAX_DIR_MISSES - 1);
+    search->misses[slot].hash = hash;
+    search->misses[slot].name = search->missnamesize;
+    search->misses[slot].length = length;
+    memcpy(search->missnames + search->missnamesize, filename, length);
+    search->missnamesize += length;
+    search->nummisses++;
+}
+
+static void COM_DirAllocMisses(searchpath_t *search)
+{
+    search->misses = Hunk_AllocName(MAX_DIR_MISSES * sizeof(*search->misses), "dirmiss");
+    search->missnames = Hunk_AllocName(MAX_DIR_MISS_NAMES, "dirmiss");
+}
+
+/*
+============
+COM_FlushMisses
+
+Must be called whenever files may have been added to the game directories,
+the path command and every new map do it too
+============
+*/
+void COM_FlushMisses(void)
+{
+    for (searchpath_t *s = com_searchpaths; s; s = s->next)
+        if (s->misses)
+            COM_DirClearMisses(s);
+}
+
 /*
 ============
 COM_Path_f
@@ -871,6 +990,9 @@ void COM_Path_f(void)
 {
     searchpath_t *s;
 
+    // files may have been copied in by hand since
+    COM_FlushMisses();
+
     Con_Printf("Current search path:\n");
     for (s = com_searchpaths; s; s = s->next) {
         if (s->pack) {
@@ -906,6 +1028,9 @@ void COM_WriteFile(char const *filename, void const *data, int len)
     Sys_Printf("COM_WriteFile: %s\n", name);
     Sys_FileWrite(handle, data, len);
     Sys_FileClose(handle);
+
+    COM_FlushMisses();
+    Prefetch_Drop(filename);
 }
 
 /*
@@ -962,24 +1087,21 @@ void COM_CopyFile(char *netpath, char *cachepath)
 
 /*
 ===========
-COM_FindFile
+COM_FindEntry
 
-Finds the file in the search path.
-Sets com_filesize and one of handle or file
+Looks the file up in the search path without opening it.
+Returns the search path element holding it and, for paks, the file index.
+The netpath is filled in for files found in a directory.
 ===========
 */
-int COM_FindFile(char const *filename, int *handle, FILE **file)
+static searchpath_t *COM_FindEntry(char const *filename, int *packindex, char *netpath, size_t netpath_len)
 {
     searchpath_t *search;
-    char netpath[MAX_OSPATH];
-    pack_t *pak;
-    int i;
-    int findtime;
+    uint32_t hash;
+    int i, length;
 
-    if (file && handle)
-        Sys_Error("COM_FindFile: both handle and file set");
-    if (!file && !handle)
-        Sys_Error("COM_FindFile: neither handle or file set");
+    hash = COM_HashName(filename);
+    length = strlen(filename);
 
     //
     // search through the path, one element at a time
@@ -993,22 +1115,11 @@ int COM_FindFile(char const *filename, int *handle, FILE **file)
     for (; search; search = search->next) {
         // is the element a pak file?
         if (search->pack) {
-            // look through all the pak file elements
-            pak = search->pack;
-            for (i = 0; i < pak->numfiles; i++)
-                if (!strcmp(pak->files[i].name, filename)) { // found it!
-                    Sys_Printf("PackFile: %s : %s\n", pak->filename, filename);
-                    if (handle) {
-                        *handle = pak->handle;
-                        Sys_FileSeek(pak->handle, pak->files[i].filepos);
-                    } else { // open a new file on the pakfile
-                        *file = fopen(pak->filename, "rb");
-                        if (*file)
-                            fseek(*file, pak->files[i].filepos, SEEK_SET);
-                    }
-                    com_filesize = pak->files[i].filelen;
-                    return com_filesize;
-                }
+            i = COM_PackFindFile(search->pack, filename, hash);
+            if (i >= 0) {
+                *packindex = i;
+                return search;
+            }
         } else {
             // check a file in the directory tree
             if (!static_registered) { // if not a registered version, don't ever go beyond base
@@ -1016,27 +1127,96 @@ int COM_FindFile(char const *filename, int *handle, FILE **file)
                     continue;
             }
 
-            int fmt_len = snprintf(netpath, sizeof(netpath), "%s/%s", search->filename, filename);
-            if (fmt_len < 0 || fmt_len >= sizeof(netpath)) {
+            if (search->misses && COM_DirMissed(search, filename, length, hash))
+                continue;
+
+            int fmt_len = snprintf(netpath, netpath_len, "%s/%s", search->filename, filename);
+            if (fmt_len < 0 || fmt_len >= netpath_len) {
                 Sys_Error("COM_FindFile: failed to format path, %d\n", fmt_len);
             }
 
-            findtime = Sys_FileTime(netpath);
-            if (findtime == -1)
+            com_probes++;
+            if (Sys_FileTime(netpath) == -1) {
+                if (search->misses)
+                    COM_DirAddMiss(search, filename, length, hash);
                 continue;
-
-            Sys_Printf("FindFile: %s\n", netpath);
-            com_filesize = Sys_FileOpenRead(netpath, &i);
-            if (handle)
-                *handle = i;
-            else {
-                Sys_FileClose(i);
-                *file = fopen(netpath, "rb");
             }
-            return com_filesize;
+
+            *packindex = -1;
+            return search;
         }
     }
 
+    return NULL;
+}
+
+static int COM_OpenEntry(char const *filename, searchpath_t *search, int i, char const *netpath, int *handle,
+                         FILE **file);
+
+/*
+===========
+COM_FindFile
+
+Finds the file in the search path.
+Sets com_filesize and one of handle or file
+===========
+*/
+int COM_FindFile(char const *filename, int *handle, FILE **file)
+{
+    searchpath_t *search;
+    char netpath[MAX_OSPATH];
+    int i;
+
+    if (file && handle)
+        Sys_Error("COM_FindFile: both handle and file set");
+    if (!file && !handle)
+        Sys_Error("COM_FindFile: neither handle or file set");
+
+    search = COM_FindEntry(filename, &i, netpath, sizeof(netpath));
+
+    return COM_OpenEntry(filename, search, i, netpath, handle, file);
+}
+
+/*
+===========
+COM_OpenEntry
+
+Opens a file found by COM_FindEntry.
+Sets com_filesize and one of handle or file
+===========
+*/
+static int COM_OpenEntry(char const *filename, searchpath_t *search, int i, char const *netpath, int *handle,
+                         FILE **file)
+{
+    pack_t *pak;
+
+    if (search && search->pack) { // found it in a pak
+        pak = search->pack;
+        Sys_Printf("PackFile: %s : %s\n", pak->filename, filename);
+        if (handle) {
+            *handle = pak->handle;
+            Sys_FileSeek(pak->handle, pak->files[i].filepos);
+        } else { // open a new file on the pakfile
+            *file = fopen(pak->filename, "rb");
+            if (*file)
+                fseek(*file, pak->files[i].filepos, SEEK_SET);
+        }
+        com_filesize = pak->files[i].filelen;
+        return com_filesize;
+    }
+
+    if (search) {
+        Sys_Printf("FindFile: %s\n", netpath);
+        com_filesize = Sys_FileOpenRead(netpath, &i);
+        if (handle)
+            *handle = i;
+        else {
+            Sys_FileClose(i);
+            *file = fopen(netpath, "rb");
+        }
+        return com_filesize;
+    }
+
     Sys_Printf("FindFile: can't find %s\n", filename);
 
     if (handle)
@@ -1105,17 +1285,37 @@ static byte *loadbuf;
 static int loadsize;
 byte *COM_LoadFile(char const *path, int usehunk)
 {
+    searchpath_t *search;
+    char netpath[MAX_OSPATH];
+    byte const *mapped;
     int h;
     byte *buf;
     char base[64];
     int len;
+    int i;
 
     buf = NULL; // quiet compiler warning
-
-    // look for it in the filesystem or pack files
-    len = COM_OpenFile(path, &h);
-    if (h == -1)
-        return NULL;
+    mapped = NULL;
+    h = -1;
+
+    // look for it in what was read ahead for this level, then the filesystem or pack files
+    mapped = Prefetch_Find(path, &len);
+    if (mapped) {
+        Sys_Printf("Prefetched: %s\n", path);
+        com_filesize = len;
+    } else {
+        search = COM_FindEntry(path, &i, netpath, sizeof(netpath));
+        if (search && search->pack && search->pack->mapped) {
+            // copy straight out of the mapping, no seek and read round trip
+            Sys_Printf("PackFile: %s : %s\n", search->pack->filename, path);
+            mapped = search->pack->mapped + search->pack->files[i].filepos;
+            len = com_filesize = search->pack->files[i].filelen;
+        } else {
+            len = COM_OpenEntry(path, search, i, netpath, &h, NULL);
+            if (h == -1)
+                return NULL;
+        }
+    }
 
     // extract the filename base name for hunk tag
     COM_FileBase(path, base, sizeof(base));
@@ -1142,8 +1342,12 @@ byte *COM_LoadFile(char const *path, int usehunk)
     buf[len] = 0;
 
     Draw_BeginDisc();
-    Sys_FileRead(h, buf, len);
-    COM_CloseFile(h);
+    if (mapped)
+        memcpy(buf, mapped, len);
+    else {
+        Sys_FileRead(h, buf, len);
+        COM_CloseFile(h);
+    }
     Draw_EndDisc();
 
     return buf;
@@ -1177,6 +1381,71 @@ byte *COM_LoadStackFile(char const *path, void *buffer, int bufsize)
     return buf;
 }
 
+/*
+============
+COM_MapFile
+
+Returns a read only view of a file straight out of a mapped pak, or NULL if
+the file isn't in one and has to be loaded with the other COM_Load* functions.
+The view is valid until the program exits but unlike the loaded copies it is
+not zero terminated and must never be written to.
+============
+*/
+byte const *COM_MapFile(char const *path, int *length)
+{
+    searchpath_t *search;
+    char netpath[MAX_OSPATH];
+    packfile_t *file;
+    int i;
+
+    search = COM_FindEntry(path, &i, netpath, sizeof(netpath));
+    if (!search || !search->pack || !search->pack->mapped)
+        return NULL;
+
+    // callers cast the data straight to int and float structures
+    file = &search->pack->files[i];
+    if (file->filepos & 3)
+        return NULL;
+
+    Sys_Printf("PackFile: %s : %s\n", search->pack->filename, path);
+    *length = com_filesize = file->filelen;
+    return search->pack->mapped + file->filepos;
+}
+
+/*
+============
+COM_FileSource
+
+Where a file's bytes are, for reading them without the search path (the
+prefetch thread). Fills in the pak or loose file they're in and the offset
+of the file in it, and mapped when the pak is mapped.
+Returns the file's length or -1.
+============
+*/
+int COM_FileSource(char const *filename, char *path, size_t path_len, int *offset, byte const **mapped)
+{
+    searchpath_t *search;
+    int i, handle, length;
+
+    search = COM_FindEntry(filename, &i, path, path_len);
+    if (!search)
+        return -1;
+
+    if (search->pack) {
+        snprintf(path, path_len, "%s", search->pack->filename);
+        *offset = search->pack->files[i].filepos;
+        *mapped = search->pack->mapped ? search->pack->mapped + *offset : NULL;
+        return search->pack->files[i].filelen;
+    }
+
+    length = Sys_FileOpenRead(path, &handle);
+    if (handle != -1)
+        Sys_FileClose(handle);
+    *offset = 0;
+    *mapped = NULL;
+    return length;
+}
+
 /*
 =================
 COM_LoadPackFile
@@ -1195,10 +1464,15 @@ pack_t *COM_LoadPackFile(char *packfile)
     int numpackfiles;
     pack_t *pack;
     int packhandle;
+    int packlen;
     dpackfile_t info[MAX_FILES_IN_PACK];
     unsigned short crc;
+    short *hashtable;
+    int hashsize;
+    int slot;
 
-    if (Sys_FileOpenRead(packfile, &packhandle) == -1) {
+    packlen = Sys_FileOpenRead(packfile, &packhandle);
+    if (packlen == -1) {
         //              Con_Printf ("Couldn't open %s\n", packfile);
         return NULL;
     }
@@ -1223,11 +1497,23 @@ pack_t *COM_LoadPackFile(char *packfile)
     for (i = 0; i < header.dirlen; i++)
         CRC_ProcessByte(&crc, ((byte *)info)[i]);
 
+    // build the name index, at most half full so lookups rarely probe more than once
+    for (hashsize = 1; hashsize < numpackfiles * 2; hashsize <<= 1)
+        ;
+    hashtable = Hunk_AllocName(hashsize * sizeof(*hashtable), "packhash");
+    memset(hashtable, 0xff, hashsize * sizeof(*hashtable));
+
     // parse the directory
     for (i = 0; i < numpackfiles; i++) {
         strcpy(newfiles[i].name, info[i].name);
+        newfiles[i].name_hash = COM_HashName(newfiles[i].name);
         newfiles[i].filepos = LittleLong(info[i].filepos);
         newfiles[i].filelen = LittleLong(info[i].filelen);
+
+        // the first entry wins on duplicate names, same as the old linear search
+        for (slot = newfiles[i].name_hash & (hashsize - 1); hashtable[slot] >= 0; slot = (slot + 1) & (hashsize - 1))
+            ;
+        hashtable[slot] = i;
     }
 
     pack = Hunk_Alloc(sizeof(pack_t));
@@ -1235,11 +1521,18 @@ pack_t *COM_LoadPackFile(char *packfile)
     pack->handle = packhandle;
     pack->numfiles = numpackfiles;
     pack->files = newfiles;
+    pack->hashmask = hashsize - 1;
+    pack->hashtable = hashtable;
+
+    // map the whole pak once, every process on the host then shares its pages
+    if (!COM_CheckParm("-nomap"))
+        pack->mapped = (byte const *)Sys_FileMap(packhandle, packlen);
 
-    Con_Printf("Added packfile %s (%i files)\n", packfile, numpackfiles);
+    Con_Printf("Added packfile %s (%i files%s)\n", packfile, numpackfiles, pack->mapped ? ", mapped" : "");
     return pack;
 }
 
+
 /*
 ================
 COM_AddGameDirectory
@@ -1262,6 +1555,7 @@ void COM_AddGameDirectory(char const *dir)
     //
     search = Hunk_Alloc(sizeof(searchpath_t));
     strcpy(search->filename, dir);
+    COM_DirAllocMisses(search);
     search->next = com_searchpaths;
     com_searchpaths = search;
 
@@ -1347,8 +1641,10 @@ void COM_InitFilesystem(void)
                 search->pack = COM_LoadPackFile(com_argv[i]);
                 if (!search->pack)
                     Sys_Error("Couldn't load packfile: %s", com_argv[i]);
-            } else
+            } else {
                 strcpy(search->filename, com_argv[i]);
+                COM_DirAllocMisses(search);
+            }
             search->next = com_searchpaths;
             com_searchpaths = search;
         }
@@ -1358,4 +1654,50 @@ void COM_InitFilesystem(void)
         proghack = true;
 }
 
+/*
+================
+COM_FindBenchmark_f
+
+Looks up every pak entry and a missing name for each of them, reporting how
+many hash slots and directory stats the lookups took
+================
+*/
+void COM_FindBenchmark_f(void)
+{
+    searchpath_t *s;
+    char netpath[MAX_OSPATH];
+    char missing[MAX_QPATH + 8];
+    int passes, pass, i, dummy;
+    int lookups, probes;
+    uint32_t start, time;
+
+    passes = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 10;
+    if (passes < 1)
+        passes = 1;
+
+    lookups = 0;
+    probes = com_probes;
+    start = Sys_CurrentTicks();
+
+    for (pass = 0; pass < passes; pass++) {
+        for (s = com_searchpaths; s; s = s->next) {
+            if (!s->pack)
+                continue;
+            for (i = 0; i < s->pack->numfiles; i++) {
+                COM_FindEntry(s->pack->files[i].name, &dummy, netpath, sizeof(netpath));
+                snprintf(missing, sizeof(missing), "%s.none", s->pack->files[i].name);
+                COM_FindEntry(missing, &dummy, netpath, sizeof(netpath));
+                lookups += 2;
+            }
+        }
+    }
+
+    time = Sys_CurrentTicks() - start;
+    probes = com_probes - probes;
+
+    Con_Printf("%i lookups, %i probes (%.2f per lookup), %u ms\n", lookups, probes,
+               lookups ? (float)probes / lookups : 0.0f, time);
+}
+
 CMD_REGISTER("path", COM_Path_f);
+CMD_REGISTER("fs_benchmark", COM_FindBenchmark_f);
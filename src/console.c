@@ -48,7 +48,9 @@ CVAR_REGISTER(con_notifytime, CVAR_CTOR({ "con_notifytime", 3 })); //seconds
 static uint32_t con_times[NUM_CON_TIMES]; // realtime time the line was generated
     // for transparent notify lines
 
+#ifndef SERVERONLY
 static int con_vislines;
+#endif
 
 qboolean con_debuglog;
 
@@ -63,6 +65,7 @@ int con_notifylines; // scan lines to clear for notify lines
 
 extern void M_Menu_Main_f(void);
 
+#ifndef SERVERONLY
 /*
 ================
 Con_ToggleConsole_f
@@ -84,6 +87,7 @@ void Con_ToggleConsole_f(void)
     SCR_EndLoadingPlaque();
     memset(con_times, 0, sizeof(con_times));
 }
+#endif
 
 /*
 ================
@@ -109,6 +113,7 @@ void Con_ClearNotify(void)
         con_times[i] = 0;
 }
 
+#ifndef SERVERONLY
 /*
 ================
 Con_MessageMode_f
@@ -132,6 +137,7 @@ void Con_MessageMode2_f(void)
     key_dest = key_message;
     team_message = true;
 }
+#endif
 
 /*
 ================
@@ -414,6 +420,7 @@ void Con_SafePrintf(char const *fmt, ...)
     scr_disabled_for_loading = temp;
 }
 
+#ifndef SERVERONLY
 /*
 ==============================================================================
 
@@ -592,4 +599,5 @@ void Con_NotifyBox(char *text)
 CMD_REGISTER("toggleconsole", Con_ToggleConsole_f);
 CMD_REGISTER("messagemode", Con_MessageMode_f);
 CMD_REGISTER("messagemode2", Con_MessageMode2_f);
+#endif
 CMD_REGISTER("clear", Con_Clear_f);
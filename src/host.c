@@ -152,6 +152,14 @@ void Host_FindMaxClients(void)
     svs.maxclients = 1;
 
     i = COM_CheckParm("-dedicated");
+#ifdef SERVERONLY
+    // headless builds can't run a local client, so they're always dedicated
+    cls.state = ca_dedicated;
+    if (i && i != (com_argc - 1))
+        svs.maxclients = Q_atoi(com_argv[i + 1]);
+    else
+        svs.maxclients = 8;
+#else
     if (i) {
         cls.state = ca_dedicated;
         if (i != (com_argc - 1)) {
@@ -170,6 +178,7 @@ void Host_FindMaxClients(void)
         else
             svs.maxclients = 8;
     }
+#endif
     if (svs.maxclients < 1)
         svs.maxclients = 8;
     else if (svs.maxclients > MAX_SCOREBOARD)
@@ -378,6 +387,7 @@ void Host_ShutdownServer(qboolean crash)
     // flush any pending messages - like the score!!!
     start = Sys_CurrentTicks();
     do {
+        NET_Poll(); // reads the acks and flushes what was sent
         count = 0;
         for (i = 0, host_client = svs.clients; i < svs.maxclients; i++, host_client++) {
             if (host_client->active && host_client->message.cursize) {
@@ -426,9 +436,13 @@ void Host_ClearMemory(void)
 {
     Con_DPrintf("Clearing memory\n");
     D_FlushCaches();
+    PVS_Flush();
+    COM_FlushMisses();
     Mod_ClearAll();
     if (host_hunklevel)
         Hunk_FreeToLowMark(host_hunklevel);
+    Cache_ClearResources();
+    Hunk_BeginLevel();
 
     cls.signon = 0;
     memset(&sv, 0, sizeof(sv));
@@ -448,7 +462,8 @@ static qboolean Host_FilterTime(uint32_t time)
 {
     realtime += time;
 
-    if (!cls.timedemo && realtime - oldrealtime < 1000 / 72)
+    // dedicated servers are paced by sys_ticrate_ms in the system driver instead
+    if (!cls.timedemo && cls.state != ca_dedicated && realtime - oldrealtime < 1000 / 72)
         return false; // framerate is too high
 
     host_frametime = realtime - oldrealtime;
@@ -491,6 +506,8 @@ void Host_GetConsoleCommands(void)
 
 void Host_ServerFrame(void)
 {
+    PROF_BEGIN("Host_ServerFrame");
+
     // run the world state
     pr_global_struct->frametime = host_frametime_float;
 
@@ -510,41 +527,61 @@ void Host_ServerFrame(void)
 
     // send all messages to the clients
     SV_SendClientMessages();
+    PROF_END();
 }
 
+#ifndef SERVERONLY
 /*
 ==================
-Host_Frame
+Host_PhaseTime
 
-Runs all active servers
+Microseconds since *start, which moves on to now
 ==================
 */
-void Host_Frame(uint32_t time)
+static uint32_t Host_PhaseTime(uint64_t *start)
 {
-    if (setjmp(host_abortserver))
-        return; // something bad happened, or the server disconnected
+    uint64_t now = Sys_MicroTicks();
+    uint32_t time = now - *start;
 
-    // keep the random time dependent
-    rand();
+    *start = now;
+    return time;
+}
+#endif
 
-    // decide the simulation time
-    if (!Host_FilterTime(time))
-        return; // don't run too fast, or packets will flood out
+/*
+==================
+Host_RunFrame
+
+Runs one frame once Host_Frame decided it's time for it
+==================
+*/
+static void Host_RunFrame(void)
+{
+#ifndef SERVERONLY
+    uint32_t phase[TD_NUMPHASES];
+    uint64_t start;
+#endif
 
+    PROF_BEGIN("Host_Frame");
+
+#ifndef SERVERONLY
     // get new key events
     Sys_SendKeyEvents();
 
     // allow mice or other external controllers to add commands
     IN_Commands();
+#endif
 
     // process console commands
     Cbuf_Execute();
 
     NET_Poll();
 
+#ifndef SERVERONLY
     // if running the server locally, make intentions now
     if (sv.active)
         CL_SendCmd();
+#endif
 
     //-------------------
     //
@@ -555,9 +592,16 @@ void Host_Frame(uint32_t time)
     // check for commands typed to the host
     Host_GetConsoleCommands();
 
+#ifndef SERVERONLY
+    start = Sys_MicroTicks();
+#endif
     if (sv.active)
         Host_ServerFrame();
+#ifndef SERVERONLY
+    phase[td_server] = Host_PhaseTime(&start);
+#endif
 
+#ifndef SERVERONLY
     //-------------------
     //
     // client operations
@@ -568,15 +612,20 @@ void Host_Frame(uint32_t time)
     // the incoming messages have been read
     if (!sv.active)
         CL_SendCmd();
+#endif
 
     host_time += host_frametime;
 
+#ifndef SERVERONLY
     // fetch results from server
+    Host_PhaseTime(&start);
     if (cls.state == ca_connected) {
         CL_ReadFromServer();
     }
+    phase[td_parse] = Host_PhaseTime(&start);
 
     SCR_UpdateScreen();
+    phase[td_screen] = Host_PhaseTime(&start);
 
     // update audio
     if (cls.signon == SIGNONS) {
@@ -586,7 +635,44 @@ void Host_Frame(uint32_t time)
         S_Update(vec3_origin, vec3_origin, vec3_origin, vec3_origin);
 
     CDAudio_Update();
+    phase[td_audio] = Host_PhaseTime(&start);
+
+    if (cls.timedemo)
+        CL_TimeDemoFrame(phase);
+#endif
+
+    // nothing is drawing from the cache between frames
+    Cache_Compact();
+
+    // send what this frame queued up in one go
+    NET_Poll();
+    PROF_END();
+}
+
+/*
+==================
+Host_Frame
+
+Runs all active servers
+==================
+*/
+void Host_Frame(uint32_t time)
+{
+    if (setjmp(host_abortserver)) {
+        Prof_Unwind();
+        return; // something bad happened, or the server disconnected
+    }
+
+    // keep the random time dependent
+    rand();
 
+    // decide the simulation time
+    if (!Host_FilterTime(time))
+        return; // don't run too fast, or packets will flood out
+
+    Host_RunFrame();
+
+    Prof_EndFrame();
     host_framecount++;
 }
 
@@ -606,23 +692,32 @@ void Host_Init(quakeparms_t *parms)
     Cvar_Init();
     Cbuf_Init();
     Cmd_Init();
+#ifndef SERVERONLY
     V_Init();
+#endif
     COM_Init();
     Host_InitLocal();
+#ifndef SERVERONLY
     W_LoadWadFile("gfx.wad");
     Key_Init();
+#endif
     Con_Init();
+#ifndef SERVERONLY
     M_Init();
+#endif
     PR_Init();
     Mod_Init();
     NET_Init();
     SV_Init();
+    Jobs_Init();
+    Prefetch_Init();
 
     Con_Printf("Exe: " __TIME__ " " __DATE__ "\n");
     Con_Printf("%4.1f megabyte heap\n", parms->memsize / (1024 * 1024.0));
 
     R_InitTextures(); // needed even for dedicated servers
 
+#ifndef SERVERONLY
     if (cls.state != ca_dedicated) {
         host_basepal = (byte *)COM_LoadHunkFile("gfx/palette.lmp");
         if (!host_basepal)
@@ -658,6 +753,7 @@ void Host_Init(quakeparms_t *parms)
         IN_Init();
 #endif
     }
+#endif
 
     Cbuf_InsertText("exec quake.rc\n");
 
@@ -691,13 +787,16 @@ void Host_Shutdown(void)
     scr_disabled_for_loading = true;
 
     Host_WriteConfiguration();
+    Hunk_Shutdown();
 
     CDAudio_Shutdown();
     NET_Shutdown();
+#ifndef SERVERONLY
     S_Shutdown();
     IN_Shutdown();
 
     if (cls.state != ca_dedicated) {
         VID_Shutdown();
     }
+#endif
 }
@@ -0,0 +1,154 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs.c -- worker threads
+
+#include "quakedef.h"
+
+#ifdef ENABLE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+static int jobs_numthreads = 1;
+
+#ifdef ENABLE_THREADS
+
+typedef struct {
+    std::mutex lock;
+    std::condition_variable wake; // a new batch was queued
+    std::condition_variable idle; // the last worker left the batch
+    uint32_t batch; // bumped by every Jobs_Run
+    int busy; // workers inside the current batch
+
+    jobfunc_t func;
+    void *arg;
+    int count;
+    int next; // next index to hand out
+    int finished;
+} jobqueue_t;
+
+// never freed, the workers are still waiting on it when the program exits
+static jobqueue_t *jobs;
+
+static void Jobs_Work(void)
+{
+    int index;
+
+    while ((index = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_ACQ_REL)) < jobs->count) {
+        jobs->func(index, jobs->arg);
+        __atomic_add_fetch(&jobs->finished, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+static void Jobs_Worker(void)
+{
+    std::unique_lock<std::mutex> l(jobs->lock);
+    uint32_t seen = 0;
+
+    while (1) {
+        jobs->wake.wait(l, [&] { return jobs->batch != seen; });
+        seen = jobs->batch;
+        jobs->busy++;
+
+        l.unlock();
+        Jobs_Work();
+        l.lock();
+
+        if (--jobs->busy == 0)
+            jobs->idle.notify_one();
+    }
+}
+
+#endif
+
+/*
+================
+Jobs_Init
+
+-threads <count> overrides the number of cores
+================
+*/
+void Jobs_Init(void)
+{
+#ifdef ENABLE_THREADS
+    int i;
+
+    i = COM_CheckParm("-threads");
+    if (i && i + 1 < com_argc)
+        jobs_numthreads = Q_atoi(com_argv[i + 1]);
+    else
+        jobs_numthreads = std::thread::hardware_concurrency();
+    if (jobs_numthreads < 1)
+        jobs_numthreads = 1;
+    if (jobs_numthreads > MAX_JOB_THREADS)
+        jobs_numthreads = MAX_JOB_THREADS;
+
+    if (jobs_numthreads > 1) {
+        jobs = new jobqueue_t();
+        for (i = 1; i < jobs_numthreads; i++)
+            std::thread(Jobs_Worker).detach();
+    }
+#endif
+    Con_Printf("%i job threads\n", jobs_numthreads);
+}
+
+int Jobs_NumThreads(void)
+{
+    return jobs_numthreads;
+}
+
+/*
+================
+Jobs_Run
+================
+*/
+void Jobs_Run(jobfunc_t func, int count, void *arg)
+{
+    int i;
+
+#ifdef ENABLE_THREADS
+    if (jobs && count > 1) {
+        {
+            // a worker that woke up late may still be looking at the last batch
+            std::unique_lock<std::mutex> l(jobs->lock);
+            jobs->idle.wait(l, [] { return !jobs->busy; });
+            jobs->func = func;
+            jobs->arg = arg;
+            jobs->count = count;
+            jobs->finished = 0;
+            __atomic_store_n(&jobs->next, 0, __ATOMIC_RELEASE);
+            jobs->batch++;
+        }
+        jobs->wake.notify_all();
+
+        Jobs_Work();
+
+        std::unique_lock<std::mutex> l(jobs->lock);
+        jobs->idle.wait(l, [] {
+            return __atomic_load_n(&jobs->finished, __ATOMIC_ACQUIRE) == jobs->count && !jobs->busy;
+        });
+        return;
+    }
+#endif
+
+    for (i = 0; i < count; i++)
+        func(i, arg);
+}
@@ -0,0 +1,452 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// mod_bake.c -- brush models saved the way they are in memory
+
+#include "quakedef.h"
+
+#define BAKEHEADER (('K' << 24) + ('A' << 16) + ('B' << 8) + 'Q')
+#define BAKE_VERSION 2
+
+// a pointer's offset with this bit set is to the external of the index the
+// pointer holds, offsets are otherwise pointer aligned
+#define BAKE_EXTERNAL 1
+
+/*
+The file is the header, imagesize bytes of hunk, nummodels model_t's and
+numrelocs offsets of the pointers in them. Offsets under imagesize are in the
+hunk, the rest in the models.
+*/
+typedef struct {
+    int ident; // BAKEHEADER, in the byte order of the build that baked it
+    int version;
+    int layout; // CRC of the structure sizes
+    int bspcrc; // CRC of the whole .bsp
+    int bspsize;
+    int imagesize; // a multiple of 16, like the hunk
+    int nummodels;
+    int numrelocs;
+} bakeheader_t;
+
+CVAR_REGISTER(mod_baked, CVAR_CTOR({ "mod_baked", 1 }));
+
+qboolean mod_baking;
+
+static bakeformat_t const *bake_format;
+static byte *bake_base; // the hunk run being baked
+static model_t **bake_models;
+static int bake_nummodels;
+static int bake_imagesize, bake_size; // the hunk run, and the models after it
+static byte *bake_out; // header, hunk run and models, with the pointers fixed
+static int *bake_relocs;
+static int bake_numrelocs;
+static byte *bake_seen; // bit per pointer sized word of bake_out
+static qboolean bake_failed;
+static int bake_highmark;
+
+static unsigned short Mod_BakeLayout(bakeformat_t const *format)
+{
+    unsigned short crc;
+    int sizes[3];
+    int i;
+
+    sizes[0] = BAKE_VERSION;
+    sizes[1] = sizeof(void *);
+    sizes[2] = sizeof(model_t);
+
+    CRC_Init(&crc);
+    for (i = 0; i < sizeof(sizes); i++)
+        CRC_ProcessByte(&crc, ((byte *)sizes)[i]);
+    for (i = 0; i < format->numsizes * sizeof(int); i++)
+        CRC_ProcessByte(&crc, ((byte const *)format->sizes)[i]);
+    for (i = 0; format->extension[i]; i++)
+        CRC_ProcessByte(&crc, format->extension[i]);
+
+    return CRC_Value(crc);
+}
+
+/*
+=================
+Mod_BakeSource
+
+The size and CRC of the whole .bsp, any lump can change without the others
+=================
+*/
+static qboolean Mod_BakeSource(char const *name, int *size, int *crc)
+{
+    byte buf[16384];
+    byte const *mapped;
+    unsigned short value;
+    int i, length, handle, left;
+
+    CRC_Init(&value);
+    mapped = COM_MapFile(name, size);
+    if (!mapped)
+        mapped = Prefetch_Find(name, size);
+    if (mapped) {
+        if (*size < sizeof(dheader_t))
+            return false;
+        for (i = 0; i < *size; i++)
+            CRC_ProcessByte(&value, mapped[i]);
+    } else {
+        *size = COM_OpenFile(name, &handle);
+        if (handle == -1)
+            return false;
+        if (*size < sizeof(dheader_t)) {
+            COM_CloseFile(handle);
+            return false;
+        }
+        for (left = *size; left > 0; left -= length) {
+            length = left < sizeof(buf) ? left : sizeof(buf);
+            if (Sys_FileRead(handle, buf, length) != length)
+                break;
+            for (i = 0; i < length; i++)
+                CRC_ProcessByte(&value, buf[i]);
+        }
+        COM_CloseFile(handle);
+        if (left > 0)
+            return false;
+    }
+
+    *crc = CRC_Value(value);
+    return true;
+}
+
+static void Mod_BakePath(bakeformat_t const *format, char const *name, char *path, int pathsize)
+{
+    char base[MAX_QPATH];
+
+    COM_StripExtension(name, base);
+    snprintf(path, pathsize, "%s%s", base, format->extension);
+}
+
+/*
+=================
+Mod_BakedPath
+
+The baked file the renderer looks for before parsing name
+=================
+*/
+qboolean Mod_BakedPath(char const *name, char *path, int pathsize)
+{
+    if (!mod_baked.value)
+        return false;
+    Mod_BakePath(&mod_bakeformat, name, path, pathsize);
+    return true;
+}
+
+/*
+=================
+Mod_BakeBegin
+=================
+*/
+void Mod_BakeBegin(bakeformat_t const *format, int mark, model_t **models, int nummodels)
+{
+    int i, words;
+
+    bake_format = format;
+    bake_base = Hunk_LowPointer(mark);
+    bake_models = models;
+    bake_nummodels = nummodels;
+    bake_imagesize = Hunk_LowMark() - mark;
+    bake_size = bake_imagesize + nummodels * sizeof(model_t);
+    bake_numrelocs = 0;
+    bake_failed = false;
+
+    words = bake_size / sizeof(void *);
+    bake_highmark = Hunk_HighMark();
+    bake_out = (byte *)Hunk_HighAllocName(sizeof(bakeheader_t) + bake_size, "bake");
+    bake_relocs = (int *)Hunk_HighAllocName(words * sizeof(int), "bake");
+    bake_seen = (byte *)Hunk_HighAllocName((words + 7) / 8, "bake");
+
+    memcpy(bake_out + sizeof(bakeheader_t), bake_base, bake_imagesize);
+    for (i = 0; i < nummodels; i++)
+        memcpy(bake_out + sizeof(bakeheader_t) + bake_imagesize + i * sizeof(model_t), models[i], sizeof(model_t));
+}
+
+/*
+=================
+Mod_BakePointer
+=================
+*/
+void Mod_BakePointer(void *field)
+{
+    byte *target;
+    int i, offset;
+    uintptr_t *out;
+
+    target = *(byte **)field;
+    if (!target)
+        return;
+
+    // where the pointer goes in the file
+    if ((byte *)field >= bake_base && (byte *)field < bake_base + bake_imagesize)
+        offset = (byte *)field - bake_base;
+    else {
+        for (i = 0; i < bake_nummodels; i++)
+            if ((byte *)field >= (byte *)bake_models[i] && (byte *)field < (byte *)(bake_models[i] + 1))
+                break;
+        if (i == bake_nummodels)
+            Sys_Error("Mod_BakePointer: pointer outside the model");
+        offset = bake_imagesize + i * sizeof(model_t) + ((byte *)field - (byte *)bake_models[i]);
+    }
+
+    if (bake_seen[offset / sizeof(void *) / 8] & (1 << (offset / sizeof(void *) % 8)))
+        return;
+    bake_seen[offset / sizeof(void *) / 8] |= 1 << (offset / sizeof(void *) % 8);
+
+    // what it points at
+    out = (uintptr_t *)(bake_out + sizeof(bakeheader_t) + offset);
+    if (target >= bake_base && target < bake_base + bake_imagesize) {
+        *out = target - bake_base;
+        bake_relocs[bake_numrelocs++] = offset;
+        return;
+    }
+    for (i = 0; i < bake_format->numexternals; i++) {
+        if (target == *(byte **)bake_format->externals[i]) {
+            *out = i;
+            bake_relocs[bake_numrelocs++] = offset | BAKE_EXTERNAL;
+            return;
+        }
+    }
+
+    Con_Printf("%s: pointer at %i points outside the model\n", bake_models[0]->name, offset);
+    bake_failed = true;
+}
+
+/*
+=================
+Mod_BakeEnd
+=================
+*/
+void Mod_BakeEnd(char const *name)
+{
+    bakeheader_t *header;
+    char file[MAX_QPATH], path[MAX_OSPATH];
+    uintptr_t word;
+    int i, handle, stray;
+
+    header = (bakeheader_t *)bake_out;
+    header->ident = BAKEHEADER;
+    header->version = BAKE_VERSION;
+    header->layout = Mod_BakeLayout(bake_format);
+    header->imagesize = bake_imagesize;
+    header->nummodels = bake_nummodels;
+    header->numrelocs = bake_numrelocs;
+    if (!Mod_BakeSource(name, &header->bspsize, &header->bspcrc)) {
+        Con_Printf("couldn't read %s\n", name);
+        bake_failed = true;
+    }
+
+    // a pointer into the model the loader didn't report won't survive the
+    // trip, it's most likely a new field
+    stray = 0;
+    for (i = 0; i < bake_size / sizeof(void *); i++) {
+        if (bake_seen[i / 8] & (1 << (i % 8)))
+            continue;
+        memcpy(&word, bake_out + sizeof(bakeheader_t) + i * sizeof(void *), sizeof(word));
+        if (word >= (uintptr_t)bake_base && word < (uintptr_t)(bake_base + bake_imagesize))
+            stray++;
+    }
+    if (stray)
+        Con_Printf("WARNING: %i words of %s look like pointers the loader missed\n", stray, name);
+
+    if (!bake_failed) {
+        Mod_BakePath(bake_format, name, file, sizeof(file));
+        if (snprintf(path, sizeof(path), "%s/%s", com_gamedir, file) >= sizeof(path)) {
+            Con_Printf("ERROR: the path of %s is too long.\n", file);
+            bake_failed = true;
+        }
+    }
+
+    if (!bake_failed) {
+        COM_CreatePath(path);
+        handle = Sys_FileOpenWrite(path);
+        if (handle == -1)
+            Con_Printf("ERROR: couldn't open %s.\n", path);
+        else {
+            Sys_FileWrite(handle, bake_out, sizeof(bakeheader_t) + bake_size);
+            Sys_FileWrite(handle, bake_relocs, bake_numrelocs * sizeof(int));
+            Sys_FileClose(handle);
+            COM_FlushMisses();
+            Prefetch_Drop(file);
+            Con_Printf("%s: %i bytes, %i models, %i pointers\n", path, bake_imagesize, bake_nummodels,
+                       bake_numrelocs);
+        }
+    }
+
+    Hunk_FreeToHighMark(bake_highmark);
+}
+
+/*
+=================
+Mod_ReadBaked
+=================
+*/
+static int Mod_ReadBaked(bakeformat_t const *format, char const *name, model_t const **models)
+{
+    bakeheader_t header;
+    char path[MAX_OSPATH];
+    char hunkname[32];
+    byte const *mapped;
+    byte *image, *rest, *at;
+    int const *relocs;
+    int length, handle, mark, restsize, size, bspsize, bspcrc, i, offset;
+
+    Mod_BakePath(format, name, path, sizeof(path));
+    handle = -1;
+    mapped = COM_MapFile(path, &length);
+    if (!mapped)
+        mapped = Prefetch_Find(path, &length);
+    if (mapped) {
+        if (length < sizeof(header))
+            return 0;
+        memcpy(&header, mapped, sizeof(header));
+    } else {
+        length = COM_OpenFile(path, &handle);
+        if (handle == -1)
+            return 0;
+        if (length < sizeof(header) || Sys_FileRead(handle, &header, sizeof(header)) != sizeof(header)) {
+            COM_CloseFile(handle);
+            return 0;
+        }
+    }
+
+    restsize = header.nummodels * sizeof(model_t) + header.numrelocs * sizeof(int);
+    if (header.ident != BAKEHEADER || header.version != BAKE_VERSION || header.layout != Mod_BakeLayout(format) ||
+        header.nummodels < 1 || header.nummodels > MAX_MAP_MODELS || header.imagesize < 0 || header.numrelocs < 0 ||
+        length != sizeof(header) + header.imagesize + restsize) {
+        Con_DPrintf("%s doesn't match %s, parsing it\n", path, name);
+        if (handle != -1)
+            COM_CloseFile(handle);
+        return 0;
+    }
+
+    COM_FileBase(name, hunkname, sizeof(hunkname));
+    mark = Hunk_LowMark();
+    image = (byte *)Hunk_AllocName(header.imagesize, hunkname);
+    if (mapped) {
+        memcpy(image, mapped + sizeof(header), header.imagesize);
+        rest = (byte *)Hunk_TempAlloc(header.nummodels * sizeof(model_t));
+        memcpy(rest, mapped + sizeof(header) + header.imagesize, header.nummodels * sizeof(model_t));
+        relocs = (int const *)(mapped + sizeof(header) + header.imagesize + header.nummodels * sizeof(model_t));
+    } else {
+        rest = (byte *)Hunk_TempAlloc(restsize);
+        Sys_FileRead(handle, image, header.imagesize);
+        Sys_FileRead(handle, rest, restsize);
+        COM_CloseFile(handle);
+        relocs = (int const *)(rest + header.nummodels * sizeof(model_t));
+    }
+
+    // only now, the .bsp may be in the same pak and share its handle
+    if (!Mod_BakeSource(name, &bspsize, &bspcrc) || bspsize != header.bspsize || bspcrc != header.bspcrc) {
+        Con_DPrintf("%s doesn't match %s, parsing it\n", path, name);
+        Hunk_FreeToLowMark(mark);
+        return 0;
+    }
+
+    size = header.imagesize + header.nummodels * sizeof(model_t);
+    for (i = 0; i < header.numrelocs; i++) {
+        offset = relocs[i] & ~BAKE_EXTERNAL;
+        if (offset < 0 || offset % sizeof(void *) || offset > size - sizeof(void *))
+            break;
+        at = offset < header.imagesize ? image + offset : rest + offset - header.imagesize;
+        if (!(relocs[i] & BAKE_EXTERNAL))
+            *(uintptr_t *)at += (uintptr_t)image;
+        else if (*(uintptr_t *)at < format->numexternals)
+            *(void **)at = *(void **)format->externals[*(uintptr_t *)at];
+        else
+            break;
+    }
+    if (i < header.numrelocs) {
+        Con_Printf("%s is corrupt, parsing %s\n", path, name);
+        Hunk_FreeToLowMark(mark);
+        return 0;
+    }
+
+    *models = (model_t const *)rest;
+    return header.nummodels;
+}
+
+/*
+=================
+Mod_LoadBaked
+=================
+*/
+int Mod_LoadBaked(bakeformat_t const *format, char const *name, model_t const **models)
+{
+    int length, nummodels;
+
+    length = strlen(name);
+    if (mod_baking || !mod_baked.value || length < 4 || Q_strcmp(name + length - 4, ".bsp"))
+        return 0;
+
+    PROF_BEGIN("Mod_LoadBaked");
+    nummodels = Mod_ReadBaked(format, name, models);
+    PROF_END();
+    return nummodels;
+}
+
+/*
+=================
+Mod_Bake_f
+
+mod_bake <model> [model...]
+=================
+*/
+static void Mod_Bake_f(void)
+{
+    model_t *mod;
+    uint64_t start, parsed;
+    int i, mark;
+
+    if (Cmd_Argc() < 2) {
+        Con_Printf("mod_bake <maps/name.bsp> [...] : save brush models load ready in the game directory\n");
+        return;
+    }
+    if (sv.active || cls.state == ca_connected) {
+        Con_Printf("mod_bake needs the memory maps use, disconnect first\n");
+        return;
+    }
+
+    for (i = 1; i < Cmd_Argc(); i++) {
+        Host_ClearMemory();
+        mark = Hunk_LowMark();
+        mod_baking = true;
+        start = Sys_MicroTicks();
+        mod = Mod_ForName(Cmd_Argv(i), false);
+        parsed = Sys_MicroTicks() - start;
+        mod_baking = false;
+        if (!mod || mod->type != mod_brush) {
+            Con_Printf("%s is not a brush model\n", Cmd_Argv(i));
+            continue;
+        }
+        Mod_BakeModel(mod, mark);
+
+        // load it back, to see it works and how much faster
+        Host_ClearMemory();
+        start = Sys_MicroTicks();
+        Mod_ForName(Cmd_Argv(i), true);
+        Con_Printf("%s: parsed in %i us, loads baked in %i us\n", Cmd_Argv(i), (int)parsed,
+                   (int)(Sys_MicroTicks() - start));
+    }
+    Host_ClearMemory();
+}
+
+CMD_REGISTER("mod_bake", Mod_Bake_f);
@@ -0,0 +1,991 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_dgrm.c -- reliable and unreliable messages over datagrams
+
+#include "quakedef.h"
+#include "net_dgrm.h"
+#include "net_udp.h"
+
+/*
+This is id's datagram protocol (the NETFLAG_ header in net.h), so the
+connection and slist requests of other Quake clients and servers still work.
+Reliable messages go out in MAX_DATAGRAM pieces, one at a time, each sent
+again every second until it's acked. Unreliable ones are numbered and dropped
+when they arrive after a later one.
+
+The connections of a landriver all share its control socket. Datagram_Poll,
+from NET_Poll, reads everything that arrived and queues it up for the
+connection it came from, by address, or as a control packet, then hands the
+landriver's batched writes to the socket.
+*/
+
+#define DGRAM_QUEUE 256 // datagrams read but not taken yet
+
+typedef struct dgrampacket_s {
+    struct dgrampacket_s *next;
+    qsocket_t *sock; // NULL for control packets
+    int landriver;
+    struct qsockaddr addr;
+    int length;
+    byte data[NET_DATAGRAMSIZE];
+} dgrampacket_t;
+
+static dgrampacket_t dgram_packets[DGRAM_QUEUE];
+static dgrampacket_t *dgram_free;
+static dgrampacket_t *dgram_queue, *dgram_last;
+
+static qboolean dgram_listening;
+static qboolean dgram_connecting;
+
+static struct {
+    unsigned int length;
+    unsigned int sequence;
+    byte data[MAX_DATAGRAM];
+} packetBuffer;
+
+static int packetsSent = 0;
+static int packetsReSent = 0;
+static int packetsReceived = 0;
+static int receivedDuplicateCount = 0;
+static int shortPacketCount = 0;
+static int droppedDatagrams;
+
+int net_landriverlevel;
+
+// these two macros are to make the code more readable
+#define sfunc net_landrivers[sock->landriver]
+#define dfunc net_landrivers[net_landriverlevel]
+
+#define IsReply(p) ((p)->data[4] & 0x80)
+
+/*
+==================
+Datagram_Take
+
+Takes the oldest queued datagram of sock off the queue. Control packets
+(sock NULL) are requests or replies to ours, from this landriver.
+==================
+*/
+static dgrampacket_t *Datagram_Take(qsocket_t *sock, qboolean reply)
+{
+    dgrampacket_t **link, *p, *prev = NULL;
+
+    for (link = &dgram_queue; (p = *link); prev = p, link = &p->next) {
+        if (p->sock != sock)
+            continue;
+        if (!sock && (p->landriver != net_landriverlevel || (IsReply(p) ? !reply : reply)))
+            continue;
+        *link = p->next;
+        if (dgram_last == p)
+            dgram_last = prev;
+        return p;
+    }
+
+    return NULL;
+}
+
+static void Datagram_Release(dgrampacket_t *p)
+{
+    p->next = dgram_free;
+    dgram_free = p;
+}
+
+/*
+==================
+Datagram_Read
+
+Queues up what the landriver read. With toreply it stops after a reply, so
+the datagrams behind an accept stay put until the connection knows its address.
+==================
+*/
+static void Datagram_Read(qboolean toreply)
+{
+    dgrampacket_t *p;
+    qsocket_t *s;
+    unsigned int control;
+    int length;
+
+    while ((p = dgram_free)) {
+        length = dfunc.Read(dfunc.controlSock, p->data, NET_DATAGRAMSIZE, &p->addr);
+        if (length <= 0)
+            break;
+
+        if (length < (int)NET_HEADERSIZE) {
+            shortPacketCount++;
+            continue;
+        }
+
+        control = BigLong(*((int *)p->data));
+        if (control & NETFLAG_CTL) {
+            if ((control & NETFLAG_LENGTH_MASK) != (unsigned)length || length <= 4)
+                continue;
+            // only queue up what somebody's going to take
+            if (IsReply(p) ? !dgram_connecting && !slistInProgress : !dgram_listening)
+                continue;
+            s = NULL;
+        } else {
+            for (s = net_activeSockets; s; s = s->next)
+                if (s->driver == net_driverlevel && s->landriver == net_landriverlevel &&
+                    dfunc.AddrCompare(&p->addr, &s->addr) == 0)
+                    break;
+            if (!s)
+                continue;
+        }
+
+        dgram_free = p->next;
+        p->next = NULL;
+        p->sock = s;
+        p->landriver = net_landriverlevel;
+        p->length = length;
+        if (dgram_last)
+            dgram_last->next = p;
+        else
+            dgram_queue = p;
+        dgram_last = p;
+
+        if (toreply && !s && IsReply(p))
+            break;
+    }
+}
+
+/*
+================
+Datagram_Poll
+================
+*/
+void Datagram_Poll(void)
+{
+    for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++) {
+        if (!dfunc.initialized)
+            continue;
+        Datagram_Read(false);
+        dfunc.Flush(dfunc.controlSock);
+    }
+}
+
+/*
+==================
+Datagram_SendControl
+
+Sends net_message, a control packet with its header left blank
+==================
+*/
+static void Datagram_SendControl(struct qsockaddr *addr)
+{
+    *((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+    dfunc.Write(dfunc.controlSock, net_message.data, net_message.cursize, addr);
+    SZ_Clear(&net_message);
+}
+
+/*
+================
+Datagram_SendMessage
+================
+*/
+int Datagram_SendMessage(qsocket_t *sock, sizebuf_t *data)
+{
+    unsigned int packetLen;
+    unsigned int dataLen;
+    unsigned int eom;
+
+    if (data->cursize == 0)
+        Sys_Error("Datagram_SendMessage: zero length message\n");
+
+    if (data->cursize > NET_MAXMESSAGE)
+        Sys_Error("Datagram_SendMessage: message too big %u\n", data->cursize);
+
+    if (sock->canSend == false)
+        Sys_Error("SendMessage: called with canSend == false\n");
+
+    Q_memcpy(sock->sendMessage, data->data, data->cursize);
+    sock->sendMessageLength = data->cursize;
+
+    if (data->cursize <= MAX_DATAGRAM) {
+        dataLen = data->cursize;
+        eom = NETFLAG_EOM;
+    } else {
+        dataLen = MAX_DATAGRAM;
+        eom = 0;
+    }
+    packetLen = NET_HEADERSIZE + dataLen;
+
+    packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+    packetBuffer.sequence = BigLong(sock->sendSequence++);
+    Q_memcpy(packetBuffer.data, sock->sendMessage, dataLen);
+
+    sock->canSend = false;
+
+    if (sfunc.Write(sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+        return -1;
+
+    sock->lastSendTime = net_time;
+    packetsSent++;
+    return 1;
+}
+
+/*
+==================
+SendMessageNext
+
+Sends the next piece of the reliable message once the last one was acked
+==================
+*/
+static int SendMessageNext(qsocket_t *sock)
+{
+    unsigned int packetLen;
+    unsigned int dataLen;
+    unsigned int eom;
+
+    if (sock->sendMessageLength <= MAX_DATAGRAM) {
+        dataLen = sock->sendMessageLength;
+        eom = NETFLAG_EOM;
+    } else {
+        dataLen = MAX_DATAGRAM;
+        eom = 0;
+    }
+    packetLen = NET_HEADERSIZE + dataLen;
+
+    packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+    packetBuffer.sequence = BigLong(sock->sendSequence++);
+    Q_memcpy(packetBuffer.data, sock->sendMessage, dataLen);
+
+    sock->sendNext = false;
+
+    if (sfunc.Write(sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+        return -1;
+
+    sock->lastSendTime = net_time;
+    packetsSent++;
+    return 1;
+}
+
+/*
+==================
+ReSendMessage
+
+Sends the piece that wasn't acked in time again
+==================
+*/
+static int ReSendMessage(qsocket_t *sock)
+{
+    unsigned int packetLen;
+    unsigned int dataLen;
+    unsigned int eom;
+
+    if (sock->sendMessageLength <= MAX_DATAGRAM) {
+        dataLen = sock->sendMessageLength;
+        eom = NETFLAG_EOM;
+    } else {
+        dataLen = MAX_DATAGRAM;
+        eom = 0;
+    }
+    packetLen = NET_HEADERSIZE + dataLen;
+
+    packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+    packetBuffer.sequence = BigLong(sock->sendSequence - 1);
+    Q_memcpy(packetBuffer.data, sock->sendMessage, dataLen);
+
+    sock->sendNext = false;
+
+    if (sfunc.Write(sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+        return -1;
+
+    sock->lastSendTime = net_time;
+    packetsReSent++;
+    return 1;
+}
+
+/*
+================
+Datagram_CanSendMessage
+================
+*/
+qboolean Datagram_CanSendMessage(qsocket_t *sock)
+{
+    if (sock->sendNext)
+        SendMessageNext(sock);
+
+    return sock->canSend;
+}
+
+/*
+================
+Datagram_CanSendUnreliableMessage
+================
+*/
+qboolean Datagram_CanSendUnreliableMessage(qsocket_t *sock)
+{
+    (void)sock;
+    return true;
+}
+
+/*
+================
+Datagram_SendUnreliableMessage
+================
+*/
+int Datagram_SendUnreliableMessage(qsocket_t *sock, sizebuf_t *data)
+{
+    int packetLen;
+
+    if (data->cursize == 0)
+        Sys_Error("Datagram_SendUnreliableMessage: zero length message\n");
+
+    if (data->cursize > MAX_DATAGRAM)
+        Sys_Error("Datagram_SendUnreliableMessage: message too big %u\n", data->cursize);
+
+    packetLen = NET_HEADERSIZE + data->cursize;
+
+    packetBuffer.length = BigLong(packetLen | NETFLAG_UNRELIABLE);
+    packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
+    Q_memcpy(packetBuffer.data, data->data, data->cursize);
+
+    if (sfunc.Write(sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+        return -1;
+
+    packetsSent++;
+    return 1;
+}
+
+/*
+==================
+Datagram_ProcessPacket
+
+Returns what Datagram_GetMessage does for one datagram of sock
+==================
+*/
+static int Datagram_ProcessPacket(qsocket_t *sock, byte *packet, int packetLen)
+{
+    unsigned int length;
+    unsigned int flags;
+    unsigned int sequence;
+    unsigned int count;
+
+    length = BigLong(((int *)packet)[0]);
+    flags = length & (~NETFLAG_LENGTH_MASK);
+    length &= NETFLAG_LENGTH_MASK;
+    sequence = BigLong(((int *)packet)[1]);
+
+    if (length != (unsigned)packetLen) {
+        shortPacketCount++;
+        return 0;
+    }
+
+    packetsReceived++;
+    packet += NET_HEADERSIZE;
+    length -= NET_HEADERSIZE;
+
+    if (flags & NETFLAG_UNRELIABLE) {
+        if (sequence < sock->unreliableReceiveSequence) {
+            Con_DPrintf("Got a stale datagram\n");
+            return 0;
+        }
+        if (sequence != sock->unreliableReceiveSequence) {
+            count = sequence - sock->unreliableReceiveSequence;
+            droppedDatagrams += count;
+            Con_DPrintf("Dropped %u datagram(s)\n", count);
+        }
+        sock->unreliableReceiveSequence = sequence + 1;
+
+        SZ_Clear(&net_message);
+        SZ_Write(&net_message, packet, length);
+        return 2;
+    }
+
+    if (flags & NETFLAG_ACK) {
+        if (sequence != (sock->sendSequence - 1)) {
+            Con_DPrintf("Stale ACK received\n");
+            return 0;
+        }
+        if (sequence == sock->ackSequence) {
+            sock->ackSequence++;
+            if (sock->ackSequence != sock->sendSequence)
+                Con_DPrintf("ack sequencing error\n");
+        } else {
+            Con_DPrintf("Duplicate ACK received\n");
+            return 0;
+        }
+        sock->sendMessageLength -= MAX_DATAGRAM;
+        if (sock->sendMessageLength > 0) {
+            memmove(sock->sendMessage, sock->sendMessage + MAX_DATAGRAM, sock->sendMessageLength);
+            sock->sendNext = true;
+        } else {
+            sock->sendMessageLength = 0;
+            sock->canSend = true;
+        }
+        return 0;
+    }
+
+    if (flags & NETFLAG_DATA) {
+        packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
+        packetBuffer.sequence = BigLong(sequence);
+        sfunc.Write(sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &sock->addr);
+
+        if (sequence != sock->receiveSequence) {
+            receivedDuplicateCount++;
+            return 0;
+        }
+        sock->receiveSequence++;
+
+        if (sock->receiveMessageLength + length > NET_MAXMESSAGE) {
+            Con_Printf("Datagram_GetMessage: reliable message from %s too long\n", sock->address);
+            return -1;
+        }
+
+        if (flags & NETFLAG_EOM) {
+            SZ_Clear(&net_message);
+            SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
+            SZ_Write(&net_message, packet, length);
+            sock->receiveMessageLength = 0;
+            return 1;
+        }
+
+        Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, packet, length);
+        sock->receiveMessageLength += length;
+    }
+
+    return 0;
+}
+
+/*
+================
+Datagram_GetMessage
+================
+*/
+int Datagram_GetMessage(qsocket_t *sock)
+{
+    dgrampacket_t *p;
+    int ret = 0;
+
+    if (!sock->canSend)
+        if ((net_time - sock->lastSendTime) > MS_PER_S)
+            ReSendMessage(sock);
+
+    while ((p = Datagram_Take(sock, false))) {
+        ret = Datagram_ProcessPacket(sock, p->data, p->length);
+        Datagram_Release(p);
+        if (ret)
+            break;
+    }
+
+    if (sock->sendNext)
+        SendMessageNext(sock);
+
+    return ret;
+}
+
+static void PrintStats(qsocket_t *s)
+{
+    Con_Printf("canSend = %4u   \n", s->canSend);
+    Con_Printf("sendSeq = %4u   ", s->sendSequence);
+    Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+    Con_Printf("\n");
+}
+
+/*
+================
+NET_Stats_f
+================
+*/
+static void NET_Stats_f(void)
+{
+    qsocket_t *s;
+
+    if (Cmd_Argc() == 1) {
+        Con_Printf("unreliable messages sent   = %i\n", unreliableMessagesSent);
+        Con_Printf("unreliable messages recv   = %i\n", unreliableMessagesReceived);
+        Con_Printf("reliable messages sent     = %i\n", messagesSent);
+        Con_Printf("reliable messages received = %i\n", messagesReceived);
+        Con_Printf("packetsSent                = %i\n", packetsSent);
+        Con_Printf("packetsReSent              = %i\n", packetsReSent);
+        Con_Printf("packetsReceived            = %i\n", packetsReceived);
+        Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
+        Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
+        Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+        Con_Printf("datagrams read / calls     = %i / %i\n", udp_packetsread, udp_readcalls);
+        Con_Printf("datagrams written / calls  = %i / %i\n", udp_packetswritten, udp_writecalls);
+        return;
+    }
+
+    if (Q_strcmp(Cmd_Argv(1), "*") == 0) {
+        for (s = net_activeSockets; s; s = s->next)
+            if (net_drivers[s->driver].Init == Datagram_Init) {
+                Con_Printf("%s\n", s->address);
+                PrintStats(s);
+            }
+        return;
+    }
+
+    for (s = net_activeSockets; s; s = s->next)
+        if (Q_strcasecmp(Cmd_Argv(1), s->address) == 0)
+            break;
+    if (s == NULL)
+        return;
+    PrintStats(s);
+}
+
+/*
+================
+Datagram_Init
+================
+*/
+int Datagram_Init(void)
+{
+    int i;
+    int csock;
+
+    if (COM_CheckParm("-nolan"))
+        return -1;
+
+    for (i = 0; i < DGRAM_QUEUE; i++)
+        Datagram_Release(&dgram_packets[i]);
+
+    for (i = 0; i < net_numlandrivers; i++) {
+        csock = net_landrivers[i].Init();
+        if (csock == -1)
+            continue;
+        net_landrivers[i].initialized = true;
+        net_landrivers[i].controlSock = csock;
+    }
+
+    return 0;
+}
+
+/*
+================
+Datagram_Shutdown
+================
+*/
+void Datagram_Shutdown(void)
+{
+    for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++) {
+        if (net_landrivers[net_landriverlevel].initialized) {
+            net_landrivers[net_landriverlevel].Shutdown();
+            net_landrivers[net_landriverlevel].initialized = false;
+        }
+    }
+}
+
+/*
+================
+Datagram_Close
+================
+*/
+void Datagram_Close(qsocket_t *sock)
+{
+    dgrampacket_t *p;
+
+    // the socket is shared, only what was queued for this connection goes
+    while ((p = Datagram_Take(sock, false)))
+        Datagram_Release(p);
+    sfunc.CloseSocket(sock->socket);
+}
+
+/*
+================
+Datagram_Listen
+================
+*/
+void Datagram_Listen(qboolean state)
+{
+    dgram_listening = state;
+
+    for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+        if (net_landrivers[net_landriverlevel].initialized)
+            dfunc.Listen(state);
+}
+
+/*
+==================
+Datagram_Answer
+
+Answers a control request, returns the new connection if it was one
+==================
+*/
+static qsocket_t *Datagram_Answer(dgrampacket_t *p)
+{
+    struct qsockaddr newaddr;
+    qsocket_t *sock;
+    qsocket_t *s;
+    client_t *client;
+    int command;
+    int playerNumber;
+    int activeNumber;
+    int clientNumber;
+
+    SZ_Clear(&net_message);
+    SZ_Write(&net_message, p->data, p->length);
+    MSG_BeginReading();
+    MSG_ReadLong();
+    command = MSG_ReadByte();
+
+    if (command == CCREQ_SERVER_INFO) {
+        if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
+            return NULL;
+
+        SZ_Clear(&net_message);
+        MSG_WriteLong(&net_message, 0);
+        MSG_WriteByte(&net_message, CCREP_SERVER_INFO);
+        dfunc.GetSocketAddr(dfunc.controlSock, &newaddr);
+        MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
+        MSG_WriteString(&net_message, hostname.string);
+        MSG_WriteString(&net_message, sv.name);
+        MSG_WriteByte(&net_message, net_activeconnections);
+        MSG_WriteByte(&net_message, svs.maxclients);
+        MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+        Datagram_SendControl(&p->addr);
+        return NULL;
+    }
+
+    if (command == CCREQ_PLAYER_INFO) {
+        playerNumber = MSG_ReadByte();
+        activeNumber = -1;
+        for (clientNumber = 0, client = svs.clients; clientNumber < svs.maxclients; clientNumber++, client++) {
+            if (client->active) {
+                activeNumber++;
+                if (activeNumber == playerNumber)
+                    break;
+            }
+        }
+        if (clientNumber == svs.maxclients)
+            return NULL;
+
+        SZ_Clear(&net_message);
+        MSG_WriteLong(&net_message, 0);
+        MSG_WriteByte(&net_message, CCREP_PLAYER_INFO);
+        MSG_WriteByte(&net_message, playerNumber);
+        MSG_WriteString(&net_message, client->name);
+        MSG_WriteLong(&net_message, client->colors);
+        MSG_WriteLong(&net_message, (int)client->edict->v.frags);
+        MSG_WriteLong(&net_message, (int)((net_time - client->netconnection->connecttime) / MS_PER_S));
+        MSG_WriteString(&net_message, client->netconnection->address);
+        Datagram_SendControl(&p->addr);
+        return NULL;
+    }
+
+    // rules aren't answered, the cvars may not keep their names
+    if (command != CCREQ_CONNECT)
+        return NULL;
+
+    if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
+        return NULL;
+
+    command = MSG_ReadByte();
+    SZ_Clear(&net_message);
+
+    if (command != NET_PROTOCOL_VERSION) {
+        MSG_WriteLong(&net_message, 0);
+        MSG_WriteByte(&net_message, CCREP_REJECT);
+        MSG_WriteString(&net_message, "Incompatible version.\n");
+        Datagram_SendControl(&p->addr);
+        return NULL;
+    }
+
+    // see if this guy is already connected
+    for (s = net_activeSockets; s; s = s->next) {
+        if (s->driver != net_driverlevel || s->landriver != net_landriverlevel)
+            continue;
+        if (dfunc.AddrCompare(&p->addr, &s->addr) != 0)
+            continue;
+
+        // if it connected a moment ago our accept got lost, otherwise it
+        // started over and has to try again once the old connection is gone
+        if (net_time - s->connecttime < 2 * MS_PER_S) {
+            MSG_WriteLong(&net_message, 0);
+            MSG_WriteByte(&net_message, CCREP_ACCEPT);
+            dfunc.GetSocketAddr(s->socket, &newaddr);
+            MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+            Datagram_SendControl(&p->addr);
+            return NULL;
+        }
+        NET_Close(s);
+        return NULL;
+    }
+
+    // allocate a QSocket
+    sock = NET_NewQSocket();
+    if (sock == NULL) {
+        MSG_WriteLong(&net_message, 0);
+        MSG_WriteByte(&net_message, CCREP_REJECT);
+        MSG_WriteString(&net_message, "Server is full.\n");
+        Datagram_SendControl(&p->addr);
+        return NULL;
+    }
+
+    sock->landriver = net_landriverlevel;
+    sock->socket = dfunc.controlSock;
+    Q_memcpy(&sock->addr, &p->addr, sizeof(struct qsockaddr));
+    Q_strcpy(sock->address, dfunc.AddrToString(&p->addr));
+
+    // send him back the info about the server connection he has been allocated
+    MSG_WriteLong(&net_message, 0);
+    MSG_WriteByte(&net_message, CCREP_ACCEPT);
+    dfunc.GetSocketAddr(sock->socket, &newaddr);
+    MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+    Datagram_SendControl(&p->addr);
+
+    return sock;
+}
+
+/*
+================
+Datagram_CheckNewConnections
+================
+*/
+qsocket_t *Datagram_CheckNewConnections(void)
+{
+    dgrampacket_t *p;
+    qsocket_t *ret = NULL;
+
+    for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++) {
+        if (!net_landrivers[net_landriverlevel].initialized)
+            continue;
+        while (!ret && (p = Datagram_Take(NULL, false))) {
+            ret = Datagram_Answer(p);
+            Datagram_Release(p);
+        }
+        if (ret)
+            break;
+    }
+
+    return ret;
+}
+
+/*
+==================
+Datagram_ReadServerInfo
+
+Adds the server of a CCREP_SERVER_INFO in net_message to the host cache
+==================
+*/
+static void Datagram_ReadServerInfo(struct qsockaddr *readaddr)
+{
+    struct qsockaddr myaddr;
+    int n, i;
+
+    if (hostCacheCount == HOSTCACHESIZE)
+        return;
+
+    // don't answer our own query
+    dfunc.GetSocketAddr(dfunc.controlSock, &myaddr);
+    if (dfunc.AddrCompare(readaddr, &myaddr) == 0)
+        return;
+
+    MSG_ReadString(); // the address we got it from is the one to use
+
+    // search the cache for this server
+    for (n = 0; n < hostCacheCount; n++)
+        if (dfunc.AddrCompare(readaddr, &hostcache[n].addr) == 0)
+            return;
+
+    // add it
+    hostCacheCount++;
+    Q_strncpy(hostcache[n].name, MSG_ReadString(), sizeof(hostcache[n].name) - 1);
+    hostcache[n].name[sizeof(hostcache[n].name) - 1] = 0;
+    Q_strncpy(hostcache[n].map, MSG_ReadString(), sizeof(hostcache[n].map) - 1);
+    hostcache[n].map[sizeof(hostcache[n].map) - 1] = 0;
+    hostcache[n].users = MSG_ReadByte();
+    hostcache[n].maxusers = MSG_ReadByte();
+    if (MSG_ReadByte() != NET_PROTOCOL_VERSION) {
+        Q_strcpy(hostcache[n].cname, hostcache[n].name);
+        hostcache[n].cname[14] = 0;
+        Q_strcpy(hostcache[n].name, "*");
+        Q_strcat(hostcache[n].name, hostcache[n].cname);
+    }
+    Q_memcpy(&hostcache[n].addr, readaddr, sizeof(struct qsockaddr));
+    hostcache[n].driver = net_driverlevel;
+    hostcache[n].ldriver = net_landriverlevel;
+    Q_strcpy(hostcache[n].cname, dfunc.AddrToString(readaddr));
+
+    // check for a name conflict
+    for (i = 0; i < hostCacheCount; i++) {
+        if (i == n)
+            continue;
+        if (Q_strcasecmp(hostcache[n].name, hostcache[i].name) == 0) {
+            i = Q_strlen(hostcache[n].name);
+            if (i < 15 && hostcache[n].name[i - 1] > '8') {
+                hostcache[n].name[i] = '0';
+                hostcache[n].name[i + 1] = 0;
+            } else
+                hostcache[n].name[i - 1]++;
+            i = -1;
+        }
+    }
+}
+
+/*
+================
+Datagram_SearchForHosts
+================
+*/
+void Datagram_SearchForHosts(qboolean xmit)
+{
+    dgrampacket_t *p;
+
+    for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++) {
+        if (!net_landrivers[net_landriverlevel].initialized)
+            continue;
+
+        if (xmit) {
+            SZ_Clear(&net_message);
+            MSG_WriteLong(&net_message, 0);
+            MSG_WriteByte(&net_message, CCREQ_SERVER_INFO);
+            MSG_WriteString(&net_message, "QUAKE");
+            MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+            *((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+            dfunc.Broadcast(dfunc.controlSock, net_message.data, net_message.cursize);
+            SZ_Clear(&net_message);
+            dfunc.Flush(dfunc.controlSock);
+            continue;
+        }
+
+        Datagram_Read(false);
+        while ((p = Datagram_Take(NULL, true))) {
+            SZ_Clear(&net_message);
+            SZ_Write(&net_message, p->data, p->length);
+            MSG_BeginReading();
+            MSG_ReadLong();
+            if (MSG_ReadByte() == CCREP_SERVER_INFO)
+                Datagram_ReadServerInfo(&p->addr);
+            Datagram_Release(p);
+        }
+    }
+}
+
+/*
+==================
+_Datagram_Connect
+
+Asks the server at host for a connection, three times, waiting 2.5 seconds
+for an answer each time
+==================
+*/
+static qsocket_t *_Datagram_Connect(char const *host)
+{
+    struct qsockaddr sendaddr;
+    qsocket_t *sock;
+    dgrampacket_t *p = NULL;
+    uint32_t start_time;
+    int reps;
+    int ret;
+    char const *reason;
+
+    // see if we can resolve the host name
+    if (dfunc.GetAddrFromName((char *)host, &sendaddr) == -1)
+        return NULL;
+
+    sock = NET_NewQSocket();
+    if (sock == NULL)
+        return NULL;
+    sock->landriver = net_landriverlevel;
+    sock->socket = dfunc.controlSock;
+    Q_memset(&sock->addr, 0, sizeof(sock->addr));
+
+    // nothing but the answer from the server is of interest
+    while ((p = Datagram_Take(NULL, true)))
+        Datagram_Release(p);
+
+    // send the connection request
+    Con_Printf("trying...\n");
+#ifndef SERVERONLY
+    SCR_UpdateScreen();
+#endif
+    dgram_connecting = true;
+    for (reps = 0; reps < 3; reps++) {
+        SZ_Clear(&net_message);
+        MSG_WriteLong(&net_message, 0);
+        MSG_WriteByte(&net_message, CCREQ_CONNECT);
+        MSG_WriteString(&net_message, "QUAKE");
+        MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+        Datagram_SendControl(&sendaddr);
+        dfunc.Flush(dfunc.controlSock);
+
+        start_time = net_time = Sys_CurrentTicks();
+        do {
+            Datagram_Read(true);
+            while ((p = Datagram_Take(NULL, true)) && dfunc.AddrCompare(&p->addr, &sendaddr) != 0)
+                Datagram_Release(p);
+            net_time = Sys_CurrentTicks();
+        } while (!p && (net_time - start_time) < 2500);
+
+        if (p)
+            break;
+        Con_Printf("still trying...\n");
+#ifndef SERVERONLY
+        SCR_UpdateScreen();
+#endif
+    }
+    dgram_connecting = false;
+
+    if (p == NULL) {
+        reason = "No Response";
+        Con_Printf("%s\n", reason);
+        goto ErrorReturn;
+    }
+
+    SZ_Clear(&net_message);
+    SZ_Write(&net_message, p->data, p->length);
+    Datagram_Release(p);
+    MSG_BeginReading();
+    MSG_ReadLong();
+    ret = MSG_ReadByte();
+
+    if (ret == CCREP_REJECT) {
+        reason = MSG_ReadString();
+        Con_Printf("%s", reason);
+        goto ErrorReturn;
+    }
+
+    if (ret != CCREP_ACCEPT) {
+        reason = "Bad Response";
+        Con_Printf("%s\n", reason);
+        goto ErrorReturn;
+    }
+
+    Q_memcpy(&sock->addr, &sendaddr, sizeof(struct qsockaddr));
+    dfunc.SetSocketPort(&sock->addr, MSG_ReadLong());
+    dfunc.GetNameFromAddr(&sendaddr, sock->address);
+
+    Con_Printf("Connection accepted\n");
+    sock->lastMessageTime = net_time;
+    return sock;
+
+ErrorReturn:
+    NET_FreeQSocket(sock);
+    return NULL;
+}
+
+/*
+================
+Datagram_Connect
+================
+*/
+qsocket_t *Datagram_Connect(char const *host)
+{
+    qsocket_t *ret = NULL;
+
+    for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+        if (net_landrivers[net_landriverlevel].initialized)
+            if ((ret = _Datagram_Connect(host)) != NULL)
+                break;
+    return ret;
+}
+
+CMD_REGISTER("net_stats", NET_Stats_f);
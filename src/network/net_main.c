@@ -478,7 +478,7 @@ int NET_GetMessage(qsocket_t *sock)
 
     // see if this connection has timed out
     if (ret == 0 && sock->driver) {
-        if (net_time - sock->lastMessageTime > net_messagetimeout.value) {
+        if (net_time - sock->lastMessageTime > net_messagetimeout.value * MS_PER_S) {
             NET_Close(sock);
             return -1;
         }
@@ -602,6 +602,7 @@ int NET_SendToAll(sizebuf_t *data, uint32_t blocktime)
 
     start = Sys_CurrentTicks();
     while (count) {
+        NET_Poll();
         count = 0;
         for (i = 0, host_client = svs.clients; i < svs.maxclients; i++, host_client++) {
             if (!state1[i]) {
@@ -743,6 +744,10 @@ void NET_Poll(void)
 
     SetNetTime();
 
+    for (net_driverlevel = 0; net_driverlevel < net_numdrivers; net_driverlevel++)
+        if (net_drivers[net_driverlevel].initialized && net_drivers[net_driverlevel].Poll)
+            net_drivers[net_driverlevel].Poll();
+
     for (pp = pollProcedureList; pp; pp = pp->next) {
         if (pp->nextTime > net_time)
             break;
@@ -0,0 +1,519 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_udp.c -- one non-blocking UDP socket, read and written in batches
+
+#include "quakedef.h"
+#include "net_udp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+Every connection shares the one socket, the datagram driver tells them apart
+by address. Reads take up to UDP_BATCH datagrams off the socket at once with
+recvmmsg, writes are queued and handed to sendmmsg together when the queue
+fills up or the driver flushes it from NET_Poll. Other systems read and write
+one datagram per call.
+
+Listening rebinds the socket to net_hostport under the same descriptor, so
+the connections that already use it keep working.
+*/
+
+#define UDP_BATCH 32
+
+typedef struct {
+    struct sockaddr_in addr;
+    int length;
+    byte data[NET_DATAGRAMSIZE + 1]; // one more to catch the ones that are too long
+} udppacket_t;
+
+static int net_controlsocket = -1;
+static int net_boundport = -1;
+static struct sockaddr_in broadcastaddr;
+static in_addr_t myAddr;
+
+static udppacket_t udp_in[UDP_BATCH];
+static int udp_innext, udp_incount;
+static udppacket_t udp_out[UDP_BATCH];
+static int udp_outcount;
+
+int udp_readcalls, udp_packetsread;
+int udp_writecalls, udp_packetswritten;
+
+/*
+================
+UDP_Init
+================
+*/
+int UDP_Init(void)
+{
+    char buff[NET_NAMELEN];
+    struct hostent *local;
+    struct qsockaddr addr;
+    char *colon;
+
+    if (COM_CheckParm("-noudp"))
+        return -1;
+
+    // determine my name & address
+    myAddr = htonl(INADDR_LOOPBACK);
+    if (gethostname(buff, sizeof(buff)) == 0) {
+        buff[sizeof(buff) - 1] = 0;
+        local = gethostbyname(buff);
+        if (local && local->h_addrtype == AF_INET)
+            myAddr = *(in_addr_t *)local->h_addr_list[0];
+
+        // if the quake hostname isn't set, set it to the machine name
+        if (Q_strcmp(hostname.string, "UNNAMED") == 0) {
+            buff[15] = 0;
+            Cvar_Set("hostname", buff);
+        }
+    }
+
+    if ((net_controlsocket = UDP_OpenSocket(0)) == -1) {
+        Con_Printf("UDP_Init: Unable to open control socket\n");
+        return -1;
+    }
+    net_boundport = 0;
+
+    Q_memset(&broadcastaddr, 0, sizeof(broadcastaddr));
+    broadcastaddr.sin_family = AF_INET;
+    broadcastaddr.sin_addr.s_addr = INADDR_BROADCAST;
+
+    UDP_GetSocketAddr(net_controlsocket, &addr);
+    Q_strcpy(my_tcpip_address, UDP_AddrToString(&addr));
+    colon = Q_strrchr(my_tcpip_address, ':');
+    if (colon)
+        *colon = 0;
+
+    Con_Printf("UDP Initialized\n");
+    tcpipAvailable = true;
+
+    return net_controlsocket;
+}
+
+/*
+================
+UDP_Shutdown
+================
+*/
+void UDP_Shutdown(void)
+{
+    UDP_Flush(net_controlsocket);
+    close(net_controlsocket);
+    net_controlsocket = -1;
+    tcpipAvailable = false;
+}
+
+/*
+================
+UDP_Listen
+================
+*/
+void UDP_Listen(qboolean state)
+{
+    int newsocket;
+    int port = state ? net_hostport : 0;
+
+    if (net_controlsocket == -1 || port == net_boundport)
+        return;
+
+    if ((newsocket = UDP_OpenSocket(port)) == -1) {
+        Con_Printf("UDP_Listen: Unable to bind port %i\n", port);
+        return;
+    }
+
+    // what's queued still goes out from the old address
+    UDP_Flush(net_controlsocket);
+    dup2(newsocket, net_controlsocket);
+    close(newsocket);
+    net_boundport = port;
+}
+
+/*
+================
+UDP_OpenSocket
+================
+*/
+int UDP_OpenSocket(int port)
+{
+    int newsocket;
+    struct sockaddr_in address;
+    int one = 1;
+
+    if ((newsocket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+        return -1;
+
+    if (fcntl(newsocket, F_SETFL, O_NONBLOCK) == -1)
+        goto ErrorReturn;
+
+    if (setsockopt(newsocket, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one)) == -1)
+        goto ErrorReturn;
+
+    Q_memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons((unsigned short)port);
+    if (bind(newsocket, (struct sockaddr *)&address, sizeof(address)) == -1)
+        goto ErrorReturn;
+
+    return newsocket;
+
+ErrorReturn:
+    close(newsocket);
+    return -1;
+}
+
+/*
+================
+UDP_CloseSocket
+================
+*/
+int UDP_CloseSocket(int socket)
+{
+    // the connections share the control socket, it stays open
+    if (socket == net_controlsocket)
+        return 0;
+    return close(socket);
+}
+
+/*
+================
+UDP_Connect
+================
+*/
+int UDP_Connect(int socket, struct qsockaddr *addr)
+{
+    (void)socket;
+    (void)addr;
+    return 0;
+}
+
+/*
+================
+UDP_CheckNewConnections
+================
+*/
+int UDP_CheckNewConnections(void)
+{
+    // the datagram driver reads everything from NET_Poll
+    return -1;
+}
+
+/*
+==================
+UDP_Receive
+
+Refills udp_in, returns how many datagrams it holds
+==================
+*/
+static int UDP_Receive(int socket)
+{
+    int i, n;
+#ifdef __linux__
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+
+    Q_memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < UDP_BATCH; i++) {
+        iov[i].iov_base = udp_in[i].data;
+        iov[i].iov_len = sizeof(udp_in[i].data);
+        msgs[i].msg_hdr.msg_name = &udp_in[i].addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(udp_in[i].addr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // ECONNREFUSED and the like only say a datagram we sent bounced
+    n = recvmmsg(socket, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0)
+        n = 0;
+    for (i = 0; i < n; i++)
+        udp_in[i].length = msgs[i].msg_len;
+#else
+    socklen_t addrlen;
+
+    for (n = 0; n < UDP_BATCH; n++) {
+        addrlen = sizeof(udp_in[n].addr);
+        i = recvfrom(socket, udp_in[n].data, sizeof(udp_in[n].data), 0, (struct sockaddr *)&udp_in[n].addr,
+                     &addrlen);
+        if (i == -1)
+            break;
+        udp_in[n].length = i;
+    }
+#endif
+
+    udp_readcalls++;
+    udp_packetsread += n;
+    udp_innext = 0;
+    udp_incount = n;
+    return n;
+}
+
+/*
+================
+UDP_Read
+================
+*/
+int UDP_Read(int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+    udppacket_t *p;
+
+    do {
+        if (udp_innext == udp_incount && !UDP_Receive(socket))
+            return 0;
+        p = &udp_in[udp_innext++];
+    } while (p->length > len);
+
+    Q_memcpy(buf, p->data, p->length);
+    Q_memcpy(addr, &p->addr, sizeof(p->addr));
+    return p->length;
+}
+
+/*
+================
+UDP_Write
+================
+*/
+int UDP_Write(int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+    udppacket_t *p;
+
+    if (len > NET_DATAGRAMSIZE)
+        Sys_Error("UDP_Write: %i byte datagram", len);
+
+    if (udp_outcount == UDP_BATCH)
+        UDP_Flush(socket);
+
+    p = &udp_out[udp_outcount++];
+    Q_memcpy(&p->addr, addr, sizeof(p->addr));
+    Q_memcpy(p->data, buf, len);
+    p->length = len;
+    return len;
+}
+
+/*
+==================
+UDP_Flush
+
+Sends the queued datagrams. One that can't be sent is dropped, like the
+network would, the reliable stream sends it again.
+==================
+*/
+void UDP_Flush(int socket)
+{
+    int sent, n;
+#ifdef __linux__
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    int i;
+
+    Q_memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < udp_outcount; i++) {
+        iov[i].iov_base = udp_out[i].data;
+        iov[i].iov_len = udp_out[i].length;
+        msgs[i].msg_hdr.msg_name = &udp_out[i].addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(udp_out[i].addr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (sent = 0; sent < udp_outcount; sent += n) {
+        n = sendmmsg(socket, msgs + sent, udp_outcount - sent, 0);
+        udp_writecalls++;
+        if (n > 0)
+            udp_packetswritten += n;
+        else if (errno == EINTR)
+            n = 0;
+        else
+            n = 1;
+    }
+#else
+    for (sent = 0; sent < udp_outcount; sent++) {
+        n = sendto(socket, udp_out[sent].data, udp_out[sent].length, 0, (struct sockaddr *)&udp_out[sent].addr,
+                   sizeof(udp_out[sent].addr));
+        udp_writecalls++;
+        if (n != -1)
+            udp_packetswritten++;
+    }
+#endif
+
+    udp_outcount = 0;
+}
+
+/*
+================
+UDP_Broadcast
+================
+*/
+int UDP_Broadcast(int socket, byte *buf, int len)
+{
+    broadcastaddr.sin_port = htons((unsigned short)net_hostport);
+    return UDP_Write(socket, buf, len, (struct qsockaddr *)&broadcastaddr);
+}
+
+/*
+================
+UDP_AddrToString
+================
+*/
+char *UDP_AddrToString(struct qsockaddr *addr)
+{
+    static char buffer[22];
+    int haddr;
+
+    haddr = ntohl(((struct sockaddr_in *)addr)->sin_addr.s_addr);
+    sprintf(buffer, "%d.%d.%d.%d:%d", (haddr >> 24) & 0xff, (haddr >> 16) & 0xff, (haddr >> 8) & 0xff, haddr & 0xff,
+            ntohs(((struct sockaddr_in *)addr)->sin_port));
+    return buffer;
+}
+
+/*
+================
+UDP_StringToAddr
+================
+*/
+int UDP_StringToAddr(char *string, struct qsockaddr *addr)
+{
+    int ha1, ha2, ha3, ha4, hp;
+    int ipaddr;
+
+    if (sscanf(string, "%d.%d.%d.%d:%d", &ha1, &ha2, &ha3, &ha4, &hp) != 5)
+        return -1;
+    ipaddr = (ha1 << 24) | (ha2 << 16) | (ha3 << 8) | ha4;
+
+    Q_memset(addr, 0, sizeof(*addr));
+    addr->sa_family = AF_INET;
+    ((struct sockaddr_in *)addr)->sin_addr.s_addr = htonl(ipaddr);
+    ((struct sockaddr_in *)addr)->sin_port = htons((unsigned short)hp);
+    return 0;
+}
+
+/*
+================
+UDP_GetSocketAddr
+================
+*/
+int UDP_GetSocketAddr(int socket, struct qsockaddr *addr)
+{
+    socklen_t addrlen = sizeof(struct qsockaddr);
+    in_addr_t a;
+
+    Q_memset(addr, 0, sizeof(struct qsockaddr));
+    getsockname(socket, (struct sockaddr *)addr, &addrlen);
+    a = ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+    if (a == 0 || a == htonl(INADDR_LOOPBACK))
+        ((struct sockaddr_in *)addr)->sin_addr.s_addr = myAddr;
+
+    return 0;
+}
+
+/*
+================
+UDP_GetNameFromAddr
+================
+*/
+int UDP_GetNameFromAddr(struct qsockaddr *addr, char *name)
+{
+    // no reverse lookup, it could hold up the frame for seconds
+    Q_strcpy(name, UDP_AddrToString(addr));
+    return 0;
+}
+
+/*
+================
+UDP_GetAddrFromName
+================
+*/
+int UDP_GetAddrFromName(char *name, struct qsockaddr *addr)
+{
+    char host[NET_NAMELEN];
+    char *colon;
+    int port = net_hostport;
+    struct hostent *hostentry;
+    struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+
+    Q_strncpy(host, name, sizeof(host) - 1);
+    host[sizeof(host) - 1] = 0;
+    colon = Q_strrchr(host, ':');
+    if (colon) {
+        *colon = 0;
+        port = Q_atoi(colon + 1);
+    }
+
+    Q_memset(addr, 0, sizeof(*addr));
+    sin->sin_family = AF_INET;
+    sin->sin_port = htons((unsigned short)port);
+
+    if (inet_pton(AF_INET, host, &sin->sin_addr) == 1)
+        return 0;
+
+    hostentry = gethostbyname(host);
+    if (!hostentry || hostentry->h_addrtype != AF_INET)
+        return -1;
+
+    sin->sin_addr.s_addr = *(in_addr_t *)hostentry->h_addr_list[0];
+    return 0;
+}
+
+/*
+================
+UDP_AddrCompare
+================
+*/
+int UDP_AddrCompare(struct qsockaddr *addr1, struct qsockaddr *addr2)
+{
+    if (addr1->sa_family != addr2->sa_family)
+        return -1;
+
+    if (((struct sockaddr_in *)addr1)->sin_addr.s_addr != ((struct sockaddr_in *)addr2)->sin_addr.s_addr)
+        return -1;
+
+    if (((struct sockaddr_in *)addr1)->sin_port != ((struct sockaddr_in *)addr2)->sin_port)
+        return 1;
+
+    return 0;
+}
+
+/*
+================
+UDP_GetSocketPort
+================
+*/
+int UDP_GetSocketPort(struct qsockaddr *addr)
+{
+    return ntohs(((struct sockaddr_in *)addr)->sin_port);
+}
+
+/*
+================
+UDP_SetSocketPort
+================
+*/
+int UDP_SetSocketPort(struct qsockaddr *addr, int port)
+{
+    ((struct sockaddr_in *)addr)->sin_port = htons((unsigned short)port);
+    return 0;
+}
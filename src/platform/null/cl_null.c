@@ -0,0 +1,59 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_null.c -- client stubs for headless dedicated server builds, the server
+// code still references a handful of client entry points and state
+
+#include "quakedef.h"
+
+client_static_t cls;
+client_state_t cl;
+
+keydest_t key_dest;
+
+CVAR_REGISTER(cl_name, CVAR_CTOR({ "_cl_name", "player", true }));
+CVAR_REGISTER(cl_color, CVAR_CTOR({ "_cl_color", 0, true }));
+
+void CL_Disconnect(void)
+{
+}
+
+void CL_Disconnect_f(void)
+{
+}
+
+void CL_NextDemo(void)
+{
+}
+
+void CL_StopPlayback(void)
+{
+}
+
+void CL_EstablishConnection(char const *)
+{
+}
+
+void Key_WriteBindings(FILE *)
+{
+}
+
+void M_Menu_Quit_f(void)
+{
+}
@@ -33,6 +33,6 @@ void IN_Commands(void)
 {
 }
 
-void IN_Move(usercmd_t *cmd)
+void IN_Move(usercmd_t *)
 {
 }
@@ -70,7 +70,7 @@ void S_StopSound(int entnum, int entchannel)
 {
 }
 
-sfx_t *S_PrecacheSound(char *sample)
+sfx_t *S_PrecacheSound(char const *sample)
 {
     return NULL;
 }
@@ -17,11 +17,20 @@ along with this program; if not, write to the Free Software
 Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
-// sys_null.h -- null system driver to aid porting efforts
+// sys_null.c -- headless system driver for dedicated servers
 
 #include "quakedef.h"
 #include "errno.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t start_ticks;
+
 /*
 ===============================================================================
 
@@ -30,7 +39,7 @@ FILE IO
 ===============================================================================
 */
 
-qboolean isDedicated;
+qboolean isDedicated = true;
 
 #define MAX_HANDLES 10
 FILE *sys_handles[MAX_HANDLES];
@@ -64,7 +73,7 @@ int filelength(FILE *f)
     return end;
 }
 
-int Sys_FileOpenRead(char *path, int *hndl)
+int Sys_FileOpenRead(char const *path, int *hndl)
 {
     FILE *f;
     int i;
@@ -82,7 +91,7 @@ int Sys_FileOpenRead(char *path, int *hndl)
     return filelength(f);
 }
 
-int Sys_FileOpenWrite(char *path)
+int Sys_FileOpenWrite(char const *path)
 {
     FILE *f;
     int i;
@@ -113,26 +122,36 @@ int Sys_FileRead(int handle, void *dest, int count)
     return fread(dest, 1, count, sys_handles[handle]);
 }
 
-int Sys_FileWrite(int handle, void *data, int count)
+int Sys_FileWrite(int handle, void const *data, int count)
 {
     return fwrite(data, 1, count, sys_handles[handle]);
 }
 
-int Sys_FileTime(char *path)
+void const *Sys_FileMap(int handle, int length)
 {
-    FILE *f;
+    void *base;
+
+    if (length <= 0)
+        return NULL;
+    base = mmap(NULL, length, PROT_READ, MAP_SHARED, fileno(sys_handles[handle]), 0);
+    if (base == MAP_FAILED)
+        return NULL;
+    return base;
+}
 
-    f = fopen(path, "rb");
-    if (f) {
-        fclose(f);
-        return 1;
-    }
+int Sys_FileTime(char const *path)
+{
+    struct stat buf;
 
-    return -1;
+    if (stat(path, &buf) == -1)
+        return -1;
+
+    return buf.st_mtime;
 }
 
-void Sys_mkdir(char *path)
+void Sys_mkdir(char const *path)
 {
+    mkdir(path, 0777);
 }
 
 /*
@@ -143,7 +162,7 @@ SYSTEM IO
 ===============================================================================
 */
 
-void Sys_Error(char *error, ...)
+void Sys_Error(char const *error, ...)
 {
     va_list argptr;
 
@@ -153,35 +172,92 @@ void Sys_Error(char *error, ...)
     va_end(argptr);
     printf("\n");
 
-    exit(1);
+    exit(EXIT_FAILURE);
 }
 
-void Sys_Printf(char *fmt, ...)
+void Sys_Printf(char const *fmt, ...)
 {
     va_list argptr;
 
     va_start(argptr, fmt);
     vprintf(fmt, argptr);
     va_end(argptr);
+    fflush(stdout);
 }
 
 void Sys_Quit(void)
 {
+    Hunk_Shutdown();
     exit(0);
 }
 
+static uint64_t Sys_MonotonicMillis(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * MS_PER_S + ts.tv_nsec / 1000000;
+}
+
 uint32_t Sys_CurrentTicks(void)
 {
-    static uint32_t t;
+    return Sys_MonotonicMillis() - start_ticks;
+}
 
-    t += 100;
+uint64_t Sys_MicroTicks(void)
+{
+    struct timespec ts;
 
-    return t;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - start_ticks * 1000;
 }
 
+/*
+================
+Sys_ConsoleInput
+
+Non-blocking, returns a complete line typed on stdin or NULL, a partial one
+is kept until the rest of it comes
+================
+*/
 char *Sys_ConsoleInput(void)
 {
-    return NULL;
+    static char text[256], line[256];
+    static int len; // of what's in text
+    char *newline;
+    int count;
+    fd_set fdset;
+    struct timeval timeout;
+
+    newline = (char *)memchr(text, '\n', len);
+    if (!newline) {
+        FD_ZERO(&fdset);
+        FD_SET(STDIN_FILENO, &fdset);
+        timeout.tv_sec = 0;
+        timeout.tv_usec = 0;
+        if (select(STDIN_FILENO + 1, &fdset, NULL, NULL, &timeout) == -1 || !FD_ISSET(STDIN_FILENO, &fdset))
+            return NULL;
+
+        count = read(STDIN_FILENO, text + len, sizeof(text) - 1 - len);
+        if (count < 1)
+            return NULL;
+        len += count;
+
+        newline = (char *)memchr(text, '\n', len);
+        if (!newline) {
+            if (len < sizeof(text) - 1)
+                return NULL;
+            newline = text + len - 1; // too long for a line, take it as it is
+        }
+    }
+
+    count = newline - text + 1;
+    memcpy(line, text, count);
+    line[count] = 0;
+    len -= count;
+    memmove(text, text + count, len);
+
+    return line;
 }
 
 void Sys_SendKeyEvents(void)
@@ -196,24 +272,68 @@ void Sys_LowFPPrecision(void)
 {
 }
 
+/*
+================
+Sys_Sleep
+
+Gives the rest of the server tick back to the OS, this is what allows many
+server processes to share a single core
+================
+*/
+static void Sys_Sleep(uint32_t ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / MS_PER_S;
+    ts.tv_nsec = (ms % MS_PER_S) * 1000000;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
 //=============================================================================
 
-void main(int argc, char **argv)
+#define DEFAULT_HEAP_SIZE (8 * 1024 * 1024)
+
+// progs string_t values are 32 bit offsets from pr_strings, so the heap has to
+// live next to the static string buffers instead of in a far away malloc arena
+static uint8_t quake_heap[32 * 1024 * 1024];
+static quakeparms_t parms;
+
+int main(int argc, char **argv)
 {
-    static quakeparms_t parms;
+    int j;
 
-    parms.memsize = 8 * 1024 * 1024;
-    parms.membase = malloc(parms.memsize);
-    parms.basedir = ".";
+    start_ticks = Sys_MonotonicMillis();
 
     COM_InitArgv(argc, argv);
 
     parms.argc = com_argc;
     parms.argv = com_argv;
+    parms.basedir = ".";
+
+    parms.memsize = DEFAULT_HEAP_SIZE;
+    j = COM_CheckParm("-mem");
+    if (j && j + 1 < com_argc)
+        parms.memsize = (int)(Q_atof(com_argv[j + 1]) * 1024 * 1024);
+    if (parms.memsize <= 0 || parms.memsize > sizeof(quake_heap))
+        Sys_Error("-mem must be between 1 and %d megabytes", (int)(sizeof(quake_heap) / (1024 * 1024)));
+    parms.membase = quake_heap;
 
-    printf("Host_Init\n");
     Host_Init(&parms);
+
+    uint32_t oldtime = Sys_CurrentTicks();
     while (1) {
-        Host_Frame(100);
+        uint32_t ticrate = sys_ticrate_ms.value > 0 ? (uint32_t)sys_ticrate_ms.value : 1;
+        uint32_t time = Sys_CurrentTicks() - oldtime;
+
+        // sleep until the next server tick is due instead of spinning,
+        // timedemos run flat out
+        if (time < ticrate && !cls.timedemo) {
+            Sys_Sleep(ticrate - time);
+            time = Sys_CurrentTicks() - oldtime;
+        }
+        oldtime += time;
+
+        Host_Frame(time);
     }
 }
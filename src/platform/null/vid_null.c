@@ -25,41 +25,61 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define BASEWIDTH 320
 #define BASEHEIGHT 200
 
-byte vid_buffer[BASEWIDTH * BASEHEIGHT];
-short zbuffer[BASEWIDTH * BASEHEIGHT];
-byte surfcache[256 * 1024];
-
 unsigned short d_8to16table[256];
 unsigned d_8to24table[256];
 
-void VID_SetPalette(unsigned char *palette)
+void VID_SetPalette(unsigned char *)
 {
 }
 
-void VID_ShiftPalette(unsigned char *palette)
+void VID_ShiftPalette(unsigned char *)
 {
 }
 
-void VID_Init(unsigned char *palette)
+/*
+================
+VID_Init
+
+-width and -height pick the resolution of the in-memory frame
+================
+*/
+void VID_Init(unsigned char *)
 {
-    vid.maxwarpwidth = vid.width = vid.conwidth = BASEWIDTH;
-    vid.maxwarpheight = vid.height = vid.conheight = BASEHEIGHT;
+    hunksubsystem_t prev;
+    int pnum, cachesize;
+
+    vid.width = BASEWIDTH;
+    vid.height = BASEHEIGHT;
+    if ((pnum = COM_CheckParm("-width")) && pnum + 1 < com_argc)
+        vid.width = Q_atoi(com_argv[pnum + 1]);
+    if ((pnum = COM_CheckParm("-height")) && pnum + 1 < com_argc)
+        vid.height = Q_atoi(com_argv[pnum + 1]);
+    if (vid.width < BASEWIDTH || vid.width > MAXWIDTH || vid.height < BASEHEIGHT || vid.height > MAXHEIGHT)
+        Sys_Error("Resolution must be between %ix%i and %ix%i", BASEWIDTH, BASEHEIGHT, MAXWIDTH, MAXHEIGHT);
+
+    vid.conwidth = vid.width;
+    vid.conheight = vid.height;
+    vid.maxwarpwidth = WARP_WIDTH;
+    vid.maxwarpheight = WARP_HEIGHT;
     vid.aspect = 1.0;
     vid.numpages = 1;
     vid.colormap = host_colormap;
     vid.fullbright = 256 - LittleLong(*((int *)vid.colormap + 2048));
-    vid.buffer = vid.conbuffer = vid_buffer;
-    vid.rowbytes = vid.conrowbytes = BASEWIDTH;
-
-    d_pzbuffer = zbuffer;
-    D_InitCaches(surfcache, sizeof(surfcache));
+    vid.buffer = vid.conbuffer = (pixel_t *)Hunk_HighAllocName(vid.width * vid.height, "video");
+    vid.rowbytes = vid.conrowbytes = vid.width;
+
+    d_pzbuffer = (short *)Hunk_HighAllocName(vid.width * vid.height * sizeof(*d_pzbuffer), "video");
+    cachesize = D_SurfaceCacheForRes(vid.width, vid.height);
+    prev = Hunk_Subsystem(hs_surfcache);
+    D_InitCaches(Hunk_HighAllocName(cachesize, "video"), cachesize);
+    Hunk_Subsystem(prev);
 }
 
 void VID_Shutdown(void)
 {
 }
 
-void VID_Update(vrect_t *rects)
+void VID_Update(vrect_t *)
 {
 }
 
@@ -68,7 +88,7 @@ void VID_Update(vrect_t *rects)
 D_BeginDirectRect
 ================
 */
-void D_BeginDirectRect(int x, int y, byte *pbitmap, int width, int height)
+void D_BeginDirectRect(int, int, byte *, int, int)
 {
 }
 
@@ -77,6 +97,6 @@ void D_BeginDirectRect(int x, int y, byte *pbitmap, int width, int height)
 D_EndDirectRect
 ================
 */
-void D_EndDirectRect(int x, int y, int width, int height)
+void D_EndDirectRect(int, int, int, int)
 {
 }
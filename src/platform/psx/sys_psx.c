@@ -72,6 +72,11 @@ uint32_t Sys_CurrentTicks()
     return systick_ms;
 }
 
+uint64_t Sys_MicroTicks()
+{
+    return (uint64_t)systick_ms * 1000;
+}
+
 // =======================================================================
 // Sleeps for microseconds
 // =======================================================================
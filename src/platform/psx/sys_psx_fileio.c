@@ -184,6 +184,12 @@ int Sys_FileWrite(int handle, void const *src, int count)
     return 0;
 }
 
+void const *Sys_FileMap(int handle, int length)
+{
+    // files stream from the CD, there's nothing to map
+    return NULL;
+}
+
 void Sys_FileClose(int handle)
 {
     psx_cd_file *f = (psx_cd_file *)handle;
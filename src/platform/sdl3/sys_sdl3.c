@@ -23,6 +23,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <SDL3/SDL.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 static uint64_t start_ticks;
 
 /*
@@ -121,6 +125,24 @@ int Sys_FileWrite(int handle, void const *data, int count)
     return fwrite(data, 1, count, sys_handles[handle]);
 }
 
+void const *Sys_FileMap(int handle, int length)
+{
+#ifdef _WIN32
+    (void)handle;
+    (void)length;
+    return NULL;
+#else
+    void *base;
+
+    if (length <= 0)
+        return NULL;
+    base = mmap(NULL, length, PROT_READ, MAP_SHARED, fileno(sys_handles[handle]), 0);
+    if (base == MAP_FAILED)
+        return NULL;
+    return base;
+#endif
+}
+
 int Sys_FileTime(char const *path)
 {
     FILE *f;
@@ -171,6 +193,7 @@ void Sys_Printf(char const *fmt, ...)
 
 void Sys_Quit(void)
 {
+    Hunk_Shutdown();
     exit(0);
 }
 
@@ -179,6 +202,11 @@ uint32_t Sys_CurrentTicks(void)
     return SDL_GetTicks() - start_ticks;
 }
 
+uint64_t Sys_MicroTicks(void)
+{
+    return SDL_GetTicksNS() / 1000 - start_ticks * 1000;
+}
+
 char *Sys_ConsoleInput(void)
 {
     return NULL;
@@ -198,13 +226,15 @@ void Sys_LowFPPrecision(void)
 
 //=============================================================================
 
-static uint8_t quake_heap[6 * 1024 * 1024];
+#define DEFAULT_HEAP_SIZE (8 * 1024 * 1024)
+
+static uint8_t quake_heap[32 * 1024 * 1024];
 static quakeparms_t parms;
 
 int main(int argc, char **argv)
 {
-    parms.memsize = sizeof(quake_heap);
-    parms.membase = quake_heap;
+    int j;
+
     parms.basedir = ".";
 
     start_ticks = SDL_GetTicks();
@@ -214,6 +244,15 @@ int main(int argc, char **argv)
     parms.argc = com_argc;
     parms.argv = com_argv;
 
+    // higher -width and -height need more
+    parms.memsize = DEFAULT_HEAP_SIZE;
+    j = COM_CheckParm("-mem");
+    if (j && j + 1 < com_argc)
+        parms.memsize = (int)(Q_atof(com_argv[j + 1]) * 1024 * 1024);
+    if (parms.memsize <= 0 || parms.memsize > sizeof(quake_heap))
+        Sys_Error("-mem must be between 1 and %d megabytes", (int)(sizeof(quake_heap) / (1024 * 1024)));
+    parms.membase = quake_heap;
+
     Host_Init(&parms);
 
     uint32_t oldtime = Sys_CurrentTicks() - 1;
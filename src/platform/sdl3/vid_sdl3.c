@@ -32,10 +32,6 @@ static SDL_Renderer *sdl_renderer;
 static SDL_Surface *sdl_surface;
 static SDL_Palette *sdl_palette;
 
-// byte	vid_buffer[BASEWIDTH*BASEHEIGHT];
-short zbuffer[BASEWIDTH * BASEHEIGHT];
-byte surfcache[256 * 1024];
-
 unsigned short d_8to16table[256];
 unsigned d_8to24table[256];
 
@@ -85,14 +81,36 @@ void VID_ShiftPalette(unsigned char *palette)
     VID_SetPalette(palette);
 }
 
+/*
+================
+VID_Init
+
+-width and -height pick the resolution, small ones get a window scaled up by a whole factor
+================
+*/
 void VID_Init(unsigned char *palette)
 {
+    hunksubsystem_t prev;
+    int pnum, scale, cachesize;
+
     (void)palette;
+    vid.width = BASEWIDTH;
+    vid.height = BASEHEIGHT;
+    if ((pnum = COM_CheckParm("-width")) && pnum + 1 < com_argc)
+        vid.width = Q_atoi(com_argv[pnum + 1]);
+    if ((pnum = COM_CheckParm("-height")) && pnum + 1 < com_argc)
+        vid.height = Q_atoi(com_argv[pnum + 1]);
+    if (vid.width < BASEWIDTH || vid.width > MAXWIDTH || vid.height < BASEHEIGHT || vid.height > MAXHEIGHT)
+        Sys_Error("Resolution must be between %ix%i and %ix%i", BASEWIDTH, BASEHEIGHT, MAXWIDTH, MAXHEIGHT);
+    scale = 960 / vid.width;
+    if (scale < 1)
+        scale = 1;
+
     if (!SDL_Init(SDL_INIT_VIDEO)) {
         Sys_Error("Could not initialize SDL, %s", SDL_GetError());
     }
 
-    sdl_window = SDL_CreateWindow("Quake", 3 * BASEWIDTH, 3 * BASEHEIGHT, 0);
+    sdl_window = SDL_CreateWindow("Quake", scale * vid.width, scale * vid.height, 0);
     if (sdl_window == NULL) {
         Sys_Error("Could not create SDL window, %s", SDL_GetError());
     }
@@ -102,7 +120,7 @@ void VID_Init(unsigned char *palette)
         Sys_Error("Could not create SDL renderer, %s", SDL_GetError());
     }
 
-    sdl_surface = SDL_CreateSurface(BASEWIDTH, BASEHEIGHT, SDL_PIXELFORMAT_INDEX8);
+    sdl_surface = SDL_CreateSurface(vid.width, vid.height, SDL_PIXELFORMAT_INDEX8);
     if (sdl_surface == NULL) {
         Sys_Error("Could not create SDL surface, %s", SDL_GetError());
     }
@@ -112,18 +130,23 @@ void VID_Init(unsigned char *palette)
         Sys_Error("Could not create SDL palette, %s", SDL_GetError());
     }
 
-    d_pzbuffer = zbuffer;
-    D_InitCaches(surfcache, sizeof(surfcache));
+    d_pzbuffer = (short *)Hunk_HighAllocName(vid.width * vid.height * sizeof(*d_pzbuffer), "video");
+    cachesize = D_SurfaceCacheForRes(vid.width, vid.height);
+    prev = Hunk_Subsystem(hs_surfcache);
+    D_InitCaches(Hunk_HighAllocName(cachesize, "video"), cachesize);
+    Hunk_Subsystem(prev);
 
-    vid.maxwarpwidth = vid.width = vid.conwidth = BASEWIDTH;
-    vid.maxwarpheight = vid.height = vid.conheight = BASEHEIGHT;
+    vid.conwidth = vid.width;
+    vid.conheight = vid.height;
+    vid.maxwarpwidth = WARP_WIDTH;
+    vid.maxwarpheight = WARP_HEIGHT;
     vid.aspect = 1.0f;
     vid.numpages = 1;
     vid.colormap = host_colormap;
     vid.fullbright = 256 - LittleLong(*((int *)vid.colormap + 2048));
     // vid.buffer = vid.conbuffer = vid_buffer;
     vid.buffer = vid.conbuffer = sdl_surface->pixels;
-    vid.rowbytes = vid.conrowbytes = BASEWIDTH;
+    vid.rowbytes = vid.conrowbytes = sdl_surface->pitch;
 }
 
 void VID_Shutdown(void)
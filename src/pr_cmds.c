@@ -832,27 +832,33 @@ void PF_cvar_set(void)
     Cvar_Set(var, val);
 }
 
+CVAR_REGISTER(sv_findindex, CVAR_CTOR({ "sv_findindex", "1" }));
+
 /*
 =================
-PF_findradius
-
-Returns a chain of entities that have origins within a spherical area
+PF_FindRadiusChain
 
-findradius (origin, radius)
+Links the matches through .chain, highest edict first
 =================
 */
-void PF_findradius(void)
+static edict_t *PF_FindRadiusChain(float *org, float rad, qboolean indexed)
 {
+    static edict_t *list[MAX_EDICTS];
     edict_t *ent, *chain;
-    float rad;
-    float *org;
     vec3_t eorg;
-    int i, j;
+    int i, j, count;
 
     chain = (edict_t *)sv.edicts;
 
-    org = G_VECTOR(OFS_PARM0);
-    rad = G_FLOAT(OFS_PARM1);
+    // NaN radius matches everything, leave that to the scan
+    if (indexed && rad >= 0) {
+        count = SV_FindInRadius(org, rad, list);
+        for (i = 0; i < count; i++) {
+            list[i]->v.chain = EDICT_TO_PROG(chain);
+            chain = list[i];
+        }
+        return chain;
+    }
 
     ent = NEXT_EDICT(sv.edicts);
     for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent)) {
@@ -869,7 +875,21 @@ void PF_findradius(void)
         chain = ent;
     }
 
-    RETURN_EDICT(chain);
+    return chain;
+}
+
+/*
+=================
+PF_findradius
+
+Returns a chain of entities that have origins within a spherical area
+
+findradius (origin, radius)
+=================
+*/
+void PF_findradius(void)
+{
+    RETURN_EDICT(PF_FindRadiusChain(G_VECTOR(OFS_PARM0), G_FLOAT(OFS_PARM1), sv_findindex.value));
 }
 
 /*
@@ -933,6 +953,251 @@ void PF_Remove(void)
     ED_Free(ed);
 }
 
+/*
+=================
+Classname index
+
+find() is mostly called on .classname, so its values are hashed to the
+edicts holding them, ascending. The next find() after a new map builds it,
+from then on an edict is moved between the lists whenever it's cleared,
+parsed, freed or has a string stored to its .classname.
+=================
+*/
+#define FIND_FIELD ((int)(offsetof(entvars_t, classname) / 4))
+#define FIND_OFS ((int)(offsetof(edict_t, v) + offsetof(entvars_t, classname)))
+
+static constexpr int PF_FindHashSize(void)
+{
+    int size = 16;
+
+    while (size < MAX_EDICTS * 2)
+        size <<= 1;
+    return size;
+}
+
+#define FIND_HASH_SIZE PF_FindHashSize()
+
+// first and last edict with the slot's string, 0 for an empty slot and -1 for
+// one that was emptied, which lookups have to probe past
+static int find_heads[FIND_HASH_SIZE];
+static int find_tails[FIND_HASH_SIZE];
+static uint32_t find_hashes[FIND_HASH_SIZE];
+static int find_usedslots; // emptied ones included
+static short find_next[MAX_EDICTS]; // next edict with the same string, 0 at the end
+static short find_prev[MAX_EDICTS]; // previous one, 0 at the start
+static short find_slot[MAX_EDICTS]; // slot of each indexed edict, -1 if it isn't
+static qboolean find_built;
+static int find_lastslot = -1;
+
+/*
+=================
+PF_FindSlot
+
+Returns the slot holding s, or the empty slot it would go in
+=================
+*/
+static int PF_FindSlot(char const *s, uint32_t hash)
+{
+    int i, emptied;
+
+    emptied = -1;
+    for (i = hash & (FIND_HASH_SIZE - 1);; i = (i + 1) & (FIND_HASH_SIZE - 1)) {
+        if (!find_heads[i])
+            return emptied >= 0 ? emptied : i;
+        if (find_heads[i] < 0) {
+            if (emptied < 0)
+                emptied = i;
+            continue;
+        }
+        if (find_hashes[i] == hash && !strcmp(E_STRING(EDICT_NUM(find_heads[i]), FIND_FIELD), s))
+            return i;
+    }
+}
+
+/*
+=================
+PF_FindInsert
+=================
+*/
+static void PF_FindInsert(int e)
+{
+    char const *t;
+    uint32_t hash;
+    int i, n;
+
+    t = E_STRING(EDICT_NUM(e), FIND_FIELD);
+    hash = pq_hash(t, strlen(t));
+    i = PF_FindSlot(t, hash);
+    find_slot[e] = i;
+
+    if (find_heads[i] <= 0) {
+        if (!find_heads[i])
+            find_usedslots++;
+        find_hashes[i] = hash;
+        find_heads[i] = find_tails[i] = e;
+        find_prev[e] = find_next[e] = 0;
+        return;
+    }
+
+    // new edicts mostly go at the end
+    if (e > find_tails[i]) {
+        find_prev[e] = find_tails[i];
+        find_next[e] = 0;
+        find_next[find_tails[i]] = e;
+        find_tails[i] = e;
+        return;
+    }
+
+    for (n = find_heads[i]; n < e; n = find_next[n])
+        ;
+    find_next[e] = n;
+    find_prev[e] = find_prev[n];
+    if (find_prev[n])
+        find_next[find_prev[n]] = e;
+    else
+        find_heads[i] = e;
+    find_prev[n] = e;
+}
+
+/*
+=================
+PF_FindRemove
+=================
+*/
+static void PF_FindRemove(int e)
+{
+    int i;
+
+    i = find_slot[e];
+    if (i < 0)
+        return;
+    find_slot[e] = -1;
+
+    if (find_prev[e])
+        find_next[find_prev[e]] = find_next[e];
+    else
+        find_heads[i] = find_next[e];
+    if (find_next[e])
+        find_prev[find_next[e]] = find_prev[e];
+    else
+        find_tails[i] = find_prev[e];
+
+    if (!find_heads[i])
+        find_heads[i] = -1;
+}
+
+/*
+=================
+PF_BuildFindIndex
+=================
+*/
+static void PF_BuildFindIndex(void)
+{
+    edict_t *ed;
+    int e;
+
+    memset(find_heads, 0, sizeof(find_heads));
+    memset(find_slot, -1, sizeof(find_slot));
+    find_usedslots = 0;
+    find_lastslot = -1;
+    find_built = true;
+
+    for (e = 1, ed = EDICT_NUM(1); e < sv.num_edicts; e++, ed = NEXT_EDICT(ed))
+        if (!ed->free)
+            PF_FindInsert(e);
+}
+
+/*
+=================
+PF_FindReset
+
+The edicts are new, the next find() indexes them
+=================
+*/
+void PF_FindReset(void)
+{
+    find_built = false;
+}
+
+/*
+=================
+PF_FindRelink
+
+Moves ed to the list of its .classname, or out of the index when it's free
+=================
+*/
+void PF_FindRelink(edict_t *ed)
+{
+    int e;
+
+    if (!find_built)
+        return;
+    e = NUM_FOR_EDICT(ed);
+    if (!e)
+        return; // the world is never found
+
+    PF_FindRemove(e);
+    if (!ed->free)
+        PF_FindInsert(e);
+
+    // every string that went away leaves an emptied slot behind
+    if (find_usedslots > FIND_HASH_SIZE / 2)
+        find_built = false;
+}
+
+/*
+=================
+PF_FindStored
+
+A string was stored at byte offset ofs of the edicts
+=================
+*/
+void PF_FindStored(int ofs)
+{
+    if (find_built && ofs % pr_edict_size == FIND_OFS)
+        PF_FindRelink(PROG_TO_EDICT(ofs - FIND_OFS));
+}
+
+/*
+=================
+PF_FindString
+
+Returns the first edict after e whose string field f is s, or 0
+=================
+*/
+static int PF_FindString(int e, int f, char const *s, qboolean indexed)
+{
+    char const *t;
+    int i;
+
+    if (indexed && f == FIND_FIELD) {
+        if (!find_built)
+            PF_BuildFindIndex();
+
+        // QC loops keep asking for the same string, a strcmp confirms it
+        i = find_lastslot;
+        if (i < 0 || find_heads[i] <= 0 || strcmp(E_STRING(EDICT_NUM(find_heads[i]), FIND_FIELD), s))
+            find_lastslot = i = PF_FindSlot(s, pq_hash(s, strlen(s)));
+        if (e > 0 && e < sv.num_edicts && find_slot[e] == i)
+            return find_next[e]; // iterating over the matches
+
+        for (e++, i = find_heads[i] > 0 ? find_heads[i] : 0; i && i < e; i = find_next[i])
+            ;
+        return i;
+    }
+
+    for (e++; e < sv.num_edicts; e++) {
+        if (EDICT_NUM(e)->free)
+            continue;
+        t = E_STRING(EDICT_NUM(e), f);
+        if (!t)
+            continue;
+        if (!strcmp(t, s))
+            return e;
+    }
+    return 0;
+}
+
 // entity (entity start, .string field, string match) find = #5;
 void PF_Find(void)
 #ifdef QUAKE2
@@ -984,8 +1249,7 @@ void PF_Find(void)
 {
     int e;
     int f;
-    char *s, *t;
-    edict_t *ed;
+    char *s;
 
     e = G_EDICTNUM(OFS_PARM0);
     f = G_INT(OFS_PARM1);
@@ -993,20 +1257,7 @@ void PF_Find(void)
     if (!s)
         PR_RunError("PF_Find: bad search string");
 
-    for (e++; e < sv.num_edicts; e++) {
-        ed = EDICT_NUM(e);
-        if (ed->free)
-            continue;
-        t = E_STRING(ed, f);
-        if (!t)
-            continue;
-        if (!strcmp(t, s)) {
-            RETURN_EDICT(ed);
-            return;
-        }
-    }
-
-    RETURN_EDICT(sv.edicts);
+    RETURN_EDICT(EDICT_NUM(PF_FindString(e, f, s, sv_findindex.value)));
 }
 #endif
 
@@ -1274,13 +1525,31 @@ vector aim(entity, missilespeed)
 =============
 */
 CVAR_REGISTER(sv_aim, CVAR_CTOR({ "sv_aim", 0.93 }));
+
+typedef struct {
+    float dist;
+    edict_t *ent;
+} aimcandidate_t;
+
+// best aligned first, on a tie the higher edict like the old linear search
+static int PF_SortAimCandidates(void const *a, void const *b)
+{
+    aimcandidate_t const *ca = (aimcandidate_t const *)a;
+    aimcandidate_t const *cb = (aimcandidate_t const *)b;
+
+    if (ca->dist != cb->dist)
+        return ca->dist < cb->dist ? 1 : -1;
+    return (ca->ent < cb->ent) - (ca->ent > cb->ent);
+}
+
 void PF_aim(void)
 {
+    static aimcandidate_t candidates[MAX_EDICTS];
     edict_t *ent, *check, *bestent;
     vec3_t start, dir, end, bestdir;
-    int i, j;
+    int i, j, count;
     trace_t tr;
-    float dist, bestdist;
+    float dist;
 
     ent = G_EDICT(OFS_PARM0);
 
@@ -1297,11 +1566,12 @@ void PF_aim(void)
         return;
     }
 
-    // try all possible entities
+    // try all possible entities, the best aligned first so the first one
+    // that can be shot at wins and the rest need no traces
     VectorCopy(dir, bestdir);
-    bestdist = sv_aim.value;
     bestent = NULL;
 
+    count = 0;
     check = NEXT_EDICT(sv.edicts);
     for (i = 1; i < sv.num_edicts; i++, check = NEXT_EDICT(check)) {
         if (check->v.takedamage != DAMAGE_AIM)
@@ -1315,12 +1585,23 @@ void PF_aim(void)
         VectorSubtract(end, start, dir);
         VectorNormalize(dir);
         dist = DotProduct(dir, pr_global_struct->v_forward);
-        if (dist < bestdist)
+        if (dist < sv_aim.value)
             continue; // to far to turn
+        candidates[count].dist = dist;
+        candidates[count].ent = check;
+        count++;
+    }
+
+    qsort(candidates, count, sizeof(*candidates), PF_SortAimCandidates);
+
+    for (i = 0; i < count; i++) {
+        check = candidates[i].ent;
+        for (j = 0; j < 3; j++)
+            end[j] = check->v.origin[j] + 0.5f * (check->v.mins[j] + check->v.maxs[j]);
         tr = SV_Move(start, vec3_origin, vec3_origin, end, false, ent);
         if (tr.ent == check) { // can shoot at this one
-            bestdist = dist;
             bestent = check;
+            break;
         }
     }
 
@@ -1727,98 +2008,110 @@ void PF_Fixme(void)
     PR_RunError("unimplemented bulitin");
 }
 
-static builtin_t const pr_builtin[] = { PF_Fixme,
-                           PF_makevectors, // void(entity e)	makevectors 		= #1;
-                           PF_setorigin, // void(entity e, vector o) setorigin	= #2;
-                           PF_setmodel, // void(entity e, string m) setmodel	= #3;
-                           PF_setsize, // void(entity e, vector min, vector max) setsize = #4;
-                           PF_Fixme, // void(entity e, vector min, vector max) setabssize = #5;
-                           PF_break, // void() break						= #6;
-                           PF_random, // float() random						= #7;
-                           PF_sound, // void(entity e, float chan, string samp) sound = #8;
-                           PF_normalize, // vector(vector v) normalize			= #9;
-                           PF_error, // void(string e) error				= #10;
-                           PF_objerror, // void(string e) objerror				= #11;
-                           PF_vlen, // float(vector v) vlen				= #12;
-                           PF_vectoyaw, // float(vector v) vectoyaw		= #13;
-                           PF_Spawn, // entity() spawn						= #14;
-                           PF_Remove, // void(entity e) remove				= #15;
-                           PF_traceline, // float(vector v1, vector v2, float tryents) traceline = #16;
-                           PF_checkclient, // entity() clientlist					= #17;
-                           PF_Find, // entity(entity start, .string fld, string match) find = #18;
-                           PF_precache_sound, // void(string s) precache_sound		= #19;
-                           PF_precache_model, // void(string s) precache_model		= #20;
-                           PF_stuffcmd, // void(entity client, string s)stuffcmd = #21;
-                           PF_findradius, // entity(vector org, float rad) findradius = #22;
-                           PF_bprint, // void(string s) bprint				= #23;
-                           PF_sprint, // void(entity client, string s) sprint = #24;
-                           PF_dprint, // void(string s) dprint				= #25;
-                           PF_ftos, // void(string s) ftos				= #26;
-                           PF_vtos, // void(string s) vtos				= #27;
-                           PF_coredump,
-                           PF_traceon,
-                           PF_traceoff,
-                           PF_eprint, // void(entity e) debug print an entire entity
-                           PF_walkmove, // float(float yaw, float dist) walkmove
-                           PF_Fixme, // float(float yaw, float dist) walkmove
-                           PF_droptofloor,
-                           PF_lightstyle,
-                           PF_rint,
-                           PF_floor,
-                           PF_ceil,
-                           PF_Fixme,
-                           PF_checkbottom,
-                           PF_pointcontents,
-                           PF_Fixme,
-                           PF_fabs,
-                           PF_aim,
-                           PF_cvar,
-                           PF_localcmd,
-                           PF_nextent,
-                           PF_particle,
-                           PF_changeyaw,
-                           PF_Fixme,
-                           PF_vectoangles,
-
-                           PF_WriteByte,
-                           PF_WriteChar,
-                           PF_WriteShort,
-                           PF_WriteLong,
-                           PF_WriteCoord,
-                           PF_WriteAngle,
-                           PF_WriteString,
-                           PF_WriteEntity,
+/*
+=================
+PF_FindBench_f
 
-#ifdef QUAKE2
-                           PF_sin,
-                           PF_cos,
-                           PF_sqrt,
-                           PF_changepitch,
-                           PF_TraceToss,
-                           PF_etos,
-                           PF_WaterMove,
-#else
-                           PF_Fixme,          PF_Fixme,         PF_Fixme,       PF_Fixme,
-                           PF_Fixme,          PF_Fixme,         PF_Fixme,
-#endif
+Times findradius and find(classname) with and without the indices on the
+current map, and checks both give the same edicts
 
-                           SV_MoveToGoal,
-                           PF_precache_file,
-                           PF_makestatic,
+sv_findbench [queries] [radius]
+=================
+*/
+static void PF_FindBench_f(void)
+{
+    static int queries_e[MAX_EDICTS];
+    edict_t *a, *b;
+    vec3_t org;
+    char const *s;
+    uint32_t seed, start, time[2];
+    int queries, results, mismatches;
+    int i, j, e, found, mode;
+    float rad;
 
-                           PF_changelevel,
-                           PF_Fixme,
+    if (!sv.active || sv.num_edicts < 2) {
+        Con_Printf("Not playing a local game.\n");
+        return;
+    }
+    queries = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 10000;
+    rad = Cmd_Argc() > 2 ? Q_atof(Cmd_Argv(2)) : 256;
+    if (queries < 1)
+        queries = 1;
+
+    // findradius, the same pseudo random centres for both runs
+    mismatches = results = 0;
+    for (mode = -1; mode < 2; mode++) {
+        start = Sys_CurrentTicks();
+        seed = 1;
+        for (i = 0; i < queries; i++) {
+            for (j = 0; j < 3; j++) {
+                seed = seed * 1103515245 + 12345;
+                org[j] = sv.worldmodel->mins[j] +
+                         (sv.worldmodel->maxs[j] - sv.worldmodel->mins[j]) * ((seed >> 8) & 0xffff) / 65535.0f;
+            }
+            if (mode >= 0) {
+                PF_FindRadiusChain(org, rad, mode);
+                continue;
+            }
 
-                           PF_cvar_set,
-                           PF_centerprint,
+            // first pass only checks, walking the index chain before the scan relinks .chain
+            a = PF_FindRadiusChain(org, rad, true);
+            for (j = 0; a != sv.edicts; a = PROG_TO_EDICT(a->v.chain))
+                queries_e[j++] = NUM_FOR_EDICT(a);
+            b = PF_FindRadiusChain(org, rad, false);
+            for (e = 0; b != sv.edicts; b = PROG_TO_EDICT(b->v.chain), e++)
+                if (e >= j || queries_e[e] != NUM_FOR_EDICT(b))
+                    break;
+            if (e != j || b != sv.edicts)
+                mismatches++;
+            results += j;
+        }
+        if (mode >= 0)
+            time[mode] = Sys_CurrentTicks() - start;
+    }
+    Con_Printf("%i edicts, %i queries\n", sv.num_edicts, queries);
+    Con_Printf("findradius %g: %.1f results, scan %u ms, grid %u ms\n", rad, (float)results / queries, time[0],
+               time[1]);
+
+    // find, every query walks all matches like a QC while loop
+    results = 0;
+    for (mode = -1; mode < 2; mode++) {
+        start = Sys_CurrentTicks();
+        seed = 1;
+        for (i = 0; i < queries; i++) {
+            seed = seed * 1103515245 + 12345;
+            e = 1 + (seed >> 8) % (sv.num_edicts - 1);
+            s = (seed & 15) ? E_STRING(EDICT_NUM(e), FIND_FIELD) : "no_such_classname";
+            if (mode >= 0) {
+                for (e = PF_FindString(0, FIND_FIELD, s, mode); e; e = PF_FindString(e, FIND_FIELD, s, mode))
+                    ;
+                continue;
+            }
+            for (e = j = 0;; j++) {
+                found = PF_FindString(e, FIND_FIELD, s, true);
+                if (found != PF_FindString(e, FIND_FIELD, s, false)) {
+                    mismatches++;
+                    break;
+                }
+                if (!found)
+                    break;
+                e = found;
+            }
+            results += j;
+        }
+        if (mode >= 0)
+            time[mode] = Sys_CurrentTicks() - start;
+    }
+    Con_Printf("find classname: %.1f results, scan %u ms, index %u ms\n", (float)results / queries, time[0],
+               time[1]);
 
-                           PF_ambientsound,
+    if (mismatches)
+        Con_Printf("%i queries differ between the scan and the index\n", mismatches);
+}
 
-                           PF_precache_model,
-                           PF_precache_sound, // precache_sound2 is different only for qcc
-                           PF_precache_file,
+CMD_REGISTER("sv_findbench", PF_FindBench_f);
 
-                           PF_setspawnparms };
+#include "pr_builtins.h"
 
 builtin_t const *pr_builtins = pr_builtin;
 int const pr_numbuiltins = sizeof(pr_builtin) / sizeof(pr_builtin[0]);
@@ -50,15 +50,25 @@ CVAR_REGISTER(saved2, CVAR_CTOR({ "saved2", 0, true }));
 CVAR_REGISTER(saved3, CVAR_CTOR({ "saved3", 0, true }));
 CVAR_REGISTER(saved4, CVAR_CTOR({ "saved4", 0, true }));
 
-#define MAX_FIELD_LEN 64
-#define GEFV_CACHESIZE 2
+// open addressed name -> index tables, built once per PR_LoadProgs
+typedef struct {
+    uint32_t hash;
+    int index; // -1 for an empty slot
+} prhash_t;
 
 typedef struct {
-    ddef_t *pcache;
-    char field[MAX_FIELD_LEN];
-} gefv_cache;
+    prhash_t *slots;
+    uint32_t mask;
+    byte const *names; // s_name of the first def
+    int stride;        // bytes between two s_name
+} prhashtable_t;
+
+static prhashtable_t pr_fieldhash;
+static prhashtable_t pr_globalhash;
+static prhashtable_t pr_functionhash;
 
-static gefv_cache gefvCache[GEFV_CACHESIZE] = { { NULL, "" }, { NULL, "" } };
+int pr_field_items2;
+int pr_field_gravity;
 
 /*
 =================
@@ -71,6 +81,7 @@ void ED_ClearEdict(edict_t *e)
 {
     memset(&e->v, 0, progs->entityfields * 4);
     e->free = false;
+    PF_FindRelink(e);
 }
 
 /*
@@ -134,6 +145,7 @@ void ED_Free(edict_t *ed)
     ed->v.solid = 0;
 
     ed->freetime = sv.time;
+    PF_FindRelink(ed);
 }
 
 //===========================================================================
@@ -174,6 +186,67 @@ ddef_t *ED_FieldAtOfs(int ofs)
     return NULL;
 }
 
+/*
+============
+PR_HashName
+
+Returns the index of the first def called name, or -1
+============
+*/
+static int PR_HashName(prhashtable_t const *table, char const *name)
+{
+    prhash_t const *slot;
+    uint32_t hash, i;
+
+    hash = pq_hash(name, strlen(name));
+    for (i = hash & table->mask;; i = (i + 1) & table->mask) {
+        slot = &table->slots[i];
+        if (slot->index < 0)
+            return -1;
+        if (slot->hash == hash &&
+            !strcmp(pr_strings + *(int const *)(table->names + slot->index * table->stride), name))
+            return slot->index;
+    }
+}
+
+/*
+============
+PR_BuildHash
+
+names points at the s_name of the first of count defs, stride bytes apart
+============
+*/
+static void PR_BuildHash(prhashtable_t *table, void const *names, int stride, int count, char const *tag)
+{
+    prhash_t *slot;
+    char const *name;
+    uint32_t size, hash, i;
+    int j;
+
+    for (size = 16; size < (uint32_t)count * 2; size <<= 1)
+        ;
+
+    table->slots = Hunk_AllocName(size * sizeof(*table->slots), tag);
+    table->mask = size - 1;
+    table->names = (byte const *)names;
+    table->stride = stride;
+    for (i = 0; i < size; i++)
+        table->slots[i].index = -1;
+
+    for (j = 0; j < count; j++) {
+        name = pr_strings + *(int const *)(table->names + j * stride);
+        if (PR_HashName(table, name) >= 0)
+            continue; // the linear search this replaces found the first one
+
+        hash = pq_hash(name, strlen(name));
+        for (i = hash & table->mask; table->slots[i].index >= 0; i = (i + 1) & table->mask)
+            ;
+        slot = &table->slots[i];
+        slot->hash = hash;
+        slot->index = j;
+    }
+}
+
 /*
 ============
 ED_FindField
@@ -181,15 +254,21 @@ ED_FindField
 */
 static ddef_t *ED_FindField(char const *name)
 {
-    ddef_t *def;
-    int i;
+    int i = PR_HashName(&pr_fieldhash, name);
+    return i < 0 ? NULL : &pr_fielddefs[i];
+}
 
-    for (i = 0; i < progs->numfielddefs; i++) {
-        def = &pr_fielddefs[i];
-        if (!strcmp(pr_strings + def->s_name, name))
-            return def;
-    }
-    return NULL;
+/*
+============
+ED_FindFieldOffset
+
+Returns the offset in ints of a field the engine reads by name, or -1
+============
+*/
+static int ED_FindFieldOffset(char const *name)
+{
+    ddef_t *def = ED_FindField(name);
+    return def ? def->ofs : -1;
 }
 
 /*
@@ -199,15 +278,8 @@ ED_FindGlobal
 */
 ddef_t *ED_FindGlobal(char *name)
 {
-    ddef_t *def;
-    int i;
-
-    for (i = 0; i < progs->numglobaldefs; i++) {
-        def = &pr_globaldefs[i];
-        if (!strcmp(pr_strings + def->s_name, name))
-            return def;
-    }
-    return NULL;
+    int i = PR_HashName(&pr_globalhash, name);
+    return i < 0 ? NULL : &pr_globaldefs[i];
 }
 
 /*
@@ -215,41 +287,16 @@ ddef_t *ED_FindGlobal(char *name)
 ED_FindFunction
 ============
 */
-dfunction_t *ED_FindFunction(char *name)
+dfunction_t *ED_FindFunction(char const *name)
 {
-    dfunction_t *func;
-    int i;
-
-    for (i = 0; i < progs->numfunctions; i++) {
-        func = &pr_functions[i];
-        if (!strcmp(pr_strings + func->s_name, name))
-            return func;
-    }
-    return NULL;
+    int i = PR_HashName(&pr_functionhash, name);
+    return i < 0 ? NULL : &pr_functions[i];
 }
 
 eval_t *GetEdictFieldValue(edict_t *ed, char const *field)
 {
-    ddef_t *def = NULL;
-    int i;
-    static int rep = 0;
-
-    for (i = 0; i < GEFV_CACHESIZE; i++) {
-        if (!strcmp(field, gefvCache[i].field)) {
-            def = gefvCache[i].pcache;
-            goto Done;
-        }
-    }
+    ddef_t *def = ED_FindField(field);
 
-    def = ED_FindField(field);
-
-    if (strlen(field) < MAX_FIELD_LEN) {
-        gefvCache[rep].pcache = def;
-        strcpy(gefvCache[rep].field, field);
-        rep ^= 1;
-    }
-
-Done:
     if (!def)
         return NULL;
 
@@ -838,6 +885,7 @@ char const *ED_ParseEdict(char const *data, edict_t *ent)
     if (!init)
         ent->free = true;
 
+    PF_FindRelink(ent);
     return data;
 }
 
@@ -930,13 +978,11 @@ PR_LoadProgs
 */
 void PR_LoadProgs(void)
 {
+    hunksubsystem_t prev;
     int i;
 
-    // flush the non-C variable lookup cache
-    for (i = 0; i < GEFV_CACHESIZE; i++)
-        gefvCache[i].field[0] = 0;
-
     CRC_Init(&pr_crc);
+    prev = Hunk_Subsystem(hs_progs);
 
     progs = (dprograms_t *)COM_LoadHunkFile("progs.dat");
     if (!progs)
@@ -999,6 +1045,17 @@ void PR_LoadProgs(void)
 
     for (i = 0; i < progs->numglobals; i++)
         ((int *)pr_globals)[i] = LittleLong(((int *)pr_globals)[i]);
+
+    PR_BuildHash(&pr_fieldhash, &pr_fielddefs->s_name, sizeof(ddef_t), progs->numfielddefs, "prfieldhash");
+    PR_BuildHash(&pr_globalhash, &pr_globaldefs->s_name, sizeof(ddef_t), progs->numglobaldefs, "prglobalhash");
+    PR_BuildHash(&pr_functionhash, &pr_functions->s_name, sizeof(dfunction_t), progs->numfunctions, "prfunchash");
+
+    // fields outside entvars_t that the engine reads every frame
+    pr_field_items2 = ED_FindFieldOffset("items2");
+    pr_field_gravity = ED_FindFieldOffset("gravity");
+
+    PR_DecodeProgram();
+    Hunk_Subsystem(prev);
 }
 
 /*
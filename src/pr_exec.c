@@ -43,6 +43,31 @@ int pr_xstatement;
 
 int pr_argc;
 
+CVAR_REGISTER(pr_predecode, CVAR_CTOR({ "pr_predecode", "1" }));
+CVAR_REGISTER(pr_profile, CVAR_CTOR({ "pr_profile", "0" }));
+
+#ifdef PR_AOT
+#include "pr_aot.h"
+
+CVAR_REGISTER(pr_native, CVAR_CTOR({ "pr_native", "1" }));
+
+static pr_native_t const *pr_natives; // indexed by function number, NULL unless built from this progs.dat
+int pr_aot_runaway;
+#endif
+
+// a statement decoded once at load, with its operands resolved to pointers
+typedef struct prinstr_s {
+    void const *handler; // dispatch target of the plain interpreter variant
+    eval_t *a, *b, *c;
+    int arg; // absolute branch target, or argument count for calls
+    unsigned short op; // bad opcodes are clamped to PR_NUM_OPS
+} prinstr_t;
+
+#define PR_NUM_OPS (OP_BITOR + 1)
+
+static prinstr_t *pr_decoded;
+static void const *const *pr_handlers;
+
 static char const * const pr_opnames[] = { "DONE",
 
                        "MUL_F",    "MUL_V",    "MUL_FV",   "MUL_VF",
@@ -162,6 +187,9 @@ void PR_Profile_f(void)
     int num;
     int i;
 
+    if (pr_predecode.value && !pr_profile.value)
+        Con_Printf("statements are only counted with pr_profile 1\n");
+
     num = 0;
     do {
         max = 0;
@@ -283,10 +311,356 @@ int PR_LeaveFunction(void)
 
 /*
 ====================
-PR_ExecuteProgram
+PR_RunDecoded
+
+Runs pre-decoded statements from s until the function that was entered at
+exitdepth returns. Tracing and profiling are compiled into their own variants
+so the plain one only pays for the runaway check and a jump per statement.
+Returns -1 when done, or the statement to resume at in another variant when
+a builtin toggled tracing.
+The plain variant called with s < 0 only publishes its handler table.
 ====================
 */
-void PR_ExecuteProgram(func_t fnum)
+template <bool trace, bool profile>
+static int PR_RunDecoded(int s, int exitdepth, int &runaway)
+{
+    static void const *const handlers[PR_NUM_OPS + 1] = {
+        &&op_done,   &&op_mul_f,   &&op_mul_v,   &&op_mul_fv,  &&op_mul_vf,  &&op_div_f,   &&op_add_f,
+        &&op_add_v,  &&op_sub_f,   &&op_sub_v,   &&op_eq_f,    &&op_eq_v,    &&op_eq_s,    &&op_eq_e,
+        &&op_eq_e,   &&op_ne_f,    &&op_ne_v,    &&op_ne_s,    &&op_ne_e,    &&op_ne_e,    &&op_le,
+        &&op_ge,     &&op_lt,      &&op_gt,      &&op_load,    &&op_load_v,  &&op_load,    &&op_load,
+        &&op_load,   &&op_load,    &&op_address, &&op_store,   &&op_store_v, &&op_store,   &&op_store,
+        &&op_store,  &&op_store,   &&op_storep,  &&op_storep_v, &&op_storep_s, &&op_storep, &&op_storep,
+        &&op_storep, &&op_done,    &&op_not_f,   &&op_not_v,   &&op_not_s,   &&op_not_ent, &&op_not_fnc,
+        &&op_if,     &&op_ifnot,   &&op_call,    &&op_call,    &&op_call,    &&op_call,    &&op_call,
+        &&op_call,   &&op_call,    &&op_call,    &&op_call,    &&op_state,   &&op_goto,    &&op_and,
+        &&op_or,     &&op_bitand,  &&op_bitor,   &&op_bad
+    };
+    prinstr_t const *st;
+    dfunction_t *newf;
+    edict_t *ed;
+    eval_t *ptr;
+    int i;
+
+    if (s < 0) {
+        pr_handlers = handlers;
+        return -1;
+    }
+
+#define PR_DISPATCH()                                                                                                  \
+    do {                                                                                                               \
+        if (!--runaway) {                                                                                              \
+            pr_xstatement = st - pr_decoded;                                                                           \
+            PR_RunError("runaway loop error");                                                                         \
+        }                                                                                                              \
+        if (profile)                                                                                                   \
+            pr_xfunction->profile++;                                                                                   \
+        if (trace) {                                                                                                   \
+            pr_xstatement = st - pr_decoded;                                                                           \
+            PR_PrintStatement(&pr_statements[pr_xstatement]);                                                          \
+        }                                                                                                              \
+        if (trace || profile)                                                                                          \
+            goto *handlers[st->op];                                                                                    \
+        goto *st->handler;                                                                                             \
+    } while (0)
+#define PR_NEXT()                                                                                                      \
+    do {                                                                                                               \
+        st++;                                                                                                          \
+        PR_DISPATCH();                                                                                                 \
+    } while (0)
+
+    st = &pr_decoded[s];
+    PR_DISPATCH();
+
+op_add_f:
+    st->c->_float = st->a->_float + st->b->_float;
+    PR_NEXT();
+op_add_v:
+    st->c->vector[0] = st->a->vector[0] + st->b->vector[0];
+    st->c->vector[1] = st->a->vector[1] + st->b->vector[1];
+    st->c->vector[2] = st->a->vector[2] + st->b->vector[2];
+    PR_NEXT();
+
+op_sub_f:
+    st->c->_float = st->a->_float - st->b->_float;
+    PR_NEXT();
+op_sub_v:
+    st->c->vector[0] = st->a->vector[0] - st->b->vector[0];
+    st->c->vector[1] = st->a->vector[1] - st->b->vector[1];
+    st->c->vector[2] = st->a->vector[2] - st->b->vector[2];
+    PR_NEXT();
+
+op_mul_f:
+    st->c->_float = st->a->_float * st->b->_float;
+    PR_NEXT();
+op_mul_v:
+    st->c->_float = st->a->vector[0] * st->b->vector[0] + st->a->vector[1] * st->b->vector[1] +
+                    st->a->vector[2] * st->b->vector[2];
+    PR_NEXT();
+op_mul_fv:
+    st->c->vector[0] = st->a->_float * st->b->vector[0];
+    st->c->vector[1] = st->a->_float * st->b->vector[1];
+    st->c->vector[2] = st->a->_float * st->b->vector[2];
+    PR_NEXT();
+op_mul_vf:
+    st->c->vector[0] = st->b->_float * st->a->vector[0];
+    st->c->vector[1] = st->b->_float * st->a->vector[1];
+    st->c->vector[2] = st->b->_float * st->a->vector[2];
+    PR_NEXT();
+
+op_div_f:
+    st->c->_float = st->a->_float / st->b->_float;
+    PR_NEXT();
+
+op_bitand:
+    st->c->_float = (int)st->a->_float & (int)st->b->_float;
+    PR_NEXT();
+op_bitor:
+    st->c->_float = (int)st->a->_float | (int)st->b->_float;
+    PR_NEXT();
+
+op_ge:
+    st->c->_float = st->a->_float >= st->b->_float;
+    PR_NEXT();
+op_le:
+    st->c->_float = st->a->_float <= st->b->_float;
+    PR_NEXT();
+op_gt:
+    st->c->_float = st->a->_float > st->b->_float;
+    PR_NEXT();
+op_lt:
+    st->c->_float = st->a->_float < st->b->_float;
+    PR_NEXT();
+op_and:
+    st->c->_float = st->a->_float && st->b->_float;
+    PR_NEXT();
+op_or:
+    st->c->_float = st->a->_float || st->b->_float;
+    PR_NEXT();
+
+op_not_f:
+    st->c->_float = !st->a->_float;
+    PR_NEXT();
+op_not_v:
+    st->c->_float = !st->a->vector[0] && !st->a->vector[1] && !st->a->vector[2];
+    PR_NEXT();
+op_not_s:
+    st->c->_float = !st->a->string || !pr_strings[st->a->string];
+    PR_NEXT();
+op_not_fnc:
+    st->c->_float = !st->a->function;
+    PR_NEXT();
+op_not_ent:
+    st->c->_float = (PROG_TO_EDICT(st->a->edict) == sv.edicts);
+    PR_NEXT();
+
+op_eq_f:
+    st->c->_float = st->a->_float == st->b->_float;
+    PR_NEXT();
+op_eq_v:
+    st->c->_float = (st->a->vector[0] == st->b->vector[0]) && (st->a->vector[1] == st->b->vector[1]) &&
+                    (st->a->vector[2] == st->b->vector[2]);
+    PR_NEXT();
+op_eq_s:
+    st->c->_float = !strcmp(pr_strings + st->a->string, pr_strings + st->b->string);
+    PR_NEXT();
+op_eq_e: // entities and functions
+    st->c->_float = st->a->_int == st->b->_int;
+    PR_NEXT();
+
+op_ne_f:
+    st->c->_float = st->a->_float != st->b->_float;
+    PR_NEXT();
+op_ne_v:
+    st->c->_float = (st->a->vector[0] != st->b->vector[0]) || (st->a->vector[1] != st->b->vector[1]) ||
+                    (st->a->vector[2] != st->b->vector[2]);
+    PR_NEXT();
+op_ne_s:
+    st->c->_float = strcmp(pr_strings + st->a->string, pr_strings + st->b->string);
+    PR_NEXT();
+op_ne_e: // entities and functions
+    st->c->_float = st->a->_int != st->b->_int;
+    PR_NEXT();
+
+    //==================
+op_store: // integers and pointers
+    st->b->_int = st->a->_int;
+    PR_NEXT();
+op_store_v:
+    st->b->vector[0] = st->a->vector[0];
+    st->b->vector[1] = st->a->vector[1];
+    st->b->vector[2] = st->a->vector[2];
+    PR_NEXT();
+
+op_storep: // integers and pointers
+    ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+    ptr->_int = st->a->_int;
+    PR_NEXT();
+op_storep_s:
+    ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+    ptr->_int = st->a->_int;
+    PF_FindStored(st->b->_int);
+    PR_NEXT();
+op_storep_v:
+    ptr = (eval_t *)((byte *)sv.edicts + st->b->_int);
+    ptr->vector[0] = st->a->vector[0];
+    ptr->vector[1] = st->a->vector[1];
+    ptr->vector[2] = st->a->vector[2];
+    PR_NEXT();
+
+op_address:
+    ed = PROG_TO_EDICT(st->a->edict);
+    pr_xstatement = st - pr_decoded;
+#ifdef PARANOID
+    NUM_FOR_EDICT(ed); // make sure it's in range
+#endif
+    if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+        PR_RunError("assignment to world entity");
+    st->c->_int = (byte *)((int *)&ed->v + st->b->_int) - (byte *)sv.edicts;
+    PR_NEXT();
+
+op_load: // everything but vectors
+    ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+    pr_xstatement = st - pr_decoded;
+    NUM_FOR_EDICT(ed); // make sure it's in range
+#endif
+    st->c->_int = ((eval_t *)((int *)&ed->v + st->b->_int))->_int;
+    PR_NEXT();
+op_load_v:
+    ed = PROG_TO_EDICT(st->a->edict);
+#ifdef PARANOID
+    pr_xstatement = st - pr_decoded;
+    NUM_FOR_EDICT(ed); // make sure it's in range
+#endif
+    ptr = (eval_t *)((int *)&ed->v + st->b->_int);
+    st->c->vector[0] = ptr->vector[0];
+    st->c->vector[1] = ptr->vector[1];
+    st->c->vector[2] = ptr->vector[2];
+    PR_NEXT();
+
+    //==================
+
+op_ifnot:
+    if (st->a->_int) // fall through
+        PR_NEXT();
+    st = &pr_decoded[st->arg];
+    PR_DISPATCH();
+op_if:
+    if (!st->a->_int) // fall through
+        PR_NEXT();
+    st = &pr_decoded[st->arg];
+    PR_DISPATCH();
+op_goto:
+    st = &pr_decoded[st->arg];
+    PR_DISPATCH();
+
+op_call:
+    pr_argc = st->arg;
+    pr_xstatement = st - pr_decoded;
+    if (!st->a->function)
+        PR_RunError("NULL function");
+
+    newf = &pr_functions[st->a->function];
+
+    if (newf->first_statement < 0) { // negative statements are built in functions
+        i = -newf->first_statement;
+        if (i >= pr_numbuiltins)
+            PR_RunError("Bad builtin call number");
+        pr_builtins[i]();
+        if (pr_trace != trace)
+            return st + 1 - pr_decoded;
+        PR_NEXT();
+    }
+
+    st = &pr_decoded[PR_EnterFunction(newf) + 1];
+    PR_DISPATCH();
+
+op_done: // and return
+    pr_globals[OFS_RETURN] = st->a->vector[0];
+    pr_globals[OFS_RETURN + 1] = st->a->vector[1];
+    pr_globals[OFS_RETURN + 2] = st->a->vector[2];
+
+    s = PR_LeaveFunction();
+    if (pr_depth == exitdepth)
+        return -1; // all done
+    st = &pr_decoded[s + 1];
+    PR_DISPATCH();
+
+op_state:
+    ed = PROG_TO_EDICT(pr_global_struct->self);
+    ed->v.nextthink = pr_global_struct->time + 0.1f;
+    if (st->a->_float != ed->v.frame) {
+        ed->v.frame = st->a->_float;
+    }
+    ed->v.think = st->b->function;
+    PR_NEXT();
+
+op_bad:
+    pr_xstatement = st - pr_decoded;
+    PR_RunError("Bad opcode %i", pr_statements[pr_xstatement].op);
+    return -1;
+
+#undef PR_NEXT
+#undef PR_DISPATCH
+}
+
+/*
+====================
+PR_DecodeProgram
+
+Builds the pre-decoded copy of pr_statements, called once per PR_LoadProgs
+====================
+*/
+void PR_DecodeProgram(void)
+{
+    dstatement_t *st;
+    prinstr_t *in;
+    int runaway;
+    int i;
+
+    if (!pr_handlers)
+        PR_RunDecoded<false, false>(-1, 0, runaway);
+
+    pr_decoded = Hunk_AllocName(progs->numstatements * sizeof(*pr_decoded), "prdecode");
+
+    for (i = 0; i < progs->numstatements; i++) {
+        st = &pr_statements[i];
+        in = &pr_decoded[i];
+
+        in->op = st->op < PR_NUM_OPS ? st->op : PR_NUM_OPS;
+        in->handler = pr_handlers[in->op];
+        in->a = (eval_t *)&pr_globals[st->a];
+        in->b = (eval_t *)&pr_globals[st->b];
+        in->c = (eval_t *)&pr_globals[st->c];
+
+        if (st->op == OP_IF || st->op == OP_IFNOT)
+            in->arg = i + st->b;
+        else if (st->op == OP_GOTO)
+            in->arg = i + st->a;
+        else if (st->op >= OP_CALL0 && st->op <= OP_CALL8)
+            in->arg = st->op - OP_CALL0;
+    }
+
+#ifdef PR_AOT
+    // the native functions hardcode global offsets, so they only fit the exact progs.dat they were compiled from
+    if (pr_crc == pr_aot_crc && progs->numfunctions == pr_aot_numfunctions &&
+        progs->numstatements == pr_aot_numstatements) {
+        pr_natives = pr_aot_functions;
+        Con_DPrintf("Using natively compiled progs.\n");
+    } else {
+        pr_natives = NULL;
+        Con_DPrintf("Native progs are for crc %i, interpreting progs.dat (crc %i)\n", pr_aot_crc, pr_crc);
+    }
+#endif
+}
+
+/*
+====================
+PR_Execute
+====================
+*/
+static void PR_Execute(func_t fnum, qboolean decoded)
 {
     eval_t *a, *b, *c;
     int s;
@@ -314,6 +688,19 @@ void PR_ExecuteProgram(func_t fnum)
 
     s = PR_EnterFunction(f);
 
+    if (decoded) {
+        // a builtin toggling tracing hands over to the matching variant
+        for (s++; s >= 0;) {
+            if (pr_trace)
+                s = PR_RunDecoded<true, false>(s, exitdepth, runaway);
+            else if (pr_profile.value)
+                s = PR_RunDecoded<false, true>(s, exitdepth, runaway);
+            else
+                s = PR_RunDecoded<false, false>(s, exitdepth, runaway);
+        }
+        return;
+    }
+
     while (1) {
         s++; // next statement
 
@@ -465,11 +852,15 @@ void PR_ExecuteProgram(func_t fnum)
         case OP_STOREP_F:
         case OP_STOREP_ENT:
         case OP_STOREP_FLD: // integers
-        case OP_STOREP_S:
         case OP_STOREP_FNC: // pointers
             ptr = (eval_t *)((byte *)sv.edicts + b->_int);
             ptr->_int = a->_int;
             break;
+        case OP_STOREP_S:
+            ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+            ptr->_int = a->_int;
+            PF_FindStored(b->_int);
+            break;
         case OP_STOREP_V:
             ptr = (eval_t *)((byte *)sv.edicts + b->_int);
             ptr->vector[0] = a->vector[0];
@@ -578,3 +969,159 @@ void PR_ExecuteProgram(func_t fnum)
         }
     }
 }
+
+#ifdef PR_AOT
+/*
+====================
+PR_RunNative
+
+Native functions count the runaway budget down on backwards branches only
+====================
+*/
+static void PR_RunNative(func_t fnum)
+{
+    int runaway;
+
+    // a builtin may run another program, which gets its own budget
+    runaway = pr_aot_runaway;
+    pr_aot_runaway = 100000;
+    pr_trace = false;
+
+    pr_natives[fnum]();
+
+    pr_aot_runaway = runaway;
+}
+
+/*
+====================
+PR_AotCall
+
+Calls made by native code through a function variable
+====================
+*/
+void PR_AotCall(func_t fnum, int argc)
+{
+    dfunction_t *f;
+    int i;
+
+    if (!fnum)
+        PR_RunError("NULL function");
+    if (fnum >= progs->numfunctions)
+        PR_RunError("Bad function number %i", fnum);
+
+    f = &pr_functions[fnum];
+
+    if (f->first_statement < 0) { // negative statements are built in functions
+        i = -f->first_statement;
+        if (i >= pr_numbuiltins)
+            PR_RunError("Bad builtin call number");
+        pr_argc = argc;
+        pr_builtins[i]();
+        return;
+    }
+
+    if (pr_natives[fnum] && pr_native.value)
+        pr_natives[fnum]();
+    else
+        PR_Execute(fnum, pr_decoded && pr_predecode.value);
+}
+#endif
+
+/*
+====================
+PR_ExecuteProgram
+====================
+*/
+void PR_ExecuteProgram(func_t fnum)
+{
+#ifdef PR_AOT
+    if (pr_natives && pr_native.value && fnum > 0 && fnum < progs->numfunctions && pr_natives[fnum]) {
+        PR_RunNative(fnum);
+        return;
+    }
+#endif
+    PR_Execute(fnum, pr_decoded && pr_predecode.value);
+}
+
+/*
+====================
+PR_Benchmark_f
+
+For program optimization, runs a function with both interpreters and the
+native code when the progs were compiled in
+====================
+*/
+void PR_Benchmark_f(void)
+{
+    dfunction_t *f;
+    edict_t *ed;
+    int i, mode, modes;
+    int iterations;
+    int statements;
+    uint32_t start, time[3];
+
+    if (Cmd_Argc() < 2) {
+        Con_Printf("pr_benchmark <function> [iterations]\n");
+        return;
+    }
+    if (!sv.active) {
+        Con_Printf("Not playing a local game.\n");
+        return;
+    }
+    f = ED_FindFunction(Cmd_Argv(1));
+    if (!f || f->first_statement < 0) {
+        Con_Printf("no function %s\n", Cmd_Argv(1));
+        return;
+    }
+    iterations = Cmd_Argc() > 2 ? Q_atoi(Cmd_Argv(2)) : 1000;
+    if (iterations < 1)
+        iterations = 1;
+
+    // run on a scratch entity so the function can't touch the world
+    ed = ED_Alloc();
+
+    // count the statements of a single call, the classic loop always profiles
+    statements = 0;
+    for (i = 0; i < progs->numfunctions; i++)
+        statements -= pr_functions[i].profile;
+    pr_global_struct->self = EDICT_TO_PROG(ed);
+    PR_Execute(f - pr_functions, false);
+    for (i = 0; i < progs->numfunctions; i++)
+        statements += pr_functions[i].profile;
+
+    modes = 2;
+#ifdef PR_AOT
+    if (pr_natives && pr_natives[f - pr_functions])
+        modes = 3;
+#endif
+
+    for (mode = 0; mode < modes; mode++) {
+        start = Sys_CurrentTicks();
+        for (i = 0; i < iterations; i++) {
+            pr_global_struct->self = EDICT_TO_PROG(ed);
+#ifdef PR_AOT
+            if (mode == 2) {
+                PR_RunNative(f - pr_functions);
+                continue;
+            }
+#endif
+            PR_Execute(f - pr_functions, mode && pr_decoded);
+        }
+        time[mode] = Sys_CurrentTicks() - start;
+        if (!time[mode])
+            time[mode] = 1;
+    }
+
+    ED_Free(ed);
+
+    Con_Printf("%i statements per call\n", statements);
+    Con_Printf("classic   : %5u ms, %.1f million statements/s\n", time[0],
+               (double)statements * iterations / time[0] / 1000.0);
+    Con_Printf("predecoded: %5u ms, %.1f million statements/s\n", time[1],
+               (double)statements * iterations / time[1] / 1000.0);
+    if (modes > 2)
+        Con_Printf("native    : %5u ms, %.1f million statements/s\n", time[2],
+                   (double)statements * iterations / time[2] / 1000.0);
+}
+
+CMD_REGISTER("pr_benchmark", PR_Benchmark_f);
@@ -0,0 +1,419 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// prefetch.c -- reading the next level's files ahead
+
+#include "quakedef.h"
+
+#ifdef ENABLE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#define MAX_PREFETCH_MAPS 8
+#define MAX_PREFETCH_FILES (MAX_PREFETCH_MAPS * 2) // a .bsp and a baked file each
+
+#define PREFETCH_CHUNK 65536 // read between looks at pft->cancel
+
+// prefetchfile_t states, the main thread and the prefetch thread each move a
+// queued file on, whichever gets to it first
+#define PF_QUEUED 0
+#define PF_READING 1
+#define PF_READY 2
+#define PF_SKIPPED 3 // missing, unreadable, or loaded before the thread got to it
+
+typedef struct {
+    char name[MAX_QPATH];
+    char source[MAX_OSPATH]; // the pak or loose file it's read from
+    int offset, length;
+    byte const *mapped; // in a mapped pak, which is only read through
+    byte *data; // in the staging area otherwise
+    int state;
+    int hits;
+} prefetchfile_t;
+
+CVAR_REGISTER(prefetch, CVAR_CTOR({ "prefetch", 16384 }));
+
+static prefetchfile_t prefetch_files[MAX_PREFETCH_FILES];
+static int prefetch_numfiles;
+static int prefetch_queued; // bytes of the files, staged or not
+static byte *prefetch_base; // the staging area
+static int prefetch_size, prefetch_used;
+static uint64_t prefetch_readtime; // microseconds the thread took over the files
+static int prefetch_hits; // loads found staged since startup
+
+#ifdef ENABLE_THREADS
+
+typedef struct {
+    std::mutex lock;
+    std::condition_variable wake; // a level's files were queued
+    std::condition_variable done; // a file was read, or the thread went idle
+    uint32_t batch; // bumped by every Prefetch_Level that queues files
+    uint32_t seen; // the batch the thread last woke up for
+    qboolean busy;
+    qboolean cancel;
+} prefetchthread_t;
+
+// never freed, the thread is still waiting on it when the program exits
+static prefetchthread_t *pft;
+
+static volatile byte prefetch_sink; // keeps the reads through mappings
+
+static qboolean Prefetch_Read(prefetchfile_t *f)
+{
+    FILE *file;
+    byte sum;
+    int i, count;
+
+    if (f->mapped) {
+        // one byte a page is enough for the system to read the page in
+        sum = 0;
+        for (i = 0; i < f->length && !__atomic_load_n(&pft->cancel, __ATOMIC_RELAXED); i += 4096)
+            sum += f->mapped[i];
+        prefetch_sink = sum;
+        return i >= f->length;
+    }
+
+    file = fopen(f->source, "rb");
+    if (!file)
+        return false;
+    if (fseek(file, f->offset, SEEK_SET)) {
+        fclose(file);
+        return false;
+    }
+    for (i = 0; i < f->length && !__atomic_load_n(&pft->cancel, __ATOMIC_RELAXED); i += count) {
+        count = f->length - i < PREFETCH_CHUNK ? f->length - i : PREFETCH_CHUNK;
+        if (fread(f->data + i, 1, count, file) != count)
+            break;
+    }
+    fclose(file);
+    return i >= f->length;
+}
+
+static void Prefetch_Thread(void)
+{
+    std::unique_lock<std::mutex> l(pft->lock);
+    prefetchfile_t *f;
+    uint64_t start;
+    qboolean ok;
+    int i, expected;
+
+    while (1) {
+        pft->wake.wait(l, [] { return pft->batch != pft->seen; });
+        pft->seen = pft->batch;
+        pft->busy = true;
+        l.unlock();
+
+        start = Sys_MicroTicks();
+        for (i = 0, f = prefetch_files; i < prefetch_numfiles && !__atomic_load_n(&pft->cancel, __ATOMIC_RELAXED);
+             i++, f++) {
+            expected = PF_QUEUED;
+            if (!__atomic_compare_exchange_n(&f->state, &expected, PF_READING, false, __ATOMIC_ACQ_REL,
+                                             __ATOMIC_ACQUIRE))
+                continue;
+            ok = Prefetch_Read(f);
+
+            l.lock();
+            __atomic_store_n(&f->state, ok ? PF_READY : PF_SKIPPED, __ATOMIC_RELEASE);
+            l.unlock();
+            pft->done.notify_all();
+        }
+
+        l.lock();
+        prefetch_readtime = Sys_MicroTicks() - start;
+        pft->busy = false;
+        pft->done.notify_all();
+    }
+}
+
+/*
+================
+Prefetch_Queue
+
+Queues a file if it's there and fits in what's left of the budget
+================
+*/
+static void Prefetch_Queue(char const *name)
+{
+    prefetchfile_t *f;
+    int length, size;
+
+    if (prefetch_numfiles == MAX_PREFETCH_FILES)
+        return;
+    f = &prefetch_files[prefetch_numfiles];
+
+    length = COM_FileSource(name, f->source, sizeof(f->source), &f->offset, &f->mapped);
+    if (length <= 0 || prefetch_queued + length > prefetch.value * 1024)
+        return;
+    f->data = NULL;
+    if (!f->mapped) {
+        size = (length + 15) & ~15;
+        if (prefetch_used + size > prefetch_size)
+            return;
+        f->data = prefetch_base + prefetch_used;
+        prefetch_used += size;
+    }
+
+    snprintf(f->name, sizeof(f->name), "%s", name);
+    f->length = length;
+    f->state = PF_QUEUED;
+    f->hits = 0;
+    prefetch_queued += length;
+    prefetch_numfiles++;
+}
+
+/*
+================
+Prefetch_Maps
+
+The maps the entities can change level to, other than mapname
+================
+*/
+static int Prefetch_Maps(char const *entities, char const *mapname, char maps[][MAX_QPATH])
+{
+    qboolean ismap;
+    int i, length, nummaps;
+
+    nummaps = 0;
+    while (1) {
+        entities = COM_Parse(entities);
+        if (!entities)
+            break;
+        if (com_token[0] != '{')
+            continue;
+
+        while (1) {
+            entities = COM_Parse(entities);
+            if (!entities || com_token[0] == '}')
+                break;
+            ismap = !Q_strcmp(com_token, "map");
+            entities = COM_Parse(entities);
+            if (!entities)
+                break;
+            length = Q_strlen(com_token);
+            if (!ismap || !length || length >= MAX_QPATH || !Q_strcmp(com_token, mapname))
+                continue;
+
+            for (i = 0; i < nummaps; i++)
+                if (!Q_strcmp(maps[i], com_token))
+                    break;
+            if (i == nummaps && nummaps < MAX_PREFETCH_MAPS)
+                memcpy(maps[nummaps++], com_token, length + 1);
+        }
+        if (!entities)
+            break;
+    }
+
+    return nummaps;
+}
+
+#endif
+
+/*
+================
+Prefetch_Init
+
+-prefetch <kilobytes> sets aside a staging area for files that aren't in a mapped pak.
+With +prefetch 0 on the command line there's neither the area nor the thread,
+the command line's cvars are only set after this otherwise.
+================
+*/
+void Prefetch_Init(void)
+{
+#ifdef ENABLE_THREADS
+    int i;
+
+    i = COM_CheckParm("+prefetch");
+    if (i && i + 1 < com_argc)
+        Cvar_Set("prefetch", com_argv[i + 1]);
+    if (prefetch.value <= 0)
+        return;
+
+    i = COM_CheckParm("-prefetch");
+    if (i && i + 1 < com_argc)
+        prefetch_size = Q_atoi(com_argv[i + 1]) * 1024;
+    if (prefetch_size > 0)
+        prefetch_base = (byte *)Hunk_AllocName(prefetch_size, "prefetch");
+    else
+        prefetch_size = 0;
+
+    pft = new prefetchthread_t();
+    std::thread(Prefetch_Thread).detach();
+#endif
+}
+
+/*
+================
+Prefetch_Flush
+================
+*/
+void Prefetch_Flush(void)
+{
+#ifdef ENABLE_THREADS
+    if (!pft)
+        return;
+
+    {
+        std::unique_lock<std::mutex> l(pft->lock);
+        pft->cancel = true;
+        pft->done.wait(l, [] { return !pft->busy && pft->seen == pft->batch; });
+        pft->cancel = false;
+    }
+
+    prefetch_numfiles = 0;
+    prefetch_queued = 0;
+    prefetch_used = 0;
+#endif
+}
+
+/*
+================
+Prefetch_Drop
+
+After the file was written, so the old contents aren't loaded from the staging area
+================
+*/
+void Prefetch_Drop(char const *path)
+{
+#ifdef ENABLE_THREADS
+    prefetchfile_t *f;
+    int i, expected;
+
+    for (i = 0, f = prefetch_files; i < prefetch_numfiles; i++, f++)
+        if (!Q_strcmp(f->name, path))
+            break;
+    if (i == prefetch_numfiles)
+        return;
+
+    expected = PF_QUEUED;
+    if (__atomic_compare_exchange_n(&f->state, &expected, PF_SKIPPED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return;
+    if (expected == PF_READING) {
+        std::unique_lock<std::mutex> l(pft->lock);
+        pft->done.wait(l, [f] { return __atomic_load_n(&f->state, __ATOMIC_ACQUIRE) != PF_READING; });
+    }
+    __atomic_store_n(&f->state, PF_SKIPPED, __ATOMIC_RELEASE);
+#endif
+}
+
+/*
+================
+Prefetch_Level
+================
+*/
+void Prefetch_Level(char const *entities, char const *mapname)
+{
+#ifdef ENABLE_THREADS
+    char maps[MAX_PREFETCH_MAPS][MAX_QPATH];
+    char name[MAX_QPATH], path[MAX_QPATH];
+    int i, nummaps;
+
+    if (!pft)
+        return;
+    Prefetch_Flush();
+    if (prefetch.value <= 0 || !entities)
+        return;
+
+    PROF_BEGIN("Prefetch_Level");
+
+    nummaps = Prefetch_Maps(entities, mapname, maps);
+
+    // the baked files go first, with them the .bsp is only checked
+    for (i = 0; i < nummaps; i++) {
+        if (snprintf(name, sizeof(name), "maps/%s.bsp", maps[i]) >= sizeof(name))
+            continue;
+        if (Mod_BakedPath(name, path, sizeof(path)))
+            Prefetch_Queue(path);
+    }
+    for (i = 0; i < nummaps; i++) {
+        if (snprintf(name, sizeof(name), "maps/%s.bsp", maps[i]) < sizeof(name))
+            Prefetch_Queue(name);
+    }
+    if (!prefetch_numfiles) {
+        PROF_END();
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> l(pft->lock);
+        pft->batch++;
+    }
+    pft->wake.notify_one();
+    PROF_END();
+#endif
+}
+
+/*
+================
+Prefetch_Find
+================
+*/
+byte const *Prefetch_Find(char const *path, int *length)
+{
+#ifdef ENABLE_THREADS
+    prefetchfile_t *f;
+    int i, expected;
+
+    for (i = 0, f = prefetch_files; i < prefetch_numfiles; i++, f++)
+        if (!Q_strcmp(f->name, path))
+            break;
+    if (i == prefetch_numfiles)
+        return NULL;
+
+    // loading it here is no slower than waiting for the thread to get to it
+    expected = PF_QUEUED;
+    if (__atomic_compare_exchange_n(&f->state, &expected, PF_SKIPPED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return NULL;
+    if (expected == PF_READING) {
+        std::unique_lock<std::mutex> l(pft->lock);
+        pft->done.wait(l, [f] { return __atomic_load_n(&f->state, __ATOMIC_ACQUIRE) != PF_READING; });
+    }
+
+    if (__atomic_load_n(&f->state, __ATOMIC_ACQUIRE) != PF_READY || !f->data)
+        return NULL;
+    f->hits++;
+    prefetch_hits++;
+    *length = f->length;
+    return f->data;
+#else
+    return NULL;
+#endif
+}
+
+/*
+===================
+Prefetch_Stats_f
+===================
+*/
+static void Prefetch_Stats_f(void)
+{
+    static char const *const states[] = { "queued", "reading", "ready", "skipped" };
+    prefetchfile_t *f;
+    int i;
+
+    Con_Printf("%i KiB of files, %i of %i KiB staged, read in %i ms, %i loads found staged so far\n",
+               prefetch_queued / 1024, prefetch_used / 1024, prefetch_size / 1024, (int)(prefetch_readtime / 1000),
+               prefetch_hits);
+    for (i = 0, f = prefetch_files; i < prefetch_numfiles; i++, f++)
+        Con_Printf("%-24s %8i %-6s %-7s %i hits\n", f->name, f->length, f->mapped ? "paged" : "staged",
+                   states[__atomic_load_n(&f->state, __ATOMIC_ACQUIRE)], f->hits);
+}
+
+CMD_REGISTER("prefetch_stats", Prefetch_Stats_f);
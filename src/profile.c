@@ -0,0 +1,256 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// profile.c -- scoped zone profiler
+
+#include "quakedef.h"
+
+#ifdef ENABLE_PROFILER
+
+#define PROF_MAX_EVENTS 65536 // must be a power of two
+#define PROF_MAX_ZONES 64 // only limits the summary
+#define PROF_MAX_DEPTH 32 // deeper scopes aren't recorded
+
+typedef struct {
+    uint64_t start;
+    uint32_t dur;
+    uint32_t tid;
+    profzone_t *zone;
+} profevent_t;
+
+typedef struct {
+    profzone_t *zone;
+    uint64_t start;
+    uint64_t children; // microseconds spent in nested scopes
+} profscope_t;
+
+static profevent_t prof_events[PROF_MAX_EVENTS];
+static uint32_t prof_numevents; // ever recorded, wraps around the ring
+
+static profzone_t *prof_zones;
+static uint32_t prof_numthreads;
+static uint64_t prof_summarytime;
+static int prof_summaryframes;
+
+static thread_local profscope_t prof_stack[PROF_MAX_DEPTH];
+static thread_local int prof_depth; // may be past PROF_MAX_DEPTH
+static thread_local uint32_t prof_tid;
+
+CVAR_REGISTER(prof_show, CVAR_CTOR({ "prof_show", "0" }));
+
+/*
+====================
+Prof_Register
+
+Links a zone into the summary the first time one of its scopes runs
+====================
+*/
+static void Prof_Register(profzone_t *z)
+{
+    if (__atomic_exchange_n(&z->registered, true, __ATOMIC_ACQ_REL))
+        return;
+
+    z->next = __atomic_load_n(&prof_zones, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&prof_zones, &z->next, z, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+}
+
+/*
+====================
+Prof_Begin
+====================
+*/
+void Prof_Begin(profzone_t *z)
+{
+    profscope_t *scope;
+
+    if (!z->registered)
+        Prof_Register(z);
+    if (!prof_tid)
+        prof_tid = __atomic_add_fetch(&prof_numthreads, 1, __ATOMIC_RELAXED);
+
+    if (prof_depth++ >= PROF_MAX_DEPTH)
+        return;
+    scope = &prof_stack[prof_depth - 1];
+    scope->zone = z;
+    scope->children = 0;
+    scope->start = Sys_MicroTicks();
+}
+
+/*
+====================
+Prof_End
+
+Records the innermost scope
+====================
+*/
+void Prof_End(void)
+{
+    profscope_t *scope;
+    profevent_t *ev;
+    uint64_t dur;
+
+    if (prof_depth <= 0)
+        Sys_Error("Prof_End: no scope to end");
+    if (--prof_depth >= PROF_MAX_DEPTH)
+        return;
+    scope = &prof_stack[prof_depth];
+    dur = Sys_MicroTicks() - scope->start;
+    if (prof_depth)
+        prof_stack[prof_depth - 1].children += dur;
+
+    __atomic_add_fetch(&scope->zone->calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&scope->zone->total, dur, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&scope->zone->self, dur - scope->children, __ATOMIC_RELAXED);
+
+    ev = &prof_events[__atomic_fetch_add(&prof_numevents, 1, __ATOMIC_RELAXED) & (PROF_MAX_EVENTS - 1)];
+    ev->start = scope->start;
+    ev->dur = dur;
+    ev->tid = prof_tid;
+    ev->zone = scope->zone;
+}
+
+/*
+====================
+Prof_Unwind
+====================
+*/
+void Prof_Unwind(void)
+{
+    while (prof_depth > 0)
+        Prof_End();
+}
+
+static int Prof_CompareZones(const void *a, const void *b)
+{
+    uint64_t ta = (*(profzone_t *const *)a)->total;
+    uint64_t tb = (*(profzone_t *const *)b)->total;
+
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+/*
+====================
+Prof_EndFrame
+
+Prints the rolling summary every prof_show seconds
+====================
+*/
+void Prof_EndFrame(void)
+{
+    profzone_t *sorted[PROF_MAX_ZONES];
+    profzone_t *z;
+    uint64_t now;
+    float frames;
+    int i, count;
+
+    prof_summaryframes++;
+    now = Sys_MicroTicks();
+    if (prof_show.value > 0 && now - prof_summarytime < prof_show.value * 1000000)
+        return;
+
+    count = 0;
+    for (z = prof_zones; z && count < PROF_MAX_ZONES; z = z->next)
+        if (z->calls)
+            sorted[count++] = z;
+
+    if (prof_show.value > 0 && count) {
+        qsort(sorted, count, sizeof(sorted[0]), Prof_CompareZones);
+        frames = prof_summaryframes;
+        Con_Printf("%i frames, ms per frame:\n", prof_summaryframes);
+        Con_Printf("zone                     calls  total   self\n");
+        for (i = 0; i < count; i++) {
+            z = sorted[i];
+            Con_Printf("%-22s %7.1f %6.2f %6.2f\n", z->name, z->calls / frames, z->total / 1000.0f / frames,
+                       z->self / 1000.0f / frames);
+        }
+    }
+
+    for (z = prof_zones; z; z = z->next) {
+        z->calls = 0;
+        z->total = 0;
+        z->self = 0;
+    }
+    prof_summaryframes = 0;
+    prof_summarytime = now;
+}
+
+/*
+====================
+Prof_Dump_f
+
+profile_dump [filename]
+
+Writes the recorded scopes as Chrome trace events, load them in
+chrome://tracing or ui.perfetto.dev
+====================
+*/
+static void Prof_Dump_f(void)
+{
+    char name[MAX_OSPATH];
+    char const *file;
+    profevent_t *ev;
+    uint32_t first, last, i;
+    uint64_t base;
+    FILE *f;
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("profile_dump [filename] : write the last %i scopes as a Chrome trace\n", PROF_MAX_EVENTS);
+        return;
+    }
+    file = Cmd_Argc() == 2 ? Cmd_Argv(1) : "profile";
+    if (strstr(file, "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+    // with room for the extension
+    if (snprintf(name, sizeof(name), "%s/%s", com_gamedir, file) >= sizeof(name) - 5) {
+        Con_Printf("ERROR: %s is too long.\n", file);
+        return;
+    }
+    COM_DefaultExtension(name, ".json");
+
+    f = fopen(name, "w");
+    if (!f) {
+        Con_Printf("ERROR: couldn't open %s.\n", name);
+        return;
+    }
+
+    last = __atomic_load_n(&prof_numevents, __ATOMIC_ACQUIRE);
+    first = last > PROF_MAX_EVENTS ? last - PROF_MAX_EVENTS : 0;
+    base = UINT64_MAX;
+    for (i = first; i < last; i++)
+        if (prof_events[i & (PROF_MAX_EVENTS - 1)].start < base)
+            base = prof_events[i & (PROF_MAX_EVENTS - 1)].start;
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (i = first; i < last; i++) {
+        ev = &prof_events[i & (PROF_MAX_EVENTS - 1)];
+        fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%u}\n",
+                i == first ? "" : ",", ev->zone->name,
+                (unsigned long long)(ev->start - base), ev->dur, ev->tid);
+    }
+    fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
+    Con_Printf("Wrote %u scopes to %s\n", last - first, name);
+}
+
+CMD_REGISTER("profile_dump", Prof_Dump_f);
+
+#endif
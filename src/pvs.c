@@ -0,0 +1,414 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pvs.c -- decompressed potentially visible sets
+
+#include "quakedef.h"
+
+#define PVS_FATLEAFS 8 // most leafs a remembered fat PVS can be made of
+#define PVS_MAXFATS 8 // fat PVSs remembered
+
+typedef struct {
+    mleaf_t *leaf; // NULL while unused
+    int prev, next; // least recently used order, pvs_newest first
+    int hashnext;
+    uint32_t *bits;
+} pvsrow_t;
+
+typedef struct {
+    int numleafs; // 0 while unused
+    mleaf_t *leafs[PVS_FATLEAFS];
+    unsigned lastused;
+    uint32_t *bits;
+} pvsfat_t;
+
+// the rows, fat PVSs and hash buckets for the current model are carved out of this
+static uint64_t pvs_arena[PVS_CACHE_SIZE / sizeof(uint64_t)];
+
+static uint32_t pvs_novis[MAX_MAP_LEAFS / 32];
+static uint32_t pvs_scratch[MAX_MAP_LEAFS / 32]; // rows when the cache can't hold one
+static uint32_t pvs_fatscratch[MAX_MAP_LEAFS / 32]; // fat PVSs of too many leafs to remember
+
+static model_t *pvs_model; // model the arena is laid out for
+static int pvs_rowwords;
+
+static pvsrow_t *pvs_rows;
+static int pvs_numrows;
+static int pvs_newest, pvs_oldest;
+static int *pvs_hash;
+static int pvs_hashmask;
+
+static pvsfat_t *pvs_fats;
+static int pvs_numfats;
+static unsigned pvs_fatclock;
+
+static mleaf_t *pvs_touched[PVS_FATLEAFS];
+static int pvs_numtouched;
+
+static struct {
+    unsigned hits, misses;
+    unsigned fathits, fatmisses;
+} pvs_stats;
+
+/*
+===================
+PVS_Init
+===================
+*/
+void PVS_Init(void)
+{
+    memset(pvs_novis, 0xff, sizeof(pvs_novis));
+}
+
+/*
+===================
+PVS_Flush
+===================
+*/
+void PVS_Flush(void)
+{
+    pvs_model = NULL;
+}
+
+/*
+===================
+PVS_SetModel
+
+Lays the arena out for rows of the model's size
+===================
+*/
+static void PVS_SetModel(model_t *model)
+{
+    size_t rowbytes, size;
+    byte *p;
+    int i;
+
+    pvs_model = model;
+    pvs_rowwords = (model->numleafs + 31) >> 5;
+    rowbytes = pvs_rowwords * sizeof(uint32_t);
+
+    // up to a quarter of the budget remembers fat PVSs, the rest holds rows
+    pvs_numfats = sizeof(pvs_arena) / 4 / (sizeof(pvsfat_t) + rowbytes);
+    if (pvs_numfats > PVS_MAXFATS)
+        pvs_numfats = PVS_MAXFATS;
+    size = pvs_numfats * (sizeof(pvsfat_t) + rowbytes);
+
+    // every row also takes up to one hash bucket
+    pvs_numrows = (sizeof(pvs_arena) - size) / (sizeof(pvsrow_t) + sizeof(int) + rowbytes);
+    if (pvs_numrows > model->numleafs)
+        pvs_numrows = model->numleafs;
+    for (pvs_hashmask = 1; pvs_hashmask * 2 <= pvs_numrows; pvs_hashmask *= 2)
+        ;
+    pvs_hashmask--;
+
+    // pointers first, the rest is only four byte aligned
+    p = (byte *)pvs_arena;
+    pvs_fats = (pvsfat_t *)p;
+    p += pvs_numfats * sizeof(pvsfat_t);
+    pvs_rows = (pvsrow_t *)p;
+    p += pvs_numrows * sizeof(pvsrow_t);
+    pvs_hash = (int *)p;
+    p += (pvs_hashmask + 1) * sizeof(int);
+
+    for (i = 0; i < pvs_numfats; i++, p += rowbytes) {
+        pvs_fats[i].numleafs = 0;
+        pvs_fats[i].bits = (uint32_t *)p;
+    }
+
+    for (i = 0; i < pvs_numrows; i++, p += rowbytes) {
+        pvs_rows[i].leaf = NULL;
+        pvs_rows[i].prev = i - 1;
+        pvs_rows[i].next = i + 1 < pvs_numrows ? i + 1 : -1;
+        pvs_rows[i].bits = (uint32_t *)p;
+    }
+    pvs_newest = pvs_numrows ? 0 : -1;
+    pvs_oldest = pvs_numrows - 1;
+
+    for (i = 0; i <= pvs_hashmask; i++)
+        pvs_hash[i] = -1;
+}
+
+/*
+===================
+PVS_Decompress
+===================
+*/
+static void PVS_Decompress(byte const *in, uint32_t *bits)
+{
+    byte *out, *end;
+    int c;
+
+    out = (byte *)bits;
+    end = out + ((pvs_model->numleafs + 7) >> 3);
+
+    if (!in) { // no vis info, so make all visible
+        memset(out, 0xff, end - out);
+        out = end;
+    }
+
+    while (out < end) {
+        if (*in) {
+            *out++ = *in++;
+            continue;
+        }
+
+        // a run can't spill into the next row
+        c = in[1];
+        in += 2;
+        if (c > end - out)
+            c = end - out;
+        memset(out, 0, c);
+        out += c;
+    }
+
+    memset(out, 0, (byte *)(bits + pvs_rowwords) - out);
+}
+
+static void PVS_Unlink(int i)
+{
+    pvsrow_t *row = &pvs_rows[i];
+
+    if (row->prev >= 0)
+        pvs_rows[row->prev].next = row->next;
+    else
+        pvs_newest = row->next;
+    if (row->next >= 0)
+        pvs_rows[row->next].prev = row->prev;
+    else
+        pvs_oldest = row->prev;
+}
+
+static void PVS_LinkNewest(int i)
+{
+    pvsrow_t *row = &pvs_rows[i];
+
+    row->prev = -1;
+    row->next = pvs_newest;
+    if (pvs_newest >= 0)
+        pvs_rows[pvs_newest].prev = i;
+    else
+        pvs_oldest = i;
+    pvs_newest = i;
+}
+
+/*
+===================
+Mod_LeafPVS
+===================
+*/
+byte *Mod_LeafPVS(mleaf_t *leaf, model_t *model)
+{
+    pvsrow_t *row;
+    int *bucket, *link;
+    int i;
+
+    if (leaf == model->leafs)
+        return (byte *)pvs_novis;
+    if (model != pvs_model)
+        PVS_SetModel(model);
+
+    if (!pvs_numrows) {
+        PVS_Decompress(leaf->compressed_vis, pvs_scratch);
+        return (byte *)pvs_scratch;
+    }
+
+    bucket = &pvs_hash[(leaf - model->leafs) & pvs_hashmask];
+    for (i = *bucket; i >= 0; i = pvs_rows[i].hashnext) {
+        if (pvs_rows[i].leaf == leaf) {
+            pvs_stats.hits++;
+            if (i != pvs_newest) {
+                PVS_Unlink(i);
+                PVS_LinkNewest(i);
+            }
+            return (byte *)pvs_rows[i].bits;
+        }
+    }
+
+    // reuse the least recently used row
+    pvs_stats.misses++;
+    i = pvs_oldest;
+    row = &pvs_rows[i];
+    if (row->leaf) {
+        link = &pvs_hash[(row->leaf - model->leafs) & pvs_hashmask];
+        while (*link != i)
+            link = &pvs_rows[*link].hashnext;
+        *link = row->hashnext;
+    }
+    row->leaf = leaf;
+    row->hashnext = *bucket;
+    *bucket = i;
+    PVS_Unlink(i);
+    PVS_LinkNewest(i);
+
+    PVS_Decompress(leaf->compressed_vis, row->bits);
+    return (byte *)row->bits;
+}
+
+/*
+===================
+PVS_OrLeaf
+===================
+*/
+static void PVS_OrLeaf(mleaf_t *leaf, uint32_t *fat)
+{
+    uint32_t const *bits;
+    int i;
+
+    bits = (uint32_t const *)Mod_LeafPVS(leaf, pvs_model);
+    for (i = 0; i < pvs_rowwords; i++)
+        fat[i] |= bits[i];
+}
+
+/*
+===================
+PVS_TouchLeafs
+
+Collects the first PVS_FATLEAFS non solid leafs within 8 units of org, and
+counts all of them. As the tree is always walked in the same order, the same
+leafs come out in the same order.
+===================
+*/
+static void PVS_TouchLeafs(vec3_t org, mnode_t *node)
+{
+    mplane_t *plane;
+    float d;
+
+    while (1) {
+        if (node->contents < 0) {
+            if (node->contents != CONTENTS_SOLID) {
+                if (pvs_numtouched < PVS_FATLEAFS)
+                    pvs_touched[pvs_numtouched] = (mleaf_t *)node;
+                pvs_numtouched++;
+            }
+            return;
+        }
+
+        plane = node->plane;
+        d = DotProduct(org, plane->normal) - plane->dist;
+        if (d > 8)
+            node = node->children[0];
+        else if (d < -8)
+            node = node->children[1];
+        else { // go down both
+            PVS_TouchLeafs(org, node->children[0]);
+            node = node->children[1];
+        }
+    }
+}
+
+/*
+===================
+PVS_AddToFat
+
+Same walk as PVS_TouchLeafs, for when too many leafs are touched to collect
+===================
+*/
+static void PVS_AddToFat(vec3_t org, mnode_t *node, uint32_t *fat)
+{
+    mplane_t *plane;
+    float d;
+
+    while (1) {
+        if (node->contents < 0) {
+            if (node->contents != CONTENTS_SOLID)
+                PVS_OrLeaf((mleaf_t *)node, fat);
+            return;
+        }
+
+        plane = node->plane;
+        d = DotProduct(org, plane->normal) - plane->dist;
+        if (d > 8)
+            node = node->children[0];
+        else if (d < -8)
+            node = node->children[1];
+        else {
+            PVS_AddToFat(org, node->children[0], fat);
+            node = node->children[1];
+        }
+    }
+}
+
+/*
+===================
+PVS_FatPVS
+===================
+*/
+byte *PVS_FatPVS(model_t *model, vec3_t org)
+{
+    pvsfat_t *fat, *oldest;
+    int i;
+
+    if (model != pvs_model)
+        PVS_SetModel(model);
+
+    pvs_numtouched = 0;
+    PVS_TouchLeafs(org, model->nodes);
+
+    if (!pvs_numtouched || pvs_numtouched > PVS_FATLEAFS || !pvs_numfats) {
+        memset(pvs_fatscratch, 0, pvs_rowwords * sizeof(uint32_t));
+        if (pvs_numtouched > PVS_FATLEAFS)
+            PVS_AddToFat(org, model->nodes, pvs_fatscratch);
+        else
+            for (i = 0; i < pvs_numtouched; i++)
+                PVS_OrLeaf(pvs_touched[i], pvs_fatscratch);
+        return (byte *)pvs_fatscratch;
+    }
+
+    pvs_fatclock++;
+    oldest = pvs_fats;
+    for (i = 0, fat = pvs_fats; i < pvs_numfats; i++, fat++) {
+        if (fat->numleafs == pvs_numtouched && !memcmp(fat->leafs, pvs_touched, pvs_numtouched * sizeof(mleaf_t *))) {
+            pvs_stats.fathits++;
+            fat->lastused = pvs_fatclock;
+            return (byte *)fat->bits;
+        }
+        if (fat->lastused < oldest->lastused || !fat->numleafs)
+            oldest = fat;
+    }
+
+    pvs_stats.fatmisses++;
+    fat = oldest;
+    fat->numleafs = pvs_numtouched;
+    fat->lastused = pvs_fatclock;
+    memcpy(fat->leafs, pvs_touched, pvs_numtouched * sizeof(mleaf_t *));
+    memset(fat->bits, 0, pvs_rowwords * sizeof(uint32_t));
+    for (i = 0; i < pvs_numtouched; i++)
+        PVS_OrLeaf(pvs_touched[i], fat->bits);
+    return (byte *)fat->bits;
+}
+
+/*
+===================
+PVS_Stats_f
+===================
+*/
+static void PVS_Stats_f(void)
+{
+    if (!pvs_model) {
+        Con_Printf("no PVS rows cached\n");
+        return;
+    }
+
+    Con_Printf("%s: %i rows of %i bytes, %i fat PVSs in %i bytes\n", pvs_model->name, pvs_numrows,
+               pvs_rowwords * (int)sizeof(uint32_t), pvs_numfats, (int)sizeof(pvs_arena));
+    Con_Printf("rows %u hits %u misses, fat PVSs %u hits %u misses\n", pvs_stats.hits, pvs_stats.misses,
+               pvs_stats.fathits, pvs_stats.fatmisses);
+}
+
+CMD_REGISTER("pvs_stats", PVS_Stats_f);
@@ -0,0 +1,389 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// r_lightmap.c -- surface lightmap building shared by the renderers
+
+#include "quakedef.h"
+#include "r_lightmap.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+===============
+R_AddLightMap
+
+blocklights[i] += lightmap[i] * scale, eight texels at a time where there
+are vectors. The products are 32 bits, so the vectors need scale to fit in 16.
+===============
+*/
+static void R_AddLightMap(unsigned *blocklights, byte const *lightmap, unsigned scale, int size)
+{
+    int i;
+
+    i = 0;
+#if defined(__SSE2__)
+    if (scale <= 0xFFFF) {
+        __m128i zero, vscale, samples, lo, hi, bl;
+
+        zero = _mm_setzero_si128();
+        vscale = _mm_set1_epi16(scale);
+        for (; i + 8 <= size; i += 8) {
+            samples = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *)(lightmap + i)), zero);
+            lo = _mm_mullo_epi16(samples, vscale);
+            hi = _mm_mulhi_epu16(samples, vscale);
+
+            bl = _mm_loadu_si128((__m128i const *)(blocklights + i));
+            _mm_storeu_si128((__m128i *)(blocklights + i), _mm_add_epi32(bl, _mm_unpacklo_epi16(lo, hi)));
+            bl = _mm_loadu_si128((__m128i const *)(blocklights + i + 4));
+            _mm_storeu_si128((__m128i *)(blocklights + i + 4), _mm_add_epi32(bl, _mm_unpackhi_epi16(lo, hi)));
+        }
+    }
+#elif defined(__ARM_NEON)
+    if (scale <= 0xFFFF) {
+        uint16x8_t samples;
+
+        for (; i + 8 <= size; i += 8) {
+            samples = vmovl_u8(vld1_u8(lightmap + i));
+            vst1q_u32(blocklights + i, vmlal_n_u16(vld1q_u32(blocklights + i), vget_low_u16(samples), scale));
+            vst1q_u32(blocklights + i + 4, vmlal_n_u16(vld1q_u32(blocklights + i + 4), vget_high_u16(samples), scale));
+        }
+    }
+#endif
+
+    for (; i < size; i++)
+        blocklights[i] += lightmap[i] * scale;
+}
+
+/*
+===============
+R_LightMapStyles
+===============
+*/
+void R_LightMapStyles(msurface_t *surf, int const *lightadj, unsigned base, unsigned *blocklights)
+{
+    int i, size, maps;
+    byte *lightmap;
+
+    size = ((surf->extents[0] >> 4) + 1) * ((surf->extents[1] >> 4) + 1);
+    lightmap = surf->samples;
+
+    for (i = 0; i < size; i++)
+        blocklights[i] = base;
+
+    if (lightmap)
+        for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
+            R_AddLightMap(blocklights, lightmap, lightadj[maps], size);
+            lightmap += size; // skip to next lightmap
+        }
+}
+
+/*
+===============
+R_LightMapDynamic
+
+The distance of a texel from a light is the larger of its distances along s
+and t plus half the smaller. The ones along s are the same for every row, and
+a row that is further along t than the light reaches is skipped.
+===============
+*/
+void R_LightMapDynamic(msurface_t *surf, dlight_t const *dlights, unsigned *blocklights)
+{
+    int lnum;
+    int sd, td;
+    int sdist[LIGHTMAP_MAXSIZE];
+    float dist, rad, minlight;
+    vec3_t impact, local;
+    int s, t;
+    int i;
+    int smax, tmax;
+    unsigned *bl;
+    mtexinfo_t *tex;
+    dlight_t const *dl;
+
+    smax = (surf->extents[0] >> 4) + 1;
+    tmax = (surf->extents[1] >> 4) + 1;
+    tex = surf->texinfo;
+
+    for (lnum = 0; lnum < MAX_DLIGHTS; lnum++) {
+        if (!(surf->dlightbits & (1 << lnum)))
+            continue; // not lit by this light
+
+        dl = &dlights[lnum];
+        rad = dl->radius;
+        dist = DotProduct(dl->origin, surf->plane->normal) - surf->plane->dist;
+        rad -= fabsf(dist);
+        minlight = dl->minlight;
+        if (rad < minlight)
+            continue;
+        minlight = rad - minlight;
+
+        for (i = 0; i < 3; i++) {
+            impact[i] = dl->origin[i] - surf->plane->normal[i] * dist;
+        }
+
+        local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3];
+        local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3];
+
+        local[0] -= surf->texturemins[0];
+        local[1] -= surf->texturemins[1];
+
+        for (s = 0; s < smax; s++) {
+            sd = local[0] - s * 16;
+            sdist[s] = sd < 0 ? -sd : sd;
+        }
+
+        for (t = 0, bl = blocklights; t < tmax; t++, bl += smax) {
+            td = local[1] - t * 16;
+            if (td < 0)
+                td = -td;
+            if (td >= minlight)
+                continue; // no texel of the row is nearer than td
+
+            for (s = 0; s < smax; s++) {
+                sd = sdist[s];
+                if (sd > td)
+                    dist = sd + (td >> 1);
+                else
+                    dist = td + (sd >> 1);
+                if (dist < minlight)
+#ifdef QUAKE2
+                {
+                    unsigned temp;
+                    temp = (rad - dist) * 256;
+                    if (!dl->dark)
+                        bl[s] += temp;
+                    else {
+                        if (bl[s] > temp)
+                            bl[s] -= temp;
+                        else
+                            bl[s] = 0;
+                    }
+                }
+#else
+                    bl[s] += (rad - dist) * 256;
+#endif
+            }
+        }
+    }
+}
+
+//=============================================================================
+
+#define BENCH_PASSES 3
+#define BENCH_DLIGHTS 4 // lighting each surface
+
+/*
+===============
+R_ReferenceLightMap
+
+The styled lightmaps and dynamic lights one texel at a time, the way each
+renderer used to add them
+===============
+*/
+static void R_ReferenceLightMap(msurface_t *surf, int const *lightadj, dlight_t const *dlights, unsigned *blocklights)
+{
+    int lnum, sd, td, s, t, i, smax, tmax, size, maps;
+    float dist, rad, minlight;
+    vec3_t impact, local;
+    mtexinfo_t *tex;
+    byte *lightmap;
+
+    smax = (surf->extents[0] >> 4) + 1;
+    tmax = (surf->extents[1] >> 4) + 1;
+    size = smax * tmax;
+    tex = surf->texinfo;
+    lightmap = surf->samples;
+
+    for (i = 0; i < size; i++)
+        blocklights[i] = 0;
+
+    for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
+        for (i = 0; i < size; i++)
+            blocklights[i] += lightmap[i] * (unsigned)lightadj[maps];
+        lightmap += size;
+    }
+
+    for (lnum = 0; lnum < MAX_DLIGHTS; lnum++) {
+        if (!(surf->dlightbits & (1 << lnum)))
+            continue;
+
+        rad = dlights[lnum].radius;
+        dist = DotProduct(dlights[lnum].origin, surf->plane->normal) - surf->plane->dist;
+        rad -= fabsf(dist);
+        minlight = dlights[lnum].minlight;
+        if (rad < minlight)
+            continue;
+        minlight = rad - minlight;
+
+        for (i = 0; i < 3; i++)
+            impact[i] = dlights[lnum].origin[i] - surf->plane->normal[i] * dist;
+
+        local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
+        local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
+
+        for (t = 0; t < tmax; t++) {
+            td = local[1] - t * 16;
+            if (td < 0)
+                td = -td;
+            for (s = 0; s < smax; s++) {
+                sd = local[0] - s * 16;
+                if (sd < 0)
+                    sd = -sd;
+                if (sd > td)
+                    dist = sd + (td >> 1);
+                else
+                    dist = td + (sd >> 1);
+                if (dist < minlight)
+                    blocklights[t * smax + s] += (rad - dist) * 256;
+            }
+        }
+    }
+}
+
+/*
+===============
+R_BenchRandom
+===============
+*/
+static unsigned R_BenchRandom(unsigned *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+/*
+===============
+R_LightMapBenchmark_f
+
+r_lightmapbenchmark [surfaces]
+
+Lights random surfaces with the shared kernels and the texel at a time
+reference, and checks they come out the same
+===============
+*/
+static void R_LightMapBenchmark_f(void)
+{
+    msurface_t *surfs, *surf;
+    mplane_t plane;
+    mtexinfo_t texinfo;
+    dlight_t dlights[MAX_DLIGHTS];
+    int *lightadj;
+    unsigned *blocklights, *reference;
+    byte *samples;
+    int numsurfs, i, j, k, pass, size, maps, mismatches;
+    unsigned seed;
+    uint64_t start, elapsed, best[2];
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("r_lightmapbenchmark [surfaces]\n");
+        return;
+    }
+    numsurfs = Cmd_Argc() == 2 ? Q_atoi(Cmd_Argv(1)) : 1000;
+    if (numsurfs < 1)
+        numsurfs = 1;
+
+    surfs = (msurface_t *)Hunk_TempAlloc(numsurfs * (sizeof(msurface_t) + MAXLIGHTMAPS * sizeof(int)) +
+                                         2 * LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE * sizeof(unsigned) +
+                                         numsurfs * MAXLIGHTMAPS * LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE);
+    lightadj = (int *)(surfs + numsurfs);
+    blocklights = (unsigned *)(lightadj + numsurfs * MAXLIGHTMAPS);
+    reference = blocklights + LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE;
+    samples = (byte *)(reference + LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE);
+
+    // all of the surfaces lie on the z = 0 plane, texel for unit
+    memset(&plane, 0, sizeof(plane));
+    plane.normal[2] = 1;
+    memset(&texinfo, 0, sizeof(texinfo));
+    texinfo.vecs[0][0] = 1;
+    texinfo.vecs[1][1] = 1;
+
+    seed = 1;
+    for (i = 0; i < MAX_DLIGHTS; i++) {
+        memset(&dlights[i], 0, sizeof(dlights[i]));
+        dlights[i].origin[0] = (int)(R_BenchRandom(&seed) % 512) - 256;
+        dlights[i].origin[1] = (int)(R_BenchRandom(&seed) % 512) - 256;
+        dlights[i].origin[2] = (int)(R_BenchRandom(&seed) % 128) - 64;
+        dlights[i].radius = 100 + R_BenchRandom(&seed) % 250;
+        dlights[i].minlight = R_BenchRandom(&seed) % 32;
+    }
+
+    for (i = 0, surf = surfs; i < numsurfs; i++, surf++) {
+        memset(surf, 0, sizeof(*surf));
+        surf->plane = &plane;
+        surf->texinfo = &texinfo;
+        surf->extents[0] = (R_BenchRandom(&seed) % LIGHTMAP_MAXSIZE) * 16;
+        surf->extents[1] = (R_BenchRandom(&seed) % LIGHTMAP_MAXSIZE) * 16;
+        surf->texturemins[0] = (int)(R_BenchRandom(&seed) % 32) * 16 - 256;
+        surf->texturemins[1] = (int)(R_BenchRandom(&seed) % 32) * 16 - 256;
+        surf->samples = samples + i * MAXLIGHTMAPS * LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE;
+
+        maps = 1 + R_BenchRandom(&seed) % MAXLIGHTMAPS;
+        for (j = 0; j < MAXLIGHTMAPS; j++) {
+            surf->styles[j] = j < maps ? j : 255;
+            lightadj[i * MAXLIGHTMAPS + j] = R_BenchRandom(&seed) % 551; // 'a' to 'z'
+        }
+        size = ((surf->extents[0] >> 4) + 1) * ((surf->extents[1] >> 4) + 1);
+        for (j = 0; j < maps * size; j++)
+            surf->samples[j] = R_BenchRandom(&seed);
+
+        for (j = 0; j < BENCH_DLIGHTS; j++)
+            surf->dlightbits |= 1 << (R_BenchRandom(&seed) % MAX_DLIGHTS);
+    }
+
+    // the best of a few passes over all of the surfaces, the first one also
+    // warms up the caches
+    for (k = 0; k < 2; k++) {
+        best[k] = UINT64_MAX;
+        for (pass = 0; pass < BENCH_PASSES; pass++) {
+            start = Sys_MicroTicks();
+            for (i = 0, surf = surfs; i < numsurfs; i++, surf++) {
+                if (k) {
+                    R_LightMapStyles(surf, lightadj + i * MAXLIGHTMAPS, 0, blocklights);
+                    R_LightMapDynamic(surf, dlights, blocklights);
+                } else
+                    R_ReferenceLightMap(surf, lightadj + i * MAXLIGHTMAPS, dlights, reference);
+            }
+            elapsed = Sys_MicroTicks() - start;
+            if (elapsed < best[k])
+                best[k] = elapsed;
+        }
+    }
+
+    mismatches = 0;
+    for (i = 0, surf = surfs; i < numsurfs; i++, surf++) {
+        R_LightMapStyles(surf, lightadj + i * MAXLIGHTMAPS, 0, blocklights);
+        R_LightMapDynamic(surf, dlights, blocklights);
+        R_ReferenceLightMap(surf, lightadj + i * MAXLIGHTMAPS, dlights, reference);
+        size = ((surf->extents[0] >> 4) + 1) * ((surf->extents[1] >> 4) + 1);
+        if (memcmp(blocklights, reference, size * sizeof(unsigned)))
+            mismatches++;
+    }
+
+    Con_Printf("%i surfaces, best of %i ms:\n", numsurfs, BENCH_PASSES);
+    Con_Printf("reference %8.2f\n", best[0] / 1000.0);
+    Con_Printf("shared    %8.2f\n", best[1] / 1000.0);
+    if (mismatches)
+        Con_Printf("%i surfaces don't match the reference\n", mismatches);
+}
+
+CMD_REGISTER("r_lightmapbenchmark", R_LightMapBenchmark_f);
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // r_surf.c: surface-related refresh code
 
 #include "quakedef.h"
+#include "r_lightmap.h"
 
 int skytexturenum;
 
@@ -31,7 +32,7 @@ int lightmap_bytes; // 1, 2, or 4
 
 int lightmap_textures;
 
-unsigned blocklights[18 * 18];
+unsigned blocklights[LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE];
 
 #define BLOCK_WIDTH 128
 #define BLOCK_HEIGHT 128
@@ -59,66 +60,27 @@ msurface_t *waterchain = NULL;
 
 void R_RenderDynamicLightmaps(msurface_t *fa);
 
-/*
-===============
-R_AddDynamicLights
-===============
-*/
-void R_AddDynamicLights(msurface_t *surf)
-{
-    int lnum;
-    int sd, td;
-    float dist, rad, minlight;
-    vec3_t impact, local;
-    int s, t;
-    int i;
-    int smax, tmax;
-    mtexinfo_t *tex;
-
-    smax = (surf->extents[0] >> 4) + 1;
-    tmax = (surf->extents[1] >> 4) + 1;
-    tex = surf->texinfo;
-
-    for (lnum = 0; lnum < MAX_DLIGHTS; lnum++) {
-        if (!(surf->dlightbits & (1 << lnum)))
-            continue; // not lit by this light
-
-        rad = cl_dlights[lnum].radius;
-        dist = DotProduct(cl_dlights[lnum].origin, surf->plane->normal) - surf->plane->dist;
-        rad -= fabsf(dist);
-        minlight = cl_dlights[lnum].minlight;
-        if (rad < minlight)
-            continue;
-        minlight = rad - minlight;
+// the lightmap blocks, one byte per texel. The texture is blended in darkened
+// by it, so it's the light inverted
+struct lightluminance_t {
+    typedef byte texel_t;
+    enum { step = 1 };
 
-        for (i = 0; i < 3; i++) {
-            impact[i] = cl_dlights[lnum].origin[i] - surf->plane->normal[i] * dist;
-        }
+    static byte Store(unsigned light)
+    {
+        int t;
 
-        local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3];
-        local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3];
-
-        local[0] -= surf->texturemins[0];
-        local[1] -= surf->texturemins[1];
-
-        for (t = 0; t < tmax; t++) {
-            td = local[1] - t * 16;
-            if (td < 0)
-                td = -td;
-            for (s = 0; s < smax; s++) {
-                sd = local[0] - s * 16;
-                if (sd < 0)
-                    sd = -sd;
-                if (sd > td)
-                    dist = sd + (td >> 1);
-                else
-                    dist = td + (sd >> 1);
-                if (dist < minlight)
-                    blocklights[t * smax + s] += (rad - dist) * 256;
-            }
-        }
+        t = light >> 7;
+        if (t > 255)
+            t = 255;
+        return 255 - t;
     }
-}
+};
+
+// the alpha of RGBA lightmap blocks, dest points at the first texel's
+struct lightalpha_t : lightluminance_t {
+    enum { step = 4 };
+};
 
 /*
 ===============
@@ -130,19 +92,14 @@ Combine and scale multiple lightmaps into the 8.8 format in blocklights
 void R_BuildLightMap(msurface_t *surf, byte *dest, int stride)
 {
     int smax, tmax;
-    int t;
-    int i, j, size;
-    byte *lightmap;
-    unsigned scale;
+    int i, size;
     int maps;
-    unsigned *bl;
 
     surf->cached_dlight = (surf->dlightframe == r_framecount);
 
     smax = (surf->extents[0] >> 4) + 1;
     tmax = (surf->extents[1] >> 4) + 1;
     size = smax * tmax;
-    lightmap = surf->samples;
 
     // set to full bright if no light data
     if (r_fullbright.value || !cl.worldmodel->lightdata) {
@@ -151,54 +108,26 @@ void R_BuildLightMap(msurface_t *surf, byte *dest, int stride)
         goto store;
     }
 
-    // clear to no light
-    for (i = 0; i < size; i++)
-        blocklights[i] = 0;
-
     // add all the lightmaps
-    if (lightmap)
-        for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
-            scale = d_lightstylevalue[surf->styles[maps]];
-            surf->cached_light[maps] = scale; // 8.8 fraction
-            for (i = 0; i < size; i++)
-                blocklights[i] += lightmap[i] * scale;
-            lightmap += size; // skip to next lightmap
-        }
+    if (surf->samples)
+        for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++)
+            surf->cached_light[maps] = d_lightstylevalue[surf->styles[maps]]; // 8.8 fraction
+    R_LightMapStyles(surf, surf->cached_light, 0, blocklights);
 
     // add all the dynamic lights
     if (surf->dlightframe == r_framecount)
-        R_AddDynamicLights(surf);
+        R_LightMapDynamic(surf, cl_dlights, blocklights);
 
 // bound, invert, and shift
 store:
     switch (gl_lightmap_format) {
     case GL_RGBA:
-        stride -= (smax << 2);
-        bl = blocklights;
-        for (i = 0; i < tmax; i++, dest += stride) {
-            for (j = 0; j < smax; j++) {
-                t = *bl++;
-                t >>= 7;
-                if (t > 255)
-                    t = 255;
-                dest[3] = 255 - t;
-                dest += 4;
-            }
-        }
+        R_StoreLightMap<lightalpha_t>(blocklights, smax, tmax, dest + 3, stride);
         break;
     case GL_ALPHA:
     case GL_LUMINANCE:
     case GL_INTENSITY:
-        bl = blocklights;
-        for (i = 0; i < tmax; i++, dest += stride) {
-            for (j = 0; j < smax; j++) {
-                t = *bl++;
-                t >>= 7;
-                if (t > 255)
-                    t = 255;
-                dest[j] = 255 - t;
-            }
-        }
+        R_StoreLightMap<lightluminance_t>(blocklights, smax, tmax, dest, stride);
         break;
     default:
         Sys_Error("Bad lightmap format");
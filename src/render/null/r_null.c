@@ -0,0 +1,75 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// r_null.c -- renderer stubs for headless dedicated server builds
+
+#include "quakedef.h"
+#include "r_local.h"
+
+viddef_t vid;
+
+qboolean scr_disabled_for_loading;
+int32_t scr_centertime_off;
+
+int r_pixbytes = 1;
+unsigned short d_8to16table[256];
+
+texture_t *r_notexture_mip;
+
+/*
+==================
+R_InitTextures
+
+The model loader substitutes this for missing textures, the server never
+draws it so no mip data is allocated
+==================
+*/
+void R_InitTextures(void)
+{
+    r_notexture_mip = Hunk_AllocName(sizeof(texture_t), "notexture");
+    r_notexture_mip->width = r_notexture_mip->height = 16;
+}
+
+void R_InitSky(texture_t *)
+{
+}
+
+void D_FlushCaches(void)
+{
+}
+
+void SCR_BeginLoadingPlaque(void)
+{
+}
+
+void SCR_EndLoadingPlaque(void)
+{
+}
+
+void SCR_UpdateScreen(void)
+{
+}
+
+void Draw_BeginDisc(void)
+{
+}
+
+void Draw_EndDisc(void)
+{
+}
@@ -31,8 +31,8 @@ void Mod_LoadSpriteModel(model_t *mod, void *buffer);
 void Mod_LoadBrushModel(model_t *mod, void *buffer);
 void Mod_LoadAliasModel(model_t *mod, void *buffer);
 model_t *Mod_LoadModel(model_t *mod, qboolean crash);
-
-byte mod_novis[MAX_MAP_LEAFS / 8];
+static void Mod_UploadTexture(texture_t *tx);
+static qboolean Mod_LoadBakedBrushModel(model_t *mod);
 
 model_t mod_known[MAX_MOD_KNOWN];
 int mod_numknown;
@@ -46,7 +46,7 @@ Mod_Init
 */
 void Mod_Init(void)
 {
-    memset(mod_novis, 0xff, sizeof(mod_novis));
+    PVS_Init();
 }
 
 /*
@@ -100,57 +100,6 @@ mleaf_t *Mod_PointInLeaf(vec3_t p, model_t *model)
     return NULL; // never reached
 }
 
-/*
-===================
-Mod_DecompressVis
-===================
-*/
-byte *Mod_DecompressVis(byte *in, model_t *model)
-{
-    static byte decompressed[MAX_MAP_LEAFS / 8];
-    int c;
-    byte *out;
-    int row;
-
-    row = (model->numleafs + 7) >> 3;
-    out = decompressed;
-
-#if 0
-	memcpy (out, in, row);
-#else
-    if (!in) { // no vis info, so make all visible
-        while (row) {
-            *out++ = 0xff;
-            row--;
-        }
-        return decompressed;
-    }
-
-    do {
-        if (*in) {
-            *out++ = *in++;
-            continue;
-        }
-
-        c = in[1];
-        in += 2;
-        while (c) {
-            *out++ = 0;
-            c--;
-        }
-    } while (out - decompressed < row);
-#endif
-
-    return decompressed;
-}
-
-byte *Mod_LeafPVS(mleaf_t *leaf, model_t *model)
-{
-    if (leaf == model->leafs)
-        return mod_novis;
-    return Mod_DecompressVis(leaf->compressed_vis, model);
-}
-
 /*
 ===================
 Mod_ClearAll
@@ -225,6 +174,7 @@ Loads a model into the cache
 */
 model_t *Mod_LoadModel(model_t *mod, qboolean crash)
 {
+    hunksubsystem_t prev;
     void *d;
     unsigned *buf;
     byte stackbuf[1024]; // avoid dirtying the cache heap
@@ -238,11 +188,17 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
             return mod; // not cached at all
     }
 
+    PROF_BEGIN("Mod_LoadModel");
+
     //
     // because the world is so huge, load it one piece at a time
     //
     if (!crash) {
     }
+    if (Mod_LoadBakedBrushModel(mod)) {
+        PROF_END();
+        return mod;
+    }
 
     //
     // load the file
@@ -251,6 +207,7 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
     if (!buf) {
         if (crash)
             Sys_Error("Mod_NumForName: %s not found", mod->name);
+        PROF_END();
         return NULL;
     }
 
@@ -267,6 +224,7 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
 
     // call the apropriate loader
     mod->needload = false;
+    prev = Hunk_Subsystem(hs_model);
 
     switch (LittleLong(*(unsigned *)buf)) {
     case IDPOLYHEADER:
@@ -282,6 +240,8 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
         break;
     }
 
+    Hunk_Subsystem(prev);
+    PROF_END();
     return mod;
 }
 
@@ -311,6 +271,24 @@ model_t *Mod_ForName(char *name, qboolean crash)
 
 byte *mod_base;
 
+/*
+=================
+Mod_UploadTexture
+
+Hands a texture's pixels to the renderer, again when it comes from a baked model
+=================
+*/
+static void Mod_UploadTexture(texture_t *tx)
+{
+    if (!Q_strncmp(tx->name, "sky", 3))
+        R_InitSky(tx);
+    else {
+        // texture_mode = GL_LINEAR_MIPMAP_NEAREST; //_LINEAR;
+        tx->gl_texturenum = GL_LoadTexture(tx->name, tx->width, tx->height, (byte *)(tx + 1), true, false);
+        // texture_mode = GL_LINEAR;
+    }
+}
+
 /*
 =================
 Mod_LoadTextures
@@ -360,13 +338,7 @@ void Mod_LoadTextures(lump_t *l)
         // the pixels immediately follow the structures
         memcpy(tx + 1, mt + 1, pixels);
 
-        if (!Q_strncmp(mt->name, "sky", 3))
-            R_InitSky(tx);
-        else {
-            // texture_mode = GL_LINEAR_MIPMAP_NEAREST; //_LINEAR;
-            tx->gl_texturenum = GL_LoadTexture(mt->name, tx->width, tx->height, (byte *)(tx + 1), true, false);
-            // texture_mode = GL_LINEAR;
-        }
+        Mod_UploadTexture(tx);
     }
 
     //
@@ -1076,6 +1048,8 @@ void Mod_LoadBrushModel(model_t *mod, void *buffer)
     dheader_t *header;
     dmodel_t *bm;
 
+    PROF_BEGIN("Mod_LoadBrushModel");
+
     loadmodel->type = mod_brush;
 
     header = (dheader_t *)buffer;
@@ -1095,8 +1069,11 @@ void Mod_LoadBrushModel(model_t *mod, void *buffer)
     Mod_LoadVertexes(&header->lumps[LUMP_VERTEXES]);
     Mod_LoadEdges(&header->lumps[LUMP_EDGES]);
     Mod_LoadSurfedges(&header->lumps[LUMP_SURFEDGES]);
+    Hunk_Subsystem(hs_texture);
     Mod_LoadTextures(&header->lumps[LUMP_TEXTURES]);
+    Hunk_Subsystem(hs_lightmap);
     Mod_LoadLighting(&header->lumps[LUMP_LIGHTING]);
+    Hunk_Subsystem(hs_model);
     Mod_LoadPlanes(&header->lumps[LUMP_PLANES]);
     Mod_LoadTexinfo(&header->lumps[LUMP_TEXINFO]);
     Mod_LoadFaces(&header->lumps[LUMP_FACES]);
@@ -1147,6 +1124,161 @@ void Mod_LoadBrushModel(model_t *mod, void *buffer)
             mod = loadmodel;
         }
     }
+    PROF_END();
+}
+
+/*
+===============================================================================
+
+					BAKED BRUSH MODELS
+
+===============================================================================
+*/
+
+static int const mod_bakesizes[] = {
+    sizeof(mplane_t), sizeof(texture_t), sizeof(medge_t), sizeof(mtexinfo_t), sizeof(glpoly_t), sizeof(msurface_t),
+    sizeof(mnode_t), sizeof(mleaf_t), sizeof(hull_t), sizeof(dmodel_t), sizeof(dclipnode_t),
+};
+
+static void *const mod_bakeexternals[] = { &r_notexture_mip };
+
+bakeformat_t const mod_bakeformat = {
+    ".bps", mod_bakesizes, sizeof(mod_bakesizes) / sizeof(mod_bakesizes[0]),
+    mod_bakeexternals, sizeof(mod_bakeexternals) / sizeof(mod_bakeexternals[0]),
+};
+
+/*
+=================
+Mod_BakeModel
+
+Every pointer Mod_LoadBrushModel sets up, the rest are NULL until drawn
+=================
+*/
+void Mod_BakeModel(model_t *mod, int mark)
+{
+    model_t *models[MAX_MAP_MODELS];
+    texture_t *tx;
+    glpoly_t *poly;
+    mnode_t *node;
+    mleaf_t *leaf;
+    char name[10];
+    int i, j, numleafs;
+
+    if (mod->numsubmodels < 1 || mod->numsubmodels > MAX_MAP_MODELS) {
+        Con_Printf("%s has %i submodels\n", mod->name, mod->numsubmodels);
+        return;
+    }
+    models[0] = mod;
+    for (i = 1; i < mod->numsubmodels; i++) {
+        snprintf(name, sizeof(name), "*%i", i);
+        models[i] = Mod_FindName(name);
+    }
+
+    Mod_BakeBegin(&mod_bakeformat, mark, models, mod->numsubmodels);
+
+    for (i = 0; i < mod->numsubmodels; i++) {
+        Mod_BakePointer(&models[i]->submodels);
+        Mod_BakePointer(&models[i]->planes);
+        Mod_BakePointer(&models[i]->leafs);
+        Mod_BakePointer(&models[i]->vertexes);
+        Mod_BakePointer(&models[i]->edges);
+        Mod_BakePointer(&models[i]->nodes);
+        Mod_BakePointer(&models[i]->texinfo);
+        Mod_BakePointer(&models[i]->surfaces);
+        Mod_BakePointer(&models[i]->surfedges);
+        Mod_BakePointer(&models[i]->clipnodes);
+        Mod_BakePointer(&models[i]->marksurfaces);
+        for (j = 0; j < MAX_MAP_HULLS; j++) {
+            Mod_BakePointer(&models[i]->hulls[j].clipnodes);
+            Mod_BakePointer(&models[i]->hulls[j].planes);
+        }
+        Mod_BakePointer(&models[i]->textures);
+        Mod_BakePointer(&models[i]->visdata);
+        Mod_BakePointer(&models[i]->lightdata);
+        Mod_BakePointer(&models[i]->entities);
+    }
+
+    for (i = 0; i < mod->numtextures; i++) {
+        Mod_BakePointer(&mod->textures[i]);
+        tx = mod->textures[i];
+        if (tx) {
+            Mod_BakePointer(&tx->anim_next);
+            Mod_BakePointer(&tx->alternate_anims);
+        }
+    }
+    for (i = 0; i < mod->numtexinfo; i++)
+        Mod_BakePointer(&mod->texinfo[i].texture);
+    for (i = 0; i < mod->numsurfaces; i++) {
+        Mod_BakePointer(&mod->surfaces[i].plane);
+        Mod_BakePointer(&mod->surfaces[i].texinfo);
+        Mod_BakePointer(&mod->surfaces[i].samples);
+        // the warped surfaces are already cut up
+        for (poly = mod->surfaces[i].polys; poly; poly = poly->next) {
+            Mod_BakePointer(&poly->chain);
+            Mod_BakePointer(&poly->next);
+        }
+        Mod_BakePointer(&mod->surfaces[i].polys);
+    }
+    for (i = 0; i < mod->nummarksurfaces; i++)
+        Mod_BakePointer(&mod->marksurfaces[i]);
+
+    // numleafs only counts the world's, the submodels' leafs come after them
+    numleafs = 1;
+    for (i = 0, node = mod->nodes; i < mod->numnodes; i++, node++) {
+        Mod_BakePointer(&node->parent);
+        Mod_BakePointer(&node->plane);
+        for (j = 0; j < 2; j++) {
+            Mod_BakePointer(&node->children[j]);
+            leaf = (mleaf_t *)node->children[j];
+            if (leaf->contents < 0 && leaf - mod->leafs >= numleafs)
+                numleafs = leaf - mod->leafs + 1;
+        }
+    }
+    for (i = 0, leaf = mod->leafs; i < numleafs; i++, leaf++) {
+        Mod_BakePointer(&leaf->parent);
+        Mod_BakePointer(&leaf->compressed_vis);
+        Mod_BakePointer(&leaf->firstmarksurface);
+    }
+
+    Mod_BakeEnd(mod->name);
+}
+
+/*
+=================
+Mod_LoadBakedBrushModel
+=================
+*/
+static qboolean Mod_LoadBakedBrushModel(model_t *mod)
+{
+    model_t const *models;
+    model_t *out;
+    char name[MAX_QPATH];
+    hunksubsystem_t prev;
+    int i, nummodels;
+
+    prev = Hunk_Subsystem(hs_model);
+    nummodels = Mod_LoadBaked(&mod_bakeformat, mod->name, &models);
+    Hunk_Subsystem(prev);
+    if (!nummodels)
+        return false;
+
+    Q_strcpy(name, mod->name);
+    for (i = 0, out = mod; i < nummodels; i++) {
+        if (i) {
+            snprintf(name, sizeof(name), "*%i", i);
+            out = Mod_FindName(name);
+        }
+        *out = models[i];
+        Q_strcpy(out->name, name);
+        out->needload = false;
+    }
+
+    // the textures live with the renderer, not in the model
+    for (i = 0; i < mod->numtextures; i++)
+        if (mod->textures[i])
+            Mod_UploadTexture(mod->textures[i]);
+
+    return true;
 }
 
 /*
@@ -1415,6 +1547,8 @@ void Mod_LoadAliasModel(model_t *mod, void *buffer)
     daliasskintype_t *pskintype;
     int start, end, total;
 
+    PROF_BEGIN("Mod_LoadAliasModel");
+
     start = Hunk_LowMark();
 
     pinmodel = (mdl_t *)buffer;
@@ -1539,11 +1673,14 @@ void Mod_LoadAliasModel(model_t *mod, void *buffer)
     total = end - start;
 
     Cache_Alloc(&mod->cache, total, loadname);
-    if (!mod->cache.data)
+    if (!mod->cache.data) {
+        PROF_END();
         return;
+    }
     memcpy(mod->cache.data, pheader, total);
 
     Hunk_FreeToLowMark(start);
+    PROF_END();
 }
 
 //=============================================================================
@@ -1654,6 +1791,8 @@ void Mod_LoadSpriteModel(model_t *mod, void *buffer)
     int size;
     dspriteframetype_t *pframetype;
 
+    PROF_BEGIN("Mod_LoadSpriteModel");
+
     pin = (dsprite_t *)buffer;
 
     version = LittleLong(pin->version);
@@ -1706,6 +1845,7 @@ void Mod_LoadSpriteModel(model_t *mod, void *buffer)
     }
 
     mod->type = mod_sprite;
+    PROF_END();
 }
 
 //=============================================================================
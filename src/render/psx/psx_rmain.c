@@ -51,9 +51,9 @@ mplane_t *mirror_plane;
 //
 // view origin
 //
-vec3_t vup;
-vec3_t vpn;
-vec3_t vright;
+THREAD_LOCAL vec3_t vup;
+THREAD_LOCAL vec3_t vpn;
+THREAD_LOCAL vec3_t vright;
 vec3_t r_origin;
 
 float r_world_matrix[16];
@@ -1013,6 +1013,8 @@ void R_RenderView(void)
     if (r_norefresh.value)
         return;
 
+    PROF_BEGIN("R_RenderView");
+
     if (!r_worldentity.model || !cl.worldmodel)
         Sys_Error("R_RenderView: NULL worldmodel");
 
@@ -1057,4 +1059,5 @@ void R_RenderView(void)
         //		glFinish ();
         Con_Printf("%3i ms  %4i wpoly %4i epoly\n", Sys_CurrentTicks() - time1, c_brush_polys, c_alias_polys);
     }
+    PROF_END();
 }
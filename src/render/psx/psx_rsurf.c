@@ -27,8 +27,6 @@ int skytexturenum;
 #define GL_RGBA4 0
 #endif
 
-unsigned blocklights[18 * 18];
-
 typedef struct glRect_s {
     unsigned char l, t, w, h;
 } glRect_t;
@@ -37,67 +35,6 @@ typedef struct glRect_s {
 msurface_t *skychain = NULL;
 msurface_t *waterchain = NULL;
 
-/*
-===============
-R_AddDynamicLights
-===============
-*/
-void R_AddDynamicLights(msurface_t *surf)
-{
-    int lnum;
-    int sd, td;
-    float dist, rad, minlight;
-    vec3_t impact, local;
-    int s, t;
-    int i;
-    int smax, tmax;
-    mtexinfo_t *tex;
-
-    smax = (surf->extents[0] >> 4) + 1;
-    tmax = (surf->extents[1] >> 4) + 1;
-    tex = surf->texinfo;
-
-    for (lnum = 0; lnum < MAX_DLIGHTS; lnum++) {
-        if (!(surf->dlightbits & (1 << lnum)))
-            continue; // not lit by this light
-
-        rad = cl_dlights[lnum].radius;
-        dist = DotProduct(cl_dlights[lnum].origin, surf->plane->normal) - surf->plane->dist;
-        rad -= fabsf(dist);
-        minlight = cl_dlights[lnum].minlight;
-        if (rad < minlight)
-            continue;
-        minlight = rad - minlight;
-
-        for (i = 0; i < 3; i++) {
-            impact[i] = cl_dlights[lnum].origin[i] - surf->plane->normal[i] * dist;
-        }
-
-        local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3];
-        local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3];
-
-        local[0] -= surf->texturemins[0];
-        local[1] -= surf->texturemins[1];
-
-        for (t = 0; t < tmax; t++) {
-            td = local[1] - t * 16;
-            if (td < 0)
-                td = -td;
-            for (s = 0; s < smax; s++) {
-                sd = local[0] - s * 16;
-                if (sd < 0)
-                    sd = -sd;
-                if (sd > td)
-                    dist = sd + (td >> 1);
-                else
-                    dist = td + (sd >> 1);
-                if (dist < minlight)
-                    blocklights[t * smax + s] += (rad - dist) * 256;
-            }
-        }
-    }
-}
-
 /*
 ===============
 R_TextureAnimation
@@ -22,18 +22,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "d_local.h"
 
-static int miplevel;
+static THREAD_LOCAL int miplevel;
 
 float scale_for_mip;
 int screenwidth;
-int ubasestep, errorterm, erroradjustup, erroradjustdown;
+THREAD_LOCAL int ubasestep, errorterm, erroradjustup, erroradjustdown;
 int vstartscan;
 
 // FIXME: should go away
 extern void R_RotateBmodel(void);
 extern void R_TransformFrustum(void);
 
-vec3_t transformed_modelorg;
+THREAD_LOCAL vec3_t transformed_modelorg;
 
 /*
 ==============
@@ -153,10 +153,13 @@ void D_CalcGradients(msurface_t *pface)
 
 /*
 ==============
-D_DrawSurfaces
+D_DrawSurfaceList
+
+caches holds the surface cache of every surface, indexed like surfaces[],
+or is NULL to build them here
 ==============
 */
-void D_DrawSurfaces(void)
+static void D_DrawSurfaceList(surfcache_t **caches)
 {
     surf_t *s;
     msurface_t *pface;
@@ -179,14 +182,15 @@ void D_DrawSurfaces(void)
             d_ziorigin = s->d_ziorigin;
 
             D_DrawSolidSurface(s, (int)s->data & 0xFF);
-            D_DrawZSpans(s->spans);
+            (*d_drawzspans)(s->spans);
         }
     } else {
         for (s = &surfaces[1]; s < surface_p; s++) {
             if (!s->spans)
                 continue;
 
-            r_drawnpolycount++;
+            if (!caches)
+                r_drawnpolycount++;
 
             d_zistepu = s->d_zistepu;
             d_zistepv = s->d_zistepv;
@@ -197,8 +201,8 @@ void D_DrawSurfaces(void)
                     R_MakeSky();
                 }
 
-                D_DrawSkyScans8(s->spans);
-                D_DrawZSpans(s->spans);
+                (*d_drawskyscans)(s->spans);
+                (*d_drawzspans)(s->spans);
             } else if (s->flags & SURF_DRAWBACKGROUND) {
                 // set up a gradient for the background surface that places it
                 // effectively at infinity distance from the viewpoint
@@ -207,7 +211,7 @@ void D_DrawSurfaces(void)
                 d_ziorigin = -0.9;
 
                 D_DrawSolidSurface(s, (int)r_clearcolor.value & 0xFF);
-                D_DrawZSpans(s->spans);
+                (*d_drawzspans)(s->spans);
             } else if (s->flags & SURF_DRAWTURB) {
                 pface = s->data;
                 miplevel = 0;
@@ -227,8 +231,8 @@ void D_DrawSurfaces(void)
                 }
 
                 D_CalcGradients(pface);
-                Turbulent8(s->spans);
-                D_DrawZSpans(s->spans);
+                (*d_drawturbulent)(s->spans);
+                (*d_drawzspans)(s->spans);
 
                 if (s->insubmodel) {
                     //
@@ -261,7 +265,10 @@ void D_DrawSurfaces(void)
                 miplevel = D_MipLevelForScale(s->nearzi * scale_for_mip * pface->texinfo->mipadjust);
 
                 // FIXME: make this passed in to D_CacheSurface
-                pcurrentcache = D_CacheSurface(pface, miplevel);
+                if (caches)
+                    pcurrentcache = caches[s - surfaces];
+                else
+                    pcurrentcache = D_CacheSurface(pface, miplevel);
 
                 cacheblock = (pixel_t *)pcurrentcache->data;
                 cachewidth = pcurrentcache->width;
@@ -270,7 +277,7 @@ void D_DrawSurfaces(void)
 
                 (*d_drawspans)(s->spans);
 
-                D_DrawZSpans(s->spans);
+                (*d_drawzspans)(s->spans);
 
                 if (s->insubmodel) {
                     //
@@ -290,3 +297,28 @@ void D_DrawSurfaces(void)
         }
     }
 }
+
+/*
+==============
+D_DrawSurfaces
+==============
+*/
+void D_DrawSurfaces(void)
+{
+    PROF_BEGIN("D_DrawSurfaces");
+
+    D_DrawSurfaceList(NULL);
+    PROF_END();
+}
+
+/*
+==============
+D_DrawBandSurfaces
+
+Draws one band's surfaces with the caches R_BandScanEdges built for them
+==============
+*/
+void D_DrawBandSurfaces(surfcache_t **caches)
+{
+    D_DrawSurfaceList(caches);
+}
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // d_part.c: software driver module for drawing particles
 
 #include "quakedef.h"
+#include "r_local.h"
 #include "d_local.h"
 
 /*
@@ -57,6 +58,11 @@ void D_DrawParticle(particle_t *pparticle)
     short *pz;
     int i, izi, pix, count, u, v;
 
+    if (r_bandqueue) {
+        R_BandQueueParticle(pparticle);
+        return;
+    }
+
     // transform point
     VectorSubtract(pparticle->org, r_origin, local);
 
@@ -88,10 +94,21 @@ void D_DrawParticle(particle_t *pparticle)
     else if (pix > d_pix_max)
         pix = d_pix_max;
 
+    // only the rows in this thread's band
+    count = pix << d_y_aspect_shift;
+    if (v < d_bandtop) {
+        count -= d_bandtop - v;
+        pz += (d_bandtop - v) * d_zwidth;
+        pdest += (d_bandtop - v) * screenwidth;
+        v = d_bandtop;
+    }
+    if (v + count > d_bandbottom)
+        count = d_bandbottom - v;
+    if (count <= 0)
+        return;
+
     switch (pix) {
     case 1:
-        count = 1 << d_y_aspect_shift;
-
         for (; count; count--, pz += d_zwidth, pdest += screenwidth) {
             if (pz[0] <= izi) {
                 pz[0] = izi;
@@ -101,8 +118,6 @@ void D_DrawParticle(particle_t *pparticle)
         break;
 
     case 2:
-        count = 2 << d_y_aspect_shift;
-
         for (; count; count--, pz += d_zwidth, pdest += screenwidth) {
             if (pz[0] <= izi) {
                 pz[0] = izi;
@@ -117,8 +132,6 @@ void D_DrawParticle(particle_t *pparticle)
         break;
 
     case 3:
-        count = 3 << d_y_aspect_shift;
-
         for (; count; count--, pz += d_zwidth, pdest += screenwidth) {
             if (pz[0] <= izi) {
                 pz[0] = izi;
@@ -138,8 +151,6 @@ void D_DrawParticle(particle_t *pparticle)
         break;
 
     case 4:
-        count = 4 << d_y_aspect_shift;
-
         for (; count; count--, pz += d_zwidth, pdest += screenwidth) {
             if (pz[0] <= izi) {
                 pz[0] = izi;
@@ -164,8 +175,6 @@ void D_DrawParticle(particle_t *pparticle)
         break;
 
     default:
-        count = pix << d_y_aspect_shift;
-
         for (; count; count--, pz += d_zwidth, pdest += screenwidth) {
             for (i = 0; i < pix; i++) {
                 if (pz[i] <= izi) {
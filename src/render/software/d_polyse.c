@@ -38,54 +38,55 @@ typedef struct {
     int sfrac, tfrac, light, zi;
 } spanpackage_t;
 
+// the vertices are indexes into r_p0, r_p1 and r_p2, so the table can be
+// shared by the band threads
 typedef struct {
     int isflattop;
     int numleftedges;
-    int *pleftedgevert0;
-    int *pleftedgevert1;
-    int *pleftedgevert2;
+    int pleftedgevert0;
+    int pleftedgevert1;
+    int pleftedgevert2;
     int numrightedges;
-    int *prightedgevert0;
-    int *prightedgevert1;
-    int *prightedgevert2;
+    int prightedgevert0;
+    int prightedgevert1;
+    int prightedgevert2;
 } edgetable;
 
-int r_p0[6], r_p1[6], r_p2[6];
+THREAD_LOCAL int r_p0[6], r_p1[6], r_p2[6];
 
-byte *d_pcolormap;
+THREAD_LOCAL byte *d_pcolormap;
 
 int d_aflatcolor;
-int d_xdenom;
+THREAD_LOCAL int d_xdenom;
 
-edgetable *pedgetable;
+static THREAD_LOCAL edgetable *pedgetable;
 
-edgetable edgetables[12] = {
-    { 0, 1, r_p0, r_p2, NULL, 2, r_p0, r_p1, r_p2 }, { 0, 2, r_p1, r_p0, r_p2, 1, r_p1, r_p2, NULL },
-    { 1, 1, r_p0, r_p2, NULL, 1, r_p1, r_p2, NULL }, { 0, 1, r_p1, r_p0, NULL, 2, r_p1, r_p2, r_p0 },
-    { 0, 2, r_p0, r_p2, r_p1, 1, r_p0, r_p1, NULL }, { 0, 1, r_p2, r_p1, NULL, 1, r_p2, r_p0, NULL },
-    { 0, 1, r_p2, r_p1, NULL, 2, r_p2, r_p0, r_p1 }, { 0, 2, r_p2, r_p1, r_p0, 1, r_p2, r_p0, NULL },
-    { 0, 1, r_p1, r_p0, NULL, 1, r_p1, r_p2, NULL }, { 1, 1, r_p2, r_p1, NULL, 1, r_p0, r_p1, NULL },
-    { 1, 1, r_p1, r_p0, NULL, 1, r_p2, r_p0, NULL }, { 0, 1, r_p0, r_p2, NULL, 1, r_p0, r_p1, NULL },
+static edgetable edgetables[12] = {
+    { 0, 1, 0, 2, -1, 2, 0, 1, 2 }, { 0, 2, 1, 0, 2, 1, 1, 2, -1 }, { 1, 1, 0, 2, -1, 1, 1, 2, -1 },
+    { 0, 1, 1, 0, -1, 2, 1, 2, 0 }, { 0, 2, 0, 2, 1, 1, 0, 1, -1 }, { 0, 1, 2, 1, -1, 1, 2, 0, -1 },
+    { 0, 1, 2, 1, -1, 2, 2, 0, 1 }, { 0, 2, 2, 1, 0, 1, 2, 0, -1 }, { 0, 1, 1, 0, -1, 1, 1, 2, -1 },
+    { 1, 1, 2, 1, -1, 1, 0, 1, -1 }, { 1, 1, 1, 0, -1, 1, 2, 0, -1 }, { 0, 1, 0, 2, -1, 1, 0, 1, -1 },
 };
 
 // FIXME: some of these can become statics
-int a_sstepxfrac, a_tstepxfrac, r_lstepx, a_ststepxwhole;
-int r_sstepx, r_tstepx, r_lstepy, r_sstepy, r_tstepy;
-int r_zistepx, r_zistepy;
-int d_aspancount, d_countextrastep;
-
-spanpackage_t *a_spans;
-spanpackage_t *d_pedgespanpackage;
-static int ystart;
-byte *d_pdest, *d_ptex;
-short *d_pz;
-int d_sfrac, d_tfrac, d_light, d_zi;
-int d_ptexextrastep, d_sfracextrastep;
-int d_tfracextrastep, d_lightextrastep, d_pdestextrastep;
-int d_lightbasestep, d_pdestbasestep, d_ptexbasestep;
-int d_sfracbasestep, d_tfracbasestep;
-int d_ziextrastep, d_zibasestep;
-int d_pzextrastep, d_pzbasestep;
+THREAD_LOCAL int a_sstepxfrac, a_tstepxfrac, r_lstepx, a_ststepxwhole;
+THREAD_LOCAL int r_sstepx, r_tstepx, r_lstepy, r_sstepy, r_tstepy;
+THREAD_LOCAL int r_zistepx, r_zistepy;
+THREAD_LOCAL int d_aspancount, d_countextrastep;
+
+THREAD_LOCAL spanpackage_t *a_spans;
+THREAD_LOCAL spanpackage_t *d_pedgespanpackage;
+static THREAD_LOCAL int ystart;
+static THREAD_LOCAL int a_ystart; // row of a_spans[0]
+THREAD_LOCAL byte *d_pdest, *d_ptex;
+THREAD_LOCAL short *d_pz;
+THREAD_LOCAL int d_sfrac, d_tfrac, d_light, d_zi;
+THREAD_LOCAL int d_ptexextrastep, d_sfracextrastep;
+THREAD_LOCAL int d_tfracextrastep, d_lightextrastep, d_pdestextrastep;
+THREAD_LOCAL int d_lightbasestep, d_pdestbasestep, d_ptexbasestep;
+THREAD_LOCAL int d_sfracbasestep, d_tfracbasestep;
+THREAD_LOCAL int d_ziextrastep, d_zibasestep;
+THREAD_LOCAL int d_pzextrastep, d_pzbasestep;
 
 typedef struct {
     int quotient;
@@ -96,9 +97,9 @@ static adivtab_t adivtab[32 * 32] = {
 #include "adivtab.h"
 };
 
-byte *skintable[MAX_LBM_HEIGHT];
-int skinwidth;
-byte *skinstart;
+THREAD_LOCAL byte *skintable[MAX_LBM_HEIGHT];
+THREAD_LOCAL int skinwidth;
+THREAD_LOCAL byte *skinstart;
 
 void D_PolysetDrawSpans8(spanpackage_t *pspanpackage);
 void D_PolysetCalcGradients(int skinwidth);
@@ -109,6 +110,20 @@ void D_PolysetSetEdgeTable(void);
 void D_RasterizeAliasPolySmooth(void);
 void D_PolysetScanLeftEdge(int height);
 
+/*
+================
+D_TriangleOutsideBand
+================
+*/
+static qboolean D_TriangleOutsideBand(finalvert_t *index0, finalvert_t *index1, finalvert_t *index2)
+{
+    if (index0->v[1] < d_bandtop && index1->v[1] < d_bandtop && index2->v[1] < d_bandtop)
+        return true;
+    if (index0->v[1] >= d_bandbottom && index1->v[1] >= d_bandbottom && index2->v[1] >= d_bandbottom)
+        return true;
+    return false;
+}
+
 #if !id386
 
 /*
@@ -121,6 +136,11 @@ void D_PolysetDraw(void)
     spanpackage_t spans[DPS_MAXSPANS + 1 + ((CACHE_SIZE - 1) / sizeof(spanpackage_t)) + 1];
     // one extra because of cache line pretouching
 
+    if (r_bandqueue) {
+        R_BandQueuePolyset();
+        return;
+    }
+
     a_spans = (spanpackage_t *)(((long)&spans[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
 
     if (r_affinetridesc.drawtype) {
@@ -140,10 +160,16 @@ void D_PolysetDrawFinalVerts(finalvert_t *fv, int numverts)
     int i, z;
     short *zbuf;
 
+    if (r_bandqueue) {
+        R_BandQueueFinalVerts(fv, numverts);
+        return;
+    }
+
     for (i = 0; i < numverts; i++, fv++) {
         // valid triangle coordinates for filling can include the bottom and
         // right clip edges, due to the fill rule; these shouldn't be drawn
-        if ((fv->v[0] < r_refdef.vrectright) && (fv->v[1] < r_refdef.vrectbottom)) {
+        if ((fv->v[0] < r_refdef.vrectright) && (fv->v[1] < r_refdef.vrectbottom) && fv->v[1] >= d_bandtop &&
+            fv->v[1] < d_bandbottom) {
             z = fv->v[5] >> 16;
             zbuf = zspantable[fv->v[1]] + fv->v[0];
             if (z >= *zbuf) {
@@ -184,29 +210,29 @@ void D_DrawSubdiv(void)
             continue;
         }
 
+        if (D_TriangleOutsideBand(index0, index1, index2))
+            continue;
+
         d_pcolormap = &((byte *)acolormap)[index0->v[4] & 0xFF00];
 
         if (ptri[i].facesfront) {
             D_PolysetRecursiveTriangle(index0->v, index1->v, index2->v);
         } else {
-            int s0, s1, s2;
+            int p0[6], p1[6], p2[6];
 
-            s0 = index0->v[2];
-            s1 = index1->v[2];
-            s2 = index2->v[2];
+            // the other bands may be drawing from the same vertices
+            memcpy(p0, index0->v, sizeof(p0));
+            memcpy(p1, index1->v, sizeof(p1));
+            memcpy(p2, index2->v, sizeof(p2));
 
             if (index0->flags & ALIAS_ONSEAM)
-                index0->v[2] += r_affinetridesc.seamfixupX16;
+                p0[2] += r_affinetridesc.seamfixupX16;
             if (index1->flags & ALIAS_ONSEAM)
-                index1->v[2] += r_affinetridesc.seamfixupX16;
+                p1[2] += r_affinetridesc.seamfixupX16;
             if (index2->flags & ALIAS_ONSEAM)
-                index2->v[2] += r_affinetridesc.seamfixupX16;
-
-            D_PolysetRecursiveTriangle(index0->v, index1->v, index2->v);
+                p2[2] += r_affinetridesc.seamfixupX16;
 
-            index0->v[2] = s0;
-            index1->v[2] = s1;
-            index2->v[2] = s2;
+            D_PolysetRecursiveTriangle(p0, p1, p2);
         }
     }
 }
@@ -239,6 +265,9 @@ void D_DrawNonSubdiv(void)
             continue;
         }
 
+        if (D_TriangleOutsideBand(index0, index1, index2))
+            continue;
+
         r_p0[0] = index0->v[0]; // u
         r_p0[1] = index0->v[1]; // v
         r_p0[2] = index0->v[2]; // s
@@ -336,6 +365,8 @@ split:
         goto nodraw;
     if ((lp2[1] == lp1[1]) && (lp2[0] < lp1[0]))
         goto nodraw;
+    if (newpoints[1] < d_bandtop || newpoints[1] >= d_bandbottom)
+        goto nodraw;
 
     z = newpoints[5] >> 16;
     zbuf = zspantable[newpoints[1]] + newpoints[0];
@@ -559,6 +590,9 @@ void D_PolysetDrawSpans8(spanpackage_t *pspanpackage)
     int llight;
     int lzi;
     short *lpz;
+    int y;
+
+    y = a_ystart + (pspanpackage - a_spans);
 
     do {
         lcount = d_aspancount - pspanpackage->count;
@@ -571,7 +605,7 @@ void D_PolysetDrawSpans8(spanpackage_t *pspanpackage)
             d_aspancount += ubasestep;
         }
 
-        if (lcount) {
+        if (lcount && y >= d_bandtop && y < d_bandbottom) {
             lpdest = pspanpackage->pdest;
             lptex = pspanpackage->ptex;
             lpz = pspanpackage->pz;
@@ -603,6 +637,7 @@ void D_PolysetDrawSpans8(spanpackage_t *pspanpackage)
         }
 
         pspanpackage++;
+        y++;
     } while (pspanpackage->count != -999999);
 }
 #endif // !id386
@@ -651,12 +686,13 @@ void D_RasterizeAliasPolySmooth(void)
     int initialleftheight, initialrightheight;
     int *plefttop, *prighttop, *pleftbottom, *prightbottom;
     int working_lstepx, originalcount;
+    int *pverts[3] = { r_p0, r_p1, r_p2 };
 
-    plefttop = pedgetable->pleftedgevert0;
-    prighttop = pedgetable->prightedgevert0;
+    plefttop = pverts[pedgetable->pleftedgevert0];
+    prighttop = pverts[pedgetable->prightedgevert0];
 
-    pleftbottom = pedgetable->pleftedgevert1;
-    prightbottom = pedgetable->prightedgevert1;
+    pleftbottom = pverts[pedgetable->pleftedgevert1];
+    prightbottom = pverts[pedgetable->prightedgevert1];
 
     initialleftheight = pleftbottom[1] - plefttop[1];
     initialrightheight = prightbottom[1] - prighttop[1];
@@ -677,6 +713,7 @@ void D_RasterizeAliasPolySmooth(void)
     d_pedgespanpackage = a_spans;
 
     ystart = plefttop[1];
+    a_ystart = ystart;
     d_aspancount = plefttop[0] - prighttop[0];
 
     d_ptex = (byte *)r_affinetridesc.pskin + (plefttop[2] >> 16) + (plefttop[3] >> 16) * r_affinetridesc.skinwidth;
@@ -766,7 +803,7 @@ void D_RasterizeAliasPolySmooth(void)
         int height;
 
         plefttop = pleftbottom;
-        pleftbottom = pedgetable->pleftedgevert2;
+        pleftbottom = pverts[pedgetable->pleftedgevert2];
 
         height = pleftbottom[1] - plefttop[1];
 
@@ -867,7 +904,7 @@ void D_RasterizeAliasPolySmooth(void)
         d_aspancount = prightbottom[0] - prighttop[0];
 
         prighttop = prightbottom;
-        prightbottom = pedgetable->prightedgevert2;
+        prightbottom = pverts[pedgetable->prightedgevert2];
 
         height = prightbottom[1] - prighttop[1];
 
@@ -0,0 +1,1283 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_simd.c -- SSE2, AVX2 and NEON versions of the span drawers
+
+/*
+The vector drawers have to come out pixel for pixel the same as the C ones in
+d_scan.c and d_sky.c, so they do the same arithmetic in the same order:
+
+The 1/z, s/z and t/z at the ends of a span's segments are stepped one after
+another like the C drawers step them, then the divides and conversions for
+all of the ends are done several at a time. The fixed point s and t of the
+pixels between two ends are the start plus the pixel's index times the step,
+which is what adding the step once per pixel gives. The texel offsets are
+worked out a vector at a time and the texels fetched one by one, gathers
+are only quicker for the turbulent textures' sine table.
+
+D_SetupFrame picks the fastest drawers the CPU runs unless d_simd is 0,
+d_spanbenchmark compares them all against the C drawers.
+*/
+
+#include "quakedef.h"
+#include "r_local.h"
+#include "d_local.h"
+
+// -Os doesn't inline the helpers otherwise, and calling them costs more than
+// the vectors save
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#define SIMD_SSE2 __attribute__((target("sse2")))
+#define SIMD_AVX2 __attribute__((target("avx2")))
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_NEON
+#endif
+
+CVAR_REGISTER(d_simd, CVAR_CTOR({ "d_simd", 1 }));
+
+typedef struct {
+    char const *name;
+    qboolean (*supported)(void);
+    void (*drawspans)(espan_t *pspan);
+    void (*drawzspans)(espan_t *pspan);
+    void (*drawturbulent)(espan_t *pspan);
+    void (*drawskyscans)(espan_t *pspan);
+} spandrawers_t;
+
+#if defined(SIMD_X86) || defined(SIMD_NEON)
+
+// a segment per 8 pixels plus the far end, rounded up to a whole vector
+#define MAX_SPAN_ENDS ((MAXWIDTH / 8 + 1 + 7) & ~7)
+
+#define SKY_SPAN_SHIFT 5 // as in d_sky.c
+#define SKY_SPAN_MAX (1 << SKY_SPAN_SHIFT)
+
+typedef struct {
+    int numsegments;
+    int count[MAXWIDTH / SKY_SPAN_MAX + 1];
+    fixed16_t s[MAXWIDTH / SKY_SPAN_MAX + 1], t[MAXWIDTH / SKY_SPAN_MAX + 1];
+    fixed16_t sstep[MAXWIDTH / SKY_SPAN_MAX + 1], tstep[MAXWIDTH / SKY_SPAN_MAX + 1];
+} skyends_t;
+
+typedef struct {
+    int numsegments;
+    int lastcount; // pixels in the last segment
+    float sdivz[MAX_SPAN_ENDS], tdivz[MAX_SPAN_ENDS], zi[MAX_SPAN_ENDS];
+    fixed16_t s[MAX_SPAN_ENDS], t[MAX_SPAN_ENDS];
+} spanends_t;
+
+/*
+=============
+D_StepSpanEnds
+
+Steps s/z, t/z and 1/z to the end of every segment of 1 << shift pixels the
+way D_DrawSpans8 and Turbulent8 do, up to the last pixel of the span. Pads
+them out to a multiple of 8 ends
+=============
+*/
+static SIMD_INLINE void D_StepSpanEnds(espan_t *pspan, int shift, spanends_t *ends)
+{
+    int i, n;
+    float sdivz, tdivz, zi, du, dv, spancountminus1;
+    float sdivzstepu, tdivzstepu, zistepu;
+
+    sdivzstepu = d_sdivzstepu * (1 << shift);
+    tdivzstepu = d_tdivzstepu * (1 << shift);
+    zistepu = d_zistepu * (1 << shift);
+
+    du = (float)pspan->u;
+    dv = (float)pspan->v;
+
+    sdivz = d_sdivzorigin + dv * d_sdivzstepv + du * d_sdivzstepu;
+    tdivz = d_tdivzorigin + dv * d_tdivzstepv + du * d_tdivzstepu;
+    zi = d_ziorigin + dv * d_zistepv + du * d_zistepu;
+
+    n = (pspan->count + (1 << shift) - 1) >> shift;
+    ends->numsegments = n;
+    ends->lastcount = pspan->count - ((n - 1) << shift);
+
+    ends->sdivz[0] = sdivz;
+    ends->tdivz[0] = tdivz;
+    ends->zi[0] = zi;
+
+    for (i = 1; i < n; i++) {
+        sdivz += sdivzstepu;
+        tdivz += tdivzstepu;
+        zi += zistepu;
+        ends->sdivz[i] = sdivz;
+        ends->tdivz[i] = tdivz;
+        ends->zi[i] = zi;
+    }
+
+    spancountminus1 = (float)(ends->lastcount - 1);
+    ends->sdivz[n] = sdivz + d_sdivzstepu * spancountminus1;
+    ends->tdivz[n] = tdivz + d_tdivzstepu * spancountminus1;
+    ends->zi[n] = zi + d_zistepu * spancountminus1;
+
+    for (i = n + 1; i & 7; i++) {
+        ends->sdivz[i] = 0;
+        ends->tdivz[i] = 0;
+        ends->zi[i] = 1;
+    }
+}
+
+/*
+=============
+D_ClampSpanEnds
+
+Clamps the fixed point ends like the C drawers, the start of the span to the
+texture and the rest also at least minstep in
+=============
+*/
+static SIMD_INLINE void D_ClampSpanEnds(spanends_t *ends, int minstep)
+{
+    int i, min;
+
+    for (i = 0, min = 0; i <= ends->numsegments; i++, min = minstep) {
+        if (ends->s[i] > bbextents)
+            ends->s[i] = bbextents;
+        else if (ends->s[i] < min)
+            ends->s[i] = min;
+
+        if (ends->t[i] > bbextentt)
+            ends->t[i] = bbextentt;
+        else if (ends->t[i] < min)
+            ends->t[i] = min;
+    }
+}
+
+/*
+=============
+D_SpanSegmentSteps
+
+The count and s and t steps of one segment, shifting like the C drawers
+except for the last one, which is divided so it ends on the last pixel
+=============
+*/
+static SIMD_INLINE int D_SpanSegmentSteps(spanends_t *ends, int i, int shift, fixed16_t *sstep, fixed16_t *tstep)
+{
+    int spancount;
+
+    if (i < ends->numsegments - 1) {
+        *sstep = (ends->s[i + 1] - ends->s[i]) >> shift;
+        *tstep = (ends->t[i + 1] - ends->t[i]) >> shift;
+        return 1 << shift;
+    }
+
+    spancount = ends->lastcount;
+    if (spancount > 1) {
+        *sstep = (ends->s[i + 1] - ends->s[i]) / (spancount - 1);
+        *tstep = (ends->t[i + 1] - ends->t[i]) / (spancount - 1);
+    } else {
+        *sstep = 0;
+        *tstep = 0;
+    }
+    return spancount;
+}
+
+/*
+=============
+D_SkySpanEnds
+
+The start and steps of every segment of a sky span, like D_DrawSkyScans8
+works them out
+=============
+*/
+static SIMD_INLINE void D_SkySpanEnds(espan_t *pspan, skyends_t *ends)
+{
+    int count, spancount, spancountminus1, u, v, n;
+    fixed16_t s, t, snext, tnext, sstep, tstep;
+
+    sstep = 0;
+    tstep = 0;
+    snext = 0;
+    tnext = 0;
+
+    count = pspan->count;
+    u = pspan->u;
+    v = pspan->v;
+    D_Sky_uv_To_st(u, v, &s, &t);
+
+    n = 0;
+    do {
+        if (count >= SKY_SPAN_MAX)
+            spancount = SKY_SPAN_MAX;
+        else
+            spancount = count;
+
+        count -= spancount;
+
+        if (count) {
+            u += spancount;
+            D_Sky_uv_To_st(u, v, &snext, &tnext);
+            sstep = (snext - s) >> SKY_SPAN_SHIFT;
+            tstep = (tnext - t) >> SKY_SPAN_SHIFT;
+        } else {
+            spancountminus1 = spancount - 1;
+            if (spancountminus1 > 0) {
+                u += spancountminus1;
+                D_Sky_uv_To_st(u, v, &snext, &tnext);
+                sstep = (snext - s) / spancountminus1;
+                tstep = (tnext - t) / spancountminus1;
+            }
+        }
+
+        ends->count[n] = spancount;
+        ends->s[n] = s;
+        ends->t[n] = t;
+        ends->sstep[n] = sstep;
+        ends->tstep[n] = tstep;
+        n++;
+
+        s = snext;
+        t = tnext;
+    } while (count > 0);
+
+    ends->numsegments = n;
+}
+
+#endif
+
+#ifdef SIMD_X86
+
+//=============================================================================
+// SSE2
+
+/*
+=============
+D_DivideSpanEnds_SSE2
+=============
+*/
+static SIMD_SSE2 void D_DivideSpanEnds_SSE2(spanends_t *ends)
+{
+    __m128 scale, z;
+    __m128i sadj, tadj;
+    int i;
+
+    scale = _mm_set1_ps((float)0x10000);
+    sadj = _mm_set1_epi32(sadjust);
+    tadj = _mm_set1_epi32(tadjust);
+
+    for (i = 0; i <= ends->numsegments; i += 4) {
+        z = _mm_div_ps(scale, _mm_loadu_ps(&ends->zi[i]));
+        _mm_storeu_si128((__m128i *)&ends->s[i],
+                         _mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(&ends->sdivz[i]), z)), sadj));
+        _mm_storeu_si128((__m128i *)&ends->t[i],
+                         _mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(&ends->tdivz[i]), z)), tadj));
+    }
+}
+
+/*
+=============
+D_DrawSpans8_SSE2
+
+SSE2 has no gathers, so the texel offsets are worked out four pixels at a
+time and fetched one by one. t >> 16 and cachewidth are both below 32768,
+which lets _mm_madd_epi16 multiply them
+=============
+*/
+static SIMD_SSE2 void D_DrawSpans8_SSE2(espan_t *pspan)
+{
+    spanends_t ends;
+    unsigned char *pbase, *pdest;
+    fixed16_t s, t, sstep, tstep;
+    __m128i sv, tv, width;
+    int offset[8];
+    int i, j, spancount;
+
+    pbase = (unsigned char *)cacheblock;
+    width = _mm_set1_epi32(cachewidth);
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_StepSpanEnds(pspan, 3, &ends);
+        D_DivideSpanEnds_SSE2(&ends);
+        D_ClampSpanEnds(&ends, 8);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = D_SpanSegmentSteps(&ends, i, 3, &sstep, &tstep);
+            s = ends.s[i];
+            t = ends.t[i];
+
+            sv = _mm_setr_epi32(s, s + sstep, s + 2 * sstep, s + 3 * sstep);
+            tv = _mm_setr_epi32(t, t + tstep, t + 2 * tstep, t + 3 * tstep);
+            _mm_storeu_si128((__m128i *)offset,
+                             _mm_add_epi32(_mm_srai_epi32(sv, 16), _mm_madd_epi16(_mm_srai_epi32(tv, 16), width)));
+            sv = _mm_add_epi32(sv, _mm_set1_epi32(4 * sstep));
+            tv = _mm_add_epi32(tv, _mm_set1_epi32(4 * tstep));
+            _mm_storeu_si128((__m128i *)(offset + 4),
+                             _mm_add_epi32(_mm_srai_epi32(sv, 16), _mm_madd_epi16(_mm_srai_epi32(tv, 16), width)));
+
+            for (j = 0; j < spancount; j++)
+                pdest[j] = pbase[offset[j]];
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_PackZ_SSE2
+
+Packs the top halves of eight 1/z values to shorts. D_DrawZSpans writes them
+in aligned pairs and sign extends the first of a pair into the second, so
+that's done here too
+=============
+*/
+static SIMD_SSE2 SIMD_INLINE __m128i D_PackZ_SSE2(__m128i izi0, __m128i izi1)
+{
+    __m128i z;
+
+    z = _mm_packs_epi32(_mm_srai_epi32(izi0, 16), _mm_srai_epi32(izi1, 16));
+    return _mm_or_si128(z, _mm_srai_epi32(_mm_slli_epi32(z, 16), 16));
+}
+
+/*
+=============
+D_DrawZSpans_SSE2
+=============
+*/
+static SIMD_SSE2 void D_DrawZSpans_SSE2(espan_t *pspan)
+{
+    int count, izistep;
+    int izi;
+    short *pdest;
+    double zi;
+    float du, dv;
+    __m128i izi0, izi1, step;
+    short tail[8];
+
+    izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+    step = _mm_set1_epi32(8 * izistep);
+
+    do {
+        pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+
+        count = pspan->count;
+
+        du = (float)pspan->u;
+        dv = (float)pspan->v;
+
+        zi = d_ziorigin + dv * d_zistepv + du * d_zistepu;
+        izi = (int)(zi * 0x8000 * 0x10000);
+
+        if ((long)pdest & 0x02) {
+            *pdest++ = (short)(izi >> 16);
+            izi += izistep;
+            count--;
+        }
+
+        izi0 = _mm_setr_epi32(izi, izi + izistep, izi + 2 * izistep, izi + 3 * izistep);
+        izi1 = _mm_add_epi32(izi0, _mm_set1_epi32(4 * izistep));
+
+        for (; count >= 8; count -= 8, pdest += 8) {
+            _mm_storeu_si128((__m128i *)pdest, D_PackZ_SSE2(izi0, izi1));
+            izi0 = _mm_add_epi32(izi0, step);
+            izi1 = _mm_add_epi32(izi1, step);
+        }
+
+        // an odd last pixel is the first of a pair, which isn't changed
+        if (count > 0) {
+            _mm_storeu_si128((__m128i *)tail, D_PackZ_SSE2(izi0, izi1));
+            memcpy(pdest, tail, count * sizeof(short));
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawTurbulent8_SSE2
+
+Only the ends are vectorized, the double lookup of every pixel is left to
+D_DrawTurbulent8Span
+=============
+*/
+static SIMD_SSE2 void D_DrawTurbulent8_SSE2(espan_t *pspan)
+{
+    spanends_t ends;
+    int i;
+
+    r_turb_turb = sintable + ((int)(cl.time * SPEED / MS_PER_S) & (CYCLE - 1));
+    r_turb_pbase = (unsigned char *)cacheblock;
+
+    do {
+        r_turb_pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_StepSpanEnds(pspan, 4, &ends);
+        D_DivideSpanEnds_SSE2(&ends);
+        D_ClampSpanEnds(&ends, 16);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            r_turb_spancount = D_SpanSegmentSteps(&ends, i, 4, &r_turb_sstep, &r_turb_tstep);
+            r_turb_s = ends.s[i] & ((CYCLE << 16) - 1);
+            r_turb_t = ends.t[i] & ((CYCLE << 16) - 1);
+
+            D_DrawTurbulent8Span();
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawSkyScans8_SSE2
+=============
+*/
+static SIMD_SSE2 void D_DrawSkyScans8_SSE2(espan_t *pspan)
+{
+    skyends_t ends;
+    unsigned char *pdest;
+    __m128i sv, tv, mask, s4, t4;
+    int offset[SKY_SPAN_MAX];
+    int i, j, spancount;
+
+    mask = _mm_set1_epi32(R_SKY_SMASK);
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_SkySpanEnds(pspan, &ends);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = ends.count[i];
+
+            sv = _mm_setr_epi32(ends.s[i], ends.s[i] + ends.sstep[i], ends.s[i] + 2 * ends.sstep[i],
+                                ends.s[i] + 3 * ends.sstep[i]);
+            tv = _mm_setr_epi32(ends.t[i], ends.t[i] + ends.tstep[i], ends.t[i] + 2 * ends.tstep[i],
+                                ends.t[i] + 3 * ends.tstep[i]);
+            s4 = _mm_set1_epi32(4 * ends.sstep[i]);
+            t4 = _mm_set1_epi32(4 * ends.tstep[i]);
+            for (j = 0; j < spancount; j += 4) {
+                _mm_storeu_si128((__m128i *)(offset + j), _mm_add_epi32(_mm_srli_epi32(_mm_and_si128(tv, mask), 8),
+                                                                       _mm_srli_epi32(_mm_and_si128(sv, mask), 16)));
+                sv = _mm_add_epi32(sv, s4);
+                tv = _mm_add_epi32(tv, t4);
+            }
+
+            for (j = 0; j < spancount; j++)
+                pdest[j] = r_skysource[offset[j]];
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+static qboolean D_HasSSE2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+//=============================================================================
+// AVX2
+
+/*
+=============
+D_DivideSpanEnds_AVX2
+=============
+*/
+static SIMD_AVX2 void D_DivideSpanEnds_AVX2(spanends_t *ends)
+{
+    __m256 scale, z;
+    __m256i sadj, tadj;
+    int i;
+
+    scale = _mm256_set1_ps((float)0x10000);
+    sadj = _mm256_set1_epi32(sadjust);
+    tadj = _mm256_set1_epi32(tadjust);
+
+    for (i = 0; i <= ends->numsegments; i += 8) {
+        z = _mm256_div_ps(scale, _mm256_loadu_ps(&ends->zi[i]));
+        _mm256_storeu_si256((__m256i *)&ends->s[i],
+                            _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(&ends->sdivz[i]), z)),
+                                             sadj));
+        _mm256_storeu_si256((__m256i *)&ends->t[i],
+                            _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_loadu_ps(&ends->tdivz[i]), z)),
+                                             tadj));
+    }
+}
+
+/*
+=============
+D_LaneSteps_AVX2
+
+0 to 7 times step, faster than multiplying
+=============
+*/
+static SIMD_AVX2 SIMD_INLINE __m256i D_LaneSteps_AVX2(int step)
+{
+    __m256i step1, step2, step4;
+
+    step1 = _mm256_set1_epi32(step);
+    step2 = _mm256_add_epi32(step1, step1);
+    step4 = _mm256_add_epi32(step2, step2);
+    step1 = _mm256_and_si256(step1, _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+    step2 = _mm256_and_si256(step2, _mm256_setr_epi32(0, 0, -1, -1, 0, 0, -1, -1));
+    step4 = _mm256_and_si256(step4, _mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1));
+    return _mm256_add_epi32(_mm256_add_epi32(step1, step2), step4);
+}
+
+/*
+=============
+D_FetchTexels_AVX2
+=============
+*/
+static SIMD_AVX2 SIMD_INLINE void D_FetchTexels_AVX2(unsigned char *pdest, byte const *pbase, __m256i offsets, int count)
+{
+    int offset[8];
+    int i;
+
+    _mm256_storeu_si256((__m256i *)offset, offsets);
+    for (i = 0; i < count; i++)
+        pdest[i] = pbase[offset[i]];
+}
+
+/*
+=============
+D_PackBytes_AVX2
+
+The low bytes of eight 32 bit lanes, in the low 8 bytes
+=============
+*/
+static SIMD_AVX2 SIMD_INLINE __m128i D_PackBytes_AVX2(__m256i v)
+{
+    v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8,
+                                                12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    return _mm_unpacklo_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+/*
+=============
+D_StoreBytes_AVX2
+=============
+*/
+static SIMD_AVX2 SIMD_INLINE void D_StoreBytes_AVX2(unsigned char *pdest, __m256i v, int count)
+{
+    __m128i b;
+    byte tail[16];
+
+    b = D_PackBytes_AVX2(v);
+    if (count == 8) {
+        _mm_storel_epi64((__m128i *)pdest, b);
+    } else {
+        _mm_storeu_si128((__m128i *)tail, b);
+        memcpy(pdest, tail, count);
+    }
+}
+
+/*
+=============
+D_DrawSpans8_AVX2
+=============
+*/
+static SIMD_AVX2 void D_DrawSpans8_AVX2(espan_t *pspan)
+{
+    spanends_t ends;
+    unsigned char *pbase, *pdest;
+    __m256i width, sv, tv, offsets;
+    fixed16_t sstep, tstep;
+    int i, spancount;
+
+    pbase = (unsigned char *)cacheblock;
+    width = _mm256_set1_epi32(cachewidth);
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_StepSpanEnds(pspan, 3, &ends);
+        D_DivideSpanEnds_AVX2(&ends);
+        D_ClampSpanEnds(&ends, 8);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = D_SpanSegmentSteps(&ends, i, 3, &sstep, &tstep);
+
+            sv = _mm256_add_epi32(_mm256_set1_epi32(ends.s[i]), D_LaneSteps_AVX2(sstep));
+            tv = _mm256_add_epi32(_mm256_set1_epi32(ends.t[i]), D_LaneSteps_AVX2(tstep));
+            offsets = _mm256_add_epi32(_mm256_srai_epi32(sv, 16), _mm256_madd_epi16(_mm256_srai_epi32(tv, 16), width));
+
+            D_FetchTexels_AVX2(pdest, pbase, offsets, spancount);
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_PackZ_AVX2
+
+D_PackZ_SSE2 for sixteen values
+=============
+*/
+static SIMD_AVX2 SIMD_INLINE __m256i D_PackZ_AVX2(__m256i izi0, __m256i izi1)
+{
+    __m256i z;
+
+    z = _mm256_packs_epi32(_mm256_srai_epi32(izi0, 16), _mm256_srai_epi32(izi1, 16));
+    z = _mm256_permute4x64_epi64(z, 0xD8);
+    return _mm256_or_si256(z, _mm256_srai_epi32(_mm256_slli_epi32(z, 16), 16));
+}
+
+/*
+=============
+D_DrawZSpans_AVX2
+=============
+*/
+static SIMD_AVX2 void D_DrawZSpans_AVX2(espan_t *pspan)
+{
+    int count, izistep;
+    int izi;
+    short *pdest;
+    double zi;
+    float du, dv;
+    __m256i lanes, izi0, izi1, step;
+    short tail[16];
+
+    izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+    lanes = D_LaneSteps_AVX2(izistep);
+    step = _mm256_set1_epi32(16 * izistep);
+
+    do {
+        pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+
+        count = pspan->count;
+
+        du = (float)pspan->u;
+        dv = (float)pspan->v;
+
+        zi = d_ziorigin + dv * d_zistepv + du * d_zistepu;
+        izi = (int)(zi * 0x8000 * 0x10000);
+
+        if ((long)pdest & 0x02) {
+            *pdest++ = (short)(izi >> 16);
+            izi += izistep;
+            count--;
+        }
+
+        izi0 = _mm256_add_epi32(_mm256_set1_epi32(izi), lanes);
+        izi1 = _mm256_add_epi32(izi0, _mm256_set1_epi32(8 * izistep));
+
+        for (; count >= 16; count -= 16, pdest += 16) {
+            _mm256_storeu_si256((__m256i *)pdest, D_PackZ_AVX2(izi0, izi1));
+            izi0 = _mm256_add_epi32(izi0, step);
+            izi1 = _mm256_add_epi32(izi1, step);
+        }
+
+        if (count > 0) {
+            _mm256_storeu_si256((__m256i *)tail, D_PackZ_AVX2(izi0, izi1));
+            memcpy(pdest, tail, count * sizeof(short));
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawTurbulent8_AVX2
+=============
+*/
+static SIMD_AVX2 void D_DrawTurbulent8_AVX2(espan_t *pspan)
+{
+    spanends_t ends;
+    unsigned char *pbase, *pdest;
+    int *turb;
+    __m256i cycle, texmask, ssteps, tsteps, sv, tv, sturb, tturb, texels;
+    fixed16_t s, t, sstep, tstep;
+    int i, j, spancount;
+
+    turb = sintable + ((int)(cl.time * SPEED / MS_PER_S) & (CYCLE - 1));
+    pbase = (unsigned char *)cacheblock;
+    cycle = _mm256_set1_epi32(CYCLE - 1);
+    texmask = _mm256_set1_epi32(63);
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_StepSpanEnds(pspan, 4, &ends);
+        D_DivideSpanEnds_AVX2(&ends);
+        D_ClampSpanEnds(&ends, 16);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = D_SpanSegmentSteps(&ends, i, 4, &sstep, &tstep);
+            s = ends.s[i] & ((CYCLE << 16) - 1);
+            t = ends.t[i] & ((CYCLE << 16) - 1);
+            ssteps = D_LaneSteps_AVX2(sstep);
+            tsteps = D_LaneSteps_AVX2(tstep);
+
+            // every offset is masked to the 64x64 texture, so the lanes past
+            // the end of the span don't need masking. The texel gather reads
+            // 4 bytes, past the last texel are the texture's smaller mips
+            for (j = 0; j < spancount; j += 8) {
+                sv = _mm256_add_epi32(_mm256_set1_epi32(s + j * sstep), ssteps);
+                tv = _mm256_add_epi32(_mm256_set1_epi32(t + j * tstep), tsteps);
+
+                sturb = _mm256_add_epi32(
+                    sv, _mm256_i32gather_epi32(turb, _mm256_and_si256(_mm256_srai_epi32(tv, 16), cycle), 4));
+                tturb = _mm256_add_epi32(
+                    tv, _mm256_i32gather_epi32(turb, _mm256_and_si256(_mm256_srai_epi32(sv, 16), cycle), 4));
+                sturb = _mm256_and_si256(_mm256_srai_epi32(sturb, 16), texmask);
+                tturb = _mm256_and_si256(_mm256_srai_epi32(tturb, 16), texmask);
+
+                texels = _mm256_i32gather_epi32((int const *)pbase,
+                                                _mm256_add_epi32(_mm256_slli_epi32(tturb, 6), sturb), 1);
+                D_StoreBytes_AVX2(pdest + j, texels, spancount - j < 8 ? spancount - j : 8);
+            }
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawSkyScans8_AVX2
+=============
+*/
+static SIMD_AVX2 void D_DrawSkyScans8_AVX2(espan_t *pspan)
+{
+    skyends_t ends;
+    unsigned char *pdest;
+    __m256i mask, ssteps, tsteps, sv, tv;
+    int i, j, spancount;
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        // D_Sky_uv_To_st isn't built for AVX, leaving the upper halves of
+        // the registers dirty would slow it down
+        _mm256_zeroupper();
+        D_SkySpanEnds(pspan, &ends);
+
+        mask = _mm256_set1_epi32(R_SKY_SMASK);
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = ends.count[i];
+            ssteps = D_LaneSteps_AVX2(ends.sstep[i]);
+            tsteps = D_LaneSteps_AVX2(ends.tstep[i]);
+
+            for (j = 0; j < spancount; j += 8) {
+                sv = _mm256_add_epi32(_mm256_set1_epi32(ends.s[i] + j * ends.sstep[i]), ssteps);
+                tv = _mm256_add_epi32(_mm256_set1_epi32(ends.t[i] + j * ends.tstep[i]), tsteps);
+                D_FetchTexels_AVX2(pdest + j, r_skysource,
+                                   _mm256_add_epi32(_mm256_srli_epi32(_mm256_and_si256(tv, mask), 8),
+                                                    _mm256_srli_epi32(_mm256_and_si256(sv, mask), 16)),
+                                   spancount - j < 8 ? spancount - j : 8);
+            }
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+static qboolean D_HasAVX2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+
+//=============================================================================
+// NEON
+
+/*
+=============
+D_DivideSpanEnds_NEON
+=============
+*/
+static void D_DivideSpanEnds_NEON(spanends_t *ends)
+{
+    float32x4_t scale, z;
+    int32x4_t sadj, tadj;
+    int i;
+
+    scale = vdupq_n_f32((float)0x10000);
+    sadj = vdupq_n_s32(sadjust);
+    tadj = vdupq_n_s32(tadjust);
+
+    for (i = 0; i <= ends->numsegments; i += 4) {
+        z = vdivq_f32(scale, vld1q_f32(&ends->zi[i]));
+        vst1q_s32(&ends->s[i], vaddq_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(&ends->sdivz[i]), z)), sadj));
+        vst1q_s32(&ends->t[i], vaddq_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(&ends->tdivz[i]), z)), tadj));
+    }
+}
+
+/*
+=============
+D_DrawSpans8_NEON
+
+NEON has no gathers, the texel offsets are worked out four pixels at a time
+and fetched one by one
+=============
+*/
+static void D_DrawSpans8_NEON(espan_t *pspan)
+{
+    spanends_t ends;
+    unsigned char *pbase, *pdest;
+    fixed16_t sstep, tstep;
+    int32x4_t lanes, width, sv, tv;
+    int offset[8];
+    int i, j, spancount;
+    static const int32_t lanevalues[4] = { 0, 1, 2, 3 };
+
+    pbase = (unsigned char *)cacheblock;
+    width = vdupq_n_s32(cachewidth);
+    lanes = vld1q_s32(lanevalues);
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_StepSpanEnds(pspan, 3, &ends);
+        D_DivideSpanEnds_NEON(&ends);
+        D_ClampSpanEnds(&ends, 8);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = D_SpanSegmentSteps(&ends, i, 3, &sstep, &tstep);
+
+            sv = vmlaq_s32(vdupq_n_s32(ends.s[i]), lanes, vdupq_n_s32(sstep));
+            tv = vmlaq_s32(vdupq_n_s32(ends.t[i]), lanes, vdupq_n_s32(tstep));
+            vst1q_s32(offset, vmlaq_s32(vshrq_n_s32(sv, 16), vshrq_n_s32(tv, 16), width));
+            sv = vaddq_s32(sv, vdupq_n_s32(4 * sstep));
+            tv = vaddq_s32(tv, vdupq_n_s32(4 * tstep));
+            vst1q_s32(offset + 4, vmlaq_s32(vshrq_n_s32(sv, 16), vshrq_n_s32(tv, 16), width));
+
+            for (j = 0; j < spancount; j++)
+                pdest[j] = pbase[offset[j]];
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_PackZ_NEON
+
+Packs the top halves of eight 1/z values to shorts, sign extending the first
+of every pair into the second like D_DrawZSpans
+=============
+*/
+static SIMD_INLINE int16x8_t D_PackZ_NEON(int32x4_t izi0, int32x4_t izi1)
+{
+    int32x4_t z0, z1;
+
+    z0 = vreinterpretq_s32_s16(vcombine_s16(vmovn_s32(vshrq_n_s32(izi0, 16)), vmovn_s32(vshrq_n_s32(izi1, 16))));
+    z1 = vshrq_n_s32(vshlq_n_s32(z0, 16), 16);
+    return vreinterpretq_s16_s32(vorrq_s32(z0, z1));
+}
+
+/*
+=============
+D_DrawZSpans_NEON
+=============
+*/
+static void D_DrawZSpans_NEON(espan_t *pspan)
+{
+    int count, izistep;
+    int izi;
+    short *pdest;
+    double zi;
+    float du, dv;
+    int32x4_t lanes, izi0, izi1, step;
+    short tail[8];
+    static const int32_t lanevalues[4] = { 0, 1, 2, 3 };
+
+    izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+    lanes = vmulq_s32(vld1q_s32(lanevalues), vdupq_n_s32(izistep));
+    step = vdupq_n_s32(8 * izistep);
+
+    do {
+        pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+
+        count = pspan->count;
+
+        du = (float)pspan->u;
+        dv = (float)pspan->v;
+
+        zi = d_ziorigin + dv * d_zistepv + du * d_zistepu;
+        izi = (int)(zi * 0x8000 * 0x10000);
+
+        if ((long)pdest & 0x02) {
+            *pdest++ = (short)(izi >> 16);
+            izi += izistep;
+            count--;
+        }
+
+        izi0 = vaddq_s32(vdupq_n_s32(izi), lanes);
+        izi1 = vaddq_s32(izi0, vdupq_n_s32(4 * izistep));
+
+        for (; count >= 8; count -= 8, pdest += 8) {
+            vst1q_s16(pdest, D_PackZ_NEON(izi0, izi1));
+            izi0 = vaddq_s32(izi0, step);
+            izi1 = vaddq_s32(izi1, step);
+        }
+
+        if (count > 0) {
+            vst1q_s16(tail, D_PackZ_NEON(izi0, izi1));
+            memcpy(pdest, tail, count * sizeof(short));
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawTurbulent8_NEON
+=============
+*/
+static void D_DrawTurbulent8_NEON(espan_t *pspan)
+{
+    spanends_t ends;
+    int i;
+
+    r_turb_turb = sintable + ((int)(cl.time * SPEED / MS_PER_S) & (CYCLE - 1));
+    r_turb_pbase = (unsigned char *)cacheblock;
+
+    do {
+        r_turb_pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_StepSpanEnds(pspan, 4, &ends);
+        D_DivideSpanEnds_NEON(&ends);
+        D_ClampSpanEnds(&ends, 16);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            r_turb_spancount = D_SpanSegmentSteps(&ends, i, 4, &r_turb_sstep, &r_turb_tstep);
+            r_turb_s = ends.s[i] & ((CYCLE << 16) - 1);
+            r_turb_t = ends.t[i] & ((CYCLE << 16) - 1);
+
+            D_DrawTurbulent8Span();
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawSkyScans8_NEON
+=============
+*/
+static void D_DrawSkyScans8_NEON(espan_t *pspan)
+{
+    skyends_t ends;
+    unsigned char *pdest;
+    int32x4_t lanes, mask, sv, tv, s4, t4;
+    int offset[SKY_SPAN_MAX];
+    int i, j, spancount;
+    static const int32_t lanevalues[4] = { 0, 1, 2, 3 };
+
+    lanes = vld1q_s32(lanevalues);
+    mask = vdupq_n_s32(R_SKY_SMASK);
+
+    do {
+        pdest = (unsigned char *)((byte *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u);
+
+        D_SkySpanEnds(pspan, &ends);
+
+        for (i = 0; i < ends.numsegments; i++) {
+            spancount = ends.count[i];
+
+            sv = vmlaq_s32(vdupq_n_s32(ends.s[i]), lanes, vdupq_n_s32(ends.sstep[i]));
+            tv = vmlaq_s32(vdupq_n_s32(ends.t[i]), lanes, vdupq_n_s32(ends.tstep[i]));
+            s4 = vdupq_n_s32(4 * ends.sstep[i]);
+            t4 = vdupq_n_s32(4 * ends.tstep[i]);
+            for (j = 0; j < spancount; j += 4) {
+                vst1q_s32(offset + j, vreinterpretq_s32_u32(
+                                          vaddq_u32(vshrq_n_u32(vreinterpretq_u32_s32(vandq_s32(tv, mask)), 8),
+                                                    vshrq_n_u32(vreinterpretq_u32_s32(vandq_s32(sv, mask)), 16))));
+                sv = vaddq_s32(sv, s4);
+                tv = vaddq_s32(tv, t4);
+            }
+
+            for (j = 0; j < spancount; j++)
+                pdest[j] = r_skysource[offset[j]];
+            pdest += spancount;
+        }
+    } while ((pspan = pspan->pnext) != NULL);
+}
+
+#endif // SIMD_NEON
+
+static spandrawers_t d_spandrawers[] = {
+    { "C", NULL, D_DrawSpans8, D_DrawZSpans, Turbulent8, D_DrawSkyScans8 },
+#ifdef SIMD_X86
+    { "SSE2", D_HasSSE2, D_DrawSpans8_SSE2, D_DrawZSpans_SSE2, D_DrawTurbulent8_SSE2, D_DrawSkyScans8_SSE2 },
+    { "AVX2", D_HasAVX2, D_DrawSpans8_AVX2, D_DrawZSpans_AVX2, D_DrawTurbulent8_AVX2, D_DrawSkyScans8_AVX2 },
+#endif
+#ifdef SIMD_NEON
+    { "NEON", NULL, D_DrawSpans8_NEON, D_DrawZSpans_NEON, D_DrawTurbulent8_NEON, D_DrawSkyScans8_NEON },
+#endif
+};
+
+#define NUM_SPANDRAWERS (int)(sizeof(d_spandrawers) / sizeof(d_spandrawers[0]))
+
+/*
+=============
+D_SpanDrawersSupported
+=============
+*/
+static qboolean D_SpanDrawersSupported(spandrawers_t *drawers)
+{
+    return !drawers->supported || drawers->supported();
+}
+
+/*
+=============
+D_UseSpanDrawers
+=============
+*/
+static void D_UseSpanDrawers(spandrawers_t *drawers)
+{
+    d_drawspans = drawers->drawspans;
+    d_drawzspans = drawers->drawzspans;
+    d_drawturbulent = drawers->drawturbulent;
+    d_drawskyscans = drawers->drawskyscans;
+}
+
+/*
+=============
+D_SelectSpanDrawers
+
+Picks the last, fastest, drawers the CPU runs
+=============
+*/
+void D_SelectSpanDrawers(void)
+{
+    static spandrawers_t *best;
+    int i;
+
+    if (!d_simd.value) {
+        D_UseSpanDrawers(&d_spandrawers[0]);
+        return;
+    }
+
+    if (!best)
+        for (i = 0; i < NUM_SPANDRAWERS; i++)
+            if (D_SpanDrawersSupported(&d_spandrawers[i]))
+                best = &d_spandrawers[i];
+
+    D_UseSpanDrawers(best);
+}
+
+//=============================================================================
+
+#define BENCH_SPANS 256
+#define BENCH_PASSES 3
+#define BENCH_TEXWIDTH 128
+#define BENCH_TEXHEIGHT 128
+
+typedef enum { bench_spans, bench_zspans, bench_turbulent, bench_sky, bench_count } benchkind_t;
+
+static char const *d_benchnames[bench_count] = { "spans", "z spans", "turbulent", "sky" };
+
+/*
+=============
+D_BenchRandom
+
+Same sequence on every run
+=============
+*/
+static unsigned D_BenchRandom(unsigned *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static float D_BenchRandomFloat(unsigned *seed, float min, float max)
+{
+    return min + (max - min) * (D_BenchRandom(seed) & 0xFFFF) / 65535.0f;
+}
+
+/*
+=============
+D_BenchSurface
+
+Random spans and a random surface facing the view at a slant, with the
+texture mapped at some random scale and offset. The surface can overhang
+the texture, the drawers clamp to it. Every eighth one has the depth
+D_DrawSurfaces gives the background
+=============
+*/
+static void D_BenchSurface(unsigned *seed, espan_t *spans, int index)
+{
+    int i;
+    float zi, scale;
+
+    zi = D_BenchRandomFloat(seed, 0.002f, 0.2f);
+    scale = D_BenchRandomFloat(seed, 0.05f, 2);
+
+    d_ziorigin = zi;
+    d_zistepu = D_BenchRandomFloat(seed, -1, 1) * zi / vid.width;
+    d_zistepv = D_BenchRandomFloat(seed, -1, 1) * zi / vid.height;
+    d_sdivzorigin = D_BenchRandomFloat(seed, -BENCH_TEXWIDTH, BENCH_TEXWIDTH) * zi;
+    d_sdivzstepu = scale * D_BenchRandomFloat(seed, -1, 1) * zi;
+    d_sdivzstepv = scale * D_BenchRandomFloat(seed, -1, 1) * zi;
+    d_tdivzorigin = D_BenchRandomFloat(seed, -BENCH_TEXHEIGHT, BENCH_TEXHEIGHT) * zi;
+    d_tdivzstepu = scale * D_BenchRandomFloat(seed, -1, 1) * zi;
+    d_tdivzstepv = scale * D_BenchRandomFloat(seed, -1, 1) * zi;
+
+    sadjust = D_BenchRandom(seed) % (BENCH_TEXWIDTH << 16);
+    tadjust = D_BenchRandom(seed) % (BENCH_TEXHEIGHT << 16);
+    bbextents = (BENCH_TEXWIDTH << 16) - 1;
+    bbextentt = (BENCH_TEXHEIGHT << 16) - 1;
+
+    for (i = 0; i < BENCH_SPANS; i++) {
+        spans[i].v = D_BenchRandom(seed) % vid.height;
+        spans[i].u = D_BenchRandom(seed) % vid.width;
+        spans[i].count = 1 + D_BenchRandom(seed) % (vid.width - spans[i].u);
+        spans[i].pnext = i < BENCH_SPANS - 1 ? &spans[i + 1] : NULL;
+    }
+
+    // some at the background's depth, behind the view
+    if (!(index & 7)) {
+        d_ziorigin = -0.9;
+        d_zistepu = 0;
+        d_zistepv = 0;
+    }
+}
+
+/*
+=============
+D_BenchDraw
+=============
+*/
+static void D_BenchDraw(spandrawers_t *drawers, benchkind_t kind, espan_t *spans)
+{
+    switch (kind) {
+    case bench_spans:
+        drawers->drawspans(spans);
+        break;
+    case bench_zspans:
+        drawers->drawzspans(spans);
+        break;
+    case bench_turbulent:
+        drawers->drawturbulent(spans);
+        break;
+    default:
+        drawers->drawskyscans(spans);
+        break;
+    }
+}
+
+/*
+=============
+D_SpanBenchmark_f
+
+d_spanbenchmark [surfaces]
+
+Draws the same random surfaces with every set of span drawers the CPU runs,
+and checks the frame and z buffer come out the same as with the C drawers
+=============
+*/
+static void D_SpanBenchmark_f(void)
+{
+    espan_t spans[BENCH_SPANS];
+    spandrawers_t *drawers;
+    pixel_t *viewbuffer, *texture, *reference;
+    short *zreference;
+    byte *skysource;
+    int oldscreenwidth, surfaces;
+    int i, j, kind, pass, mismatches;
+    unsigned seed;
+    uint64_t start, elapsed, best, time[bench_count];
+    size_t pixelsize, zsize;
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("d_spanbenchmark [surfaces]\n");
+        return;
+    }
+    if (!vid.buffer || !d_pzbuffer) {
+        Con_Printf("No video mode set.\n");
+        return;
+    }
+    surfaces = Cmd_Argc() == 2 ? Q_atoi(Cmd_Argv(1)) : 200;
+    if (surfaces < 1)
+        surfaces = 1;
+
+    pixelsize = vid.rowbytes * vid.height;
+    zsize = d_zwidth * vid.height * sizeof(short);
+
+    // the texture is big enough for the 64x64 turbulent ones and the sky,
+    // with room for the gathers to read past the last texel
+    reference = (pixel_t *)Hunk_TempAlloc(pixelsize + zsize + 128 * 256 + 4);
+    zreference = (short *)(reference + pixelsize);
+    texture = reference + pixelsize + zsize;
+    for (i = 0; i < 128 * 256 + 4; i++)
+        texture[i] = i * 7 + (i >> 7) * 13;
+
+    viewbuffer = d_viewbuffer;
+    oldscreenwidth = screenwidth;
+    skysource = r_skysource;
+    d_viewbuffer = vid.buffer;
+    screenwidth = vid.rowbytes;
+    r_skysource = texture;
+    cacheblock = texture;
+    cachewidth = BENCH_TEXWIDTH;
+
+    Con_Printf("%i surfaces of %i spans, best of %i ms:\n", surfaces, BENCH_SPANS, BENCH_PASSES);
+    Con_Printf("drawers     spans   z spans turbulent       sky\n");
+
+    for (i = 0; i < NUM_SPANDRAWERS; i++) {
+        drawers = &d_spandrawers[i];
+        if (!D_SpanDrawersSupported(drawers))
+            continue;
+
+        mismatches = 0;
+        for (kind = 0; kind < bench_count; kind++) {
+            seed = 1;
+            time[kind] = 0;
+            for (j = 0; j < surfaces; j++) {
+                D_BenchSurface(&seed, spans, j);
+
+                // what the C drawers draw into cleared buffers
+                if (i) {
+                    memset(vid.buffer, 0, pixelsize);
+                    memset(d_pzbuffer, 0, zsize);
+                    D_BenchDraw(&d_spandrawers[0], (benchkind_t)kind, spans);
+                    memcpy(reference, vid.buffer, pixelsize);
+                    memcpy(zreference, d_pzbuffer, zsize);
+                }
+
+                // the best of a few, the first one also warms up the caches
+                best = UINT64_MAX;
+                for (pass = 0; pass < BENCH_PASSES; pass++) {
+                    memset(vid.buffer, 0, pixelsize);
+                    memset(d_pzbuffer, 0, zsize);
+                    start = Sys_MicroTicks();
+                    D_BenchDraw(drawers, (benchkind_t)kind, spans);
+                    elapsed = Sys_MicroTicks() - start;
+                    if (elapsed < best)
+                        best = elapsed;
+                }
+                time[kind] += best;
+
+                if (i && (memcmp(reference, vid.buffer, pixelsize) || memcmp(zreference, d_pzbuffer, zsize)))
+                    mismatches |= 1 << kind;
+            }
+        }
+
+        Con_Printf("%-6s %9.2f %9.2f %9.2f %9.2f\n", drawers->name, time[bench_spans] / 1000.0,
+                   time[bench_zspans] / 1000.0, time[bench_turbulent] / 1000.0, time[bench_sky] / 1000.0);
+        for (kind = 0; kind < bench_count; kind++)
+            if (mismatches & (1 << kind))
+                Con_Printf("%s %s don't match the C drawers\n", drawers->name, d_benchnames[kind]);
+    }
+
+    d_viewbuffer = viewbuffer;
+    screenwidth = oldscreenwidth;
+    r_skysource = skysource;
+}
+
+CMD_REGISTER("d_spanbenchmark", D_SpanBenchmark_f);
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // sprites
 
 #include "quakedef.h"
+#include "r_local.h"
 #include "d_local.h"
 
 static int sprite_height;
@@ -366,6 +367,10 @@ void D_DrawSprite(void)
     emitpoint_t *pverts;
     sspan_t spans[MAXHEIGHT + 1];
 
+    // sprites aren't queued, draw everything queued before them first
+    if (r_bandqueue)
+        R_BandFlush();
+
     // find the top and bottom vertices, and make sure there's at least one scan to
     // draw
     ymin = 999999.9;
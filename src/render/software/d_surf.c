@@ -241,10 +241,13 @@ int D_log2(int num)
 
 /*
 ================
-D_CacheSurface
+D_AllocSurface
+
+Fills in r_drawsurf and allocates the cache of a surface that has to be
+drawn. False if the cache still holds it.
 ================
 */
-surfcache_t *D_CacheSurface(msurface_t *surface, int miplevel)
+qboolean D_AllocSurface(msurface_t *surface, int miplevel, surfcache_t **pcache)
 {
     surfcache_t *cache;
 
@@ -261,11 +264,12 @@ surfcache_t *D_CacheSurface(msurface_t *surface, int miplevel)
     // see if the cache holds apropriate data
     //
     cache = surface->cachespots[miplevel];
+    *pcache = cache;
 
     if (cache && !cache->dlight && surface->dlightframe != r_framecount && cache->texture == r_drawsurf.texture &&
         cache->lightadj[0] == r_drawsurf.lightadj[0] && cache->lightadj[1] == r_drawsurf.lightadj[1] &&
         cache->lightadj[2] == r_drawsurf.lightadj[2] && cache->lightadj[3] == r_drawsurf.lightadj[3])
-        return cache;
+        return false;
 
     //
     // determine shape of surface
@@ -285,6 +289,7 @@ surfcache_t *D_CacheSurface(msurface_t *surface, int miplevel)
         surface->cachespots[miplevel] = cache;
         cache->owner = &surface->cachespots[miplevel];
         cache->mipscale = surfscale;
+        *pcache = cache;
     }
 
     if (surface->dlightframe == r_framecount)
@@ -300,13 +305,28 @@ surfcache_t *D_CacheSurface(msurface_t *surface, int miplevel)
     cache->lightadj[2] = r_drawsurf.lightadj[2];
     cache->lightadj[3] = r_drawsurf.lightadj[3];
 
+    r_drawsurf.surf = surface;
+
+    return true;
+}
+
+/*
+================
+D_CacheSurface
+================
+*/
+surfcache_t *D_CacheSurface(msurface_t *surface, int miplevel)
+{
+    surfcache_t *cache;
+
+    if (!D_AllocSurface(surface, miplevel, &cache))
+        return cache;
+
     //
     // draw and light the surface texture
     //
-    r_drawsurf.surf = surface;
-
     c_surf++;
     R_DrawSurface();
 
-    return surface->cachespots[miplevel];
+    return cache;
 }
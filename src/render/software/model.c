@@ -32,8 +32,7 @@ void Mod_LoadSpriteModel(model_t *mod, void *buffer);
 void Mod_LoadBrushModel(model_t *mod, void *buffer);
 void Mod_LoadAliasModel(model_t *mod, void *buffer);
 model_t *Mod_LoadModel(model_t *mod, qboolean crash);
-
-byte mod_novis[MAX_MAP_LEAFS / 8];
+static qboolean Mod_LoadBakedBrushModel(model_t *mod);
 
 static model_t mod_known[MAX_MOD_KNOWN];
 static int mod_numknown;
@@ -50,7 +49,7 @@ Mod_Init
 */
 void Mod_Init(void)
 {
-    memset(mod_novis, 0xff, sizeof(mod_novis));
+    PVS_Init();
 }
 
 /*
@@ -104,53 +103,6 @@ mleaf_t *Mod_PointInLeaf(vec3_t p, model_t *model)
     return NULL; // never reached
 }
 
-/*
-===================
-Mod_DecompressVis
-===================
-*/
-byte *Mod_DecompressVis(byte *in, model_t *model)
-{
-    static byte decompressed[MAX_MAP_LEAFS / 8];
-    int c;
-    byte *out;
-    int row;
-
-    row = (model->numleafs + 7) >> 3;
-    out = decompressed;
-
-    if (!in) { // no vis info, so make all visible
-        while (row) {
-            *out++ = 0xff;
-            row--;
-        }
-        return decompressed;
-    }
-
-    do {
-        if (*in) {
-            *out++ = *in++;
-            continue;
-        }
-
-        c = in[1];
-        in += 2;
-        while (c) {
-            *out++ = 0;
-            c--;
-        }
-    } while (out - decompressed < row);
-
-    return decompressed;
-}
-
-byte *Mod_LeafPVS(mleaf_t *leaf, model_t *model)
-{
-    if (leaf == model->leafs)
-        return mod_novis;
-    return Mod_DecompressVis(leaf->compressed_vis, model);
-}
-
 /*
 ===================
 Mod_ClearAll
@@ -240,8 +192,10 @@ Loads a model into the cache
 */
 model_t *Mod_LoadModel(model_t *mod, qboolean crash)
 {
+    hunksubsystem_t prev;
     unsigned *buf;
     byte stackbuf[1024]; // avoid dirtying the cache heap
+    int len;
 
     if (mod->type == mod_alias) {
         if (Cache_Check(&mod->cache)) {
@@ -253,17 +207,27 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
             return mod;
     }
 
+    PROF_BEGIN("Mod_LoadModel");
+
     //
     // because the world is so huge, load it one piece at a time
     //
+    if (Mod_LoadBakedBrushModel(mod)) {
+        PROF_END();
+        return mod;
+    }
 
     //
     // load the file
     //
-    buf = (unsigned *)COM_LoadStackFile(mod->name, stackbuf, sizeof(stackbuf));
+    // the loaders only read their input, so parse straight out of the pak when possible
+    buf = (unsigned *)COM_MapFile(mod->name, &len);
+    if (!buf)
+        buf = (unsigned *)COM_LoadStackFile(mod->name, stackbuf, sizeof(stackbuf));
     if (!buf) {
         if (crash)
             Sys_Error("Mod_NumForName: %s not found", mod->name);
+        PROF_END();
         return NULL;
     }
 
@@ -280,6 +244,7 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
 
     // call the apropriate loader
     mod->needload = NL_PRESENT;
+    prev = Hunk_Subsystem(hs_model);
 
     switch (LittleLong(*(unsigned *)buf)) {
     case IDPOLYHEADER:
@@ -295,6 +260,8 @@ model_t *Mod_LoadModel(model_t *mod, qboolean crash)
         break;
     }
 
+    Hunk_Subsystem(prev);
+    PROF_END();
     return mod;
 }
 
@@ -337,6 +304,7 @@ void Mod_LoadTextures(lump_t *l)
     texture_t *anims[10];
     texture_t *altanims[10];
     dmiptexlump_t *m;
+    int nummiptex, dataofs, width, height;
 
     if (!l->filelen) {
         loadmodel->textures = NULL;
@@ -344,32 +312,31 @@ void Mod_LoadTextures(lump_t *l)
     }
     m = (dmiptexlump_t *)(mod_base + l->fileofs);
 
-    m->nummiptex = LittleLong(m->nummiptex);
+    // the lump may be a read only pak mapping, so swap into locals
+    nummiptex = LittleLong(m->nummiptex);
 
-    loadmodel->numtextures = m->nummiptex;
-    loadmodel->textures = Hunk_AllocName(m->nummiptex * sizeof(*loadmodel->textures), loadname);
+    loadmodel->numtextures = nummiptex;
+    loadmodel->textures = Hunk_AllocName(nummiptex * sizeof(*loadmodel->textures), loadname);
 
-    for (i = 0; i < m->nummiptex; i++) {
-        m->dataofs[i] = LittleLong(m->dataofs[i]);
-        if (m->dataofs[i] == -1)
+    for (i = 0; i < nummiptex; i++) {
+        dataofs = LittleLong(m->dataofs[i]);
+        if (dataofs == -1)
             continue;
-        mt = (miptex_t *)((byte *)m + m->dataofs[i]);
-        mt->width = LittleLong(mt->width);
-        mt->height = LittleLong(mt->height);
-        for (j = 0; j < MIPLEVELS; j++)
-            mt->offsets[j] = LittleLong(mt->offsets[j]);
+        mt = (miptex_t *)((byte *)m + dataofs);
+        width = LittleLong(mt->width);
+        height = LittleLong(mt->height);
 
-        if ((mt->width & 15) || (mt->height & 15))
+        if ((width & 15) || (height & 15))
             Sys_Error("Texture %s is not 16 aligned", mt->name);
-        pixels = mt->width * mt->height / 64 * 85;
+        pixels = width * height / 64 * 85;
         tx = Hunk_AllocName(sizeof(texture_t) + pixels, loadname);
         loadmodel->textures[i] = tx;
 
         memcpy(tx->name, mt->name, sizeof(tx->name));
-        tx->width = mt->width;
-        tx->height = mt->height;
+        tx->width = width;
+        tx->height = height;
         for (j = 0; j < MIPLEVELS; j++)
-            tx->offsets[j] = mt->offsets[j] + sizeof(texture_t) - sizeof(miptex_t);
+            tx->offsets[j] = LittleLong(mt->offsets[j]) + sizeof(texture_t) - sizeof(miptex_t);
         // the pixels immediately follow the structures
         memcpy(tx + 1, mt + 1, pixels);
 
@@ -380,7 +347,7 @@ void Mod_LoadTextures(lump_t *l)
     //
     // sequence the animations
     //
-    for (i = 0; i < m->nummiptex; i++) {
+    for (i = 0; i < nummiptex; i++) {
         tx = loadmodel->textures[i];
         if (!tx || tx->name[0] != '+')
             continue;
@@ -408,7 +375,7 @@ void Mod_LoadTextures(lump_t *l)
         } else
             Sys_Error("Bad animating texture %s", tx->name);
 
-        for (j = i + 1; j < m->nummiptex; j++) {
+        for (j = i + 1; j < nummiptex; j++) {
             tx2 = loadmodel->textures[j];
             if (!tx2 || tx2->name[0] != '+')
                 continue;
@@ -1073,40 +1040,43 @@ Mod_LoadBrushModel
 void Mod_LoadBrushModel(model_t *mod, void *buffer)
 {
     int i, j;
-    dheader_t *header;
+    dheader_t header;
     dmodel_t *bm;
 
-    loadmodel->type = mod_brush;
+    PROF_BEGIN("Mod_LoadBrushModel");
 
-    header = (dheader_t *)buffer;
-
-    i = LittleLong(header->version);
-    if (i != BSPVERSION)
-        Sys_Error("Mod_LoadBrushModel: %s has wrong version number (%i should be %i)", mod->name, i, BSPVERSION);
+    loadmodel->type = mod_brush;
 
-    // swap all the lumps
-    mod_base = (byte *)header;
+    // swap all the lumps, into a copy since the buffer may be a read only pak mapping
+    mod_base = (byte *)buffer;
 
     for (i = 0; i < sizeof(dheader_t) / 4; i++)
-        ((int *)header)[i] = LittleLong(((int *)header)[i]);
+        ((int *)&header)[i] = LittleLong(((int *)buffer)[i]);
+
+    if (header.version != BSPVERSION)
+        Sys_Error("Mod_LoadBrushModel: %s has wrong version number (%i should be %i)", mod->name, header.version,
+                  BSPVERSION);
 
     // load into heap
 
-    Mod_LoadVertexes(&header->lumps[LUMP_VERTEXES]);
-    Mod_LoadEdges(&header->lumps[LUMP_EDGES]);
-    Mod_LoadSurfedges(&header->lumps[LUMP_SURFEDGES]);
-    Mod_LoadTextures(&header->lumps[LUMP_TEXTURES]);
-    Mod_LoadLighting(&header->lumps[LUMP_LIGHTING]);
-    Mod_LoadPlanes(&header->lumps[LUMP_PLANES]);
-    Mod_LoadTexinfo(&header->lumps[LUMP_TEXINFO]);
-    Mod_LoadFaces(&header->lumps[LUMP_FACES]);
-    Mod_LoadMarksurfaces(&header->lumps[LUMP_MARKSURFACES]);
-    Mod_LoadVisibility(&header->lumps[LUMP_VISIBILITY]);
-    Mod_LoadLeafs(&header->lumps[LUMP_LEAFS]);
-    Mod_LoadNodes(&header->lumps[LUMP_NODES]);
-    Mod_LoadClipnodes(&header->lumps[LUMP_CLIPNODES]);
-    Mod_LoadEntities(&header->lumps[LUMP_ENTITIES]);
-    Mod_LoadSubmodels(&header->lumps[LUMP_MODELS]);
+    Mod_LoadVertexes(&header.lumps[LUMP_VERTEXES]);
+    Mod_LoadEdges(&header.lumps[LUMP_EDGES]);
+    Mod_LoadSurfedges(&header.lumps[LUMP_SURFEDGES]);
+    Hunk_Subsystem(hs_texture);
+    Mod_LoadTextures(&header.lumps[LUMP_TEXTURES]);
+    Hunk_Subsystem(hs_lightmap);
+    Mod_LoadLighting(&header.lumps[LUMP_LIGHTING]);
+    Hunk_Subsystem(hs_model);
+    Mod_LoadPlanes(&header.lumps[LUMP_PLANES]);
+    Mod_LoadTexinfo(&header.lumps[LUMP_TEXINFO]);
+    Mod_LoadFaces(&header.lumps[LUMP_FACES]);
+    Mod_LoadMarksurfaces(&header.lumps[LUMP_MARKSURFACES]);
+    Mod_LoadVisibility(&header.lumps[LUMP_VISIBILITY]);
+    Mod_LoadLeafs(&header.lumps[LUMP_LEAFS]);
+    Mod_LoadNodes(&header.lumps[LUMP_NODES]);
+    Mod_LoadClipnodes(&header.lumps[LUMP_CLIPNODES]);
+    Mod_LoadEntities(&header.lumps[LUMP_ENTITIES]);
+    Mod_LoadSubmodels(&header.lumps[LUMP_MODELS]);
 
     Mod_MakeHull0();
 
@@ -1147,6 +1117,154 @@ void Mod_LoadBrushModel(model_t *mod, void *buffer)
             mod = loadmodel;
         }
     }
+    PROF_END();
+}
+
+/*
+===============================================================================
+
+					BAKED BRUSH MODELS
+
+===============================================================================
+*/
+
+static int const mod_bakesizes[] = {
+    sizeof(mplane_t), sizeof(texture_t), sizeof(medge_t), sizeof(mtexinfo_t), sizeof(msurface_t),
+    sizeof(mnode_t), sizeof(mleaf_t), sizeof(hull_t), sizeof(dmodel_t), sizeof(dclipnode_t),
+};
+
+static void *const mod_bakeexternals[] = { &r_notexture_mip };
+
+bakeformat_t const mod_bakeformat = {
+    ".bsw", mod_bakesizes, sizeof(mod_bakesizes) / sizeof(mod_bakesizes[0]),
+    mod_bakeexternals, sizeof(mod_bakeexternals) / sizeof(mod_bakeexternals[0]),
+};
+
+/*
+=================
+Mod_BakeModel
+
+Every pointer Mod_LoadBrushModel sets up, the rest are NULL until drawn
+=================
+*/
+void Mod_BakeModel(model_t *mod, int mark)
+{
+    model_t *models[MAX_MAP_MODELS];
+    texture_t *tx;
+    mnode_t *node;
+    mleaf_t *leaf;
+    char name[10];
+    int i, j, numleafs;
+
+    if (mod->numsubmodels < 1 || mod->numsubmodels > MAX_MAP_MODELS) {
+        Con_Printf("%s has %i submodels\n", mod->name, mod->numsubmodels);
+        return;
+    }
+    models[0] = mod;
+    for (i = 1; i < mod->numsubmodels; i++) {
+        snprintf(name, sizeof(name), "*%i", i);
+        models[i] = Mod_FindName(name);
+    }
+
+    Mod_BakeBegin(&mod_bakeformat, mark, models, mod->numsubmodels);
+
+    for (i = 0; i < mod->numsubmodels; i++) {
+        Mod_BakePointer(&models[i]->submodels);
+        Mod_BakePointer(&models[i]->planes);
+        Mod_BakePointer(&models[i]->leafs);
+        Mod_BakePointer(&models[i]->vertexes);
+        Mod_BakePointer(&models[i]->edges);
+        Mod_BakePointer(&models[i]->nodes);
+        Mod_BakePointer(&models[i]->texinfo);
+        Mod_BakePointer(&models[i]->surfaces);
+        Mod_BakePointer(&models[i]->surfedges);
+        Mod_BakePointer(&models[i]->clipnodes);
+        Mod_BakePointer(&models[i]->marksurfaces);
+        for (j = 0; j < MAX_MAP_HULLS; j++) {
+            Mod_BakePointer(&models[i]->hulls[j].clipnodes);
+            Mod_BakePointer(&models[i]->hulls[j].planes);
+        }
+        Mod_BakePointer(&models[i]->textures);
+        Mod_BakePointer(&models[i]->visdata);
+        Mod_BakePointer(&models[i]->lightdata);
+        Mod_BakePointer(&models[i]->entities);
+    }
+
+    for (i = 0; i < mod->numtextures; i++) {
+        Mod_BakePointer(&mod->textures[i]);
+        tx = mod->textures[i];
+        if (tx) {
+            Mod_BakePointer(&tx->anim_next);
+            Mod_BakePointer(&tx->alternate_anims);
+        }
+    }
+    for (i = 0; i < mod->numtexinfo; i++)
+        Mod_BakePointer(&mod->texinfo[i].texture);
+    for (i = 0; i < mod->numsurfaces; i++) {
+        Mod_BakePointer(&mod->surfaces[i].plane);
+        Mod_BakePointer(&mod->surfaces[i].texinfo);
+        Mod_BakePointer(&mod->surfaces[i].samples);
+    }
+    for (i = 0; i < mod->nummarksurfaces; i++)
+        Mod_BakePointer(&mod->marksurfaces[i]);
+
+    // numleafs only counts the world's, the submodels' leafs come after them
+    numleafs = 1;
+    for (i = 0, node = mod->nodes; i < mod->numnodes; i++, node++) {
+        Mod_BakePointer(&node->parent);
+        Mod_BakePointer(&node->plane);
+        for (j = 0; j < 2; j++) {
+            Mod_BakePointer(&node->children[j]);
+            leaf = (mleaf_t *)node->children[j];
+            if (leaf->contents < 0 && leaf - mod->leafs >= numleafs)
+                numleafs = leaf - mod->leafs + 1;
+        }
+    }
+    for (i = 0, leaf = mod->leafs; i < numleafs; i++, leaf++) {
+        Mod_BakePointer(&leaf->parent);
+        Mod_BakePointer(&leaf->compressed_vis);
+        Mod_BakePointer(&leaf->firstmarksurface);
+    }
+
+    Mod_BakeEnd(mod->name);
+}
+
+/*
+=================
+Mod_LoadBakedBrushModel
+=================
+*/
+static qboolean Mod_LoadBakedBrushModel(model_t *mod)
+{
+    model_t const *models;
+    model_t *out;
+    char name[MAX_QPATH];
+    hunksubsystem_t prev;
+    int i, nummodels;
+
+    prev = Hunk_Subsystem(hs_model);
+    nummodels = Mod_LoadBaked(&mod_bakeformat, mod->name, &models);
+    Hunk_Subsystem(prev);
+    if (!nummodels)
+        return false;
+
+    Q_strcpy(name, mod->name);
+    for (i = 0, out = mod; i < nummodels; i++) {
+        if (i) {
+            snprintf(name, sizeof(name), "*%i", i);
+            out = Mod_FindName(name);
+        }
+        *out = models[i];
+        Q_strcpy(out->name, name);
+        out->needload = NL_PRESENT;
+    }
+
+    // what the parser set up outside the model
+    for (i = 0; i < mod->numtextures; i++)
+        if (mod->textures[i] && !Q_strncmp(mod->textures[i]->name, "sky", 3))
+            R_InitSky(mod->textures[i]);
+
+    return true;
 }
 
 /*
@@ -1358,6 +1476,8 @@ void Mod_LoadAliasModel(model_t *mod, void *buffer)
     int skinsize;
     int start, end, total;
 
+    PROF_BEGIN("Mod_LoadAliasModel");
+
     start = Hunk_LowMark();
 
     pinmodel = (mdl_t *)buffer;
@@ -1523,11 +1643,14 @@ void Mod_LoadAliasModel(model_t *mod, void *buffer)
     total = end - start;
 
     Cache_Alloc(&mod->cache, total, loadname);
-    if (!mod->cache.data)
+    if (!mod->cache.data) {
+        PROF_END();
         return;
+    }
     memcpy(mod->cache.data, pheader, total);
 
     Hunk_FreeToLowMark(start);
+    PROF_END();
 }
 
 //=============================================================================
@@ -1644,6 +1767,8 @@ void Mod_LoadSpriteModel(model_t *mod, void *buffer)
     int size;
     dspriteframetype_t *pframetype;
 
+    PROF_BEGIN("Mod_LoadSpriteModel");
+
     pin = (dsprite_t *)buffer;
 
     version = LittleLong(pin->version);
@@ -1697,6 +1822,7 @@ void Mod_LoadSpriteModel(model_t *mod, void *buffer)
     }
 
     mod->type = mod_sprite;
+    PROF_END();
 }
 
 //=============================================================================
@@ -216,8 +216,11 @@ void R_AliasClipTriangle(mtriangle_t *ptri)
     clipflags = fv[0][0].flags | fv[0][1].flags | fv[0][2].flags;
 
     if (clipflags & ALIAS_Z_CLIP) {
-        for (i = 0; i < 3; i++)
-            av[i] = pauxverts[ptri->vertindex[i]];
+        for (i = 0; i < 3; i++) {
+            av[i].fv[0] = paliasverts->x[ptri->vertindex[i]];
+            av[i].fv[1] = paliasverts->y[ptri->vertindex[i]];
+            av[i].fv[2] = paliasverts->z[ptri->vertindex[i]];
+        }
 
         k = R_AliasClip(fv[0], fv[1], ALIAS_Z_CLIP, 3, R_Alias_clip_z);
         if (k == 0)
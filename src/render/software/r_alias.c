@@ -24,13 +24,19 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "d_local.h" // FIXME: shouldn't be needed (is needed for patch
     // right now, but that should move)
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #define LIGHT_MIN                                     \
     5 // lowest light value we'll allow, to avoid the need for inner-loop light clamping
 
 mtriangle_t *ptriangles;
-affinetridesc_t r_affinetridesc;
+THREAD_LOCAL affinetridesc_t r_affinetridesc;
 
-void *acolormap; // FIXME: should go away
+THREAD_LOCAL void *acolormap; // FIXME: should go away
 
 trivertx_t *r_apverts;
 
@@ -41,7 +47,7 @@ int r_ambientlight;
 float r_shadelight;
 aliashdr_t *paliashdr;
 finalvert_t *pfinalverts;
-auxvert_t *pauxverts;
+aliasverts_t *paliasverts;
 static float ziscale;
 static model_t *pmodel;
 
@@ -69,12 +75,30 @@ float r_avertexnormals[NUMVERTEXNORMALS][3] = {
 #include "anorms.h"
 };
 
+// the light of a vertex with each of the normals, for the model being drawn
+static int r_alightnormals[NUMVERTEXNORMALS];
+
 void R_AliasTransformAndProjectFinalVerts(finalvert_t *fv, stvert_t *pstverts);
 void R_AliasSetUpTransform(int trivial_accept);
 void R_AliasTransformVector(vec3_t in, vec3_t out);
-void R_AliasTransformFinalVert(finalvert_t *fv, auxvert_t *av, trivertx_t *pverts, stvert_t *pstverts);
 void R_AliasProjectFinalVert(finalvert_t *fv, auxvert_t *av);
 
+/*
+================
+R_AliasExtradata
+
+Loading a model can throw out the ones still queued for the bands, so those
+are drawn first
+================
+*/
+static aliashdr_t *R_AliasExtradata(model_t *model)
+{
+    if (r_bandqueue && !Cache_Check(&model->cache))
+        R_BandFlush();
+
+    return (aliashdr_t *)Mod_Extradata(model);
+}
+
 /*
 ================
 R_AliasCheckBBox
@@ -96,7 +120,7 @@ qboolean R_AliasCheckBBox(void)
 
     currententity->trivial_accept = 0;
     pmodel = currententity->model;
-    pahdr = Mod_Extradata(pmodel);
+    pahdr = R_AliasExtradata(pmodel);
     pmdl = (mdl_t *)((byte *)pahdr + pahdr->model);
 
     R_AliasSetUpTransform(0);
@@ -227,6 +251,96 @@ void R_AliasTransformVector(vec3_t in, vec3_t out)
     out[2] = DotProduct(in, aliastransform[2]) + aliastransform[2][3];
 }
 
+/*
+================
+R_AliasTransformVerts
+
+Decodes the frame's vertices into paliasverts and moves them into view space.
+The lanes past the last vertex of the last batch get a z of 1.
+================
+*/
+static void R_AliasTransformVerts(trivertx_t *pverts, int numverts)
+{
+    float *x, *y, *z;
+    int i;
+
+    x = paliasverts->x;
+    y = paliasverts->y;
+    z = paliasverts->z;
+
+    i = 0;
+#if defined(__SSE2__)
+    {
+        __m128i bytes, mask;
+        __m128 vx, vy, vz, m[3][4];
+        int j, k;
+
+        for (j = 0; j < 3; j++)
+            for (k = 0; k < 4; k++)
+                m[j][k] = _mm_set1_ps(aliastransform[j][k]);
+        mask = _mm_set1_epi32(0xFF);
+
+        // a trivertx_t is 4 bytes, a batch of them is one vector
+        for (; i + ALIAS_BATCH <= numverts; i += ALIAS_BATCH) {
+            bytes = _mm_loadu_si128((__m128i const *)(pverts + i));
+            vx = _mm_cvtepi32_ps(_mm_and_si128(bytes, mask));
+            vy = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bytes, 8), mask));
+            vz = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bytes, 16), mask));
+
+            _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m[0][0]), _mm_mul_ps(vy, m[0][1])),
+                                                       _mm_mul_ps(vz, m[0][2])),
+                                            m[0][3]));
+            _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m[1][0]), _mm_mul_ps(vy, m[1][1])),
+                                                       _mm_mul_ps(vz, m[1][2])),
+                                            m[1][3]));
+            _mm_storeu_ps(z + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m[2][0]), _mm_mul_ps(vy, m[2][1])),
+                                                       _mm_mul_ps(vz, m[2][2])),
+                                            m[2][3]));
+        }
+    }
+#elif defined(__ARM_NEON)
+    {
+        uint32x4_t bytes, mask;
+        float32x4_t vx, vy, vz, m[3][4];
+        int j, k;
+
+        for (j = 0; j < 3; j++)
+            for (k = 0; k < 4; k++)
+                m[j][k] = vdupq_n_f32(aliastransform[j][k]);
+        mask = vdupq_n_u32(0xFF);
+
+        for (; i + ALIAS_BATCH <= numverts; i += ALIAS_BATCH) {
+            bytes = vreinterpretq_u32_u8(vld1q_u8((uint8_t const *)(pverts + i)));
+            vx = vcvtq_f32_u32(vandq_u32(bytes, mask));
+            vy = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(bytes, 8), mask));
+            vz = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(bytes, 16), mask));
+
+            vst1q_f32(x + i, vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(vx, m[0][0]), vmulq_f32(vy, m[0][1])),
+                                                 vmulq_f32(vz, m[0][2])),
+                                       m[0][3]));
+            vst1q_f32(y + i, vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(vx, m[1][0]), vmulq_f32(vy, m[1][1])),
+                                                 vmulq_f32(vz, m[1][2])),
+                                       m[1][3]));
+            vst1q_f32(z + i, vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(vx, m[2][0]), vmulq_f32(vy, m[2][1])),
+                                                 vmulq_f32(vz, m[2][2])),
+                                       m[2][3]));
+        }
+    }
+#endif
+
+    for (; i < numverts; i++) {
+        x[i] = DotProduct(pverts[i].v, aliastransform[0]) + aliastransform[0][3];
+        y[i] = DotProduct(pverts[i].v, aliastransform[1]) + aliastransform[1][3];
+        z[i] = DotProduct(pverts[i].v, aliastransform[2]) + aliastransform[2][3];
+    }
+
+    for (; i & (ALIAS_BATCH - 1); i++) {
+        x[i] = 0;
+        y[i] = 0;
+        z[i] = 1;
+    }
+}
+
 /*
 ================
 R_AliasPreparePoints
@@ -236,33 +350,113 @@ General clipped case
 */
 void R_AliasPreparePoints(void)
 {
-    int i;
+    int i, j, count;
+    int u[ALIAS_BATCH], v[ALIAS_BATCH], izi[ALIAS_BATCH], flags[ALIAS_BATCH];
+    float *x, *y, *z;
     stvert_t *pstverts;
     finalvert_t *fv;
-    auxvert_t *av;
     mtriangle_t *ptri;
     finalvert_t *pfv[3];
 
     pstverts = (stvert_t *)((byte *)paliashdr + paliashdr->stverts);
     r_anumverts = pmdl->numverts;
     fv = pfinalverts;
-    av = pauxverts;
-
-    for (i = 0; i < r_anumverts; i++, fv++, av++, r_apverts++, pstverts++) {
-        R_AliasTransformFinalVert(fv, av, r_apverts, pstverts);
-        if (av->fv[2] < ALIAS_Z_CLIP_PLANE)
-            fv->flags |= ALIAS_Z_CLIP;
-        else {
-            R_AliasProjectFinalVert(fv, av);
-
-            if (fv->v[0] < r_refdef.aliasvrect.x)
-                fv->flags |= ALIAS_LEFT_CLIP;
-            if (fv->v[1] < r_refdef.aliasvrect.y)
-                fv->flags |= ALIAS_TOP_CLIP;
-            if (fv->v[0] > r_refdef.aliasvrectright)
-                fv->flags |= ALIAS_RIGHT_CLIP;
-            if (fv->v[1] > r_refdef.aliasvrectbottom)
-                fv->flags |= ALIAS_BOTTOM_CLIP;
+
+    R_AliasTransformVerts(r_apverts, r_anumverts);
+    x = paliasverts->x;
+    y = paliasverts->y;
+    z = paliasverts->z;
+
+    // project and outcode a batch at a time, the vertices in front of the
+    // near clip plane only get their flags
+    for (i = 0; i < r_anumverts; i += ALIAS_BATCH) {
+#if defined(__SSE2__)
+        __m128 vz, vzi;
+        __m128i vu, vv, vflags, zclip;
+
+        vz = _mm_loadu_ps(z + i);
+        vzi = _mm_div_ps(_mm_set1_ps(1), vz);
+        vu = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(x + i), _mm_set1_ps(aliasxscale)), vzi),
+                                         _mm_set1_ps(aliasxcenter)));
+        vv = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(y + i), _mm_set1_ps(aliasyscale)), vzi),
+                                         _mm_set1_ps(aliasycenter)));
+        _mm_storeu_si128((__m128i *)u, vu);
+        _mm_storeu_si128((__m128i *)v, vv);
+        _mm_storeu_si128((__m128i *)izi, _mm_cvttps_epi32(_mm_mul_ps(vzi, _mm_set1_ps(ziscale))));
+
+        vflags = _mm_and_si128(_mm_cmplt_epi32(vu, _mm_set1_epi32(r_refdef.aliasvrect.x)),
+                               _mm_set1_epi32(ALIAS_LEFT_CLIP));
+        vflags = _mm_or_si128(vflags, _mm_and_si128(_mm_cmplt_epi32(vv, _mm_set1_epi32(r_refdef.aliasvrect.y)),
+                                                    _mm_set1_epi32(ALIAS_TOP_CLIP)));
+        vflags = _mm_or_si128(vflags, _mm_and_si128(_mm_cmpgt_epi32(vu, _mm_set1_epi32(r_refdef.aliasvrectright)),
+                                                    _mm_set1_epi32(ALIAS_RIGHT_CLIP)));
+        vflags = _mm_or_si128(vflags, _mm_and_si128(_mm_cmpgt_epi32(vv, _mm_set1_epi32(r_refdef.aliasvrectbottom)),
+                                                    _mm_set1_epi32(ALIAS_BOTTOM_CLIP)));
+        zclip = _mm_castps_si128(_mm_cmplt_ps(vz, _mm_set1_ps(ALIAS_Z_CLIP_PLANE)));
+        vflags = _mm_or_si128(_mm_andnot_si128(zclip, vflags), _mm_and_si128(zclip, _mm_set1_epi32(ALIAS_Z_CLIP)));
+        _mm_storeu_si128((__m128i *)flags, vflags);
+#elif defined(__ARM_NEON)
+        float32x4_t vz, vzi;
+        int32x4_t vu, vv;
+        uint32x4_t vflags, zclip;
+
+        vz = vld1q_f32(z + i);
+        vzi = vdivq_f32(vdupq_n_f32(1), vz);
+        vu = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vmulq_n_f32(vld1q_f32(x + i), aliasxscale), vzi),
+                                     vdupq_n_f32(aliasxcenter)));
+        vv = vcvtq_s32_f32(vaddq_f32(vmulq_f32(vmulq_n_f32(vld1q_f32(y + i), aliasyscale), vzi),
+                                     vdupq_n_f32(aliasycenter)));
+        vst1q_s32(u, vu);
+        vst1q_s32(v, vv);
+        vst1q_s32(izi, vcvtq_s32_f32(vmulq_n_f32(vzi, ziscale)));
+
+        vflags = vandq_u32(vcltq_s32(vu, vdupq_n_s32(r_refdef.aliasvrect.x)), vdupq_n_u32(ALIAS_LEFT_CLIP));
+        vflags = vorrq_u32(vflags,
+                           vandq_u32(vcltq_s32(vv, vdupq_n_s32(r_refdef.aliasvrect.y)), vdupq_n_u32(ALIAS_TOP_CLIP)));
+        vflags = vorrq_u32(vflags, vandq_u32(vcgtq_s32(vu, vdupq_n_s32(r_refdef.aliasvrectright)),
+                                             vdupq_n_u32(ALIAS_RIGHT_CLIP)));
+        vflags = vorrq_u32(vflags, vandq_u32(vcgtq_s32(vv, vdupq_n_s32(r_refdef.aliasvrectbottom)),
+                                             vdupq_n_u32(ALIAS_BOTTOM_CLIP)));
+        zclip = vcltq_f32(vz, vdupq_n_f32(ALIAS_Z_CLIP_PLANE));
+        vflags = vbslq_u32(zclip, vdupq_n_u32(ALIAS_Z_CLIP), vflags);
+        vst1q_s32(flags, vreinterpretq_s32_u32(vflags));
+#else
+        float zi;
+
+        for (j = 0; j < ALIAS_BATCH; j++) {
+            if (z[i + j] < ALIAS_Z_CLIP_PLANE) {
+                flags[j] = ALIAS_Z_CLIP;
+                continue;
+            }
+
+            zi = 1.0 / z[i + j];
+            izi[j] = zi * ziscale;
+            u[j] = (x[i + j] * aliasxscale * zi) + aliasxcenter;
+            v[j] = (y[i + j] * aliasyscale * zi) + aliasycenter;
+
+            flags[j] = 0;
+            if (u[j] < r_refdef.aliasvrect.x)
+                flags[j] |= ALIAS_LEFT_CLIP;
+            if (v[j] < r_refdef.aliasvrect.y)
+                flags[j] |= ALIAS_TOP_CLIP;
+            if (u[j] > r_refdef.aliasvrectright)
+                flags[j] |= ALIAS_RIGHT_CLIP;
+            if (v[j] > r_refdef.aliasvrectbottom)
+                flags[j] |= ALIAS_BOTTOM_CLIP;
+        }
+#endif
+
+        count = r_anumverts - i < ALIAS_BATCH ? r_anumverts - i : ALIAS_BATCH;
+        for (j = 0; j < count; j++, fv++, pstverts++) {
+            fv->v[2] = pstverts->s;
+            fv->v[3] = pstverts->t;
+            fv->v[4] = r_alightnormals[r_apverts[i + j].lightnormalindex];
+            fv->flags = pstverts->onseam | flags[j];
+            if (!(flags[j] & ALIAS_Z_CLIP)) {
+                fv->v[0] = u[j];
+                fv->v[1] = v[j];
+                fv->v[5] = izi[j];
+            }
         }
     }
 
@@ -362,42 +556,6 @@ void R_AliasSetUpTransform(int trivial_accept)
     }
 }
 
-/*
-================
-R_AliasTransformFinalVert
-================
-*/
-void R_AliasTransformFinalVert(finalvert_t *fv, auxvert_t *av, trivertx_t *pverts, stvert_t *pstverts)
-{
-    int temp;
-    float lightcos, *plightnormal;
-
-    av->fv[0] = DotProduct(pverts->v, aliastransform[0]) + aliastransform[0][3];
-    av->fv[1] = DotProduct(pverts->v, aliastransform[1]) + aliastransform[1][3];
-    av->fv[2] = DotProduct(pverts->v, aliastransform[2]) + aliastransform[2][3];
-
-    fv->v[2] = pstverts->s;
-    fv->v[3] = pstverts->t;
-
-    fv->flags = pstverts->onseam;
-
-    // lighting
-    plightnormal = r_avertexnormals[pverts->lightnormalindex];
-    lightcos = DotProduct(plightnormal, r_plightvec);
-    temp = r_ambientlight;
-
-    if (lightcos < 0) {
-        temp += (int)(r_shadelight * lightcos);
-
-        // clamp; because we limited the minimum ambient and shading light, we
-        // don't have to clamp low light, just bright
-        if (temp < 0)
-            temp = 0;
-    }
-
-    fv->v[4] = temp;
-}
-
 #if !id386
 
 /*
@@ -407,43 +565,56 @@ R_AliasTransformAndProjectFinalVerts
 */
 void R_AliasTransformAndProjectFinalVerts(finalvert_t *fv, stvert_t *pstverts)
 {
-    int i, temp;
-    float lightcos, *plightnormal, zi;
-    trivertx_t *pverts;
-
-    pverts = r_apverts;
-
-    for (i = 0; i < r_anumverts; i++, fv++, pverts++, pstverts++) {
-        // transform and project
-        zi = 1.0 / (DotProduct(pverts->v, aliastransform[2]) + aliastransform[2][3]);
-
-        // x, y, and z are scaled down by 1/2**31 in the transform, so 1/z is
-        // scaled up by 1/2**31, and the scaling cancels out for x and y in the
-        // projection
-        fv->v[5] = zi;
-
-        fv->v[0] = ((DotProduct(pverts->v, aliastransform[0]) + aliastransform[0][3]) * zi) + aliasxcenter;
-        fv->v[1] = ((DotProduct(pverts->v, aliastransform[1]) + aliastransform[1][3]) * zi) + aliasycenter;
-
-        fv->v[2] = pstverts->s;
-        fv->v[3] = pstverts->t;
-        fv->flags = pstverts->onseam;
-
-        // lighting
-        plightnormal = r_avertexnormals[pverts->lightnormalindex];
-        lightcos = DotProduct(plightnormal, r_plightvec);
-        temp = r_ambientlight;
-
-        if (lightcos < 0) {
-            temp += (int)(r_shadelight * lightcos);
-
-            // clamp; because we limited the minimum ambient and shading light, we
-            // don't have to clamp low light, just bright
-            if (temp < 0)
-                temp = 0;
+    int i, j, count;
+    int u[ALIAS_BATCH], v[ALIAS_BATCH], izi[ALIAS_BATCH];
+    float *x, *y, *z;
+
+    R_AliasTransformVerts(r_apverts, r_anumverts);
+    x = paliasverts->x;
+    y = paliasverts->y;
+    z = paliasverts->z;
+
+    // x, y, and z are scaled down by 1/2**31 in the transform, so 1/z is
+    // scaled up by 1/2**31, and the scaling cancels out for x and y in the
+    // projection
+    for (i = 0; i < r_anumverts; i += ALIAS_BATCH) {
+#if defined(__SSE2__)
+        __m128 vzi;
+
+        vzi = _mm_div_ps(_mm_set1_ps(1), _mm_loadu_ps(z + i));
+        _mm_storeu_si128((__m128i *)izi, _mm_cvttps_epi32(vzi));
+        _mm_storeu_si128((__m128i *)u,
+                         _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), vzi), _mm_set1_ps(aliasxcenter))));
+        _mm_storeu_si128((__m128i *)v,
+                         _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(y + i), vzi), _mm_set1_ps(aliasycenter))));
+#elif defined(__ARM_NEON)
+        float32x4_t vzi;
+
+        vzi = vdivq_f32(vdupq_n_f32(1), vld1q_f32(z + i));
+        vst1q_s32(izi, vcvtq_s32_f32(vzi));
+        vst1q_s32(u, vcvtq_s32_f32(vaddq_f32(vmulq_f32(vld1q_f32(x + i), vzi), vdupq_n_f32(aliasxcenter))));
+        vst1q_s32(v, vcvtq_s32_f32(vaddq_f32(vmulq_f32(vld1q_f32(y + i), vzi), vdupq_n_f32(aliasycenter))));
+#else
+        float zi;
+
+        for (j = 0; j < ALIAS_BATCH; j++) {
+            zi = 1.0 / z[i + j];
+            izi[j] = zi;
+            u[j] = (x[i + j] * zi) + aliasxcenter;
+            v[j] = (y[i + j] * zi) + aliasycenter;
         }
+#endif
 
-        fv->v[4] = temp;
+        count = r_anumverts - i < ALIAS_BATCH ? r_anumverts - i : ALIAS_BATCH;
+        for (j = 0; j < count; j++, fv++, pstverts++) {
+            fv->v[0] = u[j];
+            fv->v[1] = v[j];
+            fv->v[2] = pstverts->s;
+            fv->v[3] = pstverts->t;
+            fv->v[4] = r_alightnormals[r_apverts[i + j].lightnormalindex];
+            fv->v[5] = izi[j];
+            fv->flags = pstverts->onseam;
+        }
     }
 }
 
@@ -550,6 +721,9 @@ R_AliasSetupLighting
 */
 void R_AliasSetupLighting(alight_t *plighting)
 {
+    int i, temp;
+    float lightcos;
+
     // guarantee that no vertex will ever be lit below LIGHT_MIN, so we don't have
     // to clamp off the bottom
     r_ambientlight = plighting->ambientlight;
@@ -573,6 +747,23 @@ void R_AliasSetupLighting(alight_t *plighting)
     r_plightvec[0] = DotProduct(plighting->plightvec, alias_forward);
     r_plightvec[1] = -DotProduct(plighting->plightvec, alias_right);
     r_plightvec[2] = DotProduct(plighting->plightvec, alias_up);
+
+    // light every normal once, the vertices look theirs up
+    for (i = 0; i < NUMVERTEXNORMALS; i++) {
+        lightcos = DotProduct(r_avertexnormals[i], r_plightvec);
+        temp = r_ambientlight;
+
+        if (lightcos < 0) {
+            temp += (int)(r_shadelight * lightcos);
+
+            // clamp; because we limited the minimum ambient and shading light, we
+            // don't have to clamp low light, just bright
+            if (temp < 0)
+                temp = 0;
+        }
+
+        r_alightnormals[i] = temp;
+    }
 }
 
 /*
@@ -629,15 +820,15 @@ R_AliasDrawModel
 void R_AliasDrawModel(alight_t *plighting)
 {
     finalvert_t finalverts[MAXALIASVERTS + ((CACHE_SIZE - 1) / sizeof(finalvert_t)) + 1];
-    auxvert_t auxverts[MAXALIASVERTS];
+    aliasverts_t aliasverts;
 
     r_amodels_drawn++;
 
     // cache align
     pfinalverts = (finalvert_t *)(((long)&finalverts[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-    pauxverts = &auxverts[0];
+    paliasverts = &aliasverts;
 
-    paliashdr = (aliashdr_t *)Mod_Extradata(currententity->model);
+    paliashdr = R_AliasExtradata(currententity->model);
     pmdl = (mdl_t *)((byte *)paliashdr + paliashdr->model);
 
     R_AliasSetupSkin();
@@ -0,0 +1,727 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// r_band.c -- draws the view in horizontal bands on the job threads
+
+/*
+R_BandScanEdges splits the view into bands of rows and scans the edges of
+every band into its own copy of the surfaces at once. The surface caches the
+spans need are then allocated on the main thread, in the order D_DrawSurfaces
+would allocate them since that order decides what the cache throws out, and
+the ones that missed are drawn and lit on the job threads.
+
+The world isn't drawn yet. Alias models and particles are queued behind it,
+and R_BandFlush has every band draw its rows of the world and the queue.
+That happens at the end of the frame, and before anything that can't be
+queued: a sprite, or an alias model that has to be loaded into the cache.
+
+Each band only draws its own rows but computes every pixel the same way as
+drawing the view whole, so the frame doesn't change with the number of bands.
+*/
+
+#include "quakedef.h"
+#include "r_local.h"
+#include "d_local.h"
+
+#define MAX_BANDS MAX_JOB_THREADS
+#define BAND_MINHEIGHT 16 // fewer bands than that on short screens
+#define BAND_QUEUESIZE 0x40000
+#define BAND_PARTICLES 256 // particles per queued batch
+#define BAND_HUNKSIZE(size) ((size) + 32) // with the hunk's header and rounding
+
+typedef enum { bc_polyset, bc_particles } bandcmdtype_t;
+
+typedef struct {
+    bandcmdtype_t type;
+    int size; // in bytes, including this header
+    int top, bottom; // the rows it draws on
+} bandcmd_t;
+
+typedef struct {
+    bandcmd_t hdr;
+    affinetridesc_t desc; // pfinalverts points at the copy following this
+    void *colormap;
+    int numfinalverts; // drawn by D_PolysetDrawFinalVerts first
+    finalvert_t *from; // where the vertices were copied from
+    mtriangle_t tri; // copy of a single triangle
+} bandpolyset_t;
+
+typedef struct {
+    bandcmd_t hdr;
+    int count;
+    particle_t particles[BAND_PARTICLES];
+} bandparticles_t;
+
+// the main thread's drawing state, which it shares with the band jobs
+typedef struct {
+    entity_t *currententity;
+    vec3_t modelorg, vpn, vup, vright;
+    float entity_rotation[3][3];
+    clipplane_t view_clipplanes[4];
+    affinetridesc_t affinetridesc;
+    void *acolormap;
+    surf_t *surfaces, *surface_p;
+} bandstate_t;
+
+THREAD_LOCAL qboolean r_bandqueue;
+THREAD_LOCAL int d_bandtop, d_bandbottom = MAXHEIGHT;
+
+// 0 is one band per job thread, 1 draws the view whole. Takes effect on the
+// next map
+CVAR_REGISTER(r_bands, CVAR_CTOR({ "r_bands", 0 }));
+
+extern int r_anumverts;
+
+static band_t r_bandlist[MAX_BANDS];
+static int r_numbands; // allocated for the map, 0 when not banding
+static int r_framebands; // used this frame
+
+static surf_t *r_bandsurfaces; // R_EdgeDrawing's surfaces
+static int r_bandnumsurfs;
+static vec3_t r_bandmodelorg; // world modelorg when the edges were scanned
+
+// per surface index, built by R_BandCacheSurfaces
+static surfcache_t **r_bandcaches;
+static texture_t **r_bandtextures;
+static byte *r_bandmips;
+
+// the surface caches to draw this frame, built by R_BandCacheSurfaces
+static drawsurf_t *r_bandbuilds;
+static int r_bandnumbuilds;
+
+static qboolean r_bandworlddrawn;
+
+static byte *r_bandcmds;
+static int r_bandcmdsize;
+static bandpolyset_t *r_bandlastpolyset; // if it's the last command
+static bandparticles_t *r_bandlastparticles; // if it's the last command
+
+/*
+================
+R_BandMaxSpans
+================
+*/
+static int R_BandMaxSpans(int numbands)
+{
+    int maxspans;
+
+    maxspans = (vid.height / numbands + 1) * (vid.width / 16);
+    if (maxspans < MAXSPANS)
+        maxspans = MAXSPANS;
+    return maxspans;
+}
+
+/*
+================
+R_BandHunkSize
+
+What R_BandNewMap allocates for that many bands
+================
+*/
+static int R_BandHunkSize(int numbands)
+{
+    int size;
+
+    size = BAND_HUNKSIZE(r_numallocatededges * sizeof(edge_t)) + BAND_HUNKSIZE(r_numallocatededges * sizeof(int)) +
+           BAND_HUNKSIZE(r_numallocatededges * sizeof(fixed16_t)) + BAND_HUNKSIZE((r_cnumsurfs + 1) * sizeof(surf_t)) +
+           BAND_HUNKSIZE(R_BandMaxSpans(numbands) * sizeof(espan_t));
+    size *= numbands;
+
+    size += BAND_HUNKSIZE((r_cnumsurfs + 1) * sizeof(surfcache_t *)) +
+            BAND_HUNKSIZE((r_cnumsurfs + 1) * sizeof(texture_t *)) + BAND_HUNKSIZE(r_cnumsurfs + 1) +
+            BAND_HUNKSIZE((r_cnumsurfs + 1) * sizeof(drawsurf_t)) + BAND_HUNKSIZE(BAND_QUEUESIZE);
+    return size;
+}
+
+/*
+================
+R_BandNewMap
+================
+*/
+void R_BandNewMap(void)
+{
+    int i, wanted;
+    band_t *band;
+
+    r_numbands = r_bands.value;
+    if (r_numbands <= 0)
+        r_numbands = Jobs_NumThreads();
+    if (r_numbands > (int)vid.height / BAND_MINHEIGHT)
+        r_numbands = vid.height / BAND_MINHEIGHT;
+    if (r_numbands > MAX_BANDS)
+        r_numbands = MAX_BANDS;
+
+    // the bands get at most half of the free hunk, the cache needs the rest
+    // for the models and sounds
+    wanted = r_numbands;
+    while (r_numbands >= 2 && R_BandHunkSize(r_numbands) > Hunk_FreeSize() / 2)
+        r_numbands--;
+    if (r_numbands < wanted)
+        Con_DPrintf("only %i of %i bands fit in the hunk\n", r_numbands < 2 ? 0 : r_numbands, wanted);
+
+    if (r_numbands < 2) {
+        r_numbands = 0;
+        return;
+    }
+
+    for (i = 0, band = r_bandlist; i < r_numbands; i++, band++) {
+        band->edges = Hunk_AllocName(r_numallocatededges * sizeof(edge_t), "bands");
+        band->activeedges = Hunk_AllocName(r_numallocatededges * sizeof(int), "bands");
+        band->activeu = Hunk_AllocName(r_numallocatededges * sizeof(fixed16_t), "bands");
+        band->surfs = Hunk_AllocName((r_cnumsurfs + 1) * sizeof(surf_t), "bands");
+        band->maxspans = R_BandMaxSpans(r_numbands);
+        band->spans = Hunk_AllocName(band->maxspans * sizeof(espan_t), "bands");
+    }
+
+    r_bandcaches = Hunk_AllocName((r_cnumsurfs + 1) * sizeof(surfcache_t *), "bands");
+    r_bandtextures = Hunk_AllocName((r_cnumsurfs + 1) * sizeof(texture_t *), "bands");
+    r_bandmips = Hunk_AllocName(r_cnumsurfs + 1, "bands");
+    r_bandbuilds = Hunk_AllocName((r_cnumsurfs + 1) * sizeof(drawsurf_t), "bands");
+    r_bandcmds = Hunk_AllocName(BAND_QUEUESIZE, "bands");
+}
+
+/*
+================
+R_BandSaveState
+================
+*/
+static void R_BandSaveState(bandstate_t *state)
+{
+    state->currententity = currententity;
+    VectorCopy(modelorg, state->modelorg);
+    VectorCopy(vpn, state->vpn);
+    VectorCopy(vup, state->vup);
+    VectorCopy(vright, state->vright);
+    memcpy(state->entity_rotation, entity_rotation, sizeof(state->entity_rotation));
+    memcpy(state->view_clipplanes, view_clipplanes, sizeof(state->view_clipplanes));
+    state->affinetridesc = r_affinetridesc;
+    state->acolormap = acolormap;
+    state->surfaces = surfaces;
+    state->surface_p = surface_p;
+}
+
+/*
+================
+R_BandRestoreState
+================
+*/
+static void R_BandRestoreState(bandstate_t *state)
+{
+    currententity = state->currententity;
+    VectorCopy(state->modelorg, modelorg);
+    VectorCopy(state->vpn, vpn);
+    VectorCopy(state->vup, vup);
+    VectorCopy(state->vright, vright);
+    memcpy(entity_rotation, state->entity_rotation, sizeof(entity_rotation));
+    memcpy(view_clipplanes, state->view_clipplanes, sizeof(view_clipplanes));
+    r_affinetridesc = state->affinetridesc;
+    acolormap = state->acolormap;
+    surfaces = state->surfaces;
+    surface_p = state->surface_p;
+}
+
+/*
+================
+R_BandScan_Job
+================
+*/
+static void R_BandScan_Job(int index, void *)
+{
+    band_t *band;
+
+    band = &r_bandlist[index];
+    memcpy(&band->surfs[1], &r_bandsurfaces[1], (r_bandnumsurfs - 1) * sizeof(surf_t));
+    surfaces = band->surfs;
+    surface_p = band->surfs + r_bandnumsurfs;
+
+    R_ScanBandEdges(band);
+}
+
+/*
+================
+R_BandBuild_Job
+================
+*/
+static void R_BandBuild_Job(int index, void *)
+{
+    r_drawsurf = r_bandbuilds[index];
+    R_DrawSurface();
+}
+
+/*
+================
+R_BandQueueBuild
+
+Remembers r_drawsurf to be drawn with the rest. An instanced submodel can
+need the same cache twice, the last one wins like it would drawing in order.
+================
+*/
+static void R_BandQueueBuild(qboolean insubmodel)
+{
+    int i;
+
+    if (insubmodel) {
+        for (i = r_bandnumbuilds - 1; i >= 0; i--) {
+            if (r_bandbuilds[i].surfdat == r_drawsurf.surfdat) {
+                r_bandbuilds[i] = r_drawsurf;
+                return;
+            }
+        }
+    }
+
+    r_bandbuilds[r_bandnumbuilds++] = r_drawsurf;
+}
+
+/*
+================
+R_BandCacheSurfaces
+
+Allocates the caches of the surfaces with spans in any band like D_DrawSurfaces
+would, then draws the missing ones on the job threads. False if allocating a
+later one threw out or reused an earlier one, the caches that weren't drawn
+are marked for D_CacheSurface to draw then.
+================
+*/
+static qboolean R_BandCacheSurfaces(void)
+{
+    surf_t *s;
+    msurface_t *pface;
+    surfcache_t *cache;
+    drawsurf_t *build;
+    int i, b;
+
+    r_bandnumbuilds = 0;
+
+    for (i = 1; i < r_bandnumsurfs; i++) {
+        r_bandcaches[i] = NULL;
+
+        for (b = 0; b < r_framebands; b++)
+            if (r_bandlist[b].surfs[i].spans)
+                break;
+        if (b == r_framebands || r_drawflat.value)
+            continue;
+
+        r_drawnpolycount++;
+
+        s = &surfaces[i];
+        if (s->flags & SURF_DRAWSKY) {
+            if (!r_skymade)
+                R_MakeSky();
+            continue;
+        }
+        if (s->flags & (SURF_DRAWBACKGROUND | SURF_DRAWTURB))
+            continue;
+
+        currententity = s->insubmodel ? s->entity : &cl_entities[0];
+        pface = s->data;
+        r_bandmips[i] = D_MipLevelForScale(s->nearzi * scale_for_mip * pface->texinfo->mipadjust);
+        if (D_AllocSurface(pface, r_bandmips[i], &cache))
+            R_BandQueueBuild(s->insubmodel);
+        r_bandcaches[i] = cache;
+        r_bandtextures[i] = cache->texture;
+    }
+    currententity = &cl_entities[0];
+
+    for (i = 1; i < r_bandnumsurfs; i++) {
+        cache = r_bandcaches[i];
+        if (!cache)
+            continue;
+
+        pface = surfaces[i].data;
+        if (pface->cachespots[r_bandmips[i]] != cache || cache->texture != r_bandtextures[i])
+            break;
+    }
+
+    if (i < r_bandnumsurfs) {
+        for (i = 0, build = r_bandbuilds; i < r_bandnumbuilds; i++, build++) {
+            cache = build->surf->cachespots[build->surfmip];
+            if (cache && (pixel_t *)cache->data == build->surfdat)
+                cache->texture = NULL;
+        }
+        return false;
+    }
+
+    PROF_BEGIN("R_BandBuildSurfaces");
+    c_surf += r_bandnumbuilds;
+    Jobs_Run(R_BandBuild_Job, r_bandnumbuilds, NULL);
+    PROF_END();
+
+    return true;
+}
+
+/*
+================
+R_BandDrawWhole
+
+Gathers the spans of all bands and draws the world in one go on this thread
+================
+*/
+static void R_BandDrawWhole(void)
+{
+    espan_t *span;
+    surf_t *s;
+    int i, b;
+
+    for (b = 1; b < r_framebands; b++) {
+        for (i = 1; i < r_bandnumsurfs; i++) {
+            span = r_bandlist[b].surfs[i].spans;
+            if (!span)
+                continue;
+
+            s = &r_bandlist[0].surfs[i];
+            while (span->pnext)
+                span = span->pnext;
+            span->pnext = s->spans;
+            s->spans = r_bandlist[b].surfs[i].spans;
+        }
+    }
+
+    surfaces = r_bandlist[0].surfs;
+    surface_p = surfaces + r_bandnumsurfs;
+    D_DrawSurfaces();
+    surfaces = r_bandsurfaces;
+    surface_p = surfaces + r_bandnumsurfs;
+}
+
+/*
+================
+R_BandScanEdges
+
+Scans the edges of every band instead of R_ScanEdges, and starts queueing
+the rest of the frame for the bands. False if the view is drawn whole.
+================
+*/
+qboolean R_BandScanEdges(void)
+{
+    int b, drawn;
+    band_t *band;
+
+    r_bandqueue = false;
+    r_bandcmdsize = 0;
+    r_bandlastpolyset = NULL;
+    r_bandlastparticles = NULL;
+
+    if (!r_numbands)
+        return false;
+
+    PROF_BEGIN("R_BandScanEdges");
+
+    r_framebands = r_numbands;
+    if (r_framebands > r_refdef.vrect.height)
+        r_framebands = r_refdef.vrect.height;
+
+    for (b = 0, band = r_bandlist; b < r_framebands; b++, band++) {
+        band->top = r_refdef.vrect.y + b * r_refdef.vrect.height / r_framebands;
+        band->bottom = r_refdef.vrect.y + (b + 1) * r_refdef.vrect.height / r_framebands;
+    }
+
+    r_bandsurfaces = surfaces;
+    r_bandnumsurfs = surface_p - surfaces;
+    VectorCopy(modelorg, r_bandmodelorg);
+
+    R_SnapshotBandEdges(r_bandlist, r_framebands);
+    Jobs_Run(R_BandScan_Job, r_framebands, NULL);
+
+    surfaces = r_bandsurfaces;
+    surface_p = surfaces + r_bandnumsurfs;
+
+    // a band with more spans than it has room for goes back to R_ScanEdges,
+    // which draws whenever it runs out
+    for (b = 0; b < r_framebands; b++)
+        if (r_bandlist[b].overflowed) {
+            PROF_END();
+            return false;
+        }
+
+    drawn = r_drawnpolycount;
+    r_bandworlddrawn = false;
+    if (!R_BandCacheSurfaces()) {
+        // the cache is thrashing, draw it the way R_ScanEdges does
+        r_drawnpolycount = drawn;
+        R_BandDrawWhole();
+        r_bandworlddrawn = true;
+    }
+
+    r_bandqueue = true;
+    PROF_END();
+    return true;
+}
+
+/*
+================
+R_BandDrawPolyset
+================
+*/
+static void R_BandDrawPolyset(bandpolyset_t *cmd)
+{
+    r_affinetridesc = cmd->desc;
+    acolormap = cmd->colormap;
+
+    if (r_affinetridesc.drawtype)
+        D_PolysetUpdateTables();
+
+    if (cmd->numfinalverts)
+        D_PolysetDrawFinalVerts(r_affinetridesc.pfinalverts, cmd->numfinalverts);
+
+    if (r_affinetridesc.numtriangles)
+        D_PolysetDraw();
+}
+
+/*
+================
+R_BandDraw_Job
+================
+*/
+static void R_BandDraw_Job(int index, void *)
+{
+    band_t *band;
+    bandcmd_t *cmd;
+    bandparticles_t *particles;
+    int i, j;
+
+    band = &r_bandlist[index];
+    d_bandtop = band->top;
+    d_bandbottom = band->bottom;
+
+    if (!r_bandworlddrawn) {
+        VectorCopy(base_vpn, vpn);
+        VectorCopy(base_vup, vup);
+        VectorCopy(base_vright, vright);
+        VectorCopy(r_bandmodelorg, modelorg);
+        surfaces = band->surfs;
+        surface_p = band->surfs + r_bandnumsurfs;
+
+        D_DrawBandSurfaces(r_bandcaches);
+    }
+
+    for (i = 0; i < r_bandcmdsize; i += cmd->size) {
+        cmd = (bandcmd_t *)(r_bandcmds + i);
+        if (cmd->bottom <= band->top || cmd->top >= band->bottom)
+            continue;
+
+        switch (cmd->type) {
+        case bc_polyset:
+            R_BandDrawPolyset((bandpolyset_t *)cmd);
+            break;
+
+        case bc_particles:
+            particles = (bandparticles_t *)cmd;
+            for (j = 0; j < particles->count; j++)
+                D_DrawParticle(&particles->particles[j]);
+            break;
+        }
+    }
+}
+
+/*
+================
+R_BandFlush
+
+Draws the world, if it isn't yet, and everything queued
+================
+*/
+void R_BandFlush(void)
+{
+    bandstate_t state;
+
+    if (!r_bandqueue || (r_bandworlddrawn && !r_bandcmdsize))
+        return;
+
+    PROF_BEGIN("R_BandFlush");
+
+    R_BandSaveState(&state);
+    r_bandqueue = false;
+
+    Jobs_Run(R_BandDraw_Job, r_framebands, NULL);
+
+    R_BandRestoreState(&state);
+    r_bandqueue = true;
+    d_bandtop = 0;
+    d_bandbottom = MAXHEIGHT;
+
+    r_bandworlddrawn = true;
+    r_bandcmdsize = 0;
+    r_bandlastpolyset = NULL;
+    r_bandlastparticles = NULL;
+    PROF_END();
+}
+
+/*
+================
+R_BandEndFrame
+================
+*/
+void R_BandEndFrame(void)
+{
+    R_BandFlush();
+    r_bandqueue = false;
+}
+
+/*
+================
+R_BandAllocCommand
+================
+*/
+static bandcmd_t *R_BandAllocCommand(bandcmdtype_t type, int size)
+{
+    bandcmd_t *cmd;
+
+    size = (size + 15) & ~15;
+    if (size > BAND_QUEUESIZE)
+        Sys_Error("R_BandAllocCommand: %i bytes", size);
+    if (r_bandcmdsize + size > BAND_QUEUESIZE)
+        R_BandFlush();
+
+    cmd = (bandcmd_t *)(r_bandcmds + r_bandcmdsize);
+    r_bandcmdsize += size;
+    r_bandlastpolyset = NULL;
+    r_bandlastparticles = NULL;
+
+    cmd->type = type;
+    cmd->size = size;
+    cmd->top = r_refdef.vrect.y;
+    cmd->bottom = r_refdef.vrectbottom;
+
+    return cmd;
+}
+
+/*
+================
+R_BandPolysetRows
+================
+*/
+static void R_BandPolysetRows(bandpolyset_t *cmd, finalvert_t *fv, int numverts)
+{
+    int i, top, bottom;
+
+    top = MAXHEIGHT;
+    bottom = 0;
+    for (i = 0; i < numverts; i++, fv++) {
+        if (fv->v[1] < top)
+            top = fv->v[1];
+        if (fv->v[1] >= bottom)
+            bottom = fv->v[1] + 1;
+    }
+
+    cmd->hdr.top = top;
+    cmd->hdr.bottom = bottom;
+}
+
+/*
+================
+R_BandQueueFinalVerts
+
+D_PolysetDrawFinalVerts while queueing
+================
+*/
+void R_BandQueueFinalVerts(finalvert_t *fv, int numverts)
+{
+    bandpolyset_t *cmd;
+    finalvert_t *verts;
+
+    cmd = (bandpolyset_t *)R_BandAllocCommand(bc_polyset, sizeof(*cmd) + numverts * sizeof(finalvert_t));
+    verts = (finalvert_t *)(cmd + 1);
+    memcpy(verts, fv, numverts * sizeof(finalvert_t));
+
+    cmd->desc = r_affinetridesc;
+    cmd->desc.pfinalverts = verts;
+    cmd->desc.numtriangles = 0;
+    cmd->colormap = acolormap;
+    cmd->numfinalverts = numverts;
+    cmd->from = fv;
+    R_BandPolysetRows(cmd, verts, numverts);
+
+    r_bandlastpolyset = cmd;
+}
+
+/*
+================
+R_BandQueuePolyset
+
+D_PolysetDraw while queueing. The triangles of a whole model stay in the
+model's cache data, R_AliasExtradata keeps that from being thrown out.
+================
+*/
+void R_BandQueuePolyset(void)
+{
+    bandpolyset_t *cmd;
+    finalvert_t *verts;
+    mtriangle_t *ptri;
+    int i, numverts;
+
+    // R_AliasPrepareUnclippedPoints draws the vertices of the same model first
+    cmd = r_bandlastpolyset;
+    if (cmd && cmd->from == r_affinetridesc.pfinalverts) {
+        verts = cmd->desc.pfinalverts;
+        cmd->desc = r_affinetridesc;
+        cmd->desc.pfinalverts = verts;
+        r_bandlastpolyset = NULL;
+        return;
+    }
+
+    if (r_affinetridesc.numtriangles == 1) {
+        // one triangle, from R_AliasPreparePoints or clipped
+        cmd = (bandpolyset_t *)R_BandAllocCommand(bc_polyset, sizeof(*cmd) + 3 * sizeof(finalvert_t));
+        verts = (finalvert_t *)(cmd + 1);
+        ptri = r_affinetridesc.ptriangles;
+        for (i = 0; i < 3; i++) {
+            verts[i] = r_affinetridesc.pfinalverts[ptri->vertindex[i]];
+            cmd->tri.vertindex[i] = i;
+        }
+        cmd->tri.facesfront = ptri->facesfront;
+
+        cmd->desc = r_affinetridesc;
+        cmd->desc.ptriangles = &cmd->tri;
+        numverts = 3;
+    } else {
+        numverts = r_anumverts;
+        cmd = (bandpolyset_t *)R_BandAllocCommand(bc_polyset, sizeof(*cmd) + numverts * sizeof(finalvert_t));
+        verts = (finalvert_t *)(cmd + 1);
+        memcpy(verts, r_affinetridesc.pfinalverts, numverts * sizeof(finalvert_t));
+
+        cmd->desc = r_affinetridesc;
+    }
+
+    cmd->desc.pfinalverts = verts;
+    cmd->colormap = acolormap;
+    cmd->numfinalverts = 0;
+    cmd->from = NULL;
+    R_BandPolysetRows(cmd, verts, numverts);
+}
+
+/*
+================
+R_BandQueueParticle
+
+D_DrawParticle while queueing
+================
+*/
+void R_BandQueueParticle(particle_t *pparticle)
+{
+    bandparticles_t *cmd;
+
+    cmd = r_bandlastparticles;
+    if (!cmd || cmd->count == BAND_PARTICLES) {
+        cmd = (bandparticles_t *)R_BandAllocCommand(bc_particles, sizeof(*cmd));
+        cmd->count = 0;
+        r_bandlastparticles = cmd;
+    }
+
+    cmd->particles[cmd->count++] = *pparticle;
+}
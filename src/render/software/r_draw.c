@@ -38,7 +38,7 @@ zpointdesc_t r_zpointdesc;
 
 polydesc_t r_polydesc;
 
-clipplane_t view_clipplanes[4];
+THREAD_LOCAL clipplane_t view_clipplanes[4];
 
 static medge_t *r_pedge;
 
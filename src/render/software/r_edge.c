@@ -36,7 +36,9 @@ have a sentinal at both ends?
 edge_t *auxedges;
 edge_t *r_edges, *edge_p, *edge_max;
 
-surf_t *surfaces, *surface_p, *surf_max;
+// the bands each scan into their own copy of the surfaces
+THREAD_LOCAL surf_t *surfaces, *surface_p;
+surf_t *surf_max;
 
 // surfaces are generated in back to front order by the bsp, so if a surf
 // pointer is greater than another one, it should be drawn in front
@@ -45,24 +47,24 @@ surf_t *surfaces, *surface_p, *surf_max;
 edge_t *newedges[MAXHEIGHT];
 edge_t *removeedges[MAXHEIGHT];
 
-espan_t *span_p, *max_span_p;
+THREAD_LOCAL espan_t *span_p, *max_span_p;
 
 int r_currentkey;
 
 extern int screenwidth;
 
-int current_iv;
+THREAD_LOCAL int current_iv;
 
-int edge_head_u_shift20, edge_tail_u_shift20;
+THREAD_LOCAL int edge_head_u_shift20, edge_tail_u_shift20;
 
 static void (*pdrawfunc)(void);
 
-edge_t edge_head;
-edge_t edge_tail;
-edge_t edge_aftertail;
-edge_t edge_sentinel;
+THREAD_LOCAL edge_t edge_head;
+THREAD_LOCAL edge_t edge_tail;
+THREAD_LOCAL edge_t edge_aftertail;
+THREAD_LOCAL edge_t edge_sentinel;
 
-float fv;
+THREAD_LOCAL float fv;
 
 void R_GenerateSpans(void);
 void R_GenerateSpansBackward(void);
@@ -591,29 +593,13 @@ void R_GenerateSpansBackward(void)
 
 /*
 ==============
-R_ScanEdges
+R_ClearActiveEdges
 
-Input: 
-newedges[] array
-	this has links to edges, which have links to surfaces
-
-Output:
-Each surface has a linked list of its visible spans
+Clears the active edges to just the background edges around the whole screen
 ==============
 */
-void R_ScanEdges(void)
+static void R_ClearActiveEdges(void)
 {
-    int iv, bottom;
-    byte basespans[MAXSPANS * sizeof(espan_t) + CACHE_SIZE];
-    espan_t *basespan_p;
-    surf_t *s;
-
-    basespan_p = (espan_t *)((long)(basespans + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-    max_span_p = &basespan_p[MAXSPANS - r_refdef.vrect.width];
-
-    span_p = basespan_p;
-
-    // clear active edges to just the background edges around the whole screen
     // FIXME: most of this only needs to be set up once
     edge_head.u = r_refdef.vrect.x << 20;
     edge_head_u_shift20 = edge_head.u >> 20;
@@ -639,6 +625,33 @@ void R_ScanEdges(void)
     // FIXME: do we need this now that we clamp x in r_draw.c?
     edge_sentinel.u = 2000 << 24; // make sure nothing sorts past this
     edge_sentinel.prev = &edge_aftertail;
+}
+
+/*
+==============
+R_ScanEdges
+
+Input: 
+newedges[] array
+	this has links to edges, which have links to surfaces
+
+Output:
+Each surface has a linked list of its visible spans
+==============
+*/
+void R_ScanEdges(void)
+{
+    int iv, bottom;
+    byte basespans[MAXSPANS * sizeof(espan_t) + CACHE_SIZE];
+    espan_t *basespan_p;
+    surf_t *s;
+
+    basespan_p = (espan_t *)((long)(basespans + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
+    max_span_p = &basespan_p[MAXSPANS - r_refdef.vrect.width];
+
+    span_p = basespan_p;
+
+    R_ClearActiveEdges();
 
     //
     // process all scan lines
@@ -704,3 +717,133 @@ void R_ScanEdges(void)
     else
         D_DrawSurfaces();
 }
+
+/*
+==============
+R_CopyBandEdges
+
+Copies r_edges for a band to sort on its own, pointing the newedges and
+removeedges chains at the copy
+==============
+*/
+static void R_CopyBandEdges(edge_t *edges)
+{
+    edge_t *in, *out;
+
+    for (in = r_edges, out = edges; in < edge_p; in++, out++) {
+        *out = *in;
+        if (in->next)
+            out->next = edges + (in->next - r_edges);
+        if (in->nextremove)
+            out->nextremove = edges + (in->nextremove - r_edges);
+    }
+}
+
+/*
+==============
+R_SnapshotBandEdges
+
+Steps the active edge table down the screen without generating any spans,
+saving the table at the top of every band after the first so they can all
+be scanned at once
+==============
+*/
+void R_SnapshotBandEdges(band_t *bands, int numbands)
+{
+    edge_t *edges, *edge;
+    int iv, b, n;
+
+    // the first band starts with no active edges, so its copy is scratch
+    // space until it's scanned
+    edges = bands[0].edges;
+    R_CopyBandEdges(edges);
+    bands[0].numactive = 0;
+
+    R_ClearActiveEdges();
+
+    b = 1;
+    for (iv = r_refdef.vrect.y; b < numbands; iv++) {
+        if (iv == bands[b].top) {
+            n = 0;
+            for (edge = edge_head.next; edge != &edge_tail; edge = edge->next) {
+                bands[b].activeedges[n] = edge - edges;
+                bands[b].activeu[n] = edge->u;
+                n++;
+            }
+            bands[b].numactive = n;
+
+            if (++b == numbands)
+                break;
+        }
+
+        if (newedges[iv])
+            R_InsertNewEdges(edges + (newedges[iv] - r_edges), edge_head.next);
+
+        if (removeedges[iv])
+            R_RemoveEdges(edges + (removeedges[iv] - r_edges));
+
+        if (edge_head.next != &edge_tail)
+            R_StepActiveU(edge_head.next);
+    }
+}
+
+/*
+==============
+R_ScanBandEdges
+
+R_ScanEdges for the rows of one band, into the band's surfaces and spans.
+Sets overflowed instead of flushing when the spans run out.
+==============
+*/
+void R_ScanBandEdges(band_t *band)
+{
+    edge_t *edges, *edge, *prev;
+    int i, iv;
+
+    edges = band->edges;
+    R_CopyBandEdges(edges);
+
+    span_p = band->spans;
+    max_span_p = &band->spans[band->maxspans - r_refdef.vrect.width];
+    band->overflowed = false;
+
+    R_ClearActiveEdges();
+
+    prev = &edge_head;
+    for (i = 0; i < band->numactive; i++) {
+        edge = &edges[band->activeedges[i]];
+        edge->u = band->activeu[i];
+        edge->prev = prev;
+        prev->next = edge;
+        prev = edge;
+    }
+    prev->next = &edge_tail;
+    edge_tail.prev = prev;
+
+    for (iv = band->top; iv < band->bottom; iv++) {
+        if (span_p >= max_span_p) {
+            band->overflowed = true;
+            return;
+        }
+
+        current_iv = iv;
+        fv = (float)iv;
+
+        // mark that the head (background start) span is pre-included
+        surfaces[1].spanstate = 1;
+
+        if (newedges[iv])
+            R_InsertNewEdges(edges + (newedges[iv] - r_edges), edge_head.next);
+
+        (*pdrawfunc)();
+
+        if (iv == band->bottom - 1)
+            break;
+
+        if (removeedges[iv])
+            R_RemoveEdges(edges + (removeedges[iv] - r_edges));
+
+        if (edge_head.next != &edge_tail)
+            R_StepActiveU(edge_head.next);
+    }
+}
@@ -58,9 +58,9 @@ qboolean r_fov_greater_than_90;
 //
 // view origin
 //
-vec3_t vup, base_vup;
-vec3_t vpn, base_vpn;
-vec3_t vright, base_vright;
+// the band threads each rotate these into the bmodels they draw
+THREAD_LOCAL vec3_t vup, vpn, vright;
+vec3_t base_vup, base_vpn, base_vright;
 vec3_t r_origin;
 
 //
@@ -250,6 +250,8 @@ void R_NewMap(void)
         auxedges = Hunk_AllocName(r_numallocatededges * sizeof(edge_t), "edges");
     }
 
+    R_BandNewMap();
+
     r_dowarpold = false;
     r_viewchanged = false;
 #ifdef PASSAGES
@@ -756,6 +758,8 @@ void R_EdgeDrawing(void)
     edge_t ledges[NUMSTACKEDGES + ((CACHE_SIZE - 1) / sizeof(edge_t)) + 1];
     surf_t lsurfs[NUMSTACKSURFACES + ((CACHE_SIZE - 1) / sizeof(surf_t)) + 1];
 
+    PROF_BEGIN("R_EdgeDrawing");
+
     if (auxedges) {
         r_edges = auxedges;
     } else {
@@ -804,8 +808,9 @@ void R_EdgeDrawing(void)
         VID_LockBuffer();
     }
 
-    if (!(r_drawpolys | r_drawculledpolys))
+    if (!(r_drawpolys | r_drawculledpolys) && !R_BandScanEdges())
         R_ScanEdges();
+    PROF_END();
 }
 
 /*
@@ -879,6 +884,8 @@ void R_RenderView_(void)
     if (r_dspeeds.value)
         dp_time2 = Sys_CurrentTicks();
 
+    R_BandEndFrame();
+
     if (r_dowarp)
         D_WarpScreen();
 
@@ -911,6 +918,8 @@ void R_RenderView(void)
     int dummy;
     int delta;
 
+    PROF_BEGIN("R_RenderView");
+
     delta = (byte *)&dummy - r_stack_start;
     if (delta < -10000 || delta > 10000)
         Sys_Error("R_RenderView: called without enough stack");
@@ -925,6 +934,7 @@ void R_RenderView(void)
         Sys_Error("Globals are missaligned");
 
     R_RenderView_();
+    PROF_END();
 }
 
 /*
@@ -21,21 +21,23 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "r_local.h"
-
-drawsurf_t r_drawsurf;
-
-int lightleft, sourcesstep, blocksize, sourcetstep;
-int lightdelta, lightdeltastep;
-int lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned blockdivmask;
-void *prowdestbase;
-unsigned char *pbasesource;
-int surfrowbytes; // used by ASM files
-unsigned *r_lightptr;
-int r_stepback;
-int r_lightwidth;
-int r_numhblocks, r_numvblocks;
-unsigned char *r_source, *r_sourcemax;
+#include "r_lightmap.h"
+
+// surface caches can be built on several job threads at once
+THREAD_LOCAL drawsurf_t r_drawsurf;
+
+THREAD_LOCAL int lightleft, sourcesstep, blocksize, sourcetstep;
+THREAD_LOCAL int lightdelta, lightdeltastep;
+THREAD_LOCAL int lightright, lightleftstep, lightrightstep, blockdivshift;
+THREAD_LOCAL unsigned blockdivmask;
+THREAD_LOCAL void *prowdestbase;
+THREAD_LOCAL unsigned char *pbasesource;
+THREAD_LOCAL int surfrowbytes; // used by ASM files
+THREAD_LOCAL unsigned *r_lightptr;
+THREAD_LOCAL int r_stepback;
+THREAD_LOCAL int r_lightwidth;
+THREAD_LOCAL int r_numhblocks, r_numvblocks;
+THREAD_LOCAL unsigned char *r_source, *r_sourcemax;
 
 void R_DrawSurfaceBlock8_mip0(void);
 void R_DrawSurfaceBlock8_mip1(void);
@@ -45,86 +47,23 @@ void R_DrawSurfaceBlock8_mip3(void);
 static void (*surfmiptable[4])(void) = { R_DrawSurfaceBlock8_mip0, R_DrawSurfaceBlock8_mip1, R_DrawSurfaceBlock8_mip2,
                                          R_DrawSurfaceBlock8_mip3 };
 
-unsigned blocklights[18 * 18];
+THREAD_LOCAL unsigned blocklights[LIGHTMAP_MAXSIZE * LIGHTMAP_MAXSIZE];
 
-/*
-===============
-R_AddDynamicLights
-===============
-*/
-void R_AddDynamicLights(void)
-{
-    msurface_t *surf;
-    int lnum;
-    int sd, td;
-    float dist, rad, minlight;
-    vec3_t impact, local;
-    int s, t;
-    int i;
-    int smax, tmax;
-    mtexinfo_t *tex;
+// the light as the colormap row of its shade, which gets darker going down
+struct lightshade_t {
+    typedef unsigned texel_t;
+    enum { step = 1 };
 
-    surf = r_drawsurf.surf;
-    smax = (surf->extents[0] >> 4) + 1;
-    tmax = (surf->extents[1] >> 4) + 1;
-    tex = surf->texinfo;
-
-    for (lnum = 0; lnum < MAX_DLIGHTS; lnum++) {
-        if (!(surf->dlightbits & (1 << lnum)))
-            continue; // not lit by this light
-
-        rad = cl_dlights[lnum].radius;
-        dist = DotProduct(cl_dlights[lnum].origin, surf->plane->normal) - surf->plane->dist;
-        rad -= fabs(dist);
-        minlight = cl_dlights[lnum].minlight;
-        if (rad < minlight)
-            continue;
-        minlight = rad - minlight;
-
-        for (i = 0; i < 3; i++) {
-            impact[i] = cl_dlights[lnum].origin[i] - surf->plane->normal[i] * dist;
-        }
+    static unsigned Store(unsigned light)
+    {
+        int t;
 
-        local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3];
-        local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3];
-
-        local[0] -= surf->texturemins[0];
-        local[1] -= surf->texturemins[1];
-
-        for (t = 0; t < tmax; t++) {
-            td = local[1] - t * 16;
-            if (td < 0)
-                td = -td;
-            for (s = 0; s < smax; s++) {
-                sd = local[0] - s * 16;
-                if (sd < 0)
-                    sd = -sd;
-                if (sd > td)
-                    dist = sd + (td >> 1);
-                else
-                    dist = td + (sd >> 1);
-                if (dist < minlight)
-#ifdef QUAKE2
-                {
-                    unsigned temp;
-                    temp = (rad - dist) * 256;
-                    i = t * smax + s;
-                    if (!cl_dlights[lnum].dark)
-                        blocklights[i] += temp;
-                    else {
-                        if (blocklights[i] > temp)
-                            blocklights[i] -= temp;
-                        else
-                            blocklights[i] = 0;
-                    }
-                }
-#else
-                    blocklights[t * smax + s] += (rad - dist) * 256;
-#endif
-            }
-        }
+        t = (255 * 256 - (int)light) >> (8 - VID_CBITS);
+        if (t < (1 << 6))
+            t = (1 << 6);
+        return t;
     }
-}
+};
 
 /*
 ===============
@@ -136,11 +75,7 @@ Combine and scale multiple lightmaps into the 8.8 format in blocklights
 void R_BuildLightMap(void)
 {
     int smax, tmax;
-    int t;
     int i, size;
-    byte *lightmap;
-    unsigned scale;
-    int maps;
     msurface_t *surf;
 
     surf = r_drawsurf.surf;
@@ -148,7 +83,6 @@ void R_BuildLightMap(void)
     smax = (surf->extents[0] >> 4) + 1;
     tmax = (surf->extents[1] >> 4) + 1;
     size = smax * tmax;
-    lightmap = surf->samples;
 
     if (r_fullbright.value || !cl.worldmodel->lightdata) {
         for (i = 0; i < size; i++)
@@ -156,32 +90,15 @@ void R_BuildLightMap(void)
         return;
     }
 
-    // clear to ambient
-    for (i = 0; i < size; i++)
-        blocklights[i] = r_refdef.ambientlight << 8;
-
-    // add all the lightmaps
-    if (lightmap)
-        for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
-            scale = r_drawsurf.lightadj[maps]; // 8.8 fraction
-            for (i = 0; i < size; i++)
-                blocklights[i] += lightmap[i] * scale;
-            lightmap += size; // skip to next lightmap
-        }
+    // start from ambient and add all the lightmaps
+    R_LightMapStyles(surf, r_drawsurf.lightadj, r_refdef.ambientlight << 8, blocklights);
 
     // add all the dynamic lights
     if (surf->dlightframe == r_framecount)
-        R_AddDynamicLights();
+        R_LightMapDynamic(surf, cl_dlights, blocklights);
 
     // bound, invert, and shift
-    for (i = 0; i < size; i++) {
-        t = (255 * 256 - (int)blocklights[i]) >> (8 - VID_CBITS);
-
-        if (t < (1 << 6))
-            t = (1 << 6);
-
-        blocklights[i] = t;
-    }
+    R_StoreLightMap<lightshade_t>(blocklights, smax, tmax, blocklights, smax);
 }
 
 /*
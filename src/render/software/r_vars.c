@@ -33,6 +33,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // FIXME: make into one big structure, like cl or sv
 // FIXME: do separately for refresh engine and driver
 
-int r_bmodelactive;
+THREAD_LOCAL int r_bmodelactive;
 
 #endif // !id386
@@ -97,6 +97,7 @@ sfxcache_t *S_LoadSound(sfx_t *s)
     int len;
     float stepscale;
     sfxcache_t *sc;
+    hunksubsystem_t prev;
     byte stackbuf[1 * 1024]; // avoid dirtying the cache heap
 
     // see if still in memory
@@ -129,7 +130,9 @@ sfxcache_t *S_LoadSound(sfx_t *s)
 
     len = len * info.width * info.channels;
 
+    prev = Hunk_Subsystem(hs_sound);
     sc = Cache_Alloc(&s->cache, len + sizeof(sfxcache_t), s->name);
+    Hunk_Subsystem(prev);
     if (!sc)
         return NULL;
 
@@ -26,6 +26,9 @@ server_static_t svs;
 
 char localmodels[MAX_MODELS][5]; // inline model names for precache
 
+// PROTOCOL_DELTA only lets clients that know it connect, takes effect on the next map
+CVAR_REGISTER(sv_protocol, CVAR_CTOR({ "sv_protocol", PROTOCOL_VERSION }));
+
 //============================================================================
 
 /*
@@ -164,13 +167,14 @@ void SV_SendServerinfo(client_t *client)
 {
     char **s;
     char message[2048];
+    int i;
 
     MSG_WriteByte(&client->message, svc_print);
     sprintf(message, "%c\nVERSION %4u.%02u SERVER (%i CRC)", 2, VERSION_MAJOR, VERSION_MINOR, pr_crc);
     MSG_WriteString(&client->message, message);
 
     MSG_WriteByte(&client->message, svc_serverinfo);
-    MSG_WriteLong(&client->message, PROTOCOL_VERSION);
+    MSG_WriteLong(&client->message, sv.protocol);
     MSG_WriteByte(&client->message, svs.maxclients);
 
     if (!coop.value && deathmatch.value)
@@ -202,6 +206,11 @@ void SV_SendServerinfo(client_t *client)
     MSG_WriteByte(&client->message, svc_signonnum);
     MSG_WriteByte(&client->message, 1);
 
+    // whatever the client has acknowledged was from another level or connection
+    if (sv.entityframes)
+        for (i = 0; i < ENTITY_FRAMES; i++)
+            sv.entityframes[(client - svs.clients) * ENTITY_FRAMES + i].sequence = 0;
+
     client->sendsignon = true;
     client->spawned = false; // need prespawn, spawn, etc
 }
@@ -330,183 +339,290 @@ crosses a waterline.
 =============================================================================
 */
 
-int fatbytes;
-byte fatpvs[MAX_MAP_LEAFS / 8];
+/*
+=============
+SV_FatPVS
 
-void SV_AddToFatPVS(vec3_t org, mnode_t *node)
+Calculates a PVS that is the inclusive or of all leafs within 8 pixels of the
+given point.
+=============
+*/
+byte *SV_FatPVS(vec3_t org)
+{
+    return PVS_FatPVS(sv.worldmodel, org);
+}
+
+//=============================================================================
+
+/*
+=============
+SV_EntityVisible
+
+The client's own entity is always sent, the others when they touch its PVS
+=============
+*/
+static qboolean SV_EntityVisible(edict_t *ent, edict_t *clent, byte *pvs)
 {
     int i;
-    byte *pvs;
-    mplane_t *plane;
-    float d;
 
-    while (1) {
-        // if this is a leaf, accumulate the pvs bits
-        if (node->contents < 0) {
-            if (node->contents != CONTENTS_SOLID) {
-                pvs = Mod_LeafPVS((mleaf_t *)node, sv.worldmodel);
-                for (i = 0; i < fatbytes; i++)
-                    fatpvs[i] |= pvs[i];
-            }
-            return;
-        }
+#ifdef QUAKE2
+    // don't send if flagged for NODRAW and there are no lighting effects
+    if (ent->v.effects == EF_NODRAW)
+        return false;
+#endif
 
-        plane = node->plane;
-        d = DotProduct(org, plane->normal) - plane->dist;
-        if (d > 8)
-            node = node->children[0];
-        else if (d < -8)
-            node = node->children[1];
-        else { // go down both
-            SV_AddToFatPVS(org, node->children[0]);
-            node = node->children[1];
-        }
-    }
+    if (ent == clent) // clent is ALLWAYS sent
+        return true;
+
+    // ignore ents without visible models
+    if (!ent->v.modelindex || !pr_strings[ent->v.model])
+        return false;
+
+    for (i = 0; i < ent->num_leafs; i++)
+        if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i] & 7)))
+            return true;
+
+    return false; // not visible
 }
 
 /*
 =============
-SV_FatPVS
+SV_EntityChanges
 
-Calculates a PVS that is the inclusive or of all leafs within 8 pixels of the
-given point.
+Update bits for the fields of ent that differ from state
 =============
 */
-byte *SV_FatPVS(vec3_t org)
+static int SV_EntityChanges(edict_t *ent, entity_state_t const *state)
 {
-    fatbytes = (sv.worldmodel->numleafs + 31) >> 3;
-    Q_memset(fatpvs, 0, fatbytes);
-    SV_AddToFatPVS(org, sv.worldmodel->nodes);
-    return fatpvs;
+    int i;
+    int bits;
+    float miss;
+
+    bits = 0;
+
+    for (i = 0; i < 3; i++) {
+        miss = ent->v.origin[i] - state->origin[i];
+        if (miss < -0.1f || miss > 0.1f)
+            bits |= U_ORIGIN1 << i;
+    }
+
+    if (ent->v.angles[0] != state->angles[0])
+        bits |= U_ANGLE1;
+
+    if (ent->v.angles[1] != state->angles[1])
+        bits |= U_ANGLE2;
+
+    if (ent->v.angles[2] != state->angles[2])
+        bits |= U_ANGLE3;
+
+    if (state->colormap != ent->v.colormap)
+        bits |= U_COLORMAP;
+
+    if (state->skin != ent->v.skin)
+        bits |= U_SKIN;
+
+    if (state->frame != ent->v.frame)
+        bits |= U_FRAME;
+
+    if (state->effects != ent->v.effects)
+        bits |= U_EFFECTS;
+
+    if (state->modelindex != ent->v.modelindex)
+        bits |= U_MODEL;
+
+    return bits;
 }
 
-//=============================================================================
+/*
+=============
+SV_WriteEntityUpdate
+
+Writes an update of entity e with the fields in bits, ent is NULL for a
+U_REMOVE
+=============
+*/
+static void SV_WriteEntityUpdate(sizebuf_t *msg, int e, edict_t *ent, int bits)
+{
+    if (ent && ent->v.movetype == MOVETYPE_STEP)
+        bits |= U_NOLERP; // don't mess up the step animation
+
+    if (e >= 256)
+        bits |= U_LONGENTITY;
+
+    if (bits >= 256)
+        bits |= U_MOREBITS;
+
+    //
+    // write the message
+    //
+    MSG_WriteByte(msg, bits | U_SIGNAL);
+
+    if (bits & U_MOREBITS)
+        MSG_WriteByte(msg, bits >> 8);
+    if (bits & U_LONGENTITY)
+        MSG_WriteShort(msg, e);
+    else
+        MSG_WriteByte(msg, e);
+
+    if (bits & U_MODEL)
+        MSG_WriteByte(msg, ent->v.modelindex);
+    if (bits & U_FRAME)
+        MSG_WriteByte(msg, ent->v.frame);
+    if (bits & U_COLORMAP)
+        MSG_WriteByte(msg, ent->v.colormap);
+    if (bits & U_SKIN)
+        MSG_WriteByte(msg, ent->v.skin);
+    if (bits & U_EFFECTS)
+        MSG_WriteByte(msg, ent->v.effects);
+    if (bits & U_ORIGIN1)
+        MSG_WriteCoord(msg, ent->v.origin[0]);
+    if (bits & U_ANGLE1)
+        MSG_WriteAngle(msg, ent->v.angles[0]);
+    if (bits & U_ORIGIN2)
+        MSG_WriteCoord(msg, ent->v.origin[1]);
+    if (bits & U_ANGLE2)
+        MSG_WriteAngle(msg, ent->v.angles[1]);
+    if (bits & U_ORIGIN3)
+        MSG_WriteCoord(msg, ent->v.origin[2]);
+    if (bits & U_ANGLE3)
+        MSG_WriteAngle(msg, ent->v.angles[2]);
+}
 
 /*
 =============
 SV_WriteEntitiesToClient
 
+Returns true if the entities didn't all fit
 =============
 */
-void SV_WriteEntitiesToClient(edict_t *clent, sizebuf_t *msg)
+static qboolean SV_WriteEntitiesToClient(edict_t *clent, byte *pvs, sizebuf_t *msg)
 {
-    int e, i;
-    int bits;
-    byte *pvs;
-    vec3_t org;
-    float miss;
+    int e;
     edict_t *ent;
 
-    // find the client's PVS
-    VectorAdd(clent->v.origin, clent->v.view_ofs, org);
-    pvs = SV_FatPVS(org);
-
     // send over all entities (excpet the client) that touch the pvs
     ent = NEXT_EDICT(sv.edicts);
     for (e = 1; e < sv.num_edicts; e++, ent = NEXT_EDICT(ent)) {
-#ifdef QUAKE2
-        // don't send if flagged for NODRAW and there are no lighting effects
-        if (ent->v.effects == EF_NODRAW)
+        if (!SV_EntityVisible(ent, clent, pvs))
             continue;
-#endif
-
-        // ignore if not touching a PV leaf
-        if (ent != clent) // clent is ALLWAYS sent
-        {
-            // ignore ents without visible models
-            if (!ent->v.modelindex || !pr_strings[ent->v.model])
-                continue;
-
-            for (i = 0; i < ent->num_leafs; i++)
-                if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i] & 7)))
-                    break;
 
-            if (i == ent->num_leafs)
-                continue; // not visible
-        }
-
-        if (msg->maxsize - msg->cursize < 16) {
-            Con_Printf("packet overflow\n");
-            return;
-        }
+        if (msg->maxsize - msg->cursize < 16)
+            return true;
 
         // send an update
-        bits = 0;
+        SV_WriteEntityUpdate(msg, e, ent, SV_EntityChanges(ent, &ent->baseline));
+    }
 
-        for (i = 0; i < 3; i++) {
-            miss = ent->v.origin[i] - ent->baseline.origin[i];
-            if (miss < -0.1f || miss > 0.1f)
-                bits |= U_ORIGIN1 << i;
-        }
+    return false;
+}
 
-        if (ent->v.angles[0] != ent->baseline.angles[0])
-            bits |= U_ANGLE1;
+/*
+=============
+SV_WriteDeltaEntities
 
-        if (ent->v.angles[1] != ent->baseline.angles[1])
-            bits |= U_ANGLE2;
+PROTOCOL_DELTA version of SV_WriteEntitiesToClient. Entities are sent
+relative to the last frame the client acknowledged, or to their baselines if
+it's too old, those that didn't change aren't sent at all and the ones that
+left the view are removed.
 
-        if (ent->v.angles[2] != ent->baseline.angles[2])
-            bits |= U_ANGLE3;
+When the datagram fills up, the rest of the entities in the old frame are
+kept as they were, that's what the client does with them too. Returns true
+if that happened. New entities that don't fit the frame aren't sent, they're
+counted in dropped.
+=============
+*/
+static qboolean SV_WriteDeltaEntities(client_t *client, byte *pvs, sizebuf_t *msg, int *dropped)
+{
+    entityframe_t *frames, *frame, *from;
+    entity_state_t const *base;
+    entity_state_t *state;
+    edict_t *ent;
+    int e, i, j;
+    int bits, fromcount;
+    qboolean overflow;
+
+    frames = sv.entityframes + (client - svs.clients) * ENTITY_FRAMES;
+    client->entityframe++;
+    frame = &frames[client->entityframe & (ENTITY_FRAMES - 1)];
+    frame->sequence = client->entityframe;
+    frame->numentities = 0;
+
+    from = &frames[client->entityack & (ENTITY_FRAMES - 1)];
+    if (!client->entityack || client->entityframe - client->entityack >= ENTITY_FRAMES ||
+        from->sequence != client->entityack)
+        from = NULL;
+    fromcount = from ? from->numentities : 0;
+
+    MSG_WriteByte(msg, svc_entities);
+    MSG_WriteLong(msg, frame->sequence);
+    MSG_WriteLong(msg, from ? from->sequence : 0);
+
+    overflow = false;
+    *dropped = 0;
+    j = 0;
+    ent = NEXT_EDICT(sv.edicts);
+    for (e = 1; e < sv.num_edicts; e++, ent = NEXT_EDICT(ent)) {
+        if (!SV_EntityVisible(ent, client->edict, pvs))
+            continue;
 
-        if (ent->v.movetype == MOVETYPE_STEP)
-            bits |= U_NOLERP; // don't mess up the step animation
+        // the ones before it in the old frame left the view
+        for (; j < fromcount && from->nums[j] < e; j++) {
+            if (msg->maxsize - msg->cursize < 24) {
+                overflow = true;
+                break;
+            }
+            SV_WriteEntityUpdate(msg, from->nums[j], NULL, U_REMOVE);
+        }
 
-        if (ent->baseline.colormap != ent->v.colormap)
-            bits |= U_COLORMAP;
+        if (overflow || msg->maxsize - msg->cursize < 24) {
+            overflow = true;
+            break;
+        }
 
-        if (ent->baseline.skin != ent->v.skin)
-            bits |= U_SKIN;
+        if (j < fromcount && from->nums[j] == e)
+            base = &from->states[j++];
+        else if (frame->numentities + fromcount - j < MAX_FRAME_ENTITIES)
+            base = &ent->baseline; // new to the client, sent even when it matches
+        else {
+            (*dropped)++; // the old frame's entities that are still to come have to fit too
+            continue;
+        }
 
-        if (ent->baseline.frame != ent->v.frame)
-            bits |= U_FRAME;
+        bits = SV_EntityChanges(ent, base);
+        state = &frame->states[frame->numentities];
+        frame->nums[frame->numentities++] = e;
+        *state = *base;
+        if (!bits && base != &ent->baseline)
+            continue; // the client has it already
 
-        if (ent->baseline.effects != ent->v.effects)
-            bits |= U_EFFECTS;
+        SV_WriteEntityUpdate(msg, e, ent, bits);
 
-        if (ent->baseline.modelindex != ent->v.modelindex)
-            bits |= U_MODEL;
+        // keep what the client now has
+        for (i = 0; i < 3; i++)
+            if (bits & (U_ORIGIN1 << i))
+                state->origin[i] = ent->v.origin[i];
+        VectorCopy(ent->v.angles, state->angles);
+        state->modelindex = ent->v.modelindex;
+        state->frame = ent->v.frame;
+        state->colormap = ent->v.colormap;
+        state->skin = ent->v.skin;
+        state->effects = ent->v.effects;
+    }
 
-        if (e >= 256)
-            bits |= U_LONGENTITY;
+    for (; j < fromcount; j++) {
+        if (!overflow && msg->maxsize - msg->cursize < 24)
+            overflow = true;
+        if (!overflow) {
+            SV_WriteEntityUpdate(msg, from->nums[j], NULL, U_REMOVE);
+            continue;
+        }
+        frame->nums[frame->numentities] = from->nums[j];
+        frame->states[frame->numentities++] = from->states[j];
+    }
 
-        if (bits >= 256)
-            bits |= U_MOREBITS;
+    MSG_WriteByte(msg, 0);
 
-        //
-        // write the message
-        //
-        MSG_WriteByte(msg, bits | U_SIGNAL);
-
-        if (bits & U_MOREBITS)
-            MSG_WriteByte(msg, bits >> 8);
-        if (bits & U_LONGENTITY)
-            MSG_WriteShort(msg, e);
-        else
-            MSG_WriteByte(msg, e);
-
-        if (bits & U_MODEL)
-            MSG_WriteByte(msg, ent->v.modelindex);
-        if (bits & U_FRAME)
-            MSG_WriteByte(msg, ent->v.frame);
-        if (bits & U_COLORMAP)
-            MSG_WriteByte(msg, ent->v.colormap);
-        if (bits & U_SKIN)
-            MSG_WriteByte(msg, ent->v.skin);
-        if (bits & U_EFFECTS)
-            MSG_WriteByte(msg, ent->v.effects);
-        if (bits & U_ORIGIN1)
-            MSG_WriteCoord(msg, ent->v.origin[0]);
-        if (bits & U_ANGLE1)
-            MSG_WriteAngle(msg, ent->v.angles[0]);
-        if (bits & U_ORIGIN2)
-            MSG_WriteCoord(msg, ent->v.origin[1]);
-        if (bits & U_ANGLE2)
-            MSG_WriteAngle(msg, ent->v.angles[1]);
-        if (bits & U_ORIGIN3)
-            MSG_WriteCoord(msg, ent->v.origin[2]);
-        if (bits & U_ANGLE3)
-            MSG_WriteAngle(msg, ent->v.angles[2]);
-    }
+    return overflow;
 }
 
 /*
@@ -528,11 +644,13 @@ void SV_CleanupEnts(void)
 
 /*
 ==================
-SV_WriteClientdataToMessage
+SV_WriteClientdata
 
+SV_WriteClientdataToMessage without the ideal pitch, that traces through the
+world and has to be done on the main thread
 ==================
 */
-void SV_WriteClientdataToMessage(edict_t *ent, sizebuf_t *msg)
+static void SV_WriteClientdata(edict_t *ent, sizebuf_t *msg)
 {
     int bits;
     int i;
@@ -557,11 +675,6 @@ void SV_WriteClientdataToMessage(edict_t *ent, sizebuf_t *msg)
         ent->v.dmg_save = 0;
     }
 
-    //
-    // send the current viewpos offset from the view entity
-    //
-    SV_SetIdealPitch(); // how much to look up / down ideally
-
     // a fixangle might get lost in a dropped packet.  Oh well.
     if (ent->v.fixangle) {
         MSG_WriteByte(msg, svc_setangle);
@@ -583,7 +696,7 @@ void SV_WriteClientdataToMessage(edict_t *ent, sizebuf_t *msg)
 #ifdef QUAKE2
     items = (int)ent->v.items | ((int)ent->v.items2 << 23);
 #else
-    val = GetEdictFieldValue(ent, "items2");
+    val = EDICT_FIELD(ent, pr_field_items2);
 
     if (val)
         items = (int)ent->v.items | ((int)val->_float << 23);
@@ -662,34 +775,119 @@ void SV_WriteClientdataToMessage(edict_t *ent, sizebuf_t *msg)
     }
 }
 
+/*
+==================
+SV_WriteClientdataToMessage
+
+==================
+*/
+void SV_WriteClientdataToMessage(edict_t *ent, sizebuf_t *msg)
+{
+    //
+    // send the current viewpos offset from the view entity
+    //
+    SV_SetIdealPitch(); // how much to look up / down ideally
+
+    SV_WriteClientdata(ent, msg);
+}
+
 /*
 =======================
-SV_SendClientDatagram
+SV_BuildClientDatagram
+
+Job writing the datagram of client number ((int *)arg)[index] into its
+snapshot. It only reads the server and writes the client's own edict, so the
+clients are built side by side.
 =======================
 */
-qboolean SV_SendClientDatagram(client_t *client)
+static void SV_BuildClientDatagram(int index, void *arg)
 {
-    byte buf[MAX_DATAGRAM];
-    sizebuf_t msg;
+    client_t *client = svs.clients + ((int *)arg)[index];
+    clientsnapshot_t *snap = &sv.snapshots[client - svs.clients];
+    sizebuf_t *msg = &snap->msg;
 
-    msg.data = buf;
-    msg.maxsize = sizeof(buf);
-    msg.cursize = 0;
+    msg->allowoverflow = false;
+    msg->overflowed = false;
+    msg->data = snap->buf;
+    msg->maxsize = sizeof(snap->buf);
+    msg->cursize = 0;
 
-    MSG_WriteByte(&msg, svc_time);
-    MSG_WriteFloat(&msg, (float) sv.time / MS_PER_S);
+    MSG_WriteByte(msg, svc_time);
+    MSG_WriteFloat(msg, (float) sv.time / MS_PER_S);
 
     // add the client specific data to the datagram
-    SV_WriteClientdataToMessage(client->edict, &msg);
+    SV_WriteClientdata(client->edict, msg);
 
-    SV_WriteEntitiesToClient(client->edict, &msg);
+    if (sv.protocol == PROTOCOL_DELTA)
+        snap->overflow = SV_WriteDeltaEntities(client, snap->pvs, msg, &snap->dropped);
+    else
+        snap->overflow = SV_WriteEntitiesToClient(client->edict, snap->pvs, msg);
 
     // copy the server datagram if there is space
-    if (msg.cursize + sv.datagram.cursize < msg.maxsize)
-        SZ_Write(&msg, sv.datagram.data, sv.datagram.cursize);
+    if (msg->cursize + sv.datagram.cursize < msg->maxsize)
+        SZ_Write(msg, sv.datagram.data, sv.datagram.cursize);
+}
+
+/*
+=======================
+SV_BuildClientDatagrams
+
+Builds the datagrams of the clients in the game on the job threads. What
+isn't safe there, the PVS cache and the traces of the ideal pitch, is done
+first. Clients in the same leafs get their fat PVS from the same cache entry.
+=======================
+*/
+static void SV_BuildClientDatagrams(void)
+{
+    int building[MAX_SCOREBOARD];
+    int i, count;
+    client_t *client;
+    vec3_t org;
+
+    PROF_BEGIN("SV_BuildClientDatagrams");
+
+    count = 0;
+    for (i = 0, client = svs.clients; i < svs.maxclients; i++, client++) {
+        if (!client->active || !client->spawned)
+            continue;
+
+        // find the client's PVS
+        VectorAdd(client->edict->v.origin, client->edict->v.view_ofs, org);
+        memcpy(sv.snapshots[i].pvs, SV_FatPVS(org), sv.pvsbytes);
+        building[count++] = i;
+    }
+
+    if (!count) {
+        PROF_END();
+        return;
+    }
+
+    // how much to look up / down ideally
+    SV_SetIdealPitch();
+
+    Jobs_Run(SV_BuildClientDatagram, count, building);
+    PROF_END();
+}
+
+/*
+=======================
+SV_SendClientDatagram
+
+Sends the datagram SV_BuildClientDatagrams built
+=======================
+*/
+qboolean SV_SendClientDatagram(client_t *client)
+{
+    clientsnapshot_t *snap = &sv.snapshots[client - svs.clients];
+
+    if (snap->overflow)
+        Con_Printf("packet overflow\n");
+    if (snap->dropped && !snap->lastdropped)
+        Con_Printf("%s: %i entities don't fit the entity frame, they aren't sent\n", client->name, snap->dropped);
+    snap->lastdropped = snap->dropped;
 
     // send the datagram
-    if (NET_SendUnreliableMessage(client->netconnection, &msg) == -1) {
+    if (NET_SendUnreliableMessage(client->netconnection, &snap->msg) == -1) {
         SV_DropClient(true); // if the message couldn't send, kick off
         return false;
     }
@@ -764,10 +962,15 @@ void SV_SendClientMessages(void)
 {
     int i;
 
+    PROF_BEGIN("SV_SendClientMessages");
+
     // update frags, names, etc
     SV_UpdateToReliableMessages();
 
     // build individual updates
+    SV_BuildClientDatagrams();
+
+    // and send them
     for (i = 0, host_client = svs.clients; i < svs.maxclients; i++, host_client++) {
         if (!host_client->active)
             continue;
@@ -817,6 +1020,7 @@ void SV_SendClientMessages(void)
 
     // clear muzzle flashes
     SV_CleanupEnts();
+    PROF_END();
 }
 
 /*
@@ -970,7 +1174,10 @@ void SV_SpawnServer(char *server)
 #endif
 {
     edict_t *ent;
-    int i;
+    hunksubsystem_t prev;
+    entity_state_t *states;
+    short *nums;
+    int i, count;
 
     // let's not have any servers with no name
     if (hostname.string[0] == 0)
@@ -1019,7 +1226,27 @@ void SV_SpawnServer(char *server)
     // allocate server memory
     sv.max_edicts = MAX_EDICTS;
 
+    prev = Hunk_Subsystem(hs_edicts);
     sv.edicts = Hunk_AllocName(sv.max_edicts * pr_edict_size, "edicts");
+    Hunk_Subsystem(prev);
+    PF_FindReset();
+
+    sv.protocol = (int)sv_protocol.value;
+    if (sv.protocol != PROTOCOL_VERSION && sv.protocol != PROTOCOL_DELTA) {
+        Con_Printf("sv_protocol %i isn't supported, using %i\n", sv.protocol, PROTOCOL_VERSION);
+        sv.protocol = PROTOCOL_VERSION;
+    }
+    if (sv.protocol == PROTOCOL_DELTA) {
+        count = svs.maxclients * ENTITY_FRAMES;
+        sv.entityframes = Hunk_AllocName(
+            count * (sizeof(entityframe_t) + MAX_FRAME_ENTITIES * (sizeof(entity_state_t) + sizeof(short))), "entframes");
+        states = (entity_state_t *)(sv.entityframes + count);
+        nums = (short *)(states + count * MAX_FRAME_ENTITIES);
+        for (i = 0; i < count; i++) {
+            sv.entityframes[i].states = states + i * MAX_FRAME_ENTITIES;
+            sv.entityframes[i].nums = nums + i * MAX_FRAME_ENTITIES;
+        }
+    }
 
     sv.datagram.maxsize = sizeof(sv.datagram_buf);
     sv.datagram.cursize = 0;
@@ -1055,6 +1282,12 @@ void SV_SpawnServer(char *server)
     }
     sv.models[1] = sv.worldmodel;
 
+    // the clients' datagrams and their copies of the PVS
+    sv.pvsbytes = ((sv.worldmodel->numleafs + 31) >> 5) * 4;
+    sv.snapshots = Hunk_AllocName(svs.maxclients * (sizeof(clientsnapshot_t) + sv.pvsbytes), "snapshot");
+    for (i = 0; i < svs.maxclients; i++)
+        sv.snapshots[i].pvs = (byte *)(sv.snapshots + svs.maxclients) + i * sv.pvsbytes;
+
     //
     // clear world interaction links
     //
@@ -1113,5 +1346,8 @@ void SV_SpawnServer(char *server)
         if (host_client->active)
             SV_SendServerinfo(host_client);
 
+    // start reading the levels this one leads to while it's played
+    Prefetch_Level(sv.worldmodel->entities, sv.name);
+
     Con_DPrintf("Server spawned.\n");
 }
@@ -354,7 +354,7 @@ void SV_AddGravity(edict_t *ent)
 #else
     eval_t *val;
 
-    val = GetEdictFieldValue(ent, "gravity");
+    val = EDICT_FIELD(ent, pr_field_gravity);
     if (val && val->_float)
         ent_gravity = val->_float;
     else
@@ -1417,6 +1417,8 @@ void SV_Physics(void)
     int i;
     edict_t *ent;
 
+    PROF_BEGIN("SV_Physics");
+
     // let the progs know that a new frame has started
     pr_global_struct->self = EDICT_TO_PROG(sv.edicts);
     pr_global_struct->other = EDICT_TO_PROG(sv.edicts);
@@ -1465,6 +1467,7 @@ void SV_Physics(void)
         pr_global_struct->force_retouch--;
 
     sv.time += host_frametime;
+    PROF_END();
 }
 
 #ifdef QUAKE2
@@ -43,6 +43,40 @@ usercmd_t cmd;
 
 CVAR_REGISTER(sv_idealpitchscale, CVAR_CTOR({ "sv_idealpitchscale", 0.8 }));
 
+CVAR_REGISTER(cl_rollspeed, CVAR_CTOR({ "cl_rollspeed", 200 }));
+CVAR_REGISTER(cl_rollangle, CVAR_CTOR({ "cl_rollangle", 2.0 }));
+
+/*
+===============
+V_CalcRoll
+
+Used by view and sv_user, lives here so dedicated servers don't need the view code
+===============
+*/
+float V_CalcRoll(vec3_t angles, vec3_t const velocity)
+{
+    vec3_t v_forward, v_right, v_up;
+    float sign;
+    float side;
+    float value;
+
+    AngleVectors(angles, v_forward, v_right, v_up);
+    side = DotProduct(velocity, v_right);
+    sign = side < 0 ? -1 : 1;
+    side = fabsf(side);
+
+    value = cl_rollangle.value;
+    //	if (cl.inwater)
+    //		value *= 6;
+
+    if (side < cl_rollspeed.value)
+        side = side * value / cl_rollspeed.value;
+    else
+        side = value;
+
+    return side * sign;
+}
+
 /*
 ===============
 SV_SetIdealPitch
@@ -446,6 +480,9 @@ void SV_ReadClientMove(usercmd_t *move)
     // read light level
     host_client->edict->v.light_level = MSG_ReadByte();
 #endif
+
+    if (sv.protocol == PROTOCOL_DELTA)
+        host_client->entityack = MSG_ReadLong();
 }
 
 /*
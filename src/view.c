@@ -35,9 +35,6 @@ CVAR_REGISTER(scr_ofsx, CVAR_CTOR({ "scr_ofsx", 0, false }));
 CVAR_REGISTER(scr_ofsy, CVAR_CTOR({ "scr_ofsy", 0, false }));
 CVAR_REGISTER(scr_ofsz, CVAR_CTOR({ "scr_ofsz", 0, false }));
 
-CVAR_REGISTER(cl_rollspeed, CVAR_CTOR({ "cl_rollspeed", 200 }));
-CVAR_REGISTER(cl_rollangle, CVAR_CTOR({ "cl_rollangle", 2.0 }));
-
 CVAR_REGISTER(cl_bob, CVAR_CTOR({ "cl_bob", 0.02, false }));
 CVAR_REGISTER(cl_bobcycle, CVAR_CTOR({ "cl_bobcycle", 0.6, false }));
 CVAR_REGISTER(cl_bobup, CVAR_CTOR({ "cl_bobup", 0.5, false }));
@@ -66,38 +63,6 @@ static float v_dmg_roll, v_dmg_pitch;
 
 extern int in_forward, in_forward2, in_back;
 
-/*
-===============
-V_CalcRoll
-
-Used by view and sv_user
-===============
-*/
-static vec3_t forward, right, up;
-
-float V_CalcRoll(vec3_t angles, vec3_t const velocity)
-{
-    float sign;
-    float side;
-    float value;
-
-    AngleVectors(angles, forward, right, up);
-    side = DotProduct(velocity, right);
-    sign = side < 0 ? -1 : 1;
-    side = fabsf(side);
-
-    value = cl_rollangle.value;
-    //	if (cl.inwater)
-    //		value *= 6;
-
-    if (side < cl_rollspeed.value)
-        side = side * value / cl_rollspeed.value;
-    else
-        side = value;
-
-    return side * sign;
-}
-
 /*
 ===============
 V_CalcBob
@@ -68,8 +68,18 @@ void W_LoadWadFile(char const *filename)
     wadinfo_t *header;
     unsigned i;
     int infotableofs;
-
-    wad_base = COM_LoadHunkFile(filename);
+    int len;
+    qboolean mapped;
+
+#ifdef GLQUAKE
+    wad_base = NULL; // uploaded pics are overwritten in place with their texture info
+#else
+    // the lumps are only read, so on little endian hosts they can stay in the pak
+    wad_base = LittleLong(1) == 1 ? (byte *)COM_MapFile(filename, &len) : NULL;
+#endif
+    mapped = wad_base != NULL;
+    if (!mapped)
+        wad_base = COM_LoadHunkFile(filename);
     if (!wad_base)
         Sys_Error("W_LoadWadFile: couldn't load %s", filename);
 
@@ -82,12 +92,17 @@ void W_LoadWadFile(char const *filename)
     wad_numlumps = LittleLong(header->numlumps);
     infotableofs = LittleLong(header->infotableofs);
     wad_lumps = (lumpinfo_t *)(wad_base + infotableofs);
+    if (mapped) { // the directory gets cleaned up in place, so it needs a writable copy
+        lump_p = Hunk_AllocName(wad_numlumps * sizeof(lumpinfo_t), "wadinfo");
+        memcpy(lump_p, wad_lumps, wad_numlumps * sizeof(lumpinfo_t));
+        wad_lumps = lump_p;
+    }
 
     for (i = 0, lump_p = wad_lumps; i < wad_numlumps; i++, lump_p++) {
         lump_p->filepos = LittleLong(lump_p->filepos);
         lump_p->size = LittleLong(lump_p->size);
         W_CleanupName(lump_p->name, lump_p->name);
-        if (lump_p->type == TYP_QPIC)
+        if (lump_p->type == TYP_QPIC && !mapped)
             SwapPic((qpic_t *)(wad_base + lump_p->filepos));
     }
 }
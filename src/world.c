@@ -163,62 +163,263 @@ ENTITY AREA CHECKING
 ===============================================================================
 */
 
-typedef struct areanode_s {
-    int axis; // -1 = leaf node
-    float dist;
-    struct areanode_s *children[2];
+/*
+Edicts are linked into a stack of grids over the horizontal extent of the
+world, sized from its bounds. Level 0 has the smallest cells, every level up
+halves the cells per axis and the last one is a single cell. An edict goes
+in the finest level whose cells are larger than its box, in the cell holding
+its absmin, so it can only reach into the next cell on each axis. Queries
+visit the cells their box touches on every level.
+*/
+
+#ifdef PSXQUAKE
+#define AREA_MAX_LEVELS 5 // 16x16 cells at most
+#else
+#define AREA_MAX_LEVELS 7 // 64x64 cells at most
+#endif
+#define AREA_MIN_CELL 128 // don't split the world into cells smaller than this
+#define AREA_MAX_CELLS (((1 << (2 * AREA_MAX_LEVELS)) - 1) / 3) // all levels together
+
+typedef struct {
     link_t trigger_edicts;
     link_t solid_edicts;
-} areanode_t;
+} areacell_t;
+
+typedef struct {
+    int size; // cells per axis
+    float cellsize[2];
+    float scale[2]; // cells per unit
+    areacell_t *cells;
+} arealevel_t;
 
-#define AREA_DEPTH 4
-#define AREA_NODES 32
+static areacell_t sv_areacells[AREA_MAX_CELLS];
+static arealevel_t sv_arealevels[AREA_MAX_LEVELS];
+static int sv_numarealevels;
+static float sv_areamins[2];
 
-static areanode_t sv_areanodes[AREA_NODES];
-static int sv_numareanodes;
+// candidates walked and exact clips made by SV_Move, for sv_movestats
+static unsigned sv_movecount, sv_movecandidates, sv_moveclips;
+static unsigned sv_touchcount, sv_touchcandidates;
 
 /*
 ===============
-SV_CreateAreaNode
+SV_CreateAreaLevels
 
 ===============
 */
-static areanode_t *SV_CreateAreaNode(int depth, vec3_t const mins, vec3_t const maxs)
+static void SV_CreateAreaLevels(vec3_t const mins, vec3_t const maxs)
 {
-    areanode_t *anode;
-    vec3_t size;
-    vec3_t mins1, maxs1, mins2, maxs2;
+    arealevel_t *level;
+    areacell_t *cells;
+    float extent[2];
+    int i, j, size;
+
+    extent[0] = maxs[0] - mins[0];
+    extent[1] = maxs[1] - mins[1];
+    sv_areamins[0] = mins[0];
+    sv_areamins[1] = mins[1];
+
+    // the finest level, big worlds get more cells
+    size = 1;
+    sv_numarealevels = 1;
+    while (sv_numarealevels < AREA_MAX_LEVELS &&
+           (extent[0] >= size * 2 * AREA_MIN_CELL || extent[1] >= size * 2 * AREA_MIN_CELL)) {
+        size *= 2;
+        sv_numarealevels++;
+    }
 
-    anode = &sv_areanodes[sv_numareanodes];
-    sv_numareanodes++;
+    cells = sv_areacells;
+    for (i = 0, level = sv_arealevels; i < sv_numarealevels; i++, level++, size >>= 1) {
+        level->size = size;
+        for (j = 0; j < 2; j++) {
+            level->cellsize[j] = extent[j] > 0 ? extent[j] / size : 1;
+            level->scale[j] = 1 / level->cellsize[j];
+        }
+        level->cells = cells;
+        for (j = 0; j < size * size; j++, cells++) {
+            ClearLink(&cells->trigger_edicts);
+            ClearLink(&cells->solid_edicts);
+        }
+    }
+}
 
-    ClearLink(&anode->trigger_edicts);
-    ClearLink(&anode->solid_edicts);
+/*
+===============
+SV_AreaCoord
 
-    if (depth == AREA_DEPTH) {
-        anode->axis = -1;
-        anode->children[0] = anode->children[1] = NULL;
-        return anode;
+===============
+*/
+static int SV_AreaCoord(arealevel_t const *level, float v, int axis)
+{
+    float c = (v - sv_areamins[axis]) * level->scale[axis];
+
+    if (!(c >= 0)) // also catches NaN
+        return 0;
+    if (c >= level->size)
+        return level->size - 1;
+    return (int)c;
+}
+
+/*
+===============
+SV_AreaRange
+
+The cells of a level that edicts touching the box can be linked in
+===============
+*/
+static void SV_AreaRange(arealevel_t const *level, vec3_t const mins, vec3_t const maxs, int *x0, int *y0, int *x1,
+                         int *y1)
+{
+    *x0 = SV_AreaCoord(level, mins[0], 0);
+    *y0 = SV_AreaCoord(level, mins[1], 1);
+    if (*x0 > 0)
+        (*x0)--;
+    if (*y0 > 0)
+        (*y0)--;
+    *x1 = SV_AreaCoord(level, maxs[0], 0);
+    *y1 = SV_AreaCoord(level, maxs[1], 1);
+}
+
+/*
+===============
+SV_MoveStats_f
+
+===============
+*/
+static void SV_MoveStats_f(void)
+{
+    Con_Printf("%u moves, %.1f candidates and %.2f clips per move\n", sv_movecount,
+               sv_movecount ? (float)sv_movecandidates / sv_movecount : 0.0f,
+               sv_movecount ? (float)sv_moveclips / sv_movecount : 0.0f);
+    Con_Printf("%u trigger touches, %.1f candidates per touch\n", sv_touchcount,
+               sv_touchcount ? (float)sv_touchcandidates / sv_touchcount : 0.0f);
+    Con_Printf("%i area levels, %ix%i cells at the finest\n", sv_numarealevels, sv_arealevels[0].size,
+               sv_arealevels[0].size);
+
+    sv_movecount = sv_movecandidates = sv_moveclips = 0;
+    sv_touchcount = sv_touchcandidates = 0;
+}
+
+CMD_REGISTER("sv_movestats", SV_MoveStats_f);
+
+/*
+===============================================================================
+
+ENTITY GRID
+
+A uniform grid over the horizontal extent of the world, every linked edict
+sits in the cell holding the centre of its box, so radius queries only visit
+the cells they overlap instead of all edicts.
+
+===============================================================================
+*/
+
+#define GRID_SIZE 32
+
+static link_t sv_grid[GRID_SIZE * GRID_SIZE];
+static float sv_gridmins[2];
+static float sv_gridscale[2]; // cells per unit
+
+/*
+===============
+SV_GridCoord
+===============
+*/
+static int SV_GridCoord(float v, int axis)
+{
+    float c = (v - sv_gridmins[axis]) * sv_gridscale[axis];
+
+    if (!(c >= 0)) // also catches NaN
+        return 0;
+    if (c >= GRID_SIZE)
+        return GRID_SIZE - 1;
+    return (int)c;
+}
+
+/*
+===============
+SV_ClearGrid
+===============
+*/
+static void SV_ClearGrid(vec3_t const mins, vec3_t const maxs)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        sv_gridmins[i] = mins[i];
+        sv_gridscale[i] = maxs[i] > mins[i] ? GRID_SIZE / (maxs[i] - mins[i]) : 0;
     }
+    for (i = 0; i < GRID_SIZE * GRID_SIZE; i++)
+        ClearLink(&sv_grid[i]);
+}
 
-    VectorSubtract(maxs, mins, size);
-    if (size[0] > size[1])
-        anode->axis = 0;
-    else
-        anode->axis = 1;
+/*
+===============
+SV_GridLinkEdict
 
-    anode->dist = 0.5f * (maxs[anode->axis] + mins[anode->axis]);
-    VectorCopy(mins, mins1);
-    VectorCopy(mins, mins2);
-    VectorCopy(maxs, maxs1);
-    VectorCopy(maxs, maxs2);
+The centre is computed exactly as PF_findradius tests it
+===============
+*/
+static void SV_GridLinkEdict(edict_t *ent)
+{
+    float x, y;
 
-    maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
+    x = ent->v.origin[0] + (ent->v.mins[0] + ent->v.maxs[0]) * 0.5f;
+    y = ent->v.origin[1] + (ent->v.mins[1] + ent->v.maxs[1]) * 0.5f;
+    InsertLinkBefore(&ent->gridlink, &sv_grid[SV_GridCoord(y, 1) * GRID_SIZE + SV_GridCoord(x, 0)]);
+}
 
-    anode->children[0] = SV_CreateAreaNode(depth + 1, mins2, maxs2);
-    anode->children[1] = SV_CreateAreaNode(depth + 1, mins1, maxs1);
+/*
+===============
+SV_SortEdicts
+===============
+*/
+static int SV_SortEdicts(void const *a, void const *b)
+{
+    edict_t const *ea = *(edict_t *const *)a;
+    edict_t const *eb = *(edict_t *const *)b;
+
+    return (ea > eb) - (ea < eb);
+}
+
+/*
+===============
+SV_FindInRadius
+
+===============
+*/
+int SV_FindInRadius(vec3_t const org, float rad, edict_t **list)
+{
+    link_t *cell, *l;
+    edict_t *ent;
+    vec3_t eorg;
+    int x, y, x0, x1, y0, y1;
+    int j, count;
+
+    x0 = SV_GridCoord(org[0] - rad, 0);
+    x1 = SV_GridCoord(org[0] + rad, 0);
+    y0 = SV_GridCoord(org[1] - rad, 1);
+    y1 = SV_GridCoord(org[1] + rad, 1);
+
+    count = 0;
+    for (y = y0; y <= y1; y++) {
+        for (x = x0; x <= x1; x++) {
+            cell = &sv_grid[y * GRID_SIZE + x];
+            for (l = cell->next; l != cell; l = l->next) {
+                ent = EDICT_FROM_GRID(l);
+                if (ent->v.solid == SOLID_NOT)
+                    continue;
+                for (j = 0; j < 3; j++)
+                    eorg[j] = org[j] - (ent->v.origin[j] + (ent->v.mins[j] + ent->v.maxs[j]) * 0.5f);
+                if (Length(eorg) > rad)
+                    continue;
+                list[count++] = ent;
+            }
+        }
+    }
 
-    return anode;
+    qsort(list, count, sizeof(*list), SV_SortEdicts);
+    return count;
 }
 
 /*
@@ -231,9 +432,9 @@ void SV_ClearWorld(void)
 {
     SV_InitBoxHull();
 
-    memset(sv_areanodes, 0, sizeof(sv_areanodes));
-    sv_numareanodes = 0;
-    SV_CreateAreaNode(0, sv.worldmodel->mins, sv.worldmodel->maxs);
+    SV_CreateAreaLevels(sv.worldmodel->mins, sv.worldmodel->maxs);
+
+    SV_ClearGrid(sv.worldmodel->mins, sv.worldmodel->maxs);
 }
 
 /*
@@ -244,6 +445,11 @@ SV_UnlinkEdict
 */
 void SV_UnlinkEdict(edict_t *ent)
 {
+    if (ent->gridlink.prev) {
+        RemoveLink(&ent->gridlink);
+        ent->gridlink.prev = ent->gridlink.next = NULL;
+    }
+
     if (!ent->area.prev)
         return; // not linked in anywhere
     RemoveLink(&ent->area);
@@ -253,18 +459,59 @@ void SV_UnlinkEdict(edict_t *ent)
 /*
 ====================
 SV_TouchLinks
+
+Touch functions can link and unlink edicts, so the candidates are gathered
+first and checked again right before their touch runs
 ====================
 */
-static void SV_TouchLinks(edict_t *ent, areanode_t const *node)
+static void SV_TouchLinks(edict_t *ent)
 {
-    link_t *l, *next;
-    edict_t *touch;
+    arealevel_t const *level;
+    link_t const *list, *l;
+    edict_t *touch, *local[64], **touches;
     int old_self, old_other;
+    int x, y, x0, y0, x1, y1;
+    int i, count, maxcount, mark;
+
+    touches = local;
+    maxcount = sizeof(local) / sizeof(local[0]);
+    mark = -1;
+
+    sv_touchcount++;
+gather:
+    count = 0;
+    for (i = sv_numarealevels - 1; i >= 0; i--) {
+        level = &sv_arealevels[i];
+        SV_AreaRange(level, ent->v.absmin, ent->v.absmax, &x0, &y0, &x1, &y1);
+        for (y = y0; y <= y1; y++) {
+            for (x = x0; x <= x1; x++) {
+                list = &level->cells[y * level->size + x].trigger_edicts;
+                for (l = list->next; l != list; l = l->next) {
+                    sv_touchcandidates++;
+                    touch = EDICT_FROM_AREA(l);
+                    if (touch == ent)
+                        continue;
+                    if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+                        continue;
+                    if (ent->v.absmin[0] > touch->v.absmax[0] || ent->v.absmin[1] > touch->v.absmax[1] ||
+                        ent->v.absmin[2] > touch->v.absmax[2] || ent->v.absmax[0] < touch->v.absmin[0] ||
+                        ent->v.absmax[1] < touch->v.absmin[1] || ent->v.absmax[2] < touch->v.absmin[2])
+                        continue;
+                    if (count == maxcount) {
+                        // rare, start over with room for every edict
+                        mark = Hunk_LowMark();
+                        touches = (edict_t **)Hunk_AllocName(sv.num_edicts * sizeof(*touches), "touches");
+                        maxcount = sv.num_edicts;
+                        goto gather;
+                    }
+                    touches[count++] = touch;
+                }
+            }
+        }
+    }
 
-    // touch linked edicts
-    for (l = node->trigger_edicts.next; l != &node->trigger_edicts; l = next) {
-        next = l->next;
-        touch = EDICT_FROM_AREA(l);
+    for (i = 0; i < count; i++) {
+        touch = touches[i];
         if (touch == ent)
             continue;
         if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
@@ -285,14 +532,8 @@ static void SV_TouchLinks(edict_t *ent, areanode_t const *node)
         pr_global_struct->other = old_other;
     }
 
-    // recurse down both sides
-    if (node->axis == -1)
-        return;
-
-    if (ent->v.absmax[node->axis] > node->dist)
-        SV_TouchLinks(ent, node->children[0]);
-    if (ent->v.absmin[node->axis] < node->dist)
-        SV_TouchLinks(ent, node->children[1]);
+    if (mark != -1)
+        Hunk_FreeToLowMark(mark);
 }
 
 /*
@@ -346,10 +587,11 @@ SV_LinkEdict
 */
 void SV_LinkEdict(edict_t *ent, qboolean touch_triggers)
 {
-    areanode_t *node;
+    arealevel_t *level;
+    areacell_t *cell;
+    int i;
 
-    if (ent->area.prev)
-        SV_UnlinkEdict(ent); // unlink from old position
+    SV_UnlinkEdict(ent); // unlink from old position
 
     if (ent == sv.edicts)
         return; // don't add the world
@@ -409,32 +651,31 @@ void SV_LinkEdict(edict_t *ent, qboolean touch_triggers)
     if (ent->v.modelindex)
         SV_FindTouchedLeafs(ent, sv.worldmodel->nodes);
 
+    // findradius tests solid when it runs, so SOLID_NOT edicts are indexed too
+    SV_GridLinkEdict(ent);
+
     if (ent->v.solid == SOLID_NOT)
         return;
 
-    // find the first node that the ent's box crosses
-    node = sv_areanodes;
-    while (1) {
-        if (node->axis == -1)
+    // the finest level whose cells hold the box, NaN sizes go to the top
+    for (i = 0, level = sv_arealevels; i < sv_numarealevels - 1; i++, level++) {
+        if (ent->v.absmax[0] - ent->v.absmin[0] < level->cellsize[0] &&
+            ent->v.absmax[1] - ent->v.absmin[1] < level->cellsize[1])
             break;
-        if (ent->v.absmin[node->axis] > node->dist)
-            node = node->children[0];
-        else if (ent->v.absmax[node->axis] < node->dist)
-            node = node->children[1];
-        else
-            break; // crosses the node
     }
+    cell = &level->cells[SV_AreaCoord(level, ent->v.absmin[1], 1) * level->size +
+                         SV_AreaCoord(level, ent->v.absmin[0], 0)];
 
     // link it in
 
     if (ent->v.solid == SOLID_TRIGGER)
-        InsertLinkBefore(&ent->area, &node->trigger_edicts);
+        InsertLinkBefore(&ent->area, &cell->trigger_edicts);
     else
-        InsertLinkBefore(&ent->area, &node->solid_edicts);
+        InsertLinkBefore(&ent->area, &cell->solid_edicts);
 
-    // if touch_triggers, touch all entities at this node and decend for more
+    // if touch_triggers, touch all entities in the cells the box reaches
     if (touch_triggers)
-        SV_TouchLinks(ent, sv_areanodes);
+        SV_TouchLinks(ent);
 }
 
 /*
@@ -534,6 +775,49 @@ LINE TESTING IN HULLS
 // 1/32 epsilon to keep floating point happy
 #define DIST_EPSILON (0.03125f)
 
+/*
+==================
+SV_HullMidPoint
+
+The point frac of the way from p1 to p2, and its fraction of the whole move
+==================
+*/
+static float SV_HullMidPoint(float frac, float p1f, float p2f, vec3_t const p1, vec3_t const p2, vec3_t mid)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+    return p1f + (p2f - p1f) * frac;
+}
+
+/*
+==================
+SV_HullCrossPoint
+
+Where a line t1 and t2 away from a plane at its ends crosses it, computed
+once per split for both sides of it
+==================
+*/
+static float SV_HullCrossPoint(float t1, float t2, float p1f, float p2f, vec3_t const p1, vec3_t const p2,
+                               vec3_t mid, float *midf)
+{
+    float frac;
+
+    // put the crosspoint DIST_EPSILON pixels on the near side
+    if (t1 < 0)
+        frac = (t1 + DIST_EPSILON) / (t1 - t2);
+    else
+        frac = (t1 - DIST_EPSILON) / (t1 - t2);
+    if (frac < 0)
+        frac = 0;
+    if (frac > 1)
+        frac = 1;
+
+    *midf = SV_HullMidPoint(frac, p1f, p2f, p1, p2, mid);
+    return frac;
+}
+
 /*
 ==================
 SV_RecursiveHullCheck
@@ -546,7 +830,6 @@ qboolean SV_RecursiveHullCheck(hull_t *hull, int num, float p1f, float p2f, vec3
     mplane_t *plane;
     float t1, t2;
     float frac;
-    int i;
     vec3_t mid;
     int side;
     float midf;
@@ -593,19 +876,7 @@ qboolean SV_RecursiveHullCheck(hull_t *hull, int num, float p1f, float p2f, vec3
         return SV_RecursiveHullCheck(hull, node->children[1], p1f, p2f, p1, p2, trace);
 #endif
 
-    // put the crosspoint DIST_EPSILON pixels on the near side
-    if (t1 < 0)
-        frac = (t1 + DIST_EPSILON) / (t1 - t2);
-    else
-        frac = (t1 - DIST_EPSILON) / (t1 - t2);
-    if (frac < 0)
-        frac = 0;
-    if (frac > 1)
-        frac = 1;
-
-    midf = p1f + (p2f - p1f) * frac;
-    for (i = 0; i < 3; i++)
-        mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+    frac = SV_HullCrossPoint(t1, t2, p1f, p2f, p1, p2, mid, &midf);
 
     side = (t1 < 0);
 
@@ -640,9 +911,7 @@ qboolean SV_RecursiveHullCheck(hull_t *hull, int num, float p1f, float p2f, vec3
             Con_DPrintf("backup past 0\n");
             return false;
         }
-        midf = p1f + (p2f - p1f) * frac;
-        for (i = 0; i < 3; i++)
-            mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+        midf = SV_HullMidPoint(frac, p1f, p2f, p1, p2, mid);
     }
 
     trace->fraction = midf;
@@ -653,13 +922,177 @@ qboolean SV_RecursiveHullCheck(hull_t *hull, int num, float p1f, float p2f, vec3
 
 /*
 ==================
-SV_ClipMoveToEntity
+SV_BoxHullContents
+
+SV_HullPointContents for the box hull, from clipnode num on
+==================
+*/
+static int SV_BoxHullContents(float const dist[6], int num, vec3_t const p)
+{
+    // clipnode num sends points behind its plane to children[1], the empty side is children[num & 1]
+    for (; num < 6; num++) {
+        if ((p[num >> 1] - dist[num] < 0) == (num & 1))
+            return CONTENTS_EMPTY;
+    }
+    return CONTENTS_SOLID;
+}
+
+/*
+==================
+SV_BoxHullCheck
+
+SV_RecursiveHullCheck unrolled for the box hull. One child of every clipnode
+is empty, so only one piece of the line is ever left to trace and the
+recursion becomes a walk down the six planes. The arithmetic is kept the same
+so the trace comes out bit for bit identical.
+==================
+*/
+static void SV_BoxHullCheck(float const dist[6], vec3_t const start, vec3_t const end, trace_t *trace)
+{
+    float p1f, p2f, midf;
+    float t1, t2, frac;
+    vec3_t p1, p2, mid;
+    int num, axis, side;
+    qboolean exited;
+
+    p1f = 0;
+    p2f = 1;
+    VectorCopy(start, p1);
+    VectorCopy(end, p2);
+    exited = false;
+
+    for (num = 0;; num++) {
+        if (num == 6) { // behind all six planes
+            trace->startsolid = true;
+            break;
+        }
+
+        axis = num >> 1;
+        t1 = p1[axis] - dist[num];
+        t2 = p2[axis] - dist[num];
+
+        if (t1 >= 0 && t2 >= 0) {
+            if (num & 1)
+                continue;
+            trace->allsolid = false;
+            trace->inopen = true;
+            break;
+        }
+        if (t1 < 0 && t2 < 0) {
+            if (!(num & 1))
+                continue;
+            trace->allsolid = false;
+            trace->inopen = true;
+            break;
+        }
+
+        frac = SV_HullCrossPoint(t1, t2, p1f, p2f, p1, p2, mid, &midf);
+
+        side = (t1 < 0);
+
+        if (side != (num & 1)) {
+            // leaving the box, the rest of the line is open once the start is traced
+            exited = true;
+            p2f = midf;
+            VectorCopy(mid, p2);
+            continue;
+        }
+
+        // entering, the start is open
+        trace->allsolid = false;
+        trace->inopen = true;
+
+        if (SV_BoxHullContents(dist, num + 1, mid) != CONTENTS_SOLID) {
+            // go past the node
+            p1f = midf;
+            VectorCopy(mid, p1);
+            continue;
+        }
+
+        // the other side of the node is solid, this is the impact point
+        trace->plane.normal[0] = trace->plane.normal[1] = trace->plane.normal[2] = 0;
+        if (!side) {
+            trace->plane.normal[axis] = 1;
+            trace->plane.dist = dist[num];
+        } else {
+            trace->plane.normal[axis] = -1;
+            trace->plane.dist = -dist[num];
+        }
+
+        while (SV_BoxHullContents(dist, 0, mid) == CONTENTS_SOLID) {
+            frac -= 0.1f;
+            if (frac < 0) {
+                trace->fraction = midf;
+                VectorCopy(mid, trace->endpos);
+                Con_DPrintf("backup past 0\n");
+                return;
+            }
+            midf = SV_HullMidPoint(frac, p1f, p2f, p1, p2, mid);
+        }
+
+        trace->fraction = midf;
+        VectorCopy(mid, trace->endpos);
+        return;
+    }
+
+    if (exited) {
+        trace->allsolid = false;
+        trace->inopen = true;
+    }
+}
+
+/*
+==================
+SV_ClipMoveToBox
+
+SV_ClipMoveToEntity for edicts that clip as their bounding box
+==================
+*/
+static trace_t SV_ClipMoveToBox(edict_t *ent, vec3_t const start, vec3_t const mins, vec3_t const maxs, vec3_t const end)
+{
+    trace_t trace;
+    float dist[6];
+    vec3_t start_l, end_l;
+
+    // fill in a default trace
+    memset(&trace, 0, sizeof(trace_t));
+    trace.fraction = 1;
+    trace.allsolid = true;
+    VectorCopy(end, trace.endpos);
+
+    // the planes SV_HullForBox would set up
+    dist[0] = ent->v.maxs[0] - mins[0];
+    dist[1] = ent->v.mins[0] - maxs[0];
+    dist[2] = ent->v.maxs[1] - mins[1];
+    dist[3] = ent->v.mins[1] - maxs[1];
+    dist[4] = ent->v.maxs[2] - mins[2];
+    dist[5] = ent->v.mins[2] - maxs[2];
+
+    VectorSubtract(start, ent->v.origin, start_l);
+    VectorSubtract(end, ent->v.origin, end_l);
+
+    SV_BoxHullCheck(dist, start_l, end_l, &trace);
+
+    // fix trace up by the offset
+    if (trace.fraction != 1)
+        VectorAdd(trace.endpos, ent->v.origin, trace.endpos);
+
+    // did we clip the move?
+    if (trace.fraction < 1 || trace.startsolid)
+        trace.ent = ent;
+
+    return trace;
+}
+
+/*
+==================
+SV_ClipMoveToHull
 
 Handles selection or creation of a clipping hull, and offseting (and
 eventually rotation) of the end points
 ==================
 */
-static trace_t SV_ClipMoveToEntity(edict_t *ent, vec3_t const start, vec3_t const mins, vec3_t const maxs, vec3_t const end)
+static trace_t SV_ClipMoveToHull(edict_t *ent, vec3_t const start, vec3_t const mins, vec3_t const maxs, vec3_t const end)
 {
     trace_t trace;
     vec3_t offset;
@@ -737,24 +1170,138 @@ static trace_t SV_ClipMoveToEntity(edict_t *ent, vec3_t const start, vec3_t cons
     return trace;
 }
 
+CVAR_REGISTER(sv_boxsweep, CVAR_CTOR({ "sv_boxsweep", "1" }));
+
+/*
+==================
+SV_ClipMoveToEntity
+
+==================
+*/
+static trace_t SV_ClipMoveToEntity(edict_t *ent, vec3_t const start, vec3_t const mins, vec3_t const maxs,
+                                   vec3_t const end)
+{
+    if (ent->v.solid != SOLID_BSP && sv_boxsweep.value)
+        return SV_ClipMoveToBox(ent, start, mins, maxs, end);
+    return SV_ClipMoveToHull(ent, start, mins, maxs, end);
+}
+
+/*
+==================
+SV_TraceBench_f
+
+Checks the box sweep against the box hull on pseudo random boxes and moves,
+then times both. Coordinates sit on a 1/8 unit grid so moves that start,
+end or slide exactly on a plane come up often.
+
+sv_tracebench [traces]
+==================
+*/
+#define TRACEBENCH_CASES 4096
+
+typedef struct {
+    vec3_t entmins, entmaxs, origin;
+    vec3_t start, mins, maxs, end;
+} tracecase_t;
+
+static volatile float tracebench_sink; // keeps the timed traces from being optimized out
+
+static float SV_TraceBenchCoord(uint32_t *seed, int range)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (int)((*seed >> 8) % (range * 16 + 1) - range * 8) / 8.0f;
+}
+
+static void SV_TraceBench_f(void)
+{
+    static tracecase_t cases[TRACEBENCH_CASES];
+    static edict_t ent;
+    tracecase_t *c;
+    trace_t a, b;
+    uint32_t seed, start, time[2];
+    int traces, mismatches, hits;
+    int i, j, mode;
+    float sum;
+
+    traces = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 1000000;
+    if (traces < TRACEBENCH_CASES)
+        traces = TRACEBENCH_CASES;
+
+    seed = 1;
+    for (i = 0, c = cases; i < TRACEBENCH_CASES; i++, c++) {
+        for (j = 0; j < 3; j++) {
+            c->entmins[j] = -fabsf(SV_TraceBenchCoord(&seed, 32));
+            c->entmaxs[j] = fabsf(SV_TraceBenchCoord(&seed, 32));
+            c->origin[j] = SV_TraceBenchCoord(&seed, 16);
+            c->start[j] = SV_TraceBenchCoord(&seed, 96);
+            c->end[j] = (i & 3) == j ? c->start[j] : SV_TraceBenchCoord(&seed, 96);
+            c->mins[j] = (i & 4) ? 0 : -fabsf(SV_TraceBenchCoord(&seed, 24));
+            c->maxs[j] = (i & 4) ? 0 : fabsf(SV_TraceBenchCoord(&seed, 24));
+        }
+        if ((i & 31) == 31)
+            VectorCopy(c->start, c->end);
+    }
+
+    ent.v.solid = SOLID_BBOX;
+
+    // identical traces, compared bit for bit
+    mismatches = hits = 0;
+    for (i = 0, c = cases; i < TRACEBENCH_CASES; i++, c++) {
+        VectorCopy(c->entmins, ent.v.mins);
+        VectorCopy(c->entmaxs, ent.v.maxs);
+        VectorCopy(c->origin, ent.v.origin);
+        a = SV_ClipMoveToHull(&ent, c->start, c->mins, c->maxs, c->end);
+        b = SV_ClipMoveToBox(&ent, c->start, c->mins, c->maxs, c->end);
+        if (memcmp(&a, &b, sizeof(a))) {
+            if (!mismatches)
+                Con_Printf("case %i: hull %g (%g %g %g) box %g (%g %g %g)\n", i, a.fraction, a.endpos[0],
+                           a.endpos[1], a.endpos[2], b.fraction, b.endpos[0], b.endpos[1], b.endpos[2]);
+            mismatches++;
+        }
+        if (a.fraction < 1 || a.startsolid)
+            hits++;
+    }
+
+    for (mode = 0; mode < 2; mode++) {
+        sum = 0;
+        start = Sys_CurrentTicks();
+        for (i = 0; i < traces; i++) {
+            c = &cases[i & (TRACEBENCH_CASES - 1)];
+            VectorCopy(c->entmins, ent.v.mins);
+            VectorCopy(c->entmaxs, ent.v.maxs);
+            VectorCopy(c->origin, ent.v.origin);
+            if (mode)
+                sum += SV_ClipMoveToBox(&ent, c->start, c->mins, c->maxs, c->end).fraction;
+            else
+                sum += SV_ClipMoveToHull(&ent, c->start, c->mins, c->maxs, c->end).fraction;
+        }
+        time[mode] = Sys_CurrentTicks() - start;
+        tracebench_sink = sum;
+    }
+
+    Con_Printf("%i cases, %i hit, %i differ\n", TRACEBENCH_CASES, hits, mismatches);
+    Con_Printf("%i traces: box hull %u ms, box sweep %u ms\n", traces, time[0], time[1]);
+}
+
+CMD_REGISTER("sv_tracebench", SV_TraceBench_f);
+
 //===========================================================================
 
 /*
 ====================
-SV_ClipToLinks
+SV_ClipToCell
 
-Mins and maxs enclose the entire area swept by the move
 ====================
 */
-void SV_ClipToLinks(areanode_t const *node, moveclip_t *clip)
+static void SV_ClipToCell(link_t const *list, moveclip_t *clip)
 {
-    link_t *l, *next;
+    link_t const *l;
     edict_t *touch;
     trace_t trace;
 
     // touch linked edicts
-    for (l = node->solid_edicts.next; l != &node->solid_edicts; l = next) {
-        next = l->next;
+    for (l = list->next; l != list; l = l->next) {
+        sv_movecandidates++;
         touch = EDICT_FROM_AREA(l);
         if (touch->v.solid == SOLID_NOT)
             continue;
@@ -784,6 +1331,7 @@ void SV_ClipToLinks(areanode_t const *node, moveclip_t *clip)
                 continue; // don't clip against owner
         }
 
+        sv_moveclips++;
         if ((int)touch->v.flags & FL_MONSTER)
             trace = SV_ClipMoveToEntity(touch, clip->start, clip->mins2, clip->maxs2, clip->end);
         else
@@ -797,15 +1345,31 @@ void SV_ClipToLinks(areanode_t const *node, moveclip_t *clip)
                 clip->trace = trace;
         }
     }
+}
 
-    // recurse down both sides
-    if (node->axis == -1)
-        return;
+/*
+====================
+SV_ClipToLinks
 
-    if (clip->boxmaxs[node->axis] > node->dist)
-        SV_ClipToLinks(node->children[0], clip);
-    if (clip->boxmins[node->axis] < node->dist)
-        SV_ClipToLinks(node->children[1], clip);
+Mins and maxs enclose the entire area swept by the move
+====================
+*/
+static void SV_ClipToLinks(moveclip_t *clip)
+{
+    arealevel_t const *level;
+    int i, x, y, x0, y0, x1, y1;
+
+    for (i = sv_numarealevels - 1; i >= 0; i--) {
+        level = &sv_arealevels[i];
+        SV_AreaRange(level, clip->boxmins, clip->boxmaxs, &x0, &y0, &x1, &y1);
+        for (y = y0; y <= y1; y++) {
+            for (x = x0; x <= x1; x++) {
+                if (clip->trace.allsolid)
+                    return;
+                SV_ClipToCell(&level->cells[y * level->size + x].solid_edicts, clip);
+            }
+        }
+    }
 }
 
 /*
@@ -871,7 +1435,8 @@ trace_t SV_Move(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, ed
     SV_MoveBounds(start, clip.mins2, clip.maxs2, end, clip.boxmins, clip.boxmaxs);
 
     // clip to entities
-    SV_ClipToLinks(sv_areanodes, &clip);
+    sv_movecount++;
+    SV_ClipToLinks(&clip);
 
     return clip.trace;
 }
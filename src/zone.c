@@ -24,20 +24,41 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define DYNAMIC_SIZE 0xc000
 
 #define ZONEID 0x1d4a11
-#define MINFRAGMENT 64
+
+#define ZONE_ALIGNBITS 3 // blocks are a multiple of 8 bytes
+#define ZONE_SLBITS 3 // each power of two is split over 8 free lists
+#define ZONE_SLCOUNT (1 << ZONE_SLBITS)
+#define ZONE_SMALL (1 << (ZONE_SLBITS + ZONE_ALIGNBITS)) // smaller blocks get a list per size
+#define ZONE_FLCOUNT (32 - ZONE_SLBITS - ZONE_ALIGNBITS)
+#define ZONE_TAGS 8
 
 typedef struct memblock_s {
-    int size; // including the header and possibly tiny fragments
+    int size; // including the header and the trash tester, 0 for the end cap
     int tag; // a tag of 0 is a free block
     int id; // should be ZONEID
-    struct memblock_s *next, *prev;
-    int pad; // pad to 64 bit boundary
+    struct memblock_s *prev; // the block right below this one, NULL for the first
+    struct memblock_s *nextfree, *prevfree; // free blocks only, in place of the data
 } memblock_t;
 
+#define ZONE_HEADER ((int)offsetof(memblock_t, nextfree))
+#define ZONE_MINBLOCK (((int)sizeof(memblock_t) + 7) & ~7)
+
+typedef struct {
+    int tag;
+    int blocks;
+    int bytes; // of the blocks, headers included
+    int peak;
+} zonetag_t;
+
 typedef struct {
     int size; // total bytes malloced, including header
-    memblock_t blocklist; // start / end cap for linked list
-    memblock_t *rover;
+    memblock_t *blocks; // the lowest block, the end cap is the highest
+    unsigned flmap; // a bit for each power of two with a free block
+    unsigned slmap[ZONE_FLCOUNT]; // a bit for each of its lists that has one
+    memblock_t *free[ZONE_FLCOUNT * ZONE_SLCOUNT];
+    int used, peak; // bytes in allocated blocks, headers included
+    int allocs, frees, failures;
+    zonetag_t tags[ZONE_TAGS]; // the last one counts the tags that didn't fit
 } memzone_t;
 
 void Cache_FreeLow(int new_low_hunk);
@@ -51,7 +72,11 @@ void Cache_FreeHigh(int new_high_hunk);
 There is never any space between memblocks, and there will never be two
 contiguous free memblocks.
 
-The rover can be left pointing at a non-empty block
+Free blocks are kept on segregated lists, eight per power of two of their size
+(one per size below 64 bytes), with a bitmap of the lists that aren't empty.
+An allocation takes the first block from the smallest list whose blocks are
+all big enough, and a free merges with the blocks on either side, both without
+walking the zone.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
@@ -62,67 +87,301 @@ memzone_t *mainzone;
 
 void Z_ClearZone(memzone_t *zone, int size);
 
+static inline int Z_Log2(unsigned size)
+{
+    return 31 - __builtin_clz(size);
+}
+
 /*
 ========================
-Z_ClearZone
+Z_List
+
+The free list a block of this size goes on, eight lists to a power of two
 ========================
 */
-void Z_ClearZone(memzone_t *zone, int size)
+static inline int Z_List(int size)
 {
-    memblock_t *block;
+    int shift;
+
+    if (size < ZONE_SMALL)
+        return size >> ZONE_ALIGNBITS;
 
-    // set the entire zone to one free block
+    shift = Z_Log2(size) - ZONE_SLBITS;
+    return ((shift - ZONE_ALIGNBITS) << ZONE_SLBITS) + (size >> shift);
+}
 
-    zone->blocklist.next = zone->blocklist.prev = block = (memblock_t *)((byte *)zone + sizeof(memzone_t));
-    zone->blocklist.tag = 1; // in use block
-    zone->blocklist.id = 0;
-    zone->blocklist.size = 0;
-    zone->rover = block;
+static inline void Z_LinkFree(memzone_t *zone, memblock_t *block)
+{
+    int list;
+
+    list = Z_List(block->size);
+    block->prevfree = NULL;
+    block->nextfree = zone->free[list];
+    if (block->nextfree)
+        block->nextfree->prevfree = block;
+    zone->free[list] = block;
+    zone->flmap |= 1u << (list >> ZONE_SLBITS);
+    zone->slmap[list >> ZONE_SLBITS] |= 1u << (list & (ZONE_SLCOUNT - 1));
+}
 
-    block->prev = block->next = &zone->blocklist;
-    block->tag = 0; // free block
-    block->id = ZONEID;
-    block->size = size - sizeof(memzone_t);
+static inline void Z_UnlinkFree(memzone_t *zone, memblock_t *block)
+{
+    int list;
+
+    if (block->nextfree)
+        block->nextfree->prevfree = block->prevfree;
+    if (block->prevfree) {
+        block->prevfree->nextfree = block->nextfree;
+        return;
+    }
+
+    list = Z_List(block->size);
+    zone->free[list] = block->nextfree;
+    if (!block->nextfree) {
+        zone->slmap[list >> ZONE_SLBITS] &= ~(1u << (list & (ZONE_SLCOUNT - 1)));
+        if (!zone->slmap[list >> ZONE_SLBITS])
+            zone->flmap &= ~(1u << (list >> ZONE_SLBITS));
+    }
 }
 
 /*
 ========================
-Z_Free
+Z_FindFree
+
+A free block of at least size bytes, the size is rounded up to the next list
+so that any block on the list fits
 ========================
 */
-void Z_Free(void *ptr)
+static inline memblock_t *Z_FindFree(memzone_t *zone, int size)
+{
+    unsigned map;
+    int list, fl;
+
+    if (size >= ZONE_SMALL)
+        size += (1 << (Z_Log2(size) - ZONE_SLBITS)) - 1;
+    list = Z_List(size);
+    fl = list >> ZONE_SLBITS;
+
+    map = zone->slmap[fl] & (~0u << (list & (ZONE_SLCOUNT - 1)));
+    if (!map) {
+        map = zone->flmap & (~0u << (fl + 1));
+        if (!map)
+            return NULL;
+        fl = __builtin_ctz(map);
+        map = zone->slmap[fl];
+    }
+
+    return zone->free[(fl << ZONE_SLBITS) + __builtin_ctz(map)];
+}
+
+static inline zonetag_t *Z_TagStats(memzone_t *zone, int tag)
+{
+    zonetag_t *stats;
+
+    for (stats = zone->tags; stats < zone->tags + ZONE_TAGS - 1; stats++) {
+        if (!stats->tag)
+            stats->tag = tag;
+        if (stats->tag == tag)
+            return stats;
+    }
+
+    if (stats->tag != tag)
+        stats->tag = -1;
+    return stats;
+}
+
+/*
+========================
+Z_ClearZone
+========================
+*/
+void Z_ClearZone(memzone_t *zone, int size)
+{
+    memblock_t *block, *end;
+
+    Q_memset(zone, 0, sizeof(*zone));
+    zone->size = size;
+
+    // set the entire zone to one free block, followed by an in use end cap
+    block = zone->blocks = (memblock_t *)((byte *)zone + ((sizeof(memzone_t) + 7) & ~7));
+    end = (memblock_t *)((byte *)zone + ((size - ZONE_HEADER) & ~7));
+
+    block->size = (byte *)end - (byte *)block;
+    block->tag = 0; // free block
+    block->id = ZONEID;
+    block->prev = NULL;
+    Z_LinkFree(zone, block);
+
+    end->size = 0;
+    end->tag = -1; // in use block
+    end->id = ZONEID;
+    end->prev = block;
+}
+
+static void *Z_ZoneAlloc(memzone_t *zone, int size, int tag)
+{
+    int extra;
+    memblock_t *block, *rest;
+    zonetag_t *stats;
+
+    size += ZONE_HEADER; // account for size of block header
+    size += 4; // space for memory trash tester
+    size = (size + 7) & ~7; // align to 8-byte boundary
+    if (size < ZONE_MINBLOCK)
+        size = ZONE_MINBLOCK;
+
+    block = size < zone->size ? Z_FindFree(zone, size) : NULL;
+    if (!block) {
+        zone->failures++;
+        return NULL;
+    }
+    Z_UnlinkFree(zone, block);
+
+    extra = block->size - size;
+    if (extra >= ZONE_MINBLOCK) { // the rest of the block stays free
+        rest = (memblock_t *)((byte *)block + size);
+        rest->size = extra;
+        rest->tag = 0; // free block
+        rest->id = ZONEID;
+        rest->prev = block;
+        ((memblock_t *)((byte *)rest + extra))->prev = rest;
+        block->size = size;
+        Z_LinkFree(zone, rest);
+    }
+
+    block->tag = tag; // no longer a free block
+
+    // marker for memory trash testing
+    *(int *)((byte *)block + block->size - 4) = ZONEID;
+
+    zone->allocs++;
+    zone->used += block->size;
+    if (zone->used > zone->peak)
+        zone->peak = zone->used;
+    stats = Z_TagStats(zone, tag);
+    stats->blocks++;
+    stats->bytes += block->size;
+    if (stats->bytes > stats->peak)
+        stats->peak = stats->bytes;
+
+    return (void *)((byte *)block + ZONE_HEADER);
+}
+
+static void Z_ZoneFree(memzone_t *zone, void *ptr)
 {
     memblock_t *block, *other;
+    zonetag_t *stats;
 
     if (!ptr)
         Sys_Error("Z_Free: NULL pointer");
 
-    block = (memblock_t *)((byte *)ptr - sizeof(memblock_t));
+    block = (memblock_t *)((byte *)ptr - ZONE_HEADER);
     if (block->id != ZONEID)
         Sys_Error("Z_Free: freed a pointer without ZONEID");
     if (block->tag == 0)
         Sys_Error("Z_Free: freed a freed pointer");
 
+    zone->frees++;
+    zone->used -= block->size;
+    stats = Z_TagStats(zone, block->tag);
+    stats->blocks--;
+    stats->bytes -= block->size;
+
     block->tag = 0; // mark as free
 
     other = block->prev;
-    if (!other->tag) { // merge with previous free block
+    if (other && !other->tag) { // merge with previous free block
+        Z_UnlinkFree(zone, other);
         other->size += block->size;
-        other->next = block->next;
-        other->next->prev = other;
-        if (block == mainzone->rover)
-            mainzone->rover = other;
         block = other;
     }
 
-    other = block->next;
+    other = (memblock_t *)((byte *)block + block->size);
     if (!other->tag) { // merge the next free block onto the end
+        Z_UnlinkFree(zone, other);
         block->size += other->size;
-        block->next = other->next;
-        block->next->prev = block;
-        if (other == mainzone->rover)
-            mainzone->rover = block;
     }
+
+    ((memblock_t *)((byte *)block + block->size))->prev = block;
+    Z_LinkFree(zone, block);
+}
+
+/*
+========================
+Z_FreeStats
+
+Walks the zone for the free bytes, blocks and the largest free block
+========================
+*/
+static void Z_FreeStats(memzone_t *zone, int *bytes, int *blocks, int *largest)
+{
+    memblock_t *block;
+
+    *bytes = *blocks = *largest = 0;
+    for (block = zone->blocks; block->size; block = (memblock_t *)((byte *)block + block->size)) {
+        if (block->tag)
+            continue;
+        *bytes += block->size;
+        *blocks += 1;
+        if (block->size > *largest)
+            *largest = block->size;
+    }
+}
+
+/*
+==============================================================================
+
+ALLOCATION TRACES
+
+zone_trace writes every allocation and free of the main zone to a file,
+zone_replay runs them through the allocators again to time them
+==============================================================================
+*/
+
+typedef struct {
+    int offset; // of the data from the zone, matches a free to its allocation
+    int size; // asked for, -1 for a free
+    int tag;
+} zonetrace_t;
+// the file starts with { ZONEID, zone size, 0 }
+
+#define ZONE_TRACEBUFFER 256
+
+static int zone_tracefile = -1;
+static int zone_traceevents;
+static int zone_tracecount;
+static zonetrace_t zone_trace[ZONE_TRACEBUFFER];
+
+static void Z_TraceFlush(void)
+{
+    Sys_FileWrite(zone_tracefile, zone_trace, zone_tracecount * sizeof(zonetrace_t));
+    zone_tracecount = 0;
+}
+
+static void Z_Trace(void const *ptr, int size, int tag)
+{
+    zonetrace_t *ev;
+
+    ev = &zone_trace[zone_tracecount++];
+    ev->offset = (byte const *)ptr - (byte const *)mainzone;
+    ev->size = size;
+    ev->tag = tag;
+    zone_traceevents++;
+
+    if (zone_tracecount == ZONE_TRACEBUFFER)
+        Z_TraceFlush();
+}
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free(void *ptr)
+{
+    Z_ZoneFree(mainzone, ptr);
+    if (zone_tracefile != -1)
+        Z_Trace(ptr, -1, 0);
 }
 
 /*
@@ -149,25 +408,200 @@ void *Z_Malloc(int size)
 
 void *Z_TagMalloc(int size, int tag)
 {
-    int extra;
-    memblock_t *start, *rover, *newblock, *base;
+    void *buf;
 
     if (!tag)
         Sys_Error("Z_TagMalloc: tried to use a 0 tag");
 
-    //
-    // scan through the block list looking for the first free block
-    // of sufficient size
-    //
-    size += sizeof(memblock_t); // account for size of block header
-    size += 4; // space for memory trash tester
-    size = (size + 7) & ~7; // align to 8-byte boundary
+    buf = Z_ZoneAlloc(mainzone, size, tag);
+    if (buf && zone_tracefile != -1)
+        Z_Trace(buf, size, tag);
+
+    return buf;
+}
+
+/*
+========================
+Z_Print
+========================
+*/
+void Z_Print(memzone_t *zone)
+{
+    memblock_t *block, *next;
+
+    Con_Printf("zone size: %i  location: %p\n", zone->size, zone);
+
+    for (block = zone->blocks; block->size; block = next) {
+        Con_Printf("block:%p    size:%7i    tag:%3i\n", block, block->size, block->tag);
+
+        next = (memblock_t *)((byte *)block + block->size);
+        if (next->prev != block)
+            Con_Printf("ERROR: next block doesn't have proper back link\n");
+        if (!block->tag && !next->tag)
+            Con_Printf("ERROR: two consecutive free blocks\n");
+    }
+}
+
+/*
+========================
+Z_CheckHeap
+========================
+*/
+void Z_CheckHeap(void)
+{
+    memblock_t *block, *next;
+
+    for (block = mainzone->blocks; block->size; block = next) {
+        next = (memblock_t *)((byte *)block + block->size);
+        if (block->id != ZONEID)
+            Sys_Error("Z_CheckHeap: block without ZONEID\n");
+        if (block->size < ZONE_MINBLOCK || (byte *)next > (byte *)mainzone + mainzone->size)
+            Sys_Error("Z_CheckHeap: bad block size\n");
+        if (next->prev != block)
+            Sys_Error("Z_CheckHeap: next block doesn't have proper back link\n");
+        if (!block->tag && !next->tag)
+            Sys_Error("Z_CheckHeap: two consecutive free blocks\n");
+        if (block->tag && *(int *)((byte *)next - 4) != ZONEID)
+            Sys_Error("Z_CheckHeap: memory trashed past the end of a block\n");
+    }
+}
+
+/*
+========================
+Z_Stats_f
+
+zone_stats
+========================
+*/
+static void Z_Stats_f(void)
+{
+    int freebytes, freeblocks, largest, blocks, i;
+    zonetag_t *stats;
+
+    Z_FreeStats(mainzone, &freebytes, &freeblocks, &largest);
+    for (i = blocks = 0; i < ZONE_TAGS; i++)
+        blocks += mainzone->tags[i].blocks;
+
+    Con_Printf("zone: %i bytes, %i used in %i blocks (peak %i), %i free in %i blocks\n",
+               mainzone->size, mainzone->used, blocks, mainzone->peak, freebytes, freeblocks);
+    Con_Printf("largest free block %i, fragmentation %.1f%%\n", largest,
+               freebytes ? 100.0 * (freebytes - largest) / freebytes : 0.0);
+    Con_Printf("%i allocations, %i frees, %i failed\n", mainzone->allocs, mainzone->frees, mainzone->failures);
+
+    Con_Printf(" tag blocks   bytes    peak\n");
+    for (stats = mainzone->tags; stats < mainzone->tags + ZONE_TAGS && stats->tag; stats++) {
+        if (stats->tag == -1)
+            Con_Printf("rest");
+        else
+            Con_Printf("%4i", stats->tag);
+        Con_Printf(" %6i %7i %7i\n", stats->blocks, stats->bytes, stats->peak);
+    }
+}
+
+/*
+========================
+Z_Trace_f
+
+zone_trace [filename]
+========================
+*/
+static void Z_Trace_f(void)
+{
+    char name[MAX_OSPATH];
+    memblock_t *block;
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("zone_trace [filename] : record the zone allocations to filename, without one stop\n");
+        return;
+    }
+
+    if (zone_tracefile != -1) {
+        Z_TraceFlush();
+        Sys_FileClose(zone_tracefile);
+        zone_tracefile = -1;
+        Con_Printf("Recorded %i zone allocations and frees\n", zone_traceevents);
+    }
+    if (Cmd_Argc() == 1)
+        return;
+
+    if (strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+    if (snprintf(name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv(1)) >= sizeof(name)) {
+        Con_Printf("ERROR: %s is too long.\n", Cmd_Argv(1));
+        return;
+    }
+
+    zone_tracefile = Sys_FileOpenWrite(name);
+    COM_FlushMisses();
+    zone_trace[0].offset = ZONEID;
+    zone_trace[0].size = mainzone->size;
+    zone_trace[0].tag = 0;
+    zone_tracecount = 1;
+    zone_traceevents = 0;
 
-    base = rover = mainzone->rover;
+    // start with the blocks already allocated
+    for (block = mainzone->blocks; block->size; block = (memblock_t *)((byte *)block + block->size))
+        if (block->tag)
+            Z_Trace((byte *)block + ZONE_HEADER, block->size - ZONE_HEADER - 4, block->tag);
+
+    Con_Printf("Recording zone allocations to %s\n", name);
+}
+
+/*
+========================
+The first fit allocator the zone used before, with a rover going around the
+blocks, kept for zone_replay to compare against
+========================
+*/
+
+#define MINFRAGMENT 64
+
+typedef struct roverblock_s {
+    int size; // including the header and possibly tiny fragments
+    int tag; // a tag of 0 is a free block
+    int id; // should be ZONEID
+    struct roverblock_s *next, *prev;
+    int pad; // pad to 64 bit boundary
+} roverblock_t;
+
+typedef struct {
+    roverblock_t blocklist; // start / end cap for linked list
+    roverblock_t *rover;
+} roverzone_t;
+
+static void Z_RoverClear(void *zone, int size)
+{
+    roverzone_t *rz = (roverzone_t *)zone;
+    roverblock_t *block;
+
+    rz->blocklist.next = rz->blocklist.prev = block = (roverblock_t *)(rz + 1);
+    rz->blocklist.tag = 1;
+    rz->blocklist.size = 0;
+    rz->rover = block;
+
+    block->prev = block->next = &rz->blocklist;
+    block->tag = 0;
+    block->id = ZONEID;
+    block->size = size - sizeof(roverzone_t);
+}
+
+static void *Z_RoverAlloc(void *zone, int size, int tag)
+{
+    roverzone_t *rz = (roverzone_t *)zone;
+    roverblock_t *start, *rover, *newblock, *base;
+    int extra;
+
+    size += sizeof(roverblock_t);
+    size += 4;
+    size = (size + 7) & ~7;
+
+    base = rover = rz->rover;
     start = base->prev;
 
     do {
-        if (rover == start) // scaned all the way around the list
+        if (rover == start)
             return NULL;
         if (rover->tag)
             base = rover = rover->next;
@@ -175,14 +609,11 @@ void *Z_TagMalloc(int size, int tag)
             rover = rover->next;
     } while (base->tag || base->size < size);
 
-    //
-    // found a block big enough
-    //
     extra = base->size - size;
-    if (extra > MINFRAGMENT) { // there will be a free fragment after the allocated block
-        newblock = (memblock_t *)((byte *)base + size);
+    if (extra > MINFRAGMENT) {
+        newblock = (roverblock_t *)((byte *)base + size);
         newblock->size = extra;
-        newblock->tag = 0; // free block
+        newblock->tag = 0;
         newblock->prev = base;
         newblock->id = ZONEID;
         newblock->next = base->next;
@@ -191,64 +622,208 @@ void *Z_TagMalloc(int size, int tag)
         base->size = size;
     }
 
-    base->tag = tag; // no longer a free block
+    base->tag = tag;
+    rz->rover = base->next;
+    base->id = ZONEID;
+    *(int *)((byte *)base + base->size - 4) = ZONEID;
+
+    return (void *)(base + 1);
+}
+
+static void Z_RoverFree(void *zone, void *ptr)
+{
+    roverzone_t *rz = (roverzone_t *)zone;
+    roverblock_t *block, *other;
+
+    block = (roverblock_t *)ptr - 1;
+    block->tag = 0;
+
+    other = block->prev;
+    if (!other->tag) {
+        other->size += block->size;
+        other->next = block->next;
+        other->next->prev = other;
+        if (block == rz->rover)
+            rz->rover = other;
+        block = other;
+    }
+
+    other = block->next;
+    if (!other->tag) {
+        block->size += other->size;
+        block->next = other->next;
+        block->next->prev = block;
+        if (other == rz->rover)
+            rz->rover = block;
+    }
+}
 
-    mainzone->rover = base->next; // next allocation will start looking here
+static void Z_RoverFreeStats(void *zone, int *bytes, int *blocks, int *largest)
+{
+    roverzone_t *rz = (roverzone_t *)zone;
+    roverblock_t *block;
+
+    *bytes = *blocks = *largest = 0;
+    for (block = rz->blocklist.next; block != &rz->blocklist; block = block->next) {
+        if (block->tag)
+            continue;
+        *bytes += block->size;
+        *blocks += 1;
+        if (block->size > *largest)
+            *largest = block->size;
+    }
+}
 
-    base->id = ZONEID;
+static void Z_SizeClassClear(void *zone, int size)
+{
+    Z_ClearZone((memzone_t *)zone, size);
+}
 
-    // marker for memory trash testing
-    *(int *)((byte *)base + base->size - 4) = ZONEID;
+static void *Z_SizeClassAlloc(void *zone, int size, int tag)
+{
+    return Z_ZoneAlloc((memzone_t *)zone, size, tag);
+}
 
-    return (void *)((byte *)base + sizeof(memblock_t));
+static void Z_SizeClassFree(void *zone, void *ptr)
+{
+    Z_ZoneFree((memzone_t *)zone, ptr);
+}
+
+static void Z_SizeClassFreeStats(void *zone, int *bytes, int *blocks, int *largest)
+{
+    Z_FreeStats((memzone_t *)zone, bytes, blocks, largest);
 }
 
+typedef struct {
+    char const *name;
+    void (*clear)(void *zone, int size);
+    void *(*alloc)(void *zone, int size, int tag);
+    void (*free)(void *zone, void *ptr);
+    void (*freestats)(void *zone, int *bytes, int *blocks, int *largest);
+} zoneallocator_t;
+
+static zoneallocator_t const zone_allocators[] = {
+    { "first fit", Z_RoverClear, Z_RoverAlloc, Z_RoverFree, Z_RoverFreeStats },
+    { "size class", Z_SizeClassClear, Z_SizeClassAlloc, Z_SizeClassFree, Z_SizeClassFreeStats },
+};
+
 /*
 ========================
-Z_Print
+Z_ReplayTrace
+
+Runs the trace through an allocator once, returns the failed allocations.
+With worst, the zone is walked after every event for the worst fragmentation.
 ========================
 */
-void Z_Print(memzone_t *zone)
+static int Z_ReplayTrace(zoneallocator_t const *za, void *zone, int size, void **live,
+                         zonetrace_t const *trace, int count, float *worst)
 {
-    memblock_t *block;
-
-    Con_Printf("zone size: %i  location: %p\n", mainzone->size, mainzone);
-
-    for (block = zone->blocklist.next;; block = block->next) {
-        Con_Printf("block:%p    size:%7i    tag:%3i\n", block, block->size, block->tag);
+    zonetrace_t const *ev;
+    int freebytes, freeblocks, largest, failures;
+
+    za->clear(zone, size);
+    Q_memset(live, 0, (size >> ZONE_ALIGNBITS) * sizeof(*live));
+
+    failures = 0;
+    for (ev = trace; ev < trace + count; ev++) {
+        if ((unsigned)ev->offset >= (unsigned)size)
+            continue;
+        if (ev->size >= 0) {
+            live[ev->offset >> ZONE_ALIGNBITS] = za->alloc(zone, ev->size, ev->tag);
+            if (!live[ev->offset >> ZONE_ALIGNBITS])
+                failures++;
+        } else if (live[ev->offset >> ZONE_ALIGNBITS]) {
+            za->free(zone, live[ev->offset >> ZONE_ALIGNBITS]);
+            live[ev->offset >> ZONE_ALIGNBITS] = NULL;
+        }
 
-        if (block->next == &zone->blocklist)
-            break; // all blocks have been hit
-        if ((byte *)block + block->size != (byte *)block->next)
-            Con_Printf("ERROR: block size does not touch the next block\n");
-        if (block->next->prev != block)
-            Con_Printf("ERROR: next block doesn't have proper back link\n");
-        if (!block->tag && !block->next->tag)
-            Con_Printf("ERROR: two consecutive free blocks\n");
+        if (worst) {
+            za->freestats(zone, &freebytes, &freeblocks, &largest);
+            if (freebytes && (float)(freebytes - largest) / freebytes > *worst)
+                *worst = (float)(freebytes - largest) / freebytes;
+        }
     }
+
+    return failures;
 }
 
 /*
 ========================
-Z_CheckHeap
+Z_Replay_f
+
+zone_replay <filename> [runs]
+
+Times the first fit and the size class allocators on a zone_trace recording,
+in a scratch zone of the size it was recorded with
 ========================
 */
-void Z_CheckHeap(void)
+static void Z_Replay_f(void)
 {
-    memblock_t *block;
-
-    for (block = mainzone->blocklist.next;; block = block->next) {
-        if (block->next == &mainzone->blocklist)
-            break; // all blocks have been hit
-        if ((byte *)block + block->size != (byte *)block->next)
-            Sys_Error("Z_CheckHeap: block size does not touch the next block\n");
-        if (block->next->prev != block)
-            Sys_Error("Z_CheckHeap: next block doesn't have proper back link\n");
-        if (!block->tag && !block->next->tag)
-            Sys_Error("Z_CheckHeap: two consecutive free blocks\n");
+    int handle, length, size, count, runs, failures, freebytes, freeblocks, largest, mark, i, j;
+    zonetrace_t header;
+    zonetrace_t *trace;
+    void **live;
+    byte *zone;
+    uint64_t start, time;
+    float worst;
+
+    if (Cmd_Argc() < 2 || Cmd_Argc() > 3) {
+        Con_Printf("zone_replay <filename> [runs] : time the zone allocators on a zone_trace recording\n");
+        return;
+    }
+    runs = Cmd_Argc() == 3 ? Q_atoi(Cmd_Argv(2)) : 100;
+    if (runs < 1)
+        runs = 1;
+
+    length = COM_OpenFile(Cmd_Argv(1), &handle);
+    if (handle == -1) {
+        Con_Printf("Couldn't open %s\n", Cmd_Argv(1));
+        return;
+    }
+    if (length < (int)sizeof(header) || Sys_FileRead(handle, &header, sizeof(header)) != sizeof(header) ||
+        header.offset != ZONEID || header.size < (int)sizeof(memzone_t) + 2 * ZONE_MINBLOCK) {
+        Con_Printf("%s is not a zone trace\n", Cmd_Argv(1));
+        COM_CloseFile(handle);
+        return;
+    }
+    size = (header.size + 15) & ~15;
+    count = length / sizeof(zonetrace_t) - 1;
+
+    mark = Hunk_HighMark();
+    zone = (byte *)Hunk_HighAllocName(size + (size >> ZONE_ALIGNBITS) * sizeof(void *) + count * sizeof(zonetrace_t),
+                                      "zonetrc");
+    if (!zone) {
+        COM_CloseFile(handle);
+        return;
+    }
+    live = (void **)(zone + size);
+    trace = (zonetrace_t *)(live + (size >> ZONE_ALIGNBITS));
+    count = Sys_FileRead(handle, trace, count * sizeof(zonetrace_t)) / sizeof(zonetrace_t);
+    COM_CloseFile(handle);
+
+    Con_Printf("%i events in a %i byte zone, %i runs\n", count, header.size, runs);
+    for (i = 0; i < (int)(sizeof(zone_allocators) / sizeof(zone_allocators[0])); i++) {
+        worst = 0;
+        failures = Z_ReplayTrace(&zone_allocators[i], zone, header.size, live, trace, count, &worst);
+        zone_allocators[i].freestats(zone, &freebytes, &freeblocks, &largest);
+
+        start = Sys_MicroTicks();
+        for (j = 0; j < runs; j++)
+            Z_ReplayTrace(&zone_allocators[i], zone, header.size, live, trace, count, NULL);
+        time = Sys_MicroTicks() - start;
+
+        Con_Printf("%-10s: %6.1f ns per event, %i failed, worst fragmentation %.1f%%, %i free blocks at the end\n",
+                   zone_allocators[i].name, count ? time * 1000.0 / ((double)runs * count) : 0.0,
+                   failures, worst * 100, freeblocks);
     }
+
+    Hunk_FreeToHighMark(mark);
 }
 
+CMD_REGISTER("zone_stats", Z_Stats_f);
+CMD_REGISTER("zone_trace", Z_Trace_f);
+CMD_REGISTER("zone_replay", Z_Replay_f);
+
 //============================================================================
 
 #define HUNK_SENTINAL 0x1df001ed
@@ -270,6 +845,206 @@ int hunk_tempmark;
 
 void R_FreeTextures(void);
 
+/*
+==============================================================================
+
+HUNK STATISTICS
+
+The bytes and peak of every hunk name, and of every subsystem with the hunk and
+the cache together. The low and the high hunk each keep a stack of the ranges
+allocated for one subsystem, so freeing to a mark knows what to take off.
+Every level, from one Host_ClearMemory to the next, keeps its own peaks.
+==============================================================================
+*/
+
+typedef struct {
+    char name[8];
+    int bytes;
+    int peak;
+} hunkname_t;
+
+typedef struct {
+    int start; // hunk_low_used or hunk_high_used where it starts
+    int subsystem;
+} hunkrange_t;
+
+typedef struct {
+    char name[8]; // of the first model it loads, the world
+    uint32_t start; // Sys_CurrentTicks, 0 for startup
+    int low; // hunk_low_used when it started
+    int peaklow, peakhigh, peakcache;
+    int lowfrees; // Hunk_FreeToLowMark calls
+    int largestfree; // bytes
+    int peaks[HS_NUMSUBSYSTEMS];
+} hunklevel_t;
+
+#define MAX_HUNK_NAMES 256 // a power of two
+#define MAX_HUNK_RANGES 64
+#define MAX_HUNK_LEVELS 32 // the last ones are kept
+
+static char const *const hunk_subsystemnames[HS_NUMSUBSYSTEMS] = {
+    "other", "model", "texture", "lightmap", "progs", "edicts", "sound", "surfcache",
+};
+
+static hunkname_t hunk_names[MAX_HUNK_NAMES];
+static hunksubsystem_t hunk_subsystem;
+static int hunk_bytes[HS_NUMSUBSYSTEMS], hunk_peaks[HS_NUMSUBSYSTEMS];
+static hunkrange_t hunk_lowranges[MAX_HUNK_RANGES], hunk_highranges[MAX_HUNK_RANGES];
+static int hunk_numlowranges, hunk_numhighranges;
+static int hunk_peaklow, hunk_peakhigh, hunk_peakcache;
+static hunklevel_t hunk_levels[MAX_HUNK_LEVELS];
+static int hunk_numlevels;
+
+static int cache_used; // bytes in cache blocks, headers included
+
+CVAR_REGISTER(hunk_exitreport, CVAR_CTOR({ "hunk_exitreport", "" }));
+
+#define HUNK_LEVEL (&hunk_levels[(hunk_numlevels - 1) % MAX_HUNK_LEVELS])
+
+/*
+===================
+Hunk_Subsystem
+===================
+*/
+hunksubsystem_t Hunk_Subsystem(hunksubsystem_t subsystem)
+{
+    hunksubsystem_t prev;
+
+    prev = hunk_subsystem;
+    hunk_subsystem = subsystem;
+    return prev;
+}
+
+/*
+===================
+Hunk_BeginLevel
+===================
+*/
+void Hunk_BeginLevel(void)
+{
+    hunklevel_t *level;
+
+    level = &hunk_levels[hunk_numlevels++ % MAX_HUNK_LEVELS];
+    memset(level, 0, sizeof(*level));
+    level->start = Sys_CurrentTicks();
+    level->low = level->peaklow = hunk_low_used;
+    level->peakhigh = hunk_high_used;
+    level->peakcache = cache_used;
+    memcpy(level->peaks, hunk_bytes, sizeof(level->peaks));
+}
+
+static hunkname_t *Hunk_Name(char const *name)
+{
+    hunkname_t *hn;
+    unsigned hash;
+    int i;
+
+    for (i = 0, hash = 0; i < 8 && name[i]; i++)
+        hash = hash * 31 + (byte)name[i];
+
+    for (i = 0; i < MAX_HUNK_NAMES; i++) {
+        hn = &hunk_names[(hash + i) & (MAX_HUNK_NAMES - 1)];
+        if (!hn->name[0])
+            Q_strncpy(hn->name, name[0] ? name : "?", 8);
+        if (!strncmp(hn->name, name[0] ? name : "?", 8))
+            return hn;
+    }
+
+    return NULL; // all taken
+}
+
+static void Hunk_Peaks(void)
+{
+    hunklevel_t *level;
+
+    level = HUNK_LEVEL;
+    if (hunk_low_used > hunk_peaklow)
+        hunk_peaklow = hunk_low_used;
+    if (hunk_high_used > hunk_peakhigh)
+        hunk_peakhigh = hunk_high_used;
+    if (cache_used > hunk_peakcache)
+        hunk_peakcache = cache_used;
+    if (hunk_low_used > level->peaklow)
+        level->peaklow = hunk_low_used;
+    if (hunk_high_used > level->peakhigh)
+        level->peakhigh = hunk_high_used;
+    if (cache_used > level->peakcache)
+        level->peakcache = cache_used;
+}
+
+static void Hunk_Use(int subsystem, int bytes)
+{
+    hunklevel_t *level;
+
+    level = HUNK_LEVEL;
+    hunk_bytes[subsystem] += bytes;
+    if (hunk_bytes[subsystem] > hunk_peaks[subsystem])
+        hunk_peaks[subsystem] = hunk_bytes[subsystem];
+    if (hunk_bytes[subsystem] > level->peaks[subsystem])
+        level->peaks[subsystem] = hunk_bytes[subsystem];
+}
+
+/*
+===================
+Hunk_Allocated
+
+Counts h, allocated where the low or high hunk used start bytes
+===================
+*/
+static void Hunk_Allocated(hunkrange_t *ranges, int *numranges, int start, hunk_t const *h)
+{
+    hunkname_t *hn;
+
+    if (!*numranges || (ranges[*numranges - 1].subsystem != hunk_subsystem && *numranges < MAX_HUNK_RANGES)) {
+        ranges[*numranges].start = start;
+        ranges[*numranges].subsystem = hunk_subsystem;
+        (*numranges)++;
+    }
+    Hunk_Use(ranges[*numranges - 1].subsystem, h->size);
+
+    hn = Hunk_Name(h->name);
+    if (hn) {
+        hn->bytes += h->size;
+        if (hn->bytes > hn->peak)
+            hn->peak = hn->bytes;
+    }
+
+    if (hunk_subsystem == hs_model && !HUNK_LEVEL->name[0])
+        memcpy(HUNK_LEVEL->name, h->name, sizeof(h->name));
+
+    Hunk_Peaks();
+}
+
+/*
+===================
+Hunk_Freed
+
+Takes off the blocks from h to end, freeing the low or high hunk used from
+used to mark
+===================
+*/
+static void Hunk_Freed(hunkrange_t *ranges, int *numranges, int used, int mark, hunk_t const *h, hunk_t const *end)
+{
+    hunkrange_t *range;
+    hunkname_t *hn;
+    int start;
+
+    for (; h < end; h = (hunk_t const *)((byte const *)h + h->size)) {
+        hn = Hunk_Name(h->name);
+        if (hn)
+            hn->bytes -= h->size;
+    }
+
+    while (*numranges && used > mark) {
+        range = &ranges[*numranges - 1];
+        start = range->start > mark ? range->start : mark;
+        Hunk_Use(range->subsystem, start - used);
+        used = start;
+        if (range->start >= mark)
+            (*numranges)--;
+    }
+}
+
 /*
 ==============
 Hunk_Check
@@ -404,6 +1179,8 @@ void *Hunk_AllocName(int size, char const *name)
     h->sentinal = HUNK_SENTINAL;
     Q_strncpy(h->name, name, 8);
 
+    Hunk_Allocated(hunk_lowranges, &hunk_numlowranges, hunk_low_used - size, h);
+
     return (void *)(h + 1);
 }
 
@@ -417,15 +1194,32 @@ void *Hunk_Alloc(int size)
     return Hunk_AllocName(size, "unknown");
 }
 
+int Hunk_FreeSize(void)
+{
+    return hunk_size - hunk_low_used - hunk_high_used;
+}
+
 int Hunk_LowMark(void)
 {
     return hunk_low_used;
 }
 
+byte *Hunk_LowPointer(int mark)
+{
+    if (mark < 0 || mark > hunk_low_used)
+        Sys_Error("Hunk_LowPointer: bad mark %i", mark);
+    return hunk_base + mark;
+}
+
 void Hunk_FreeToLowMark(int mark)
 {
     if (mark < 0 || mark > hunk_low_used)
         Sys_Error("Hunk_FreeToLowMark: bad mark %i", mark);
+    Hunk_Freed(hunk_lowranges, &hunk_numlowranges, hunk_low_used, mark, (hunk_t *)(hunk_base + mark),
+               (hunk_t *)(hunk_base + hunk_low_used));
+    HUNK_LEVEL->lowfrees++;
+    if (hunk_low_used - mark > HUNK_LEVEL->largestfree)
+        HUNK_LEVEL->largestfree = hunk_low_used - mark;
     memset(hunk_base + mark, 0, hunk_low_used - mark);
     hunk_low_used = mark;
 }
@@ -448,6 +1242,8 @@ void Hunk_FreeToHighMark(int mark)
     }
     if (mark < 0 || mark > hunk_high_used)
         Sys_Error("Hunk_FreeToHighMark: bad mark %i", mark);
+    Hunk_Freed(hunk_highranges, &hunk_numhighranges, hunk_high_used, mark,
+               (hunk_t *)(hunk_base + hunk_size - hunk_high_used), (hunk_t *)(hunk_base + hunk_size - mark));
     memset(hunk_base + hunk_size - hunk_high_used, 0, hunk_high_used - mark);
     hunk_high_used = mark;
 }
@@ -490,6 +1286,8 @@ void *Hunk_HighAllocName(int size, char const *name)
     h->sentinal = HUNK_SENTINAL;
     Q_strncpy(h->name, name, 8);
 
+    Hunk_Allocated(hunk_highranges, &hunk_numhighranges, hunk_high_used - size, h);
+
     return (void *)(h + 1);
 }
 
@@ -520,11 +1318,145 @@ void *Hunk_TempAlloc(int size)
     return buf;
 }
 
+__attribute__((format(printf, 2, 3)))
+static void Hunk_Write(int handle, char const *fmt, ...)
+{
+    va_list argptr;
+    char text[1024];
+
+    va_start(argptr, fmt);
+    vsnprintf(text, sizeof(text), fmt, argptr);
+    va_end(argptr);
+
+    Sys_FileWrite(handle, text, strlen(text));
+}
+
+/*
+=================
+Hunk_WriteReport
+
+The hunk statistics as JSON, to file in the game directory
+=================
+*/
+static void Hunk_WriteReport(char const *file)
+{
+    char path[MAX_OSPATH];
+    char name[9];
+    hunkname_t *hn;
+    hunklevel_t *level;
+    int handle, i, j, first;
+
+    // with room for the extension
+    if (snprintf(path, sizeof(path), "%s/%s", com_gamedir, file) >= sizeof(path) - 5) {
+        Con_Printf("ERROR: %s is too long.\n", file);
+        return;
+    }
+    COM_DefaultExtension(path, ".json");
+    handle = Sys_FileOpenWrite(path);
+    if (handle == -1) {
+        Con_Printf("ERROR: couldn't open %s.\n", path);
+        return;
+    }
+
+    Hunk_Write(handle, "{\"hunk\":{\"size\":%i,\"low\":%i,\"high\":%i,\"cache\":%i,", hunk_size, hunk_low_used,
+               hunk_high_used, cache_used);
+    Hunk_Write(handle, "\"peaklow\":%i,\"peakhigh\":%i,\"peakcache\":%i},\n", hunk_peaklow, hunk_peakhigh,
+               hunk_peakcache);
+
+    Hunk_Write(handle, "\"subsystems\":[\n");
+    for (i = 0; i < HS_NUMSUBSYSTEMS; i++)
+        Hunk_Write(handle, "%s{\"name\":\"%s\",\"bytes\":%i,\"peak\":%i}\n", i ? "," : "", hunk_subsystemnames[i],
+                   hunk_bytes[i], hunk_peaks[i]);
+
+    Hunk_Write(handle, "],\"names\":[\n");
+    name[8] = 0;
+    for (i = j = 0, hn = hunk_names; i < MAX_HUNK_NAMES; i++, hn++) {
+        if (!hn->name[0])
+            continue;
+        memcpy(name, hn->name, 8);
+        for (char *c = name; *c; c++)
+            if (*c == '"' || *c == '\\' || (byte)*c < ' ')
+                *c = '_';
+        Hunk_Write(handle, "%s{\"name\":\"%s\",\"bytes\":%i,\"peak\":%i}\n", j++ ? "," : "", name, hn->bytes,
+                   hn->peak);
+    }
+
+    Hunk_Write(handle, "],\"levels\":[\n");
+    first = hunk_numlevels > MAX_HUNK_LEVELS ? hunk_numlevels - MAX_HUNK_LEVELS : 0; // the older ones were reused
+    for (i = first; i < hunk_numlevels; i++) {
+        level = &hunk_levels[i % MAX_HUNK_LEVELS];
+        memcpy(name, level->name, 8);
+        for (char *c = name; *c; c++)
+            if (*c == '"' || *c == '\\' || (byte)*c < ' ')
+                *c = '_';
+        Hunk_Write(handle, "%s{\"name\":\"%s\",\"start_ms\":%u,\"low\":%i,\"peaklow\":%i,\"peakhigh\":%i,",
+                   i > first ? "," : "", name, level->start, level->low, level->peaklow, level->peakhigh);
+        Hunk_Write(handle, "\"peakcache\":%i,\"lowfrees\":%i,\"largestfree\":%i,\"peaks\":{", level->peakcache,
+                   level->lowfrees, level->largestfree);
+        for (j = 0; j < HS_NUMSUBSYSTEMS; j++)
+            Hunk_Write(handle, "%s\"%s\":%i", j ? "," : "", hunk_subsystemnames[j], level->peaks[j]);
+        Hunk_Write(handle, "}}\n");
+    }
+    Hunk_Write(handle, "]}\n");
+
+    Sys_FileClose(handle);
+    Con_Printf("Wrote %s\n", path);
+}
+
+/*
+=================
+Hunk_Report_f
+
+hunk_report [filename]
+=================
+*/
+static void Hunk_Report_f(void)
+{
+    int i;
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("hunk_report [filename] : print the memory peaks, and write them all to filename.json\n");
+        return;
+    }
+
+    Con_Printf("subsystem     bytes      peak\n");
+    for (i = 0; i < HS_NUMSUBSYSTEMS; i++)
+        Con_Printf("%-9s %9i %9i\n", hunk_subsystemnames[i], hunk_bytes[i], hunk_peaks[i]);
+    Con_Printf("peak low hunk %i, high hunk %i, cache %i, of %i\n", hunk_peaklow, hunk_peakhigh, hunk_peakcache,
+               hunk_size);
+
+    if (Cmd_Argc() == 2 && strstr(Cmd_Argv(1), "..")) {
+        Con_Printf("Relative pathnames are not allowed.\n");
+        return;
+    }
+    Hunk_WriteReport(Cmd_Argc() == 2 ? Cmd_Argv(1) : "hunk");
+}
+
+CMD_REGISTER("hunk_report", Hunk_Report_f);
+
+/*
+=================
+Hunk_Shutdown
+=================
+*/
+void Hunk_Shutdown(void)
+{
+    if (hunk_exitreport.string[0] && !strstr(hunk_exitreport.string, ".."))
+        Hunk_WriteReport(hunk_exitreport.string);
+}
+
 /*
 ===============================================================================
 
 CACHE MEMORY
 
+The cache blocks sit between the low and the high hunk in address order. A new
+block goes in the smallest gap it fits, and Cache_Compact slides a few blocks a
+frame down into the gaps under them, so the free space gathers below the high
+hunk, where the temporary allocations of loading files come from.
+
+cache_budget (in KiB) caps the cache, throwing out the least recently used
+blocks before the hunk has to when it grows into them.
 ===============================================================================
 */
 
@@ -532,14 +1464,80 @@ typedef struct cache_system_s {
     int size; // including this header
     cache_user_t *user;
     char name[16];
+    int subsystem; // hunksubsystem_t it was allocated for
     struct cache_system_s *prev, *next;
     struct cache_system_s *lru_prev, *lru_next; // for LRU flushing
 } cache_system_t;
 
+// what happened to each thing that was ever cached, cache_user_t::resource
+// points back here
+typedef struct {
+    cache_user_t *user;
+    char name[16];
+    int size;
+    int hits; // Cache_Check found it
+    int loads; // Cache_Alloc, the first and every reload
+    int evictions; // thrown out to make room
+    qboolean cached; // for Cache_ClearResources
+} cacheresource_t;
+
+#define MAX_CACHE_RESOURCES 512
+
 cache_system_t *Cache_TryAlloc(int size, qboolean nobottom);
 
 cache_system_t cache_head;
 
+static cacheresource_t cache_resources[MAX_CACHE_RESOURCES];
+static int cache_numresources;
+static int cache_hits, cache_loads, cache_evictions, cache_moved;
+
+CVAR_REGISTER(cache_budget, CVAR_CTOR({ "cache_budget", 0 }));
+CVAR_REGISTER(cache_compact, CVAR_CTOR({ "cache_compact", 65536 }));
+
+static cacheresource_t *Cache_Resource(cache_user_t *c)
+{
+    cacheresource_t *res;
+
+    if (!c->resource)
+        return NULL;
+    res = &cache_resources[c->resource - 1];
+    return res->user == c ? res : NULL;
+}
+
+static cacheresource_t *Cache_NewResource(cache_user_t *c, char const *name)
+{
+    cacheresource_t *res;
+
+    c->resource = 0;
+    if (cache_numresources == MAX_CACHE_RESOURCES)
+        return NULL;
+    res = &cache_resources[cache_numresources++];
+    memset(res, 0, sizeof(*res));
+    res->user = c;
+    Q_memcpy(res->name, name, sizeof(res->name));
+    c->resource = cache_numresources;
+    return res;
+}
+
+/*
+===========
+Cache_Evict
+
+Cache_Free for the blocks the cache throws out itself
+===========
+*/
+static void Cache_Evict(cache_system_t *cs)
+{
+    cacheresource_t *res;
+
+    res = Cache_Resource(cs->user);
+    if (res)
+        res->evictions++;
+    cache_evictions++;
+
+    Cache_Free(cs->user);
+}
+
 /*
 ===========
 Cache_Move
@@ -557,12 +1555,14 @@ void Cache_Move(cache_system_t *c)
         Q_memcpy(newsys + 1, c + 1, c->size - sizeof(cache_system_t));
         newsys->user = c->user;
         Q_memcpy(newsys->name, c->name, sizeof(newsys->name));
+        newsys->subsystem = c->subsystem;
+        Hunk_Use(c->subsystem, c->size);
         Cache_Free(c->user);
         newsys->user->data = (void *)(newsys + 1);
     } else {
         //		Con_Printf ("cache_move failed\n");
 
-        Cache_Free(c->user); // tough luck...
+        Cache_Evict(c); // tough luck...
     }
 }
 
@@ -606,7 +1606,7 @@ void Cache_FreeHigh(int new_high_hunk)
         if ((byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
             return; // there is space to grow the hunk
         if (c == prev)
-            Cache_Free(c->user); // didn't move out of the way
+            Cache_Evict(c); // didn't move out of the way
         else {
             Cache_Move(c); // try to move it
             prev = c;
@@ -640,75 +1640,65 @@ void Cache_MakeLRU(cache_system_t *cs)
 ============
 Cache_TryAlloc
 
-Looks for a free block of memory between the high and low hunk marks
+Looks for the smallest free block of memory between the high and low hunk
+marks that fits, the lowest of those that are as small
 Size should already include the header and padding
 ============
 */
 cache_system_t *Cache_TryAlloc(int size, qboolean nobottom)
 {
-    cache_system_t *cs, *newsys;
+    cache_system_t *cs, *newsys, *best, *bestnext;
+    int gap, bestgap;
 
     // is the cache completely empty?
 
     if (!nobottom && cache_head.prev == &cache_head) {
         if (hunk_size - hunk_high_used - hunk_low_used < size)
             Sys_Error("Cache_TryAlloc: %i is greater then free hunk", size);
-
-        newsys = (cache_system_t *)(hunk_base + hunk_low_used);
-        memset(newsys, 0, sizeof(*newsys));
-        newsys->size = size;
-
-        cache_head.prev = cache_head.next = newsys;
-        newsys->prev = newsys->next = &cache_head;
-
-        Cache_MakeLRU(newsys);
-        return newsys;
     }
 
-    // search from the bottom up for space
+    // look at every gap from the bottom up, the last one reaching the high hunk
 
+    best = bestnext = NULL;
+    bestgap = 0;
     newsys = (cache_system_t *)(hunk_base + hunk_low_used);
     cs = cache_head.next;
 
-    do {
-        if (!nobottom || cs != cache_head.next) {
-            if ((byte *)cs - (byte *)newsys >= size) { // found space
-                memset(newsys, 0, sizeof(*newsys));
-                newsys->size = size;
-
-                newsys->next = cs;
-                newsys->prev = cs->prev;
-                cs->prev->next = newsys;
-                cs->prev = newsys;
-
-                Cache_MakeLRU(newsys);
+    while (1) {
+        if (cs == &cache_head)
+            gap = hunk_base + hunk_size - hunk_high_used - (byte *)newsys;
+        else
+            gap = (byte *)cs - (byte *)newsys;
 
-                return newsys;
-            }
+        if (gap >= size && (!best || gap < bestgap) && (!nobottom || cs != cache_head.next)) {
+            best = newsys;
+            bestnext = cs;
+            bestgap = gap;
         }
 
+        if (cs == &cache_head)
+            break;
+
         // continue looking
         newsys = (cache_system_t *)((byte *)cs + cs->size);
         cs = cs->next;
+    }
 
-    } while (cs != &cache_head);
+    if (!best)
+        return NULL; // couldn't allocate
 
-    // try to allocate one at the very end
-    if (hunk_base + hunk_size - hunk_high_used - (byte *)newsys >= size) {
-        memset(newsys, 0, sizeof(*newsys));
-        newsys->size = size;
+    memset(best, 0, sizeof(*best));
+    best->size = size;
 
-        newsys->next = &cache_head;
-        newsys->prev = cache_head.prev;
-        cache_head.prev->next = newsys;
-        cache_head.prev = newsys;
+    best->next = bestnext;
+    best->prev = bestnext->prev;
+    bestnext->prev->next = best;
+    bestnext->prev = best;
 
-        Cache_MakeLRU(newsys);
+    Cache_MakeLRU(best);
+    cache_used += size;
 
-        return newsys;
-    }
-
-    return NULL; // couldn't allocate
+    return best;
 }
 
 /*
@@ -754,10 +1744,35 @@ void Cache_Report(void)
 ============
 Cache_Compact
 
+Slides the blocks above a gap down into it, about cache_compact bytes of them
+each call. The caller makes sure nothing is holding on to cached data.
 ============
 */
 void Cache_Compact(void)
 {
+    cache_system_t *cs;
+    byte *bottom;
+    int left;
+
+    left = cache_compact.value;
+    bottom = hunk_base + hunk_low_used;
+
+    for (cs = cache_head.next; cs != &cache_head && left > 0; cs = cs->next) {
+        if ((byte *)cs > bottom) {
+            memmove(bottom, cs, cs->size);
+            cs = (cache_system_t *)bottom;
+
+            cs->prev->next = cs;
+            cs->next->prev = cs;
+            cs->lru_prev->lru_next = cs;
+            cs->lru_next->lru_prev = cs;
+            cs->user->data = (void *)(cs + 1);
+
+            left -= cs->size;
+            cache_moved += cs->size;
+        }
+        bottom = (byte *)cs + cs->size;
+    }
 }
 
 /*
@@ -793,6 +1808,8 @@ void Cache_Free(cache_user_t *c)
     cs->next = cs->prev = NULL;
 
     c->data = NULL;
+    cache_used -= cs->size;
+    Hunk_Use(cs->subsystem, -cs->size);
 
     Cache_UnlinkLRU(cs);
 }
@@ -805,6 +1822,7 @@ Cache_Check
 void *Cache_Check(cache_user_t *c)
 {
     cache_system_t *cs;
+    cacheresource_t *res;
 
     if (!c->data)
         return NULL;
@@ -815,6 +1833,11 @@ void *Cache_Check(cache_user_t *c)
     Cache_UnlinkLRU(cs);
     Cache_MakeLRU(cs);
 
+    res = Cache_Resource(c);
+    if (res)
+        res->hits++;
+    cache_hits++;
+
     return c->data;
 }
 
@@ -826,6 +1849,8 @@ Cache_Alloc
 void *Cache_Alloc(cache_user_t *c, int size, char *name)
 {
     cache_system_t *cs;
+    cacheresource_t *res;
+    int budget;
 
     if (c->data)
         Sys_Error("Cache_Alloc: allready allocated");
@@ -835,6 +1860,11 @@ void *Cache_Alloc(cache_user_t *c, int size, char *name)
 
     size = (size + sizeof(cache_system_t) + 15) & ~15;
 
+    // stay under the budget before the hunk has to make room
+    budget = cache_budget.value * 1024;
+    while (budget > 0 && cache_used + size > budget && cache_head.lru_prev != &cache_head)
+        Cache_Evict(cache_head.lru_prev);
+
     // find memory for it
     while (1) {
         cs = Cache_TryAlloc(size, false);
@@ -842,6 +1872,9 @@ void *Cache_Alloc(cache_user_t *c, int size, char *name)
             strncpy(cs->name, name, sizeof(cs->name) - 1);
             c->data = (void *)(cs + 1);
             cs->user = c;
+            cs->subsystem = hunk_subsystem;
+            Hunk_Use(cs->subsystem, size);
+            Hunk_Peaks();
             break;
         }
 
@@ -849,12 +1882,109 @@ void *Cache_Alloc(cache_user_t *c, int size, char *name)
         if (cache_head.lru_prev == &cache_head)
             Sys_Error("Cache_Alloc: out of memory");
         // not enough memory at all
-        Cache_Free(cache_head.lru_prev->user);
+        Cache_Evict(cache_head.lru_prev);
+    }
+
+    res = Cache_Resource(c);
+    if (!res || strncmp(res->name, cs->name, sizeof(res->name)))
+        res = Cache_NewResource(c, cs->name);
+    if (res) {
+        res->size = size;
+        res->loads++;
+    }
+    cache_loads++;
+
+    return c->data;
+}
+
+/*
+==============
+Cache_ClearResources
+
+Keeps the statistics of what is still cached and frees the slots of the rest,
+whose users may go away with the level
+==============
+*/
+void Cache_ClearResources(void)
+{
+    cacheresource_t *res;
+    cache_system_t *cs;
+    int i, count;
+
+    for (cs = cache_head.next; cs != &cache_head; cs = cs->next) {
+        res = Cache_Resource(cs->user);
+        if (res)
+            res->cached = true;
     }
 
-    return Cache_Check(c);
+    for (i = count = 0, res = cache_resources; i < cache_numresources; i++, res++) {
+        if (!res->cached)
+            continue;
+        res->cached = false;
+        cache_resources[count] = *res;
+        res->user->resource = ++count;
+    }
+    cache_numresources = count;
+
+    // the ones that found the table full
+    for (cs = cache_head.next; cs != &cache_head; cs = cs->next) {
+        if (Cache_Resource(cs->user))
+            continue;
+        res = Cache_NewResource(cs->user, cs->name);
+        if (res) {
+            res->size = cs->size;
+            res->loads = 1;
+        }
+    }
 }
 
+/*
+==============
+Cache_Stats_f
+
+cache_stats [all]
+==============
+*/
+static void Cache_Stats_f(void)
+{
+    cache_system_t *cs;
+    cacheresource_t *res;
+    byte *bottom;
+    int blocks, gap, largest, all;
+
+    if (Cmd_Argc() > 2) {
+        Con_Printf("cache_stats [all] : cache use, and the things loaded more than once (or all of them)\n");
+        return;
+    }
+    all = Cmd_Argc() == 2 && !Q_strcmp(Cmd_Argv(1), "all");
+
+    blocks = largest = 0;
+    bottom = hunk_base + hunk_low_used;
+    for (cs = cache_head.next;; cs = cs->next) {
+        gap = (cs == &cache_head ? hunk_base + hunk_size - hunk_high_used : (byte *)cs) - bottom;
+        if (gap > largest)
+            largest = gap;
+        if (cs == &cache_head)
+            break;
+        blocks++;
+        bottom = (byte *)cs + cs->size;
+    }
+
+    Con_Printf("cache: %i bytes in %i blocks, budget %i, %i free between the hunks, largest gap %i\n", cache_used,
+               blocks, (int)cache_budget.value * 1024, hunk_size - hunk_high_used - hunk_low_used - cache_used,
+               largest);
+    Con_Printf("%i hits, %i loads, %i evictions, %i bytes compacted\n", cache_hits, cache_loads, cache_evictions,
+               cache_moved);
+
+    Con_Printf("name                size     hits loads evict\n");
+    for (res = cache_resources; res < cache_resources + cache_numresources; res++)
+        if (all || res->loads > 1 || res->evictions)
+            Con_Printf("%-16.16s %7i %8i %5i %5i%s\n", res->name, res->size, res->hits, res->loads, res->evictions,
+                       res->user->data && Cache_Resource(res->user) == res ? "" : " (out)");
+}
+
+CMD_REGISTER("cache_stats", Cache_Stats_f);
+
 //============================================================================
 
 /*
@@ -871,6 +2001,8 @@ void Memory_Init(void *buf, int size)
     hunk_size = size;
     hunk_low_used = 0;
     hunk_high_used = 0;
+    hunk_numlevels = 1; // the startup allocations, until the first map
+    Q_strncpy(hunk_levels[0].name, "startup", sizeof(hunk_levels[0].name));
 
     Cache_Init();
     p = COM_CheckParm("-zone");
@@ -0,0 +1,98 @@
+#!/bin/sh
+# localhost_test.sh -- starts a dedicated server and a few headless clients on
+# localhost and checks that every client gets through the signon into the game
+# and is still there a few seconds later
+#
+# usage: localhost_test.sh <server quake> <client quake> <basedir> [clients] [map]
+#
+# The server can be any build, the clients have to be -DHEADLESS_CLIENT=1 ones.
+# <basedir> holds the game directory (id1) with the map, start unless given.
+# PORT (26123), TIMEOUT (30 seconds) and CLIENT_ARGS change the defaults.
+
+server=$1
+client=$2
+basedir=$3
+clients=${4:-4}
+map=${5:-start}
+port=${PORT:-26123}
+timeout=${TIMEOUT:-30}
+
+if [ -z "$server" ] || [ -z "$client" ] || [ -z "$basedir" ]; then
+    echo "usage: $0 <server quake> <client quake> <basedir> [clients] [map]" >&2
+    exit 2
+fi
+
+logs=$(mktemp -d)
+pids=""
+
+cleanup() {
+    exec 3>&-
+    for pid in $pids; do
+        kill "$pid" 2>/dev/null
+    done
+    wait 2>/dev/null
+    rm -rf "$logs"
+}
+trap cleanup EXIT
+trap 'exit 1' HUP INT PIPE TERM
+
+fail() {
+    echo "FAIL: $*"
+    for log in "$logs"/*.log; do
+        echo "---- $(basename "$log")"
+        tail -n 20 "$log"
+    done
+    exit 1
+}
+
+# the server's console, for status
+mkfifo "$logs/console"
+"$server" -basedir "$basedir" -dedicated "$clients" -port "$port" +map "$map" <"$logs/console" >"$logs/server.log" 2>&1 &
+pids="$!"
+exec 3>"$logs/console"
+
+# the map is loaded once the server reads its .bsp, from a pak or a directory
+waited=0
+until grep -Eq "(: |/)maps/$map\.bsp$" "$logs/server.log"; do
+    kill -0 $pids 2>/dev/null || fail "the server exited"
+    [ "$waited" -lt 10 ] || fail "the server didn't load maps/$map.bsp"
+    sleep 1
+    waited=$((waited + 1))
+done
+
+i=1
+while [ "$i" -le "$clients" ]; do
+    # shellcheck disable=SC2086 # CLIENT_ARGS is split on purpose
+    "$client" -basedir "$basedir" -port "$port" $CLIENT_ARGS +name "client$i" +connect 127.0.0.1 \
+        </dev/null >"$logs/client$i.log" 2>&1 &
+    pids="$pids $!"
+    i=$((i + 1))
+done
+
+# the server prints "<name> entered the game" when it spawns a client, which
+# is the last signon stage that needs the server
+waited=0
+while [ "$(grep -c "entered the game" "$logs/server.log")" -lt "$clients" ]; do
+    for pid in $pids; do
+        kill -0 "$pid" 2>/dev/null || fail "a process exited before every client was in"
+    done
+    [ "$waited" -lt "$timeout" ] || fail "not every client was in after $timeout seconds"
+    sleep 1
+    waited=$((waited + 1))
+done
+
+# none of them dropped while they finished the signon and started to play
+sleep 3
+echo status >&3
+sleep 1
+for pid in $pids; do
+    kill -0 "$pid" 2>/dev/null || fail "a process exited after every client was in"
+done
+grep -q "players: $clients active" "$logs/server.log" || fail "not every client is still connected"
+i=1
+while [ "$i" -le "$clients" ]; do
+    grep -q "client$i entered the game" "$logs/server.log" || fail "client$i didn't get in"
+    i=$((i + 1))
+done
+
+echo "PASS: $clients clients signed on to $map"
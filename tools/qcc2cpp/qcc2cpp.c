@@ -0,0 +1,752 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// qcc2cpp.c -- compiles a progs.dat ahead of time into one C++ function per QuakeC function
+//
+// usage: qcc2cpp <progs.dat> <pr_aot.c>
+//
+// The generated code works on the same pr_globals and edicts as the interpreter, so
+// it only fits the exact progs.dat it was built from. The engine checks pr_crc before
+// using it. Functions the compiler can't prove well formed are left to the interpreter.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+typedef float vec3_t[3];
+
+#include "pr_comp.h"
+#include "progdefs.h"
+
+static byte *progs_data;
+static int progs_size;
+static dprograms_t *progs;
+static dstatement_t *statements;
+static dfunction_t *functions;
+static ddef_t *globaldefs;
+static char *strings;
+static int *globals;
+
+static byte *immutable; // per global, never written by the progs or the engine
+static byte *compiled;  // per function
+static int *labels;     // per statement, branch target of the function being emitted
+
+static FILE *out;
+
+/*
+================
+Error
+================
+*/
+static void Error(char const *error, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, error);
+    fprintf(stderr, "qcc2cpp: ");
+    vfprintf(stderr, error, argptr);
+    fprintf(stderr, "\n");
+    va_end(argptr);
+    exit(1);
+}
+
+/*
+================
+LittleLong
+================
+*/
+static int LittleLong(int l)
+{
+    byte *b = (byte *)&l;
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned)b[3] << 24);
+}
+
+/*
+================
+LittleShort
+================
+*/
+static unsigned short LittleShort(unsigned short s)
+{
+    byte *b = (byte *)&s;
+    return b[0] | (b[1] << 8);
+}
+
+/*
+================
+CRC_Block
+
+The same CCITT crc as crc.c, pr_crc covers the whole file
+================
+*/
+static unsigned short CRC_Block(byte const *data, int size)
+{
+    unsigned short crc = 0xffff;
+    int i, j;
+
+    for (i = 0; i < size; i++) {
+        crc ^= data[i] << 8;
+        for (j = 0; j < 8; j++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+/*
+================
+LoadProgs
+================
+*/
+static void LoadProgs(char const *filename)
+{
+    FILE *f;
+    int i;
+
+    f = fopen(filename, "rb");
+    if (!f)
+        Error("couldn't open %s", filename);
+    fseek(f, 0, SEEK_END);
+    progs_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    progs_data = (byte *)malloc(progs_size);
+    if (fread(progs_data, 1, progs_size, f) != (size_t)progs_size)
+        Error("couldn't read %s", filename);
+    fclose(f);
+
+    if (progs_size < (int)sizeof(dprograms_t))
+        Error("%s is too short", filename);
+
+    progs = (dprograms_t *)progs_data;
+    for (i = 0; i < (int)(sizeof(*progs) / 4); i++)
+        ((int *)progs)[i] = LittleLong(((int *)progs)[i]);
+
+    if (progs->version != PROG_VERSION)
+        Error("%s has wrong version number (%i should be %i)", filename, progs->version, PROG_VERSION);
+    if (progs->crc != PROGHEADER_CRC)
+        Error("%s system vars don't match progdefs.h", filename);
+    if (progs->numstatements <= 0 || progs->numfunctions <= 0 || progs->numglobals <= 0)
+        Error("%s is empty", filename);
+
+    statements = (dstatement_t *)(progs_data + progs->ofs_statements);
+    functions = (dfunction_t *)(progs_data + progs->ofs_functions);
+    globaldefs = (ddef_t *)(progs_data + progs->ofs_globaldefs);
+    strings = (char *)progs_data + progs->ofs_strings;
+    globals = (int *)(progs_data + progs->ofs_globals);
+
+    for (i = 0; i < progs->numstatements; i++) {
+        statements[i].op = LittleShort(statements[i].op);
+        statements[i].a = LittleShort(statements[i].a);
+        statements[i].b = LittleShort(statements[i].b);
+        statements[i].c = LittleShort(statements[i].c);
+    }
+    for (i = 0; i < progs->numfunctions; i++) {
+        functions[i].first_statement = LittleLong(functions[i].first_statement);
+        functions[i].parm_start = LittleLong(functions[i].parm_start);
+        functions[i].s_name = LittleLong(functions[i].s_name);
+        functions[i].locals = LittleLong(functions[i].locals);
+        functions[i].numparms = LittleLong(functions[i].numparms);
+    }
+    for (i = 0; i < progs->numglobaldefs; i++) {
+        globaldefs[i].type = LittleShort(globaldefs[i].type);
+        globaldefs[i].ofs = LittleShort(globaldefs[i].ofs);
+    }
+    for (i = 0; i < progs->numglobals; i++)
+        globals[i] = LittleLong(globals[i]);
+}
+
+/*
+====================
+FindImmutable
+
+A global the progs never write, that isn't a parm, a system global or saved
+in savegames holds its progs.dat value forever and can become a literal
+====================
+*/
+static void MarkWritten(int ofs, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+        if (ofs + i < progs->numglobals)
+            immutable[ofs + i] = 0;
+}
+
+static void FindImmutable(void)
+{
+    dstatement_t *st;
+    dfunction_t *f;
+    int i, j, o;
+
+    immutable = (byte *)malloc(progs->numglobals);
+    for (i = 0; i < progs->numglobals; i++)
+        immutable[i] = i >= (int)(sizeof(globalvars_t) / 4); // includes the RESERVED_OFS parms
+
+    for (i = 0; i < progs->numglobaldefs; i++)
+        if (globaldefs[i].type & DEF_SAVEGLOBAL)
+            MarkWritten(globaldefs[i].ofs, (globaldefs[i].type & ~DEF_SAVEGLOBAL) == ev_vector ? 3 : 1);
+
+    // PR_EnterFunction copies the parms in, the rest of the locals are saved and
+    // restored unchanged, so constants the compiler placed among them still qualify
+    for (i = 0, f = functions; i < progs->numfunctions; i++, f++)
+        if (f->first_statement >= 0)
+            for (j = 0, o = f->parm_start; j < f->numparms && j < MAX_PARMS; o += f->parm_size[j], j++)
+                MarkWritten(o, f->parm_size[j]);
+
+    for (i = 0, st = statements; i < progs->numstatements; i++, st++) {
+        switch (st->op) {
+        case OP_ADD_V:
+        case OP_SUB_V:
+        case OP_MUL_FV:
+        case OP_MUL_VF:
+        case OP_LOAD_V:
+            MarkWritten((unsigned short)st->c, 3);
+            break;
+        case OP_STORE_V:
+            MarkWritten((unsigned short)st->b, 3);
+            break;
+        case OP_STORE_F:
+        case OP_STORE_S:
+        case OP_STORE_ENT:
+        case OP_STORE_FLD:
+        case OP_STORE_FNC:
+            MarkWritten((unsigned short)st->b, 1);
+            break;
+        case OP_STOREP_F:
+        case OP_STOREP_V:
+        case OP_STOREP_S:
+        case OP_STOREP_ENT:
+        case OP_STOREP_FLD:
+        case OP_STOREP_FNC:
+        case OP_RETURN:
+        case OP_DONE:
+        case OP_IF:
+        case OP_IFNOT:
+        case OP_GOTO:
+        case OP_STATE:
+            break;
+        default:
+            if (st->op >= OP_CALL0 && st->op <= OP_CALL8)
+                break;
+            MarkWritten((unsigned short)st->c, 1);
+            break;
+        }
+    }
+}
+
+/*
+================
+FunctionEnd
+================
+*/
+static int FunctionEnd(dfunction_t *f)
+{
+    int i, end;
+
+    end = progs->numstatements;
+    for (i = 0; i < progs->numfunctions; i++)
+        if (functions[i].first_statement > f->first_statement && functions[i].first_statement < end)
+            end = functions[i].first_statement;
+    return end;
+}
+
+/*
+================
+BranchTarget
+================
+*/
+static int BranchTarget(int s)
+{
+    dstatement_t *st = &statements[s];
+
+    if (st->op == OP_IF || st->op == OP_IFNOT)
+        return s + st->b;
+    if (st->op == OP_GOTO)
+        return s + st->a;
+    return -1;
+}
+
+/*
+====================
+CanCompile
+
+Only functions whose branches stay inside them and which can't run off their
+last statement are compiled, anything odd is left to the interpreter
+====================
+*/
+static int CanCompile(dfunction_t *f)
+{
+    int s, end, target;
+
+    if (f->first_statement <= 0)
+        return 0;
+    end = FunctionEnd(f);
+    if (end <= f->first_statement)
+        return 0;
+
+    for (s = f->first_statement; s < end; s++) {
+        if (statements[s].op > OP_BITOR)
+            return 0;
+        target = BranchTarget(s);
+        if (target >= 0 && (target < f->first_statement || target >= end))
+            return 0;
+        if (statements[s].op == OP_IF || statements[s].op == OP_IFNOT)
+            if (target < 0)
+                return 0;
+    }
+
+    s = statements[end - 1].op;
+    return s == OP_RETURN || s == OP_DONE || s == OP_GOTO;
+}
+
+/*
+================
+FunctionName
+================
+*/
+static char const *FunctionName(int fnum)
+{
+    static char name[128];
+    char const *src;
+    int i;
+
+    i = snprintf(name, sizeof(name), "qc_%i_", fnum);
+    for (src = strings + functions[fnum].s_name; *src && i < (int)sizeof(name) - 1; src++, i++)
+        name[i] = (*src >= 'a' && *src <= 'z') || (*src >= 'A' && *src <= 'Z') || (*src >= '0' && *src <= '9')
+                      ? *src
+                      : '_';
+    name[i] = 0;
+    return name;
+}
+
+/*
+====================
+Operands
+
+Each returns a C++ expression for reading a global, as a literal when it can
+never change. The returned buffers rotate so several fit in one printf.
+====================
+*/
+static char *NextBuffer(void)
+{
+    static char buffers[8][64];
+    static int next;
+
+    return buffers[next++ & 7];
+}
+
+static char const *Int(int ofs)
+{
+    char *buf = NextBuffer();
+
+    if (ofs < progs->numglobals && immutable[ofs])
+        snprintf(buf, 64, "%i", globals[ofs]);
+    else
+        snprintf(buf, 64, "E(%i)->_int", ofs);
+    return buf;
+}
+
+static char const *Float(int ofs)
+{
+    char *buf = NextBuffer();
+    float value;
+
+    if (ofs < progs->numglobals && immutable[ofs]) {
+        memcpy(&value, &globals[ofs], sizeof(value));
+        if (isfinite(value)) {
+            snprintf(buf, 64, "(%af)", (double)value);
+            return buf;
+        }
+    }
+    snprintf(buf, 64, "E(%i)->_float", ofs);
+    return buf;
+}
+
+/*
+================
+Emit
+================
+*/
+static void Emit(char const *fmt, ...)
+{
+    va_list argptr;
+
+    fprintf(out, "    ");
+    va_start(argptr, fmt);
+    vfprintf(out, fmt, argptr);
+    va_end(argptr);
+    fprintf(out, "\n");
+}
+
+/*
+================
+EmitBranch
+================
+*/
+static void EmitBranch(int s, char const *condition, int target)
+{
+    // only backwards branches can loop, so that's where the runaway budget is spent
+    if (target <= s)
+        Emit("if (%s) { PR_AOT_LOOP(%i); goto s%i; }", condition, s, target);
+    else
+        Emit("if (%s) goto s%i;", condition, target);
+}
+
+/*
+================
+EmitCall
+================
+*/
+static void EmitCall(int s, int a, int argc)
+{
+    dfunction_t *f;
+    int fnum;
+
+    Emit("pr_xstatement = %i;", s);
+    Emit("pr_argc = %i;", argc);
+
+    if (!immutable[a]) {
+        Emit("PR_AotCall(E(%i)->function, %i);", a, argc);
+        return;
+    }
+
+    fnum = globals[a];
+    if (!fnum) {
+        Emit("PR_RunError(\"NULL function\");");
+        return;
+    }
+    if (fnum < 0 || fnum >= progs->numfunctions) {
+        Emit("PR_AotCall(%i, %i);", fnum, argc);
+        return;
+    }
+
+    f = &functions[fnum];
+    if (f->first_statement < 0)
+        Emit("PR_CallBuiltin<%i>(); // %s", -f->first_statement, strings + f->s_name);
+    else if (compiled[fnum])
+        Emit("%s();", FunctionName(fnum));
+    else
+        Emit("PR_AotCall(%i, %i); // %s", fnum, argc, strings + f->s_name);
+}
+
+/*
+================
+EmitStatement
+================
+*/
+static void EmitStatement(int s)
+{
+    dstatement_t *st = &statements[s];
+    int a = (unsigned short)st->a;
+    int b = (unsigned short)st->b;
+    int c = (unsigned short)st->c;
+    char condition[80];
+    int i;
+
+    switch (st->op) {
+    case OP_ADD_F:
+        Emit("E(%i)->_float = %s + %s;", c, Float(a), Float(b));
+        break;
+    case OP_SUB_F:
+        Emit("E(%i)->_float = %s - %s;", c, Float(a), Float(b));
+        break;
+    case OP_MUL_F:
+        Emit("E(%i)->_float = %s * %s;", c, Float(a), Float(b));
+        break;
+    case OP_DIV_F:
+        Emit("E(%i)->_float = %s / %s;", c, Float(a), Float(b));
+        break;
+    case OP_ADD_V:
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_float = %s + %s;", c + i, Float(a + i), Float(b + i));
+        break;
+    case OP_SUB_V:
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_float = %s - %s;", c + i, Float(a + i), Float(b + i));
+        break;
+    case OP_MUL_V:
+        Emit("E(%i)->_float = %s * %s + %s * %s + %s * %s;", c, Float(a), Float(b), Float(a + 1), Float(b + 1),
+             Float(a + 2), Float(b + 2));
+        break;
+    case OP_MUL_FV:
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_float = %s * %s;", c + i, Float(a), Float(b + i));
+        break;
+    case OP_MUL_VF:
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_float = %s * %s;", c + i, Float(b), Float(a + i));
+        break;
+
+    case OP_BITAND:
+        Emit("E(%i)->_float = (int)%s & (int)%s;", c, Float(a), Float(b));
+        break;
+    case OP_BITOR:
+        Emit("E(%i)->_float = (int)%s | (int)%s;", c, Float(a), Float(b));
+        break;
+
+    case OP_GE:
+        Emit("E(%i)->_float = %s >= %s;", c, Float(a), Float(b));
+        break;
+    case OP_LE:
+        Emit("E(%i)->_float = %s <= %s;", c, Float(a), Float(b));
+        break;
+    case OP_GT:
+        Emit("E(%i)->_float = %s > %s;", c, Float(a), Float(b));
+        break;
+    case OP_LT:
+        Emit("E(%i)->_float = %s < %s;", c, Float(a), Float(b));
+        break;
+    case OP_AND:
+        Emit("E(%i)->_float = %s && %s;", c, Float(a), Float(b));
+        break;
+    case OP_OR:
+        Emit("E(%i)->_float = %s || %s;", c, Float(a), Float(b));
+        break;
+
+    case OP_NOT_F:
+        Emit("E(%i)->_float = !%s;", c, Float(a));
+        break;
+    case OP_NOT_V:
+        Emit("E(%i)->_float = !%s && !%s && !%s;", c, Float(a), Float(a + 1), Float(a + 2));
+        break;
+    case OP_NOT_S:
+        Emit("E(%i)->_float = !%s || !pr_strings[%s];", c, Int(a), Int(a));
+        break;
+    case OP_NOT_FNC:
+        Emit("E(%i)->_float = !%s;", c, Int(a));
+        break;
+    case OP_NOT_ENT:
+        Emit("E(%i)->_float = PROG_TO_EDICT(%s) == sv.edicts;", c, Int(a));
+        break;
+
+    case OP_EQ_F:
+        Emit("E(%i)->_float = %s == %s;", c, Float(a), Float(b));
+        break;
+    case OP_EQ_V:
+        Emit("E(%i)->_float = %s == %s && %s == %s && %s == %s;", c, Float(a), Float(b), Float(a + 1), Float(b + 1),
+             Float(a + 2), Float(b + 2));
+        break;
+    case OP_EQ_S:
+        Emit("E(%i)->_float = !strcmp(pr_strings + %s, pr_strings + %s);", c, Int(a), Int(b));
+        break;
+    case OP_EQ_E:
+    case OP_EQ_FNC:
+        Emit("E(%i)->_float = %s == %s;", c, Int(a), Int(b));
+        break;
+
+    case OP_NE_F:
+        Emit("E(%i)->_float = %s != %s;", c, Float(a), Float(b));
+        break;
+    case OP_NE_V:
+        Emit("E(%i)->_float = %s != %s || %s != %s || %s != %s;", c, Float(a), Float(b), Float(a + 1), Float(b + 1),
+             Float(a + 2), Float(b + 2));
+        break;
+    case OP_NE_S:
+        Emit("E(%i)->_float = strcmp(pr_strings + %s, pr_strings + %s);", c, Int(a), Int(b));
+        break;
+    case OP_NE_E:
+    case OP_NE_FNC:
+        Emit("E(%i)->_float = %s != %s;", c, Int(a), Int(b));
+        break;
+
+    case OP_STORE_F:
+    case OP_STORE_ENT:
+    case OP_STORE_FLD:
+    case OP_STORE_S:
+    case OP_STORE_FNC:
+        Emit("E(%i)->_int = %s;", b, Int(a));
+        break;
+    case OP_STORE_V:
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_int = %s;", b + i, Int(a + i));
+        break;
+
+    case OP_STOREP_F:
+    case OP_STOREP_ENT:
+    case OP_STOREP_FLD:
+    case OP_STOREP_FNC:
+        Emit("POINTER(%s)->_int = %s;", Int(b), Int(a));
+        break;
+    case OP_STOREP_S:
+        Emit("POINTER(%s)->_int = %s;", Int(b), Int(a));
+        Emit("PF_FindStored(%s);", Int(b));
+        break;
+    case OP_STOREP_V:
+        Emit("ptr = POINTER(%s);", Int(b));
+        for (i = 0; i < 3; i++)
+            Emit("((int *)ptr)[%i] = %s;", i, Int(a + i));
+        break;
+
+    case OP_ADDRESS:
+        Emit("ed = PROG_TO_EDICT(%s);", Int(a));
+        Emit("if (ed == (edict_t *)sv.edicts && sv.state == ss_active) {");
+        Emit("    pr_xstatement = %i;", s);
+        Emit("    PR_RunError(\"assignment to world entity\");");
+        Emit("}");
+        Emit("E(%i)->_int = (byte *)((int *)&ed->v + %s) - (byte *)sv.edicts;", c, Int(b));
+        break;
+
+    case OP_LOAD_F:
+    case OP_LOAD_FLD:
+    case OP_LOAD_ENT:
+    case OP_LOAD_S:
+    case OP_LOAD_FNC:
+        Emit("E(%i)->_int = FIELD(%s, %s)->_int;", c, Int(a), Int(b));
+        break;
+    case OP_LOAD_V:
+        Emit("ptr = FIELD(%s, %s);", Int(a), Int(b));
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_float = ptr->vector[%i];", c + i, i);
+        break;
+
+    case OP_IFNOT:
+        snprintf(condition, sizeof(condition), "!%s", Int(a));
+        EmitBranch(s, condition, s + st->b);
+        break;
+    case OP_IF:
+        EmitBranch(s, Int(a), s + st->b);
+        break;
+    case OP_GOTO:
+        EmitBranch(s, "true", s + st->a);
+        break;
+
+    case OP_DONE:
+    case OP_RETURN:
+        for (i = 0; i < 3; i++)
+            Emit("E(%i)->_int = %s;", OFS_RETURN + i, Int(a + i));
+        Emit("PR_LeaveFunction();");
+        Emit("return;");
+        break;
+
+    case OP_STATE:
+        Emit("ed = PROG_TO_EDICT(pr_global_struct->self);");
+        Emit("ed->v.nextthink = pr_global_struct->time + 0.1f;");
+        Emit("if (%s != ed->v.frame)", Float(a));
+        Emit("    ed->v.frame = %s;", Float(a));
+        Emit("ed->v.think = %s;", Int(b));
+        break;
+
+    default:
+        if (st->op >= OP_CALL0 && st->op <= OP_CALL8) {
+            EmitCall(s, a, st->op - OP_CALL0);
+            break;
+        }
+        Error("statement %i: unhandled opcode %i", s, st->op);
+    }
+}
+
+/*
+====================
+EmitFunction
+
+Locals live in pr_globals exactly as for the interpreter, PR_EnterFunction
+and PR_LeaveFunction keep the stack, parms and error traces compatible
+====================
+*/
+static void EmitFunction(int fnum)
+{
+    dfunction_t *f = &functions[fnum];
+    int s, end, target;
+
+    end = FunctionEnd(f);
+    for (s = f->first_statement; s < end; s++)
+        labels[s] = 0;
+    for (s = f->first_statement; s < end; s++) {
+        target = BranchTarget(s);
+        if (target >= 0)
+            labels[target] = 1;
+    }
+
+    fprintf(out, "\n// %s, statements %i-%i\n", strings + f->s_name, f->first_statement, end - 1);
+    fprintf(out, "static void %s(void)\n{\n", FunctionName(fnum));
+    Emit("float *const g = pr_globals;");
+    Emit("edict_t *ed;");
+    Emit("eval_t *ptr;");
+    Emit("(void)ed;");
+    Emit("(void)ptr;");
+    fprintf(out, "\n");
+    Emit("PR_EnterFunction(&pr_functions[%i]);", fnum);
+
+    for (s = f->first_statement; s < end; s++) {
+        if (labels[s])
+            fprintf(out, "s%i:;\n", s);
+        EmitStatement(s);
+    }
+    fprintf(out, "}\n");
+}
+
+/*
+================
+main
+================
+*/
+int main(int argc, char **argv)
+{
+    int i, count;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: qcc2cpp <progs.dat> <output.c>\n");
+        return 1;
+    }
+
+    LoadProgs(argv[1]);
+    FindImmutable();
+
+    compiled = (byte *)calloc((unsigned)progs->numfunctions, 1);
+    labels = (int *)calloc((unsigned)progs->numstatements, sizeof(int));
+    for (i = count = 0; i < progs->numfunctions; i++)
+        count += compiled[i] = CanCompile(&functions[i]);
+
+    out = fopen(argv[2], "w");
+    if (!out)
+        Error("couldn't write %s", argv[2]);
+
+    fprintf(out, "// generated by qcc2cpp from %s, don't edit\n\n", argv[1]);
+    fprintf(out, "#include \"quakedef.h\"\n");
+    fprintf(out, "#include \"pr_aot.h\"\n");
+    fprintf(out, "#include \"pr_builtins.h\"\n\n");
+    fprintf(out, "#define E(o) ((eval_t *)&g[o])\n");
+    fprintf(out, "#define FIELD(e, o) ((eval_t *)((int *)&PROG_TO_EDICT(e)->v + (o)))\n");
+    fprintf(out, "#define POINTER(p) ((eval_t *)((byte *)sv.edicts + (p)))\n\n");
+
+    for (i = 0; i < progs->numfunctions; i++)
+        if (compiled[i])
+            fprintf(out, "static void %s(void);\n", FunctionName(i));
+
+    for (i = 0; i < progs->numfunctions; i++)
+        if (compiled[i])
+            EmitFunction(i);
+
+    fprintf(out, "\nunsigned short const pr_aot_crc = %i;\n", CRC_Block(progs_data, progs_size));
+    fprintf(out, "int const pr_aot_numstatements = %i;\n", progs->numstatements);
+    fprintf(out, "int const pr_aot_numfunctions = %i;\n\n", progs->numfunctions);
+    fprintf(out, "pr_native_t const pr_aot_functions[] = {\n");
+    for (i = 0; i < progs->numfunctions; i++)
+        fprintf(out, "    %s,\n", compiled[i] ? FunctionName(i) : "NULL");
+    fprintf(out, "};\n");
+
+    if (fclose(out))
+        Error("couldn't write %s", argv[2]);
+
+    printf("qcc2cpp: compiled %i of %i functions\n", count, progs->numfunctions);
+    return 0;
+}